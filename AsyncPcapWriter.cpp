@@ -0,0 +1,360 @@
+#include "AsyncPcapWriter.h"
+
+#include <cstring>
+
+#include <chrono>
+
+#include "PacketPool.h"
+
+constexpr uint32_t AsyncPcapWriter::WRAP_MARKER;
+constexpr uint32_t AsyncPcapWriter::ENTRY_ALIGNMENT;
+constexpr size_t AsyncPcapWriter::DRAIN_BATCH_PACKETS;
+
+AsyncPcapWriter::AsyncPcapWriter(size_t ring_size, overflow_policy policy)
+: ring_mask(0)
+, policy(policy)
+, head(0)
+, tail(0)
+, pcap_sink(nullptr)
+, snapshot_length(writer.snaplen())
+, batch(DRAIN_BATCH_PACKETS)
+, batch_entries(DRAIN_BATCH_PACKETS)
+, running(false)
+, failed(false)
+, dropped_packet_count(0)
+, dropped_byte_count(0)
+, written_packet_count(0)
+{
+	// Positions wrap modulo 2^32, so the ring size must be a power of two which divides it.
+	size_t size = 256 * 1024;
+	while (size < ring_size && size < (size_t(1) << 31))
+		size <<= 1;
+
+	ring.resize(size);
+	ring_mask = static_cast<uint32_t>(size - 1);
+}
+
+AsyncPcapWriter::~AsyncPcapWriter()
+{
+	stop();
+}
+
+uint32_t AsyncPcapWriter::read_position(uint64_t tail_value)
+{
+	return static_cast<uint32_t>(tail_value >> 32);
+}
+
+uint32_t AsyncPcapWriter::claim_position(uint64_t tail_value)
+{
+	return static_cast<uint32_t>(tail_value);
+}
+
+uint64_t AsyncPcapWriter::make_tail(uint32_t read, uint32_t claim)
+{
+	return (static_cast<uint64_t>(read) << 32) | claim;
+}
+
+int AsyncPcapWriter::start(PcapSink* sink, uint32_t link_type)
+{
+	if (writer_thread.joinable())
+		return -1;
+
+	const int result = writer.write_pcap_header(sink, link_type);
+	if (result < 0)
+		return -1;
+
+	pcap_sink = sink;
+	head.store(0, std::memory_order_relaxed);
+	tail.store(0, std::memory_order_relaxed);
+	failed.store(false, std::memory_order_relaxed);
+	running.store(true, std::memory_order_release);
+	writer_thread = std::thread(&AsyncPcapWriter::drain, this);
+
+	return result;
+}
+
+void AsyncPcapWriter::set_snaplen(uint32_t snaplen)
+{
+	writer.set_snaplen(snaplen);
+	snapshot_length = writer.snaplen();
+}
+
+void AsyncPcapWriter::set_stats(WriterStats* stats)
+{
+	writer.set_stats(stats);
+}
+
+bool AsyncPcapWriter::stop()
+{
+	if (!writer_thread.joinable())
+		return !failed.load(std::memory_order_acquire);
+
+	running.store(false, std::memory_order_release);
+	writer_thread.join();
+
+	const bool flushed = writer.flush();
+	pcap_sink = nullptr;
+	return flushed && !failed.load(std::memory_order_acquire);
+}
+
+uint32_t AsyncPcapWriter::entry_at(uint32_t position, const entry_t** entry) const
+{
+	const uint32_t ring_size = ring_mask + 1;
+	uint32_t offset = position & ring_mask;
+
+	// Tail of the ring is padding if it is too small for an entry header, or if it holds a wrap marker.
+	if (ring_size - offset < sizeof(entry_t))
+		position += ring_size - offset;
+	else if (reinterpret_cast<const entry_t*>(&ring[offset])->frame_size == WRAP_MARKER)
+		position += reinterpret_cast<const entry_t*>(&ring[offset])->entry_size;
+
+	*entry = reinterpret_cast<const entry_t*>(&ring[position & ring_mask]);
+	return position;
+}
+
+bool AsyncPcapWriter::drop_oldest(uint32_t needed)
+{
+	const uint32_t ring_size = ring_mask + 1;
+	const uint32_t head_position = head.load(std::memory_order_relaxed);
+
+	uint64_t tail_value = tail.load(std::memory_order_acquire);
+	while (ring_size - (head_position - read_position(tail_value)) < needed)
+	{
+		// Entries taken by the writer thread are in use, and an empty ring has nothing to discard.
+		const uint32_t claim = claim_position(tail_value);
+		if (read_position(tail_value) != claim || claim == head_position)
+			return false;
+
+		const entry_t* entry = nullptr;
+		const uint32_t next = entry_at(claim, &entry) + entry->entry_size;
+		const uint32_t frame_size = entry->frame_size;
+		if (tail.compare_exchange_weak(tail_value, make_tail(next, next), std::memory_order_acq_rel))
+		{
+			// The entry is the producer's again, so its buffer is returned before the room is reused.
+			release_buffer(entry);
+			dropped_packet_count.fetch_add(1, std::memory_order_relaxed);
+			dropped_byte_count.fetch_add(frame_size, std::memory_order_relaxed);
+			tail_value = make_tail(next, next);
+		}
+	}
+
+	return true;
+}
+
+int AsyncPcapWriter::write_packet(const char* frame, uint32_t frame_size, timeval time)
+{
+	if (!pcap_sink || failed.load(std::memory_order_relaxed))
+		return -1;
+
+	// Bytes beyond snaplen are never written, so they are not copied either.
+	const uint32_t original_size = frame_size;
+	if (frame_size > snapshot_length)
+		frame_size = snapshot_length;
+
+	const uint32_t needed = (static_cast<uint32_t>(sizeof(entry_t)) + frame_size + ENTRY_ALIGNMENT - 1)
+		/ ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+
+	uint32_t position = 0;
+	const int reserved = reserve(needed, frame_size, &position);
+	if (reserved <= 0)
+		return reserved;
+
+	entry_t* entry = reinterpret_cast<entry_t*>(&ring[position & ring_mask]);
+	entry->entry_size = needed;
+	entry->frame_size = frame_size;
+	entry->original_size = original_size;
+	entry->buffer_class = 0;
+	entry->time = time;
+	memcpy(entry + 1, frame, frame_size);
+
+	head.store(position + needed, std::memory_order_release);
+
+	// Number of bytes which will be written to file.
+	return static_cast<int>(frame_size + 16);		// Record header is 16 bytes.
+}
+
+int AsyncPcapWriter::write_packet(PacketBuffer buffer)
+{
+	if (!pcap_sink || failed.load(std::memory_order_relaxed) || !buffer)
+		return -1;
+
+	const uint32_t original_size = buffer.size();
+	const uint32_t frame_size = original_size < snapshot_length ? original_size : snapshot_length;
+	const uint32_t needed = (static_cast<uint32_t>(sizeof(entry_t) + sizeof(pooled_t)) + ENTRY_ALIGNMENT - 1)
+		/ ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+
+	// A dropped packet's buffer goes back to the pool when the handle is destroyed.
+	uint32_t position = 0;
+	const int reserved = reserve(needed, frame_size, &position);
+	if (reserved <= 0)
+		return reserved;
+
+	entry_t* entry = reinterpret_cast<entry_t*>(&ring[position & ring_mask]);
+	pooled_t* pooled = reinterpret_cast<pooled_t*>(entry + 1);
+	uint32_t size_class = 0;
+	entry->entry_size = needed;
+	entry->frame_size = frame_size;
+	entry->original_size = original_size;
+	entry->time = buffer.time();
+	pooled->data = buffer.data();
+	pooled->pool = buffer.detach(&size_class, &pooled->index);
+	entry->buffer_class = size_class + 1;
+
+	head.store(position + needed, std::memory_order_release);
+
+	// Number of bytes which will be written to file.
+	return static_cast<int>(frame_size + 16);		// Record header is 16 bytes.
+}
+
+int AsyncPcapWriter::reserve(uint32_t needed, uint32_t frame_size, uint32_t* position)
+{
+	const uint32_t ring_size = ring_mask + 1;
+
+	// Entries of up to half the ring always fit after skipping the padding at the end of it.
+	if (needed > ring_size / 2)
+	{
+		dropped_packet_count.fetch_add(1, std::memory_order_relaxed);
+		dropped_byte_count.fetch_add(frame_size, std::memory_order_relaxed);
+		return 0;
+	}
+
+	const uint32_t head_position = head.load(std::memory_order_relaxed);
+	const uint32_t offset = head_position & ring_mask;
+
+	// Entries never wrap, so the rest of the ring is skipped if the entry does not fit in it.
+	const uint32_t padding = ring_size - offset < needed ? ring_size - offset : 0;
+
+	while (ring_size - (head_position - read_position(tail.load(std::memory_order_acquire))) < padding + needed)
+	{
+		switch (policy)
+		{
+			case overflow_policy::block:
+				if (failed.load(std::memory_order_relaxed))
+					return -1;
+
+				std::this_thread::yield();
+				continue;
+			case overflow_policy::drop_oldest:
+				if (drop_oldest(padding + needed))
+					continue;
+
+				break;
+			case overflow_policy::drop_newest:
+				break;
+		}
+
+		dropped_packet_count.fetch_add(1, std::memory_order_relaxed);
+		dropped_byte_count.fetch_add(frame_size, std::memory_order_relaxed);
+		return 0;
+	}
+
+	if (padding >= sizeof(entry_t))
+	{
+		entry_t* marker = reinterpret_cast<entry_t*>(&ring[offset]);
+		marker->entry_size = padding;
+		marker->frame_size = WRAP_MARKER;
+	}
+
+	*position = head_position + padding;
+	return 1;
+}
+
+void AsyncPcapWriter::release_buffer(const entry_t* entry)
+{
+	if (entry->buffer_class != 0)
+	{
+		const pooled_t* pooled = reinterpret_cast<const pooled_t*>(entry + 1);
+		pooled->pool->release(entry->buffer_class - 1, pooled->index);
+	}
+}
+
+void AsyncPcapWriter::drain()
+{
+	unsigned int idle_rounds = 0;
+
+	while (true)
+	{
+		uint64_t tail_value = tail.load(std::memory_order_acquire);
+		const uint32_t claim = claim_position(tail_value);
+		const uint32_t head_position = head.load(std::memory_order_acquire);
+
+		if (head_position == claim)
+		{
+			// Producer is done before running is cleared, so an empty ring after that means everything is written.
+			if (!running.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == claim)
+				break;
+
+			if (++idle_rounds < 64)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+			continue;
+		}
+
+		idle_rounds = 0;
+
+		// Takes every queued entry at once. Fails if the producer has just discarded entries; then retries.
+		if (!tail.compare_exchange_strong(tail_value, make_tail(claim, head_position), std::memory_order_acq_rel))
+			continue;
+
+		uint32_t position = claim;
+		size_t count = 0;
+		size_t pooled_count = 0;
+		while (position != head_position)
+		{
+			const entry_t* entry = nullptr;
+			position = entry_at(position, &entry);
+
+			PcapWriter::packet_t& packet = batch[count++];
+			packet.frame = reinterpret_cast<const char*>(entry + 1);
+			if (entry->buffer_class != 0)
+			{
+				packet.frame = reinterpret_cast<const pooled_t*>(entry + 1)->data;
+				batch_entries[pooled_count++] = entry;
+			}
+			packet.frame_size = entry->frame_size;
+			packet.original_size = entry->original_size;
+			packet.time = entry->time;
+			position += entry->entry_size;
+
+			if (count == DRAIN_BATCH_PACKETS || position == head_position)
+			{
+				// Batches after a failure are not written, so they are not counted either.
+				if (!failed.load(std::memory_order_relaxed))
+				{
+					size_t records = 0;
+					if (writer.write_packets(batch.data(), count, &records) < 0)
+						failed.store(true, std::memory_order_release);
+					else
+						written_packet_count.fetch_add(records, std::memory_order_relaxed);
+				}
+
+				// The frames are in the sink now, or lost if it has failed; either way their buffers are free.
+				for (size_t i = 0; i < pooled_count; ++i)
+					release_buffer(batch_entries[i]);
+
+				count = 0;
+				pooled_count = 0;
+			}
+		}
+
+		// Releases the written entries to the producer.
+		tail.store(make_tail(head_position, head_position), std::memory_order_release);
+	}
+}
+
+uint64_t AsyncPcapWriter::dropped_packets() const
+{
+	return dropped_packet_count.load(std::memory_order_relaxed);
+}
+
+uint64_t AsyncPcapWriter::dropped_bytes() const
+{
+	return dropped_byte_count.load(std::memory_order_relaxed);
+}
+
+uint64_t AsyncPcapWriter::written_packets() const
+{
+	return written_packet_count.load(std::memory_order_relaxed);
+}
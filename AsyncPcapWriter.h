@@ -0,0 +1,263 @@
+#ifndef ASYNC_PCAP_WRITER_H_
+#define ASYNC_PCAP_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "PacketBuffer.h"
+#include "PcapSink.h"
+#include "PcapWriter.h"
+
+/**
+ * This class decouples packet capture from disk writes. The capture thread copies each packet into a preallocated
+ * lock-free single-producer/single-consumer ring, and a dedicated writer thread drains the ring in large batches with
+ * PcapWriter::write_packets(). A disk stall then only fills the ring instead of stalling the capture loop; what
+ * happens when the ring is full is decided by the overflow policy.
+ *
+ * Only one thread may call write_packet() on an instance. Use one instance (and one output file) per capture thread.
+ *
+ * Ring entries are 8-byte aligned and never wrap around the end of the ring, so every frame is contiguous in ring
+ * memory and is handed to the writer without another copy.
+ *
+ * Packets captured into PacketPool buffers are not copied at all: write_packet(PacketBuffer) queues a reference to the
+ * buffer, and the writer thread returns the buffer to its pool once the batch holding it has been written. The pool
+ * must outlive the writer thread.
+ */
+class AsyncPcapWriter
+{
+public:
+	/// What write_packet() does when the ring has no room for a packet.
+	enum class overflow_policy
+	{
+		/// Waits for the writer thread to free enough room.
+		block,
+
+		/// Drops the packet being written.
+		drop_newest,
+
+		/// Drops the oldest queued packets which the writer thread has not taken yet, or the packet being written
+		/// if the writer thread holds all of them.
+		drop_oldest
+	};
+
+	/**
+	 * @param ring_size Size of ring in bytes, rounded up to a power of two (at least 256 KiB, at most 2 GiB).
+	 * @param policy What write_packet() does when the ring is full.
+	 */
+	explicit AsyncPcapWriter(size_t ring_size = 64 * 1024 * 1024, overflow_policy policy = overflow_policy::block);
+
+	/// Stops the writer thread after draining the ring.
+	~AsyncPcapWriter();
+
+	AsyncPcapWriter(const AsyncPcapWriter&) = delete;
+	AsyncPcapWriter& operator=(const AsyncPcapWriter&) = delete;
+
+	/**
+	 * Writes global header to the given sink and starts the writer thread.
+	 *
+	 * @param sink The output sink; it must outlive the writer thread (see stop()).
+	 * @param link_type Data link layer type (1 = Ethernet).
+	 * @return -1 for failure or number of bytes has been written to the file (header size = 24bytes) for success.
+	 */
+	int start(PcapSink* sink, uint32_t link_type);
+
+	/**
+	 * Sets the snapshot length of the output file (see PcapWriter::set_snaplen()). Only the first snaplen bytes of each
+	 * frame are copied into the ring. It must be called before start().
+	 *
+	 * @param snaplen The snapshot length, greater than zero.
+	 */
+	void set_snaplen(uint32_t snaplen);
+
+	/**
+	 * Sets the statistics of the writer thread and of its sink (see PcapWriter::set_stats()). Packets dropped by the
+	 * ring are not counted there, see dropped_packets(). It must be called before start().
+	 *
+	 * @param stats The statistics, or nullptr not to count.
+	 */
+	void set_stats(WriterStats* stats);
+
+	/**
+	 * Queues packet for writing. The frame is copied into the ring, so it may be reused as soon as this returns.
+	 *
+	 * @param frame Packet data shall to be written in pcap file.
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 * @return Number of bytes which will be written to the file for this packet (record header + frame size
+	 *	truncated to snaplen),
+	 *	"0" if the packet has been dropped,
+	 *	"-1" if the writer is not started or writing to the sink has failed.
+	 */
+	int write_packet(const char* frame, uint32_t frame_size, timeval time);
+
+	/**
+	 * Queues a pool buffer for writing, without copying it. The writer thread returns the buffer to its pool once it
+	 * has been written; if the packet is dropped, the buffer is returned at once.
+	 *
+	 * @param buffer Handle on the filled buffer, with its frame size and timestamp set.
+	 * @return Same as write_packet(const char*, uint32_t, timeval); also "-1" if the handle is empty.
+	 */
+	int write_packet(PacketBuffer buffer);
+
+	/**
+	 * Waits for the writer thread to write every queued packet, then stops it. The sink is flushed, but not closed.
+	 *
+	 * @return True if every dequeued packet has been written successfully; otherwise false.
+	 */
+	bool stop();
+
+	/// @return Number of packets dropped because the ring was full.
+	uint64_t dropped_packets() const;
+
+	/// @return Number of frame bytes dropped because the ring was full.
+	uint64_t dropped_bytes() const;
+
+	/// @return Number of packets written to the sink by the writer thread.
+	uint64_t written_packets() const;
+
+private:
+	/// Header of each ring entry, followed by the frame
+	struct entry_t
+	{
+		/// Size of entry including header, frame and alignment padding
+		uint32_t entry_size;
+
+		/// Number of frame bytes in the entry, or WRAP_MARKER if the rest of the ring is padding
+		uint32_t frame_size;
+
+		/// Length of packet before truncation to snaplen
+		uint32_t original_size;
+
+		/// Size class plus one of the pool buffer holding the frame, then followed by a pooled_t instead of the frame;
+		/// 0 if the frame follows
+		uint32_t buffer_class;
+
+		/// Captured packet's timestamp
+		timeval time;
+	};
+
+	/// Reference to a pool buffer, following the header of its entry
+	struct pooled_t
+	{
+		/// Pool of the buffer
+		PacketPool* pool;
+
+		/// Buffer memory
+		const char* data;
+
+		/// Index of the buffer in its size class
+		uint32_t index;
+	};
+
+	/// Frame size of an entry which pads the ring up to its end
+	constexpr static uint32_t WRAP_MARKER = UINT32_MAX;
+
+	/// Alignment of ring entries
+	constexpr static uint32_t ENTRY_ALIGNMENT = 8;
+
+	/// Maximum number of packets given to one PcapWriter::write_packets() call
+	constexpr static size_t DRAIN_BATCH_PACKETS = 1024;
+
+	/**
+	 * Makes room for an entry at head, applying the overflow policy if the ring is full.
+	 *
+	 * @param needed Size of the entry.
+	 * @param frame_size Number of frame bytes of the entry, counted if it is dropped.
+	 * @param position Filled with the ring position of the entry, after any wrap padding.
+	 * @return 1 if the entry shall be filled at position and published, 0 if it has been dropped, or -1 if writing
+	 *	to the sink has failed.
+	 */
+	int reserve(uint32_t needed, uint32_t frame_size, uint32_t* position);
+
+	/// Writer thread main loop.
+	void drain();
+
+	/**
+	 * Returns the pool buffer of an entry, if it has one.
+	 *
+	 * @param entry A ring entry.
+	 */
+	static void release_buffer(const entry_t* entry);
+
+	/**
+	 * Returns position of the entry following the one at position, skipping the wrap padding at the end of the ring.
+	 *
+	 * @param position Ring position of an entry.
+	 * @param entry Filled with the header of the entry at position (after skipping padding).
+	 * @return Ring position of the entry's start after skipping padding.
+	 */
+	uint32_t entry_at(uint32_t position, const entry_t** entry) const;
+
+	/**
+	 * Frees room for an entry under drop_oldest policy by discarding unclaimed entries.
+	 *
+	 * @param needed Number of free bytes needed.
+	 * @return True if enough room has been freed; otherwise false.
+	 */
+	bool drop_oldest(uint32_t needed);
+
+	/// @return Read position packed in the upper half of tail.
+	static uint32_t read_position(uint64_t tail_value);
+
+	/// @return Claim position packed in the lower half of tail.
+	static uint32_t claim_position(uint64_t tail_value);
+
+	/// @return Tail value packing the given read and claim positions.
+	static uint64_t make_tail(uint32_t read, uint32_t claim);
+
+	/// Ring memory
+	std::vector<char> ring;
+
+	/// Ring size minus one, ring size is a power of two
+	uint32_t ring_mask;
+
+	/// Overflow policy of this writer
+	overflow_policy policy;
+
+	/// Position where the producer writes the next entry, positions grow and wrap modulo 2^32
+	std::atomic<uint32_t> head;
+
+	/**
+	 * Read position (upper 32 bits) and claim position (lower 32 bits). Entries in [read, claim) are being written by
+	 * the writer thread, entries in [claim, head) are queued. Both are packed into one word so that the producer can
+	 * discard queued entries with a single compare-and-swap while the writer thread is idle.
+	 */
+	std::atomic<uint64_t> tail;
+
+	/// Writer thread
+	std::thread writer_thread;
+
+	/// Pcap writer used by writer thread
+	PcapWriter writer;
+
+	/// Output sink of the writer thread
+	PcapSink* pcap_sink;
+
+	/// Maximum number of bytes of each frame copied into the ring
+	uint32_t snapshot_length;
+
+	/// Packet descriptors of a drained batch
+	std::vector<PcapWriter::packet_t> batch;
+
+	/// Entries of a drained batch which reference pool buffers, returned once the batch has been written
+	std::vector<const entry_t*> batch_entries;
+
+	/// True while the writer thread shall keep running
+	std::atomic<bool> running;
+
+	/// True if the writer thread has failed to write to the sink
+	std::atomic<bool> failed;
+
+	/// Number of packets dropped because the ring was full
+	std::atomic<uint64_t> dropped_packet_count;
+
+	/// Number of frame bytes dropped because the ring was full
+	std::atomic<uint64_t> dropped_byte_count;
+
+	/// Number of packets written by the writer thread
+	std::atomic<uint64_t> written_packet_count;
+};
+
+#endif
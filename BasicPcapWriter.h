@@ -0,0 +1,1209 @@
+#ifndef BASIC_PCAP_WRITER_H_
+#define BASIC_PCAP_WRITER_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <pcap.h>
+#include <sys/uio.h>
+
+#include "DurabilityPolicy.h"
+#include "FdSink.h"
+#include "PacketDeduplicator.h"
+#include "PacketFilter.h"
+#include "PcapIndex.h"
+#include "PcapSink.h"
+#include "StreamSink.h"
+#include "WriteCoalescer.h"
+#include "WriterStats.h"
+
+/// Resolution of the fractional part of record timestamps
+enum class pcap_ts_resolution
+{
+	/// Microseconds, magic number 0xA1B2C3D4
+	microseconds,
+
+	/// Nanoseconds, magic number 0xA1B23C4D
+	nanoseconds,
+
+	/// Chosen when the global header is written; only meaningful as template argument of BasicPcapWriter
+	runtime
+};
+
+/// Link type template argument of BasicPcapWriter whose link type is chosen when the global header is written
+constexpr uint32_t RUNTIME_LINK_TYPE = UINT32_MAX;
+
+/**
+ * A snapshot length of 65535 should be sufficient, on most if not all networks, to capture all the data available from
+ * the packet. For more information, please read pcap man page.
+ */
+constexpr uint32_t DEFAULT_SNAPLEN = 65535;
+
+/// Snaplen template argument of BasicPcapWriter whose snapshot length is set at run time (see set_snaplen())
+constexpr uint32_t RUNTIME_SNAPLEN = 0;
+
+/// Optional stages of BasicPcapWriter, or-ed together into its Stages template argument
+enum pcap_writer_stage : uint32_t
+{
+	/// No optional stage: only the sink is called for each record
+	PCAP_NO_STAGES = 0,
+
+	/// Packet filter, see BasicPcapWriter::set_filter()
+	PCAP_FILTER_STAGE = 1 << 0,
+
+	/// Remover of duplicate packets, see BasicPcapWriter::set_deduplicator()
+	PCAP_DEDUPLICATOR_STAGE = 1 << 1,
+
+	/// Statistics, see BasicPcapWriter::set_stats()
+	PCAP_STATS_STAGE = 1 << 2,
+
+	/// Sidecar index, see BasicPcapWriter::set_index()
+	PCAP_INDEX_STAGE = 1 << 3,
+
+	/// Output buffer, see BasicPcapWriter::set_coalescing()
+	PCAP_COALESCING_STAGE = 1 << 4,
+
+	/// Durability policy, see BasicPcapWriter::set_durability()
+	PCAP_DURABILITY_STAGE = 1 << 5,
+
+	/// Every optional stage, each of them set or left unset at run time
+	PCAP_ALL_STAGES = (1 << 6) - 1
+};
+
+/// Describes one captured packet for batched writing by write_packets().
+struct pcap_packet_t
+{
+	/// Packet data
+	const char* frame;
+
+	/// Number of bytes available at frame
+	uint32_t frame_size;
+
+	/// Nanoseconds of the timestamp beyond time.tv_usec, from 0 to 999, kept by files with nanosecond resolution
+	uint32_t time_nsec = 0;
+
+	/// Captured packet's timestamp
+	timeval time;
+
+	/// Actual length of packet on the wire; 0, or any value below frame_size, stands for frame_size
+	uint32_t original_size = 0;
+
+	/**
+	 * 802.1Q tag which the capture has stripped from the frame (TPID in the high 16 bits, TCI in the low ones), or 0.
+	 * BasicPcapWriter::write_packets() inserts it after the MAC addresses, where it was on the wire.
+	 */
+	uint32_t vlan_tag = 0;
+};
+
+/**
+ * This class provides well-defined interface for writing network captured data to pcap file. The output file must be
+ * opened by user application, and that file stream, file descriptor or pcap sink (see PcapSink) is used for writing
+ * data to output file. The pcap file has a global header and followed by zero or more data records for each captured
+ * packet. Global header starts at the beginning of pcap file and will be followed by the first packet header. Every
+ * packet starts with record (packet) header (any byte alignment is possible). The actual packet data will immediately
+ * follow record (packet) header.
+ *
+ * Frames longer than the snapshot length (DEFAULT_SNAPLEN by default, see set_snaplen()) are truncated: only the first
+ * snaplen bytes are written, while the record header keeps the original length of the packet.
+ *
+ * Timestamps are written with microsecond resolution by default. With nanosecond resolution the global header carries
+ * the nanosecond magic number (0xA1B23C4D) and the fraction field of every record header holds nanoseconds.
+ *
+ * The template arguments fix at compile time what would otherwise be decided for every packet:
+ *
+ *	- LinkType: data link type of the global header (any 32-bit value), or RUNTIME_LINK_TYPE to pass it to
+ *	  write_pcap_header().
+ *	- TsResolution: timestamp resolution, so the magic number and timestamp scaling are constants, or
+ *	  pcap_ts_resolution::runtime to pass it to write_pcap_header().
+ *	- Sink: type of the output sink. Unless it is abstract, its functions are called directly instead of through the
+ *	  virtual table, so a sink which defines them inline (e.g. MmapSink::write()) is inlined into write_packet(). The
+ *	  sink must then be of exactly that type, not derived from it.
+ *	- Stages: optional stages which can be set (see pcap_writer_stage), PCAP_NO_STAGES by default. Tests of a stage
+ *	  left out are constant false, so they compile to nothing, and its setter fails to compile.
+ *	- Snaplen: snapshot length, DEFAULT_SNAPLEN by default, or RUNTIME_SNAPLEN to pass it to set_snaplen().
+ *
+ * The StreamSink and FdSink used by the fstream and file descriptor overloads of write_pcap_header() are only embedded
+ * when Sink can hold them.
+ *
+ * PcapWriter is the instantiation which decides everything at run time, has every stage and writes to any PcapSink.
+ *
+ * For more information about pcap file format see "http://wiki.wireshark.org/Development/LibpcapFileFormat", and
+ * "/usr/include/pcap/pcap.h" header file and pcap man page.
+ *
+ * Usage:
+ *	BasicPcapWriter<228, pcap_ts_resolution::nanoseconds, MmapSink> writer;		// LINKTYPE_IPV4
+ *	writer.write_pcap_header(&sink);
+ *	writer.write_packet(frame, frame_size, time);
+ */
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages = PCAP_NO_STAGES,
+	uint32_t Snaplen = DEFAULT_SNAPLEN>
+class BasicPcapWriter
+{
+public:
+	/// Resolution of the fractional part of record timestamps
+	typedef pcap_ts_resolution ts_resolution;
+
+	/// Describes one captured packet for batched writing by write_packets().
+	typedef pcap_packet_t packet_t;
+
+	BasicPcapWriter();
+
+	/**
+	 * Sets the snapshot length, the maximum number of bytes of each packet written to file. It is also written to the
+	 * global header, so it must be set before write_pcap_header(). Only available if Snaplen is RUNTIME_SNAPLEN.
+	 *
+	 * @param snaplen The snapshot length, greater than zero.
+	 */
+	void set_snaplen(uint32_t snaplen);
+
+	/// @return The snapshot length.
+	uint32_t snaplen() const;
+
+	/**
+	 * Sets a filter which every packet must pass to be written (see PacketFilter). The filter is not owned by the
+	 * writer and must outlive it. It sees frames as they are written, with a stripped VLAN tag inserted back. Only
+	 * available if Stages has PCAP_FILTER_STAGE.
+	 *
+	 * @param filter The filter, or nullptr to write every packet.
+	 */
+	void set_filter(PacketFilter* filter);
+
+	/**
+	 * Sets a deduplicator which removes duplicate packets after the filter (see PacketDeduplicator). The deduplicator
+	 * is not owned by the writer and must outlive it. Like the filter, it sees frames with their VLAN tag, which it
+	 * only hashes for non-IP packets. Only available if Stages has PCAP_DEDUPLICATOR_STAGE.
+	 *
+	 * @param deduplicator The deduplicator, or nullptr to write duplicate packets.
+	 */
+	void set_deduplicator(PacketDeduplicator* deduplicator);
+
+	/**
+	 * Sets a sidecar index which every written record is added to (see PcapIndex). The index is not owned by the
+	 * writer; it must outlive it and be closed by user application after the last packet has been written. Only
+	 * available if Stages has PCAP_INDEX_STAGE.
+	 *
+	 * @param index The index, or nullptr not to index records.
+	 */
+	void set_index(PcapIndex* index);
+
+	/**
+	 * Sets the statistics which packets, bytes and write latencies of this writer are counted in (see WriterStats).
+	 * They are also set on the output sink, which counts its system calls in them. The statistics are not owned by the
+	 * writer and must outlive it. Only the thread writing packets updates them. Only available if Stages has
+	 * PCAP_STATS_STAGE.
+	 *
+	 * @param stats The statistics, or nullptr not to count.
+	 */
+	void set_stats(WriterStats* stats);
+
+	/**
+	 * Sets the durability policy of the output file (see DurabilityPolicy). At each checkpoint of the policy, the sink
+	 * is flushed and the policy syncs the file in the background. The policy is not owned by the writer and must
+	 * outlive it; starting and stopping it is up to user application. Only available if Stages has
+	 * PCAP_DURABILITY_STAGE.
+	 *
+	 * @param durability The policy, or nullptr to leave syncing to the operating system.
+	 */
+	void set_durability(DurabilityPolicy* durability);
+
+	/**
+	 * Makes the writer gather records in an output buffer of its own and write them to the sink in large writes, at
+	 * an adaptive flush threshold or once the oldest buffered record is max_latency_ms old (see WriteCoalescer).
+	 * Buffered records are written by flush(), which must be called before the sink is closed. Records already
+	 * buffered are written first. Only available if Stages has PCAP_COALESCING_STAGE.
+	 *
+	 * @param buffer_size Size of the buffer in bytes, from WriteCoalescer::MIN_BUFFER_SIZE to MAX_BUFFER_SIZE, or 0 to
+	 *	write every record to the sink directly.
+	 * @param max_latency_ms Maximum time a record stays in the buffer in milliseconds, or 0 for no limit.
+	 * @return True for success; false if the size is out of range or buffered records could not be written.
+	 */
+	bool set_coalescing(size_t buffer_size, unsigned int max_latency_ms = WriteCoalescer::DEFAULT_MAX_LATENCY_MS);
+
+	/// @return The output buffer, to read its flush threshold and counters.
+	const WriteCoalescer& coalescer() const;
+
+	/**
+	 * Writes global header to the beginning of pcap file. You must use this function before writing any captured
+	 * packet data to the pcap file. Only available if Sink is PcapSink.
+	 *
+	 * @param file_stream The output file stream.
+	 * @param link_type Data link layer type (1 = Ethernet); it must be LinkType unless that is RUNTIME_LINK_TYPE.
+	 * @param resolution Resolution of record timestamps; it must be TsResolution unless that is runtime.
+	 * @return -1 for failure or number of bytes has been written to the file (header size = 24bytes) for success.
+	 */
+	int write_pcap_header(std::fstream* file_stream, uint32_t link_type,
+		ts_resolution resolution = default_resolution());
+
+	/**
+	 * Writes global header to the beginning of pcap file opened as a raw file descriptor. Writing to a descriptor
+	 * bypasses the stream buffer and lets write_packets() submit a whole batch with a single writev call. Only
+	 * available if Sink is PcapSink or FdSink.
+	 *
+	 * @param file_descriptor The output file descriptor, opened for writing by the caller.
+	 * @param link_type Data link layer type (1 = Ethernet); it must be LinkType unless that is RUNTIME_LINK_TYPE.
+	 * @param resolution Resolution of record timestamps; it must be TsResolution unless that is runtime.
+	 * @return -1 for failure or number of bytes has been written to the file (header size = 24bytes) for success.
+	 */
+	int write_pcap_header(int file_descriptor, uint32_t link_type, ts_resolution resolution = default_resolution());
+
+	/**
+	 * Writes global header to the beginning of the given pcap sink. The sink is not owned by the writer and must
+	 * outlive it; closing the sink (and so flushing its buffered bytes) is up to user application.
+	 *
+	 * @param sink The output sink.
+	 * @param link_type Data link layer type (1 = Ethernet); it must be LinkType unless that is RUNTIME_LINK_TYPE.
+	 * @param resolution Resolution of record timestamps; it must be TsResolution unless that is runtime.
+	 * @return -1 for failure or number of bytes has been written to the file (header size = 24bytes) for success.
+	 */
+	int write_pcap_header(Sink* sink, uint32_t link_type, ts_resolution resolution = default_resolution());
+
+	/**
+	 * Writes global header with the link type and resolution given as template arguments.
+	 *
+	 * @param sink The output sink.
+	 * @return Same as write_pcap_header() with a link type, and -1 if either template argument is a runtime one.
+	 */
+	int write_pcap_header(Sink* sink);
+
+	/**
+	 * Writes packet info to file. Per-record (packet) header will be created by the given input parameters
+	 * (frame_size and time parameters). It fills per-record header, writes packet header, and packet data,
+	 * all together in the specified pcap output file.
+	 *
+	 * @param frame Packet data shall to be written in pcap file.
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 * @return Number of bytes written to the file.
+	 *	"header size=16 bytes + frame size (truncated to snaplen)" if succeed,
+	 *	"0" if the packet has been rejected by the filter or is a duplicate,
+	 *	"-1" if writing packet header be failed.
+	 *	"-2" if writing data frame be failed.
+	 */
+	inline int write_packet(const char* frame, uint32_t frame_size, timeval time);
+
+	/**
+	 * Writes packet info to file for a packet of which only a part has been captured. The record header keeps the
+	 * original length, and at most snaplen of the captured bytes are written.
+	 *
+	 * @param frame Captured packet data.
+	 * @param frame_size Number of captured bytes available at frame.
+	 * @param original_size Actual length of packet on the wire; a value below frame_size is raised to frame_size, as
+	 *	a record cannot hold more bytes than the packet had.
+	 * @param time Captured packet's timestamp.
+	 * @return Same as write_packet() with timeval timestamp.
+	 */
+	inline int write_packet(const char* frame, uint32_t frame_size, uint32_t original_size, timeval time);
+
+	/**
+	 * Writes packet info to file with a nanosecond timestamp. The timestamp is reduced to microseconds if the file has
+	 * microsecond resolution.
+	 *
+	 * @param frame Packet data shall to be written in pcap file.
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 * @return Same as write_packet() with timeval timestamp.
+	 */
+	inline int write_packet(const char* frame, uint32_t frame_size, timespec time);
+
+	/**
+	 * Writes packet info to file with a timestamp in nanoseconds since the epoch, e.g. a hardware timestamp converted
+	 * by ClockScale. The timestamp is reduced to microseconds if the file has microsecond resolution.
+	 *
+	 * @param frame Packet data shall to be written in pcap file.
+	 * @param frame_size Length of packet.
+	 * @param timestamp Captured packet's timestamp in nanoseconds.
+	 * @return Same as write_packet() with timeval timestamp.
+	 */
+	inline int write_packet(const char* frame, uint32_t frame_size, uint64_t timestamp);
+
+	/**
+	 * Writes a batch of packets to file. All record headers are built in one contiguous scratch area, then headers
+	 * and frames are submitted together as header/frame pairs, with one writev call per MAX_BATCH_PACKETS packets
+	 * when the output is a file descriptor (see PcapSink::write_vector). Timestamps are scaled to nanoseconds, with
+	 * their time_nsec, if the file has nanosecond resolution. A stripped VLAN tag is inserted back into its frame
+	 * without copying the frame. Frames are truncated to snaplen, and packets rejected by the filter or removed as
+	 * duplicates are skipped.
+	 *
+	 * @param packets Array of packets to be written in pcap file.
+	 * @param count Number of packets in the array.
+	 * @param records Number of records written, filled by this function unless it is nullptr. It is less than count
+	 *	if packets have been skipped; on failure, it counts the records of the batches written before.
+	 * @return Number of bytes written to the file (sum of record header and frame sizes), or "-1" if writing failed.
+	 */
+	long int write_packets(const packet_t* packets, size_t count, size_t* records = nullptr);
+
+	/**
+	 * Pushes bytes buffered by the output sink to the operating system (see PcapSink::flush()). The time it takes is
+	 * recorded in the flush latency histogram of the statistics.
+	 *
+	 * @return True for success and false for failure to write.
+	 */
+	bool flush();
+
+	/**
+	 * Flushes the writer if its buffered records have reached their maximum latency (see set_coalescing()), and takes
+	 * a checkpoint if one is due (see set_durability()). Capture loops call it when they wake up without packets, so
+	 * that records of an idle link reach the file, and become durable, in time.
+	 *
+	 * @return True for success and false for failure to write.
+	 */
+	bool poll();
+
+private:
+	/**
+	 * Magic number is used to detect file format ordering, the writing application writes 0xA1B2C3D4 and the reading
+	 * application reads this field, if swapped (0xD4C3B2A1) reads all the following fields in little-endian ordering.
+	 */
+	constexpr static uint64_t TCPDUMP_MAGIC = 0xa1b2c3d4;
+
+	/// Magic number of files whose record timestamps have nanosecond resolution.
+	constexpr static uint64_t NSEC_TCPDUMP_MAGIC = 0xa1b23c4d;
+
+	/**
+	 * Maximum number of packets submitted by one writev call. Each packet takes two I/O vectors (record header and
+	 * frame), and Linux limits a single call to IOV_MAX (1024) vectors.
+	 */
+	constexpr static size_t MAX_BATCH_PACKETS = 512;
+
+	/// Maximum number of I/O vectors of one writev call (IOV_MAX); a packet with an inserted VLAN tag takes four.
+	constexpr static size_t MAX_BATCH_VECTORS = 1024;
+
+	/// Offset of an inserted VLAN tag in the frame, after the destination and source MAC addresses
+	constexpr static uint32_t VLAN_TAG_OFFSET = 12;
+
+	/// Size of an inserted VLAN tag
+	constexpr static uint32_t VLAN_TAG_SIZE = 4;
+
+	/// @return Default resolution argument of write_pcap_header(): TsResolution, or microseconds if it is runtime.
+	constexpr static ts_resolution default_resolution()
+	{
+		return TsResolution == ts_resolution::runtime ? ts_resolution::microseconds : TsResolution;
+	}
+
+	/// @return True if record timestamps have nanosecond resolution; a constant unless TsResolution is runtime.
+	inline bool nanosecond_resolution() const;
+
+	/// @return True if Stages has the given stage (see pcap_writer_stage).
+	constexpr static bool has_stage(uint32_t stage)
+	{
+		return (Stages & stage) != 0;
+	}
+
+	/// @return The filter, or nullptr; a constant nullptr unless Stages has PCAP_FILTER_STAGE.
+	inline PacketFilter* filter_stage() const;
+
+	/// @return The deduplicator, or nullptr; a constant nullptr unless Stages has PCAP_DEDUPLICATOR_STAGE.
+	inline PacketDeduplicator* deduplicator_stage() const;
+
+	/// @return The index, or nullptr; a constant nullptr unless Stages has PCAP_INDEX_STAGE.
+	inline PcapIndex* index_stage() const;
+
+	/// @return The statistics, or nullptr; a constant nullptr unless Stages has PCAP_STATS_STAGE.
+	inline WriterStats* stats_stage() const;
+
+	/// @return The durability policy, or nullptr; a constant nullptr unless Stages has PCAP_DURABILITY_STAGE.
+	inline DurabilityPolicy* durability_stage() const;
+
+	/// @return True if records go through the output buffer; a constant false unless Stages has PCAP_COALESCING_STAGE.
+	inline bool coalescing_stage() const;
+
+	/**
+	 * Writes all the buffer contents in the output file.
+	 *
+	 * @param buffer Content of the buffer.
+	 * @param count Number of bytes that you want to be written in the specified output file.
+	 * @return True for success and false for failure to write.
+	 */
+	inline bool write_buffer(const void* buffer, size_t count);
+
+	/**
+	 * Writes all the I/O vectors contents in the output file.
+	 *
+	 * @param vector Array of I/O vectors; it may be modified.
+	 * @param count Number of I/O vectors in the array.
+	 * @return True for success and false for failure to write.
+	 */
+	inline bool write_vector(iovec* vector, int count);
+
+	/**
+	 * Copies bytes into the output buffer, writing it first if they do not fit.
+	 *
+	 * @return True for success and false for failure to write the buffer.
+	 */
+	inline bool coalesce(const void* buffer, size_t count);
+
+	/**
+	 * Writes the output buffer to the sink, if it is full or if its records are late.
+	 *
+	 * @return True for success and false for failure to write.
+	 */
+	inline bool check_coalescer();
+
+	/**
+	 * Writes the output buffer to the sink and empties it, even if writing failed.
+	 *
+	 * @param by_size True if the buffer is written because it reached its flush threshold or had no room left.
+	 * @return True for success and false for failure to write.
+	 */
+	bool drain_coalescer(bool by_size);
+
+	/**
+	 * Writes a buffer to a sink of an abstract type, through the virtual table.
+	 *
+	 * @return Same as PcapSink::write().
+	 */
+	static bool sink_write(PcapSink* sink, const void* buffer, size_t count, std::true_type);
+
+	/**
+	 * Writes a buffer to a sink of a concrete type, with a direct call which may be inlined. It is a template so that
+	 * it is only instantiated for concrete sinks.
+	 *
+	 * @return Same as PcapSink::write().
+	 */
+	template <class ConcreteSink>
+	static bool sink_write(ConcreteSink* sink, const void* buffer, size_t count, std::false_type);
+
+	/**
+	 * Writes I/O vectors to a sink of an abstract type, through the virtual table.
+	 *
+	 * @return Same as PcapSink::write_vector().
+	 */
+	static bool sink_write_vector(PcapSink* sink, iovec* vector, int count, std::true_type);
+
+	/**
+	 * Writes I/O vectors to a sink of a concrete type, with a direct call.
+	 *
+	 * @return Same as PcapSink::write_vector().
+	 */
+	template <class ConcreteSink>
+	static bool sink_write_vector(ConcreteSink* sink, iovec* vector, int count, std::false_type);
+
+	/**
+	 * Flushes the sink and hands a checkpoint to the durability policy.
+	 *
+	 * @return True for success and false for failure to flush.
+	 */
+	bool checkpoint();
+
+	/**
+	 * Copies a frame with its stripped VLAN tag inserted back into a scratch area, for the filter and deduplicator.
+	 *
+	 * @param packet A packet with a VLAN tag and at least VLAN_TAG_OFFSET bytes.
+	 * @return The tagged frame, VLAN_TAG_SIZE bytes longer than packet.frame_size; valid until the next call.
+	 */
+	const char* tagged_frame(const packet_t& packet);
+
+	/**
+	 * Writes a record header followed by packet data truncated to snaplen.
+	 *
+	 * @param frame Packet data.
+	 * @param frame_size Number of bytes available at frame.
+	 * @param original_size Actual length of packet.
+	 * @param seconds Timestamp seconds.
+	 * @param fraction Timestamp fraction in units of the file's resolution.
+	 * @return Same as write_packet().
+	 */
+	inline int write_record(const char* frame, uint32_t frame_size, uint32_t original_size, uint32_t seconds,
+		uint32_t fraction);
+
+	/// Pcap recorded packet header
+	struct pcaprec_hdr_t
+	{
+		/// Timestamp seconds
+		uint32_t ts_sec;
+
+		/// Timestamp microseconds
+		uint32_t ts_usec;
+
+		/// Number of packet bytes saved in file
+		uint32_t incl_len;
+
+		/// Actual length of packet
+		uint32_t orig_len;
+	} __attribute__((packed));
+
+	/// Placeholder of the sinks of the fstream and file descriptor overloads when Sink cannot hold them
+	struct unused_sink_t
+	{
+	};
+
+	/// Record of a batch, kept until the batch has been written
+	struct batch_record_t
+	{
+		/// Record header
+		pcaprec_hdr_t header;
+
+		/// Inserted VLAN tag in network byte order, pointed to by an I/O vector
+		uint32_t vlan_tag;
+
+		/// Frame as given, without the inserted tag
+		const char* frame;
+
+		/// Number of bytes of frame which are written
+		uint32_t frame_size;
+	};
+
+	/// Output sink for this pcap writer
+	Sink* pcap_sink;
+
+	/// True if record timestamps have nanosecond resolution, only used if TsResolution is runtime
+	bool nanosecond_timestamps;
+
+	/// Maximum number of bytes of each packet written to file, only used if Snaplen is RUNTIME_SNAPLEN
+	uint32_t snapshot_length;
+
+	/// Filter of packets to write, or nullptr
+	PacketFilter* packet_filter;
+
+	/// Remover of duplicate packets, or nullptr
+	PacketDeduplicator* packet_deduplicator;
+
+	/// Sidecar index of written records, or nullptr
+	PcapIndex* packet_index;
+
+	/// File offset of the next record
+	uint64_t file_offset;
+
+	/// Statistics of this writer, or nullptr
+	WriterStats* writer_stats;
+
+	/// Durability policy of the output file, or nullptr
+	DurabilityPolicy* durability_policy;
+
+	/// Sink used when the output is a file stream given by user application, if Sink is PcapSink
+	typename std::conditional<std::is_same<Sink, PcapSink>::value, StreamSink, unused_sink_t>::type stream_sink;
+
+	/// Sink used when the output is a file descriptor given by user application, if Sink is PcapSink or FdSink
+	typename std::conditional<std::is_base_of<Sink, FdSink>::value, FdSink, unused_sink_t>::type fd_sink;
+
+	/// Scratch area for records of a batch, reused between write_packets() calls
+	std::vector<batch_record_t> batch_records;
+
+	/// Scratch area for I/O vectors of a batch, reused between write_packets() calls
+	std::vector<iovec> batch_vectors;
+
+	/// Scratch area for a frame with its VLAN tag, only used by the filter and deduplicator
+	std::vector<char> tagged_frame_buffer;
+
+	/// Scratch area for the index records of a batch, only used with an index
+	std::vector<PcapIndex::record_t> index_records;
+
+	/// Output buffer, disabled unless set_coalescing() is called
+	WriteCoalescer write_coalescer;
+};
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr uint64_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::TCPDUMP_MAGIC;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr uint64_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::NSEC_TCPDUMP_MAGIC;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr size_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::MAX_BATCH_PACKETS;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr size_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::MAX_BATCH_VECTORS;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr uint32_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::VLAN_TAG_OFFSET;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+constexpr uint32_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::VLAN_TAG_SIZE;
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::BasicPcapWriter()
+: pcap_sink(nullptr)
+, nanosecond_timestamps(TsResolution == ts_resolution::nanoseconds)
+, snapshot_length(DEFAULT_SNAPLEN)
+, packet_filter(nullptr)
+, packet_deduplicator(nullptr)
+, packet_index(nullptr)
+, file_offset(0)
+, writer_stats(nullptr)
+, durability_policy(nullptr)
+, batch_records(MAX_BATCH_PACKETS)
+, batch_vectors(MAX_BATCH_VECTORS)
+{
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_snaplen(uint32_t snaplen)
+{
+	static_assert(Snaplen == RUNTIME_SNAPLEN, "the snapshot length is a template argument of this writer");
+	snapshot_length = snaplen > 0 ? snaplen : DEFAULT_SNAPLEN;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+uint32_t BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::snaplen() const
+{
+	return Snaplen != RUNTIME_SNAPLEN ? Snaplen : snapshot_length;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_filter(PacketFilter* filter)
+{
+	static_assert(has_stage(PCAP_FILTER_STAGE), "this writer has no filter stage");
+	packet_filter = filter;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_deduplicator(PacketDeduplicator* deduplicator)
+{
+	static_assert(has_stage(PCAP_DEDUPLICATOR_STAGE), "this writer has no deduplicator stage");
+	packet_deduplicator = deduplicator;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_index(PcapIndex* index)
+{
+	static_assert(has_stage(PCAP_INDEX_STAGE), "this writer has no index stage");
+	packet_index = index;
+	if (packet_index)
+		index_records.resize(MAX_BATCH_PACKETS);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_stats(WriterStats* stats)
+{
+	static_assert(has_stage(PCAP_STATS_STAGE), "this writer has no statistics stage");
+	writer_stats = stats;
+	if (pcap_sink)
+		pcap_sink->set_stats(stats);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+void BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_durability(DurabilityPolicy* durability)
+{
+	static_assert(has_stage(PCAP_DURABILITY_STAGE), "this writer has no durability stage");
+	durability_policy = durability;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::set_coalescing(size_t buffer_size,
+	unsigned int max_latency_ms)
+{
+	static_assert(has_stage(PCAP_COALESCING_STAGE), "this writer has no coalescing stage");
+	return drain_coalescer(false) && write_coalescer.reset(buffer_size, max_latency_ms);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+const WriteCoalescer& BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::coalescer() const
+{
+	return write_coalescer;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::sink_write(PcapSink* sink, const void* buffer,
+	size_t count, std::true_type)
+{
+	return sink->write(buffer, count);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+template <class ConcreteSink>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::sink_write(ConcreteSink* sink, const void* buffer,
+	size_t count, std::false_type)
+{
+	return sink->ConcreteSink::write(buffer, count);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::sink_write_vector(PcapSink* sink, iovec* vector,
+	int count, std::true_type)
+{
+	return sink->write_vector(vector, count);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+template <class ConcreteSink>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::sink_write_vector(ConcreteSink* sink,
+	iovec* vector, int count, std::false_type)
+{
+	return sink->ConcreteSink::write_vector(vector, count);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_pcap_header(std::fstream* file_stream,
+	uint32_t link_type, ts_resolution resolution)
+{
+	stream_sink.set_stream(file_stream);
+
+	return write_pcap_header(&stream_sink, link_type, resolution);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_pcap_header(int file_descriptor,
+	uint32_t link_type, ts_resolution resolution)
+{
+	fd_sink.attach(file_descriptor);
+
+	return write_pcap_header(&fd_sink, link_type, resolution);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_pcap_header(Sink* sink)
+{
+	if (LinkType == RUNTIME_LINK_TYPE || TsResolution == ts_resolution::runtime)
+		return -1;
+
+	return write_pcap_header(sink, LinkType, TsResolution);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_pcap_header(Sink* sink, uint32_t link_type,
+	ts_resolution resolution)
+{
+	// Arguments fixed at compile time cannot be changed here; the runtime resolution value is never a valid argument.
+	if ((LinkType != RUNTIME_LINK_TYPE && link_type != LinkType) || resolution == ts_resolution::runtime
+		|| (TsResolution != ts_resolution::runtime && resolution != TsResolution))
+	{
+		return -1;
+	}
+
+	pcap_sink = sink;
+	if (stats_stage() && sink)
+		sink->set_stats(stats_stage());
+	nanosecond_timestamps = resolution == ts_resolution::nanoseconds;
+	pcap_file_header file_header;
+
+	// For more information about pcap_file_header struct, please read "/usr/include/pcap/pcap.h" header file.
+	file_header.magic = nanosecond_timestamps ? NSEC_TCPDUMP_MAGIC : TCPDUMP_MAGIC;		// Tcpdump magic number.
+	file_header.sigfigs = 0;		// Accuracy of timestamps.
+	file_header.version_major = PCAP_VERSION_MAJOR;		// Set pcap file version.
+	file_header.version_minor = PCAP_VERSION_MINOR;
+
+	file_header.snaplen = snaplen();
+	file_header.thiszone = 0;		// GMT to local time correction.
+	file_header.linktype = link_type;		// Set data link type.
+
+	if (!write_buffer(&file_header, sizeof(file_header)))
+	{
+		pcap_sink = nullptr;
+		return -1;
+	}
+
+	file_offset = sizeof(file_header);
+	// Number of bytes has been written to file (must be 24 bytes).
+	return sizeof(file_header);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+long int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_packets(const packet_t* packets,
+	size_t count, size_t* records)
+{
+	long int total_bytes = 0;
+	if (records)
+		*records = 0;
+	const uint32_t fraction_scale = nanosecond_resolution() ? 1000 : 1;
+	const uint32_t nanosecond_mask = nanosecond_resolution() ? UINT32_MAX : 0;
+	const uint32_t snapshot_size = snaplen();
+	PacketFilter* const filter = filter_stage();
+	PacketDeduplicator* const deduplicator = deduplicator_stage();
+	PcapIndex* const index = index_stage();
+	WriterStats* const stats = stats_stage();
+
+	while (count > 0)
+	{
+		// Fills all records of this batch, then pairs each header with its frame, split around an inserted VLAN tag.
+		size_t consumed = 0;
+		size_t written = 0;
+		size_t vector_count = 0;
+		long int batch_bytes = 0;
+		for (; consumed < count && written < MAX_BATCH_PACKETS; ++consumed)
+		{
+			const packet_t& packet = packets[consumed];
+			const uint32_t tag_size = packet.vlan_tag && packet.frame_size >= VLAN_TAG_OFFSET ? VLAN_TAG_SIZE : 0;
+			if (vector_count + (tag_size ? 4 : 2) > MAX_BATCH_VECTORS)
+				break;
+
+			const uint32_t frame_size = packet.frame_size + tag_size;
+			const uint32_t original_size = (packet.original_size > packet.frame_size ? packet.original_size
+				: packet.frame_size) + tag_size;
+			if (filter || deduplicator)
+			{
+				// Both see the frame which is written, so tagged frames are copied with their tag.
+				const char* const frame = tag_size ? tagged_frame(packet) : packet.frame;
+				if (filter && !filter->accept(frame, frame_size, original_size))
+					continue;
+
+				const uint64_t timestamp = static_cast<uint64_t>(packet.time.tv_sec) * 1000000000
+					+ static_cast<uint64_t>(packet.time.tv_usec) * 1000 + packet.time_nsec;
+				if (deduplicator && !deduplicator->accept(frame, frame_size, timestamp))
+					continue;
+			}
+
+			const uint32_t saved_size = frame_size < snapshot_size ? frame_size : snapshot_size;
+
+			batch_record_t& record = batch_records[written];
+			record.header.incl_len = saved_size;
+			record.header.orig_len = original_size;
+			record.header.ts_sec = static_cast<uint32_t>(packet.time.tv_sec);
+			record.header.ts_usec = static_cast<uint32_t>(packet.time.tv_usec) * fraction_scale
+				+ (packet.time_nsec & nanosecond_mask);
+			record.frame = packet.frame;
+			record.frame_size = saved_size < packet.frame_size ? saved_size : packet.frame_size;
+
+			iovec* vector = &batch_vectors[vector_count];
+			vector[0].iov_base = &record.header;
+			vector[0].iov_len = sizeof(record.header);
+			vector[1].iov_base = const_cast<char*>(packet.frame);
+			if (!tag_size)
+			{
+				vector[1].iov_len = saved_size;
+				vector_count += 2;
+			}
+			else
+			{
+				// MAC addresses, tag and the rest of the frame, each cut at snaplen.
+				record.vlan_tag = htonl(packet.vlan_tag);
+				const uint32_t tag_end = VLAN_TAG_OFFSET + VLAN_TAG_SIZE;
+				vector[1].iov_len = saved_size < VLAN_TAG_OFFSET ? saved_size : VLAN_TAG_OFFSET;
+				vector[2].iov_base = &record.vlan_tag;
+				vector[2].iov_len = saved_size < VLAN_TAG_OFFSET ? 0 : (saved_size < tag_end ? saved_size : tag_end)
+					- VLAN_TAG_OFFSET;
+				vector[3].iov_base = const_cast<char*>(packet.frame + VLAN_TAG_OFFSET);
+				vector[3].iov_len = saved_size < tag_end ? 0 : saved_size - tag_end;
+				vector_count += 4;
+			}
+
+			batch_bytes += static_cast<long int>(saved_size + sizeof(record.header));
+			++written;
+		}
+
+		const bool timed = stats && written > 0 && stats->sample_write();
+		const uint64_t start = timed ? WriterStats::now() : 0;
+		if (!pcap_sink || (written > 0 && !write_vector(batch_vectors.data(), static_cast<int>(vector_count))))
+		{
+			if (stats)
+				stats->add_error();
+			return -1;
+		}
+
+		if (timed)
+			stats->record_write(WriterStats::now() - start);
+
+		// Records are indexed once written, when their frames are still in cache from being copied to the sink.
+		for (size_t i = 0; i < written; ++i)
+		{
+			const batch_record_t& record = batch_records[i];
+			const uint32_t record_size = static_cast<uint32_t>(record.header.incl_len + sizeof(record.header));
+			if (index)
+			{
+				const uint64_t nanoseconds = static_cast<uint64_t>(record.header.ts_usec) * (1000 / fraction_scale);
+				PcapIndex::record_t& index_record = index_records[i];
+				index_record.timestamp = record.header.ts_sec * 1000000000ull + nanoseconds;
+				index_record.offset = file_offset;
+				index_record.frame = record.frame;
+				index_record.size = record_size;
+				index_record.frame_size = record.frame_size;
+			}
+			file_offset += record_size;
+		}
+
+		if (index)
+			index->add(index_records.data(), written);
+
+		total_bytes += batch_bytes;
+		if (records)
+			*records += written;
+		if (stats)
+			stats->add_packets(written, static_cast<uint64_t>(batch_bytes));
+
+		if (coalescing_stage() && !check_coalescer())
+			return -1;
+
+		if (durability_stage() && durability_stage()->due(file_offset) && !checkpoint())
+			return -1;
+
+		packets += consumed;
+		count -= consumed;
+	}
+
+	// Number of bytes has been written to file.
+	return total_bytes;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::flush()
+{
+	if (!pcap_sink)
+		return false;
+
+	WriterStats* const stats = stats_stage();
+	const uint64_t start = stats ? WriterStats::now() : 0;
+	bool result = drain_coalescer(false);
+	result = pcap_sink->flush() && result;
+	if (stats)
+	{
+		stats->record_flush(WriterStats::now() - start);
+		if (!result)
+			stats->add_error();
+	}
+
+	return result;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::poll()
+{
+	if (coalescing_stage() && write_coalescer.expired() && !flush())
+		return false;
+
+	// The interval timer of the policy only marks a checkpoint as due, so without packets it is taken here.
+	return !durability_stage() || !durability_stage()->due(file_offset) || checkpoint();
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::drain_coalescer(bool by_size)
+{
+	if (!has_stage(PCAP_COALESCING_STAGE) || write_coalescer.size() == 0)
+		return true;
+
+	// The bytes are dropped on failure, so that a failed write is not repeated by every later one.
+	const bool result = pcap_sink
+		&& sink_write(pcap_sink, write_coalescer.data(), write_coalescer.size(), std::is_abstract<Sink>());
+	write_coalescer.drained(by_size);
+	return result;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+const char* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::tagged_frame(const packet_t& packet)
+{
+	if (tagged_frame_buffer.size() < packet.frame_size + VLAN_TAG_SIZE)
+		tagged_frame_buffer.resize(packet.frame_size + VLAN_TAG_SIZE);
+
+	const uint32_t tag = htonl(packet.vlan_tag);
+	char* const frame = tagged_frame_buffer.data();
+	memcpy(frame, packet.frame, VLAN_TAG_OFFSET);
+	memcpy(frame + VLAN_TAG_OFFSET, &tag, VLAN_TAG_SIZE);
+	memcpy(frame + VLAN_TAG_OFFSET + VLAN_TAG_SIZE, packet.frame + VLAN_TAG_OFFSET,
+		packet.frame_size - VLAN_TAG_OFFSET);
+	return frame;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::checkpoint()
+{
+	if (!flush())
+		return false;
+
+	durability_stage()->checkpoint(file_offset);
+	return true;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::nanosecond_resolution() const
+{
+	return TsResolution == ts_resolution::runtime ? nanosecond_timestamps : TsResolution == ts_resolution::nanoseconds;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+PacketFilter* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::filter_stage() const
+{
+	return has_stage(PCAP_FILTER_STAGE) ? packet_filter : nullptr;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+PacketDeduplicator* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::deduplicator_stage() const
+{
+	return has_stage(PCAP_DEDUPLICATOR_STAGE) ? packet_deduplicator : nullptr;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+PcapIndex* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::index_stage() const
+{
+	return has_stage(PCAP_INDEX_STAGE) ? packet_index : nullptr;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+WriterStats* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::stats_stage() const
+{
+	return has_stage(PCAP_STATS_STAGE) ? writer_stats : nullptr;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+DurabilityPolicy* BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::durability_stage() const
+{
+	return has_stage(PCAP_DURABILITY_STAGE) ? durability_policy : nullptr;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::coalescing_stage() const
+{
+	return has_stage(PCAP_COALESCING_STAGE) && write_coalescer.enabled();
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_buffer(const void* buffer, size_t count)
+{
+	if (!pcap_sink)
+		return false;
+
+	if (coalescing_stage())
+		return coalesce(buffer, count);
+
+	return sink_write(pcap_sink, buffer, count, std::is_abstract<Sink>());
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_vector(iovec* vector, int count)
+{
+	if (!coalescing_stage())
+		return sink_write_vector(pcap_sink, vector, count, std::is_abstract<Sink>());
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (!coalesce(vector[i].iov_base, vector[i].iov_len))
+			return false;
+	}
+
+	return true;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::coalesce(const void* buffer, size_t count)
+{
+	if (!write_coalescer.fits(count))
+	{
+		if (!drain_coalescer(true))
+			return false;
+
+		// Only bytes larger than the whole buffer, i.e. with a snapshot length beyond it, are written directly.
+		if (!write_coalescer.fits(count))
+			return sink_write(pcap_sink, buffer, count, std::is_abstract<Sink>());
+	}
+
+	write_coalescer.append(buffer, count);
+	return true;
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+bool BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::check_coalescer()
+{
+	if (write_coalescer.full())
+	{
+		WriterStats* const stats = stats_stage();
+		const uint64_t start = stats ? WriterStats::now() : 0;
+		const bool result = drain_coalescer(true);
+		if (stats)
+		{
+			stats->record_flush(WriterStats::now() - start);
+			if (!result)
+				stats->add_error();
+		}
+
+		return result;
+	}
+
+	// Late records are flushed through the sink too, in case it buffers them.
+	return !write_coalescer.expired() || flush();
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_record(const char* frame, uint32_t frame_size,
+	uint32_t original_size, uint32_t seconds, uint32_t fraction)
+{
+	if (filter_stage() && !filter_stage()->accept(frame, frame_size, original_size))
+		return 0;
+
+	const uint64_t timestamp = seconds * 1000000000ull + (nanosecond_resolution() ? fraction : fraction * 1000ull);
+	if (deduplicator_stage() && !deduplicator_stage()->accept(frame, frame_size, timestamp))
+		return 0;
+
+	// Pcap record header
+	pcaprec_hdr_t packet_header;
+
+	// Only the first snaplen bytes are saved, the original length is kept.
+	if (frame_size > snaplen())
+		frame_size = snaplen();
+
+	// Fills per-record header.
+	packet_header.incl_len = frame_size;
+	packet_header.orig_len = original_size;
+	packet_header.ts_sec = seconds;
+	packet_header.ts_usec = fraction;
+
+	WriterStats* const stats = stats_stage();
+	const bool timed = stats && stats->sample_write();
+	const uint64_t start = timed ? WriterStats::now() : 0;
+
+	// Writes pcap record header.
+	if (!write_buffer(&packet_header, sizeof(packet_header)))
+	{
+		if (stats)
+			stats->add_error();
+		return -1;
+	}
+
+	// Writes pcap data.
+	if (!write_buffer(frame, frame_size))
+	{
+		if (stats)
+			stats->add_error();
+		return -2;
+	}
+
+	const uint32_t record_size = static_cast<uint32_t>(frame_size + sizeof(packet_header));
+	if (timed)
+		stats->record_write(WriterStats::now() - start);
+	if (stats)
+		stats->add_packets(1, record_size);
+	if (index_stage())
+		index_stage()->add(timestamp, file_offset, record_size, frame, frame_size);
+	file_offset += record_size;
+
+	if (coalescing_stage() && !check_coalescer())
+		return -2;
+
+	if (durability_stage() && durability_stage()->due(file_offset) && !checkpoint())
+		return -2;
+
+	// Number of bytes has been written to file.
+	return static_cast<int>(record_size);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_packet(const char* frame, uint32_t frame_size,
+	timeval time)
+{
+	return write_packet(frame, frame_size, frame_size, time);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_packet(const char* frame, uint32_t frame_size,
+	uint32_t original_size, timeval time)
+{
+	const uint32_t fraction = static_cast<uint32_t>(time.tv_usec);
+
+	return write_record(frame, frame_size, original_size > frame_size ? original_size : frame_size,
+		static_cast<uint32_t>(time.tv_sec), nanosecond_resolution() ? fraction * 1000 : fraction);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_packet(const char* frame, uint32_t frame_size,
+	timespec time)
+{
+	const uint32_t fraction = static_cast<uint32_t>(time.tv_nsec);
+
+	return write_record(frame, frame_size, frame_size, static_cast<uint32_t>(time.tv_sec),
+		nanosecond_resolution() ? fraction : fraction / 1000);
+}
+
+template <uint32_t LinkType, pcap_ts_resolution TsResolution, class Sink, uint32_t Stages, uint32_t Snaplen>
+int BasicPcapWriter<LinkType, TsResolution, Sink, Stages, Snaplen>::write_packet(const char* frame, uint32_t frame_size,
+	uint64_t timestamp)
+{
+	// Division by constants compiles to multiplications.
+	const uint32_t fraction = static_cast<uint32_t>(timestamp % 1000000000);
+
+	return write_record(frame, frame_size, frame_size, static_cast<uint32_t>(timestamp / 1000000000),
+		nanosecond_resolution() ? fraction : fraction / 1000);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#include "ClockScale.h"
+
+ClockScale::ClockScale(uint64_t frequency, uint64_t reference_ticks, uint64_t reference_nanoseconds)
+: multiplier(0)
+, shift(0)
+, base_ticks(reference_ticks)
+, base_nanoseconds(reference_nanoseconds)
+{
+	if (frequency == 0)
+		frequency = 1000000000;
+
+	// Takes the most fractional bits for which the multiplier still fits in 64 bits.
+	for (unsigned int bits = 63; ; --bits)
+	{
+		const uint128_t scaled = (static_cast<uint128_t>(1000000000) << bits) / frequency;
+		if (scaled <= UINT64_MAX || bits == 0)
+		{
+			multiplier = static_cast<uint64_t>(scaled);
+			shift = bits;
+			break;
+		}
+	}
+}
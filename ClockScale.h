@@ -0,0 +1,50 @@
+#ifndef CLOCK_SCALE_H_
+#define CLOCK_SCALE_H_
+
+#include <cstdint>
+
+/**
+ * This class converts raw timestamps of a hardware clock (e.g. NIC clock ticks) to nanoseconds since the epoch. The
+ * ratio between the clock frequency and one gigahertz is precomputed once as a fixed-point multiplier, so converting a
+ * timestamp takes one 128-bit multiplication and a shift instead of a division by the clock frequency.
+ */
+class ClockScale
+{
+public:
+	/**
+	 * @param frequency Clock frequency in Hz.
+	 * @param reference_ticks A clock reading.
+	 * @param reference_nanoseconds Time of that reading in nanoseconds since the epoch.
+	 */
+	explicit ClockScale(uint64_t frequency, uint64_t reference_ticks = 0, uint64_t reference_nanoseconds = 0);
+
+	/**
+	 * Converts a clock reading to nanoseconds since the epoch.
+	 *
+	 * @param ticks The clock reading, not before the reference reading.
+	 * @return Time of the reading in nanoseconds since the epoch.
+	 */
+	inline uint64_t to_nanoseconds(uint64_t ticks) const;
+
+private:
+	__extension__ typedef unsigned __int128 uint128_t;
+
+	/// Nanoseconds per tick as a fixed-point number with shift fractional bits
+	uint64_t multiplier;
+
+	/// Number of fractional bits of multiplier
+	unsigned int shift;
+
+	/// Reference clock reading
+	uint64_t base_ticks;
+
+	/// Time of the reference reading in nanoseconds since the epoch
+	uint64_t base_nanoseconds;
+};
+
+uint64_t ClockScale::to_nanoseconds(uint64_t ticks) const
+{
+	return base_nanoseconds + static_cast<uint64_t>((static_cast<uint128_t>(ticks - base_ticks) * multiplier) >> shift);
+}
+
+#endif
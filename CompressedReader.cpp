@@ -0,0 +1,234 @@
+#include "CompressedReader.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef PCAP_WRITER_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef PCAP_WRITER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "CompressedSink.h"
+
+constexpr uint32_t CompressedReader::LZ4_MAGIC;
+constexpr uint32_t CompressedReader::ZSTD_MAGIC;
+
+CompressedReader::CompressedReader()
+: data(nullptr)
+, file_size(0)
+, cached_frame(SIZE_MAX)
+{
+}
+
+CompressedReader::~CompressedReader()
+{
+	close();
+}
+
+bool CompressedReader::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data = static_cast<const char*>(mapping);
+	file_size = static_cast<uint64_t>(file_stat.st_size);
+
+	// Footer: frame count, descriptor and magic number.
+	const uint64_t footer_size = 9;
+	const uint64_t header_size = 8;
+	if (file_size < header_size + footer_size)
+	{
+		close();
+		return false;
+	}
+
+	uint32_t frame_count = 0;
+	uint32_t magic = 0;
+	memcpy(&frame_count, data + file_size - footer_size, sizeof(frame_count));
+	const uint8_t descriptor = static_cast<uint8_t>(data[file_size - 5]);
+	memcpy(&magic, data + file_size - 4, sizeof(magic));
+
+	// Entries carry a checksum if the highest descriptor bit is set.
+	const uint64_t entry_size = descriptor & 0x80 ? 12 : 8;
+	const uint64_t table_size = frame_count * entry_size + footer_size;
+	if (magic != CompressedSink::SEEKABLE_MAGIC || file_size < header_size + table_size)
+	{
+		close();
+		return false;
+	}
+
+	const char* table = data + file_size - table_size;
+	uint32_t header[2];
+	memcpy(header, table - header_size, sizeof(header));
+	if (header[0] != CompressedSink::SKIPPABLE_MAGIC || header[1] != table_size)
+	{
+		close();
+		return false;
+	}
+
+	const uint64_t frames_end = file_size - table_size - header_size;
+	uint64_t compressed_offset = 0;
+	uint64_t decompressed_offset = 0;
+	frame_list.resize(frame_count);
+	for (uint32_t i = 0; i < frame_count; ++i)
+	{
+		frame_t& frame = frame_list[i];
+		memcpy(&frame.compressed_size, table + i * entry_size, sizeof(uint32_t));
+		memcpy(&frame.decompressed_size, table + i * entry_size + 4, sizeof(uint32_t));
+		frame.compressed_offset = compressed_offset;
+		frame.decompressed_offset = decompressed_offset;
+
+		compressed_offset += frame.compressed_size;
+		decompressed_offset += frame.decompressed_size;
+	}
+
+	if (compressed_offset != frames_end)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void CompressedReader::close()
+{
+	if (data)
+		munmap(const_cast<char*>(data), file_size);
+
+	data = nullptr;
+	file_size = 0;
+	frame_list.clear();
+	cached_frame = SIZE_MAX;
+}
+
+size_t CompressedReader::frames() const
+{
+	return frame_list.size();
+}
+
+uint64_t CompressedReader::size() const
+{
+	if (frame_list.empty())
+		return 0;
+
+	return frame_list.back().decompressed_offset + frame_list.back().decompressed_size;
+}
+
+bool CompressedReader::read_frame(size_t index, std::vector<char>* block)
+{
+	if (!data || index >= frame_list.size())
+		return false;
+
+	const frame_t& frame = frame_list[index];
+	const char* source = data + frame.compressed_offset;
+	if (frame.compressed_size < sizeof(uint32_t))
+		return false;
+
+	uint32_t magic = 0;
+	memcpy(&magic, source, sizeof(magic));
+	block->resize(frame.decompressed_size);
+
+	if (magic == LZ4_MAGIC)
+	{
+#ifdef PCAP_WRITER_HAVE_LZ4
+		LZ4F_dctx* context = nullptr;
+		if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))
+			return false;
+
+		size_t destination_size = block->size();
+		size_t source_size = frame.compressed_size;
+		const size_t result = LZ4F_decompress(context, block->data(), &destination_size, source, &source_size,
+			nullptr);
+		LZ4F_freeDecompressionContext(context);
+
+		// A result of 0 means the whole frame has been decoded.
+		return result == 0 && destination_size == block->size() && source_size == frame.compressed_size;
+#else
+		return false;
+#endif
+	}
+
+	if (magic == ZSTD_MAGIC)
+	{
+#ifdef PCAP_WRITER_HAVE_ZSTD
+		ZSTD_DCtx* context = ZSTD_createDCtx();
+		if (!context)
+			return false;
+
+		const size_t result = ZSTD_decompressDCtx(context, block->data(), block->size(), source, frame.compressed_size);
+		ZSTD_freeDCtx(context);
+
+		return !ZSTD_isError(result) && result == block->size();
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+long long int CompressedReader::read(uint64_t offset, char* buffer, size_t count)
+{
+	if (!data)
+		return -1;
+
+	// Binary search for the frame holding offset.
+	size_t low = 0;
+	size_t high = frame_list.size();
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (frame_list[middle].decompressed_offset + frame_list[middle].decompressed_size <= offset)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	long long int total = 0;
+	for (size_t index = low; index < frame_list.size() && count > 0; ++index)
+	{
+		if (cached_frame != index)
+		{
+			cached_frame = SIZE_MAX;
+			if (!read_frame(index, &cache))
+				return -1;
+			cached_frame = index;
+		}
+
+		const frame_t& frame = frame_list[index];
+		const uint64_t start = offset - frame.decompressed_offset;
+		const size_t available = static_cast<size_t>(frame.decompressed_size - start);
+		const size_t chunk = count < available ? count : available;
+		memcpy(buffer, cache.data() + start, chunk);
+
+		buffer += chunk;
+		offset += chunk;
+		count -= chunk;
+		total += static_cast<long long int>(chunk);
+	}
+
+	return total;
+}
@@ -0,0 +1,98 @@
+#ifndef COMPRESSED_READER_H_
+#define COMPRESSED_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * This class reads files written by CompressedSink through a read-only memory mapping. The seek table at the end of
+ * the file gives the position of every frame, so reading at an uncompressed offset decompresses only the frames which
+ * hold the requested bytes. The codec of each frame is detected from its magic number.
+ */
+class CompressedReader
+{
+public:
+	CompressedReader();
+
+	~CompressedReader();
+
+	CompressedReader(const CompressedReader&) = delete;
+	CompressedReader& operator=(const CompressedReader&) = delete;
+
+	/**
+	 * Maps the file and loads its seek table.
+	 *
+	 * @param path The input file path.
+	 * @return True if the file has been mapped and has a valid seek table; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// Unmaps the file.
+	void close();
+
+	/// @return Number of frames.
+	size_t frames() const;
+
+	/// @return Uncompressed size of the whole file.
+	uint64_t size() const;
+
+	/**
+	 * Decompresses one frame.
+	 *
+	 * @param index Frame index.
+	 * @param block Filled with the uncompressed block.
+	 * @return True for success, false if the index is out of range, the codec is not available or the frame is corrupt.
+	 */
+	bool read_frame(size_t index, std::vector<char>* block);
+
+	/**
+	 * Reads uncompressed bytes starting at an offset, decompressing only the frames which hold them.
+	 *
+	 * @param offset Uncompressed offset.
+	 * @param buffer Destination buffer.
+	 * @param count Number of bytes to read.
+	 * @return Number of bytes read, less than count at the end of file, or -1 for failure.
+	 */
+	long long int read(uint64_t offset, char* buffer, size_t count);
+
+private:
+	/// Magic number of LZ4 frames
+	constexpr static uint32_t LZ4_MAGIC = 0x184d2204;
+
+	/// Magic number of zstd frames
+	constexpr static uint32_t ZSTD_MAGIC = 0xfd2fb528;
+
+	/// Position of one frame
+	struct frame_t
+	{
+		/// File offset of the compressed frame
+		uint64_t compressed_offset;
+
+		/// Size of the compressed frame
+		uint32_t compressed_size;
+
+		/// Uncompressed offset of the block
+		uint64_t decompressed_offset;
+
+		/// Size of the block
+		uint32_t decompressed_size;
+	};
+
+	/// File mapping, or nullptr
+	const char* data;
+
+	/// Size of the file
+	uint64_t file_size;
+
+	/// Frames in file order
+	std::vector<frame_t> frame_list;
+
+	/// Index of the frame held in cache, or SIZE_MAX
+	size_t cached_frame;
+
+	/// Last decompressed block, reused by sequential reads
+	std::vector<char> cache;
+};
+
+#endif
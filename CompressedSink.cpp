@@ -0,0 +1,335 @@
+#include "CompressedSink.h"
+
+#include <cstring>
+
+#ifdef PCAP_WRITER_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef PCAP_WRITER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+constexpr uint32_t CompressedSink::SKIPPABLE_MAGIC;
+constexpr uint32_t CompressedSink::SEEKABLE_MAGIC;
+
+CompressedSink::CompressedSink(codec compression, size_t block_size, unsigned int worker_count, int level)
+: compression(compression)
+, block_size(block_size > 0 && block_size <= UINT32_MAX ? block_size : 1024 * 1024)
+, worker_count(worker_count > 0 ? worker_count : 1)
+, level(level)
+, input_bytes(0)
+, output_bytes(0)
+, failed(false)
+, writing(false)
+, stopping(false)
+{
+}
+
+CompressedSink::~CompressedSink()
+{
+	close();
+}
+
+bool CompressedSink::available(codec compression)
+{
+	switch (compression)
+	{
+		case codec::lz4:
+#ifdef PCAP_WRITER_HAVE_LZ4
+			return true;
+#else
+			return false;
+#endif
+		case codec::zstd:
+#ifdef PCAP_WRITER_HAVE_ZSTD
+			return true;
+#else
+			return false;
+#endif
+	}
+
+	return false;
+}
+
+bool CompressedSink::open(const std::string& path)
+{
+	if (!workers.empty() || !available(compression) || !file.open(path))
+		return false;
+
+	block.clear();
+	block.reserve(block_size);
+	frames.clear();
+	input_bytes = 0;
+	output_bytes = 0;
+	failed = false;
+	writing = false;
+	stopping = false;
+
+	for (unsigned int i = 0; i < worker_count; ++i)
+		workers.emplace_back(&CompressedSink::work, this);
+
+	return true;
+}
+
+bool CompressedSink::write(const void* buffer, size_t count)
+{
+	if (workers.empty())
+		return false;
+
+	const char* data = static_cast<const char*>(buffer);
+	input_bytes += count;
+
+	while (count > 0)
+	{
+		const size_t room = block_size - block.size();
+		const size_t chunk = count < room ? count : room;
+		block.insert(block.end(), data, data + chunk);
+		data += chunk;
+		count -= chunk;
+
+		if (block.size() == block_size && !submit())
+			return false;
+	}
+
+	return true;
+}
+
+bool CompressedSink::submit()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Bounds memory held by blocks in flight; the packet path waits here only if compression cannot keep up.
+	frame_written.wait(lock, [this]() { return failed || in_flight.size() < 2 * static_cast<size_t>(worker_count); });
+	if (failed)
+		return false;
+
+	std::unique_ptr<job_t> job;
+	if (free_jobs.empty())
+	{
+		job.reset(new job_t());
+	}
+	else
+	{
+		job = std::move(free_jobs.back());
+		free_jobs.pop_back();
+	}
+
+	// The block buffer is swapped with the recycled one of the job, so neither is reallocated.
+	job->input.swap(block);
+	job->done = false;
+	job->succeeded = false;
+	block.clear();
+	block.reserve(block_size);
+
+	pending.push_back(job.get());
+	in_flight.push_back(std::move(job));
+	lock.unlock();
+
+	work_ready.notify_one();
+	return true;
+}
+
+void CompressedSink::work()
+{
+	void* context = nullptr;
+#ifdef PCAP_WRITER_HAVE_ZSTD
+	if (compression == codec::zstd)
+		context = ZSTD_createCCtx();
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		work_ready.wait(lock, [this]() { return stopping || !pending.empty(); });
+		if (pending.empty())
+			break;
+
+		job_t* job = pending.front();
+		pending.pop_front();
+		lock.unlock();
+
+		const bool succeeded = compress(job, context);
+
+		lock.lock();
+		job->done = true;
+		job->succeeded = succeeded;
+		write_frames(lock);
+	}
+	lock.unlock();
+
+#ifdef PCAP_WRITER_HAVE_ZSTD
+	if (context)
+		ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(context));
+#endif
+}
+
+bool CompressedSink::compress(job_t* job, void* context) const
+{
+	const std::vector<char>& input = job->input;
+	std::vector<char>& output = job->output;
+
+	switch (compression)
+	{
+		case codec::lz4:
+		{
+#ifdef PCAP_WRITER_HAVE_LZ4
+			// Content size in the frame header lets readers allocate the decompressed block up front.
+			LZ4F_preferences_t preferences;
+			memset(&preferences, 0, sizeof(preferences));
+			preferences.frameInfo.blockMode = LZ4F_blockIndependent;
+			preferences.frameInfo.contentSize = input.size();
+			preferences.compressionLevel = level;
+
+			output.resize(LZ4F_compressFrameBound(input.size(), &preferences));
+			const size_t size = LZ4F_compressFrame(output.data(), output.size(), input.data(), input.size(),
+				&preferences);
+			if (LZ4F_isError(size))
+				return false;
+
+			output.resize(size);
+			return true;
+#else
+			(void)input;
+			(void)output;
+			return false;
+#endif
+		}
+		case codec::zstd:
+		{
+#ifdef PCAP_WRITER_HAVE_ZSTD
+			output.resize(ZSTD_compressBound(input.size()));
+			const size_t size = ZSTD_compressCCtx(static_cast<ZSTD_CCtx*>(context), output.data(), output.size(),
+				input.data(), input.size(), level);
+			if (ZSTD_isError(size))
+				return false;
+
+			output.resize(size);
+			return true;
+#else
+			(void)context;
+			return false;
+#endif
+		}
+	}
+
+	return false;
+}
+
+void CompressedSink::write_frames(std::unique_lock<std::mutex>& lock)
+{
+	if (writing)
+		return;
+
+	writing = true;
+	while (!in_flight.empty() && in_flight.front()->done)
+	{
+		std::unique_ptr<job_t> job = std::move(in_flight.front());
+		in_flight.pop_front();
+
+		// Frames are written without holding the lock, so other workers keep compressing meanwhile.
+		const bool writable = !failed && job->succeeded;
+		lock.unlock();
+		const bool succeeded = writable && file.write(job->output.data(), job->output.size());
+		lock.lock();
+
+		if (succeeded)
+		{
+			frame_t frame;
+			frame.compressed_size = static_cast<uint32_t>(job->output.size());
+			frame.decompressed_size = static_cast<uint32_t>(job->input.size());
+			frames.push_back(frame);
+			output_bytes += job->output.size();
+		}
+		else
+		{
+			failed = true;
+		}
+
+		free_jobs.push_back(std::move(job));
+		frame_written.notify_all();
+	}
+	writing = false;
+
+	// The last frame taken off the queue is only in the file now.
+	frame_written.notify_all();
+}
+
+bool CompressedSink::flush()
+{
+	if (workers.empty())
+		return false;
+
+	if (!block.empty() && !submit())
+		return false;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	frame_written.wait(lock, [this]() { return failed || (in_flight.empty() && !writing); });
+	if (failed)
+		return false;
+	lock.unlock();
+
+	return file.flush();
+}
+
+bool CompressedSink::write_seek_table()
+{
+	const uint32_t frame_count = static_cast<uint32_t>(frames.size());
+	const uint32_t footer_size = 9;		// Frame count, descriptor and magic number.
+
+	std::vector<char> table;
+	table.reserve(8 + frames.size() * sizeof(frame_t) + footer_size);
+
+	const uint32_t header[2] = {SKIPPABLE_MAGIC, static_cast<uint32_t>(frames.size() * sizeof(frame_t) + footer_size)};
+	table.insert(table.end(), reinterpret_cast<const char*>(header), reinterpret_cast<const char*>(header + 2));
+	table.insert(table.end(), reinterpret_cast<const char*>(frames.data()),
+		reinterpret_cast<const char*>(frames.data() + frames.size()));
+	table.insert(table.end(), reinterpret_cast<const char*>(&frame_count),
+		reinterpret_cast<const char*>(&frame_count + 1));
+	table.push_back(0);		// Descriptor: no frame checksums.
+	table.insert(table.end(), reinterpret_cast<const char*>(&SEEKABLE_MAGIC),
+		reinterpret_cast<const char*>(&SEEKABLE_MAGIC + 1));
+
+	if (!file.write(table.data(), table.size()))
+		return false;
+
+	output_bytes += table.size();
+	return true;
+}
+
+bool CompressedSink::close()
+{
+	if (workers.empty())
+		return true;
+
+	bool result = flush();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+
+	// Blocks left after a failure are discarded.
+	in_flight.clear();
+	pending.clear();
+
+	result = result && write_seek_table();
+	result = file.close() && result;
+	return result;
+}
+
+uint64_t CompressedSink::bytes_in() const
+{
+	return input_bytes;
+}
+
+uint64_t CompressedSink::bytes_out() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return output_bytes;
+}
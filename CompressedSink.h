@@ -0,0 +1,206 @@
+#ifndef COMPRESSED_SINK_H_
+#define COMPRESSED_SINK_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FdSink.h"
+#include "PcapSink.h"
+
+/**
+ * This sink compresses the pcap stream into a file of independent LZ4 or zstd frames. Written bytes are collected
+ * into blocks of a fixed size, and each full block is compressed by a pool of worker threads into one complete frame,
+ * so the thread writing packets never compresses. Frames are written to the file in order by the worker which finishes
+ * the oldest one.
+ *
+ * On close a seek table is appended, in the zstd seekable format: a skippable frame (magic 0x184D2A5E) listing the
+ * compressed and decompressed size of every frame, followed by the frame count, a descriptor byte and the magic number
+ * 0x8F92EAB1. Skippable frames are ignored by both "lz4 -d" and "zstd -d", so the file decompresses to the original
+ * pcap file with the standard tools, while CompressedReader uses the table to decompress only the frames it needs.
+ *
+ * Codecs are compiled in if their libraries were found by the build (PCAP_WRITER_HAVE_LZ4, PCAP_WRITER_HAVE_ZSTD); see
+ * available().
+ */
+class CompressedSink : public PcapSink
+{
+public:
+	/// Compression format of frames
+	enum class codec
+	{
+		/// LZ4 frame format
+		lz4,
+
+		/// Zstandard frame format
+		zstd
+	};
+
+	/**
+	 * @param compression Compression format of frames.
+	 * @param block_size Number of uncompressed bytes in each frame.
+	 * @param worker_count Number of compression threads.
+	 * @param level Compression level, or 0 for the codec's default.
+	 */
+	CompressedSink(codec compression = codec::zstd, size_t block_size = 1024 * 1024, unsigned int worker_count = 2,
+		int level = 0);
+
+	/// Closes the sink if it is open.
+	~CompressedSink() override;
+
+	CompressedSink(const CompressedSink&) = delete;
+	CompressedSink& operator=(const CompressedSink&) = delete;
+
+	/**
+	 * @param compression Compression format.
+	 * @return True if the format has been compiled in.
+	 */
+	static bool available(codec compression);
+
+	/**
+	 * Creates (or truncates) the output file and starts the worker threads.
+	 *
+	 * @param path The output file path.
+	 * @return True for success, false if the file could not be opened or the codec is not available.
+	 */
+	bool open(const std::string& path);
+
+	bool write(const void* buffer, size_t count) override;
+
+	/// Compresses the current partial block, then waits until every frame has been written.
+	bool flush() override;
+
+	/// Flushes, stops the worker threads, appends the seek table and closes the file.
+	bool close() override;
+
+	/// @return Number of uncompressed bytes written to the sink.
+	uint64_t bytes_in() const;
+
+	/// @return Number of compressed bytes written to the file so far, including the seek table once closed.
+	uint64_t bytes_out() const;
+
+	/// Magic number of the skippable frame holding the seek table
+	constexpr static uint32_t SKIPPABLE_MAGIC = 0x184d2a5e;
+
+	/// Magic number at the end of the seek table
+	constexpr static uint32_t SEEKABLE_MAGIC = 0x8f92eab1;
+
+private:
+	/// One block on its way from the packet path to the file
+	struct job_t
+	{
+		/// Uncompressed block
+		std::vector<char> input;
+
+		/// Compressed frame
+		std::vector<char> output;
+
+		/// True once compressed
+		bool done;
+
+		/// True if compression has succeeded
+		bool succeeded;
+	};
+
+	/// Seek table entry of one frame
+	struct frame_t
+	{
+		/// Size of the compressed frame
+		uint32_t compressed_size;
+
+		/// Size of the block it decompresses to
+		uint32_t decompressed_size;
+	};
+
+	/// Loop of each worker thread.
+	void work();
+
+	/**
+	 * Compresses a block into one frame.
+	 *
+	 * @param job The block.
+	 * @param context Per-thread compression context of the codec, or nullptr.
+	 * @return True for success and false for failure.
+	 */
+	bool compress(job_t* job, void* context) const;
+
+	/**
+	 * Hands the current block over to the worker threads, waiting while too many blocks are in flight.
+	 *
+	 * @return False if compressing or writing has failed.
+	 */
+	bool submit();
+
+	/**
+	 * Writes compressed frames at the front of the queue, in order. Only one thread writes at a time.
+	 *
+	 * @param lock Lock of mutex, held on entry and on return.
+	 */
+	void write_frames(std::unique_lock<std::mutex>& lock);
+
+	/// Appends the seek table to the file.
+	bool write_seek_table();
+
+	/// Compression format
+	codec compression;
+
+	/// Uncompressed size of each frame
+	size_t block_size;
+
+	/// Number of worker threads
+	unsigned int worker_count;
+
+	/// Compression level
+	int level;
+
+	/// Output file
+	FdSink file;
+
+	/// Block being filled by the packet path
+	std::vector<char> block;
+
+	/// Blocks submitted and not yet written, in file order, guarded by mutex
+	std::deque<std::unique_ptr<job_t>> in_flight;
+
+	/// Blocks waiting for a worker, guarded by mutex
+	std::deque<job_t*> pending;
+
+	/// Jobs whose buffers are reused, guarded by mutex
+	std::vector<std::unique_ptr<job_t>> free_jobs;
+
+	/// Seek table, guarded by mutex
+	std::vector<frame_t> frames;
+
+	/// Number of uncompressed bytes written
+	uint64_t input_bytes;
+
+	/// Number of compressed bytes written, guarded by mutex
+	uint64_t output_bytes;
+
+	/// True if compressing or writing has failed, guarded by mutex
+	bool failed;
+
+	/// True while a thread writes frames, guarded by mutex
+	bool writing;
+
+	/// True when worker threads shall exit, guarded by mutex
+	bool stopping;
+
+	/// Guards state shared with worker threads
+	mutable std::mutex mutex;
+
+	/// Wakes up worker threads
+	std::condition_variable work_ready;
+
+	/// Wakes up the packet path when a frame has been written
+	std::condition_variable frame_written;
+
+	/// Worker threads
+	std::vector<std::thread> workers;
+};
+
+#endif
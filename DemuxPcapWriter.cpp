@@ -0,0 +1,334 @@
+#include "DemuxPcapWriter.h"
+
+#include <cstring>
+
+constexpr uint32_t DemuxPcapWriter::LINKTYPE_ETHERNET;
+constexpr uint32_t DemuxPcapWriter::LINKTYPE_LINUX_SLL;
+constexpr uint32_t DemuxPcapWriter::LINKTYPE_LINUX_SLL2;
+constexpr size_t DemuxPcapWriter::DEFAULT_BUFFER_SIZE;
+
+namespace
+{
+
+/// Ethernet types of VLAN tags
+enum : uint32_t
+{
+	ETHERTYPE_VLAN = 0x8100,
+	ETHERTYPE_QINQ = 0x88a8
+};
+
+/// Reads a big-endian 16-bit word.
+inline uint32_t load16(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 8 | data[1];
+}
+
+}
+
+DemuxPcapWriter::BufferedSink::BufferedSink(size_t buffer_size)
+: capacity(buffer_size)
+, used(0)
+{
+}
+
+bool DemuxPcapWriter::BufferedSink::open(const std::string& path, bool append)
+{
+	if (!file.open(path, append))
+		return false;
+
+	file.set_stats(sink_stats);
+	data.reset(new char[capacity]);
+	used = 0;
+	return true;
+}
+
+bool DemuxPcapWriter::BufferedSink::is_open() const
+{
+	return file.descriptor() >= 0;
+}
+
+bool DemuxPcapWriter::BufferedSink::write(const void* buffer, size_t count)
+{
+	if (!is_open())
+		return false;
+
+	if (used + count > capacity)
+	{
+		if (!flush())
+			return false;
+
+		// Bytes which would fill the whole buffer gain nothing from being copied.
+		if (count >= capacity)
+			return file.write(buffer, count);
+	}
+
+	memcpy(data.get() + used, buffer, count);
+	used += count;
+	return true;
+}
+
+bool DemuxPcapWriter::BufferedSink::flush()
+{
+	if (used == 0)
+		return true;
+
+	// The bytes are dropped on failure, so that a failed write is not repeated by every later one.
+	const bool result = file.write(data.get(), used);
+	used = 0;
+	return result;
+}
+
+bool DemuxPcapWriter::BufferedSink::close()
+{
+	if (!is_open())
+		return true;
+
+	bool result = flush();
+	result = file.close() && result;
+	data.reset();
+	return result;
+}
+
+bool DemuxPcapWriter::stream_key_t::operator==(const stream_key_t& other) const
+{
+	return link_type == other.link_type && key == other.key;
+}
+
+size_t DemuxPcapWriter::stream_key_hash::operator()(const stream_key_t& stream_key) const
+{
+	// Keys are often small consecutive numbers, so they are spread with the golden ratio multiplier.
+	return static_cast<size_t>((stream_key.key ^ static_cast<uint64_t>(stream_key.link_type) << 48)
+		* 0x9e3779b97f4a7c15ull);
+}
+
+DemuxPcapWriter::stream_t::stream_t(const stream_key_t& stream_key, size_t buffer_size)
+: id(stream_key)
+, sink(buffer_size)
+, created(false)
+{
+}
+
+DemuxPcapWriter::DemuxPcapWriter(const std::string& path_prefix, unsigned int max_open_files,
+	unsigned int flush_interval_ms, size_t buffer_size)
+: prefix(path_prefix)
+, max_open(max_open_files)
+, flush_interval(flush_interval_ms)
+, stream_buffer_size(buffer_size)
+, snapshot_length(0)
+, last_stream(nullptr)
+, eviction_count(0)
+, failed(false)
+, stopping(false)
+{
+}
+
+DemuxPcapWriter::~DemuxPcapWriter()
+{
+	close();
+}
+
+void DemuxPcapWriter::set_snaplen(uint32_t snaplen)
+{
+	snapshot_length = snaplen;
+}
+
+std::string DemuxPcapWriter::file_path(uint32_t link_type, uint64_t key) const
+{
+	return prefix + "." + std::to_string(link_type) + "." + std::to_string(key) + ".pcap";
+}
+
+bool DemuxPcapWriter::open()
+{
+	close();
+
+	if (max_open == 0)
+		return false;
+
+	eviction_count.store(0, std::memory_order_relaxed);
+	failed.store(false, std::memory_order_relaxed);
+	stopping = false;
+	background_thread = std::thread(&DemuxPcapWriter::background, this);
+	return true;
+}
+
+void DemuxPcapWriter::background()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stop_requested.wait_for(lock, flush_interval, [this]() { return stopping; }))
+	{
+		// The packet path only inserts streams under the mutex, so they can be walked while it writes packets.
+		for (auto& entry : streams)
+		{
+			stream_t& stream = *entry.second;
+			std::lock_guard<std::mutex> stream_lock(stream.mutex);
+			if (stream.sink.is_open() && !stream.writer.flush())
+				failed.store(true, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool DemuxPcapWriter::reopen(stream_t* stream)
+{
+	if (open_streams.size() >= max_open)
+	{
+		stream_t* evicted = open_streams.back();
+		open_streams.pop_back();
+
+		std::lock_guard<std::mutex> lock(evicted->mutex);
+		if (!evicted->sink.close())
+			failed.store(true, std::memory_order_relaxed);
+		eviction_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	if (!stream->sink.open(file_path(stream->id.link_type, stream->id.key), stream->created))
+		return false;
+
+	if (!stream->created)
+	{
+		stream->writer.set_snaplen(snapshot_length);
+		if (stream->writer.write_pcap_header(&stream->sink, stream->id.link_type) < 0)
+		{
+			stream->sink.close();
+			return false;
+		}
+		stream->created = true;
+	}
+
+	open_streams.push_front(stream);
+	stream->lru_position = open_streams.begin();
+	return true;
+}
+
+DemuxPcapWriter::stream_t* DemuxPcapWriter::open_stream(uint32_t link_type, uint64_t key)
+{
+	// Packets of one stream usually come in runs, which skip the lookup.
+	stream_t* stream = last_stream;
+	if (!stream || stream->id.key != key || stream->id.link_type != link_type)
+	{
+		const stream_key_t stream_key = {link_type, key};
+		auto position = streams.find(stream_key);
+		if (position == streams.end())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			position = streams.emplace(stream_key,
+				std::unique_ptr<stream_t>(new stream_t(stream_key, stream_buffer_size))).first;
+		}
+
+		stream = position->second.get();
+		last_stream = stream;
+	}
+
+	if (!stream->sink.is_open())
+		return reopen(stream) ? stream : nullptr;
+
+	if (stream->lru_position != open_streams.begin())
+		open_streams.splice(open_streams.begin(), open_streams, stream->lru_position);
+
+	return stream;
+}
+
+int DemuxPcapWriter::write_packet(uint32_t link_type, uint64_t key, const char* frame, uint32_t frame_size,
+	timeval time)
+{
+	stream_t* stream = open_stream(link_type, key);
+	if (!stream)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	return stream->writer.write_packet(frame, frame_size, time);
+}
+
+long int DemuxPcapWriter::write_packets(uint32_t link_type, uint64_t key, const PcapWriter::packet_t* packets,
+	size_t count)
+{
+	stream_t* stream = open_stream(link_type, key);
+	if (!stream)
+		return -1;
+
+	std::lock_guard<std::mutex> lock(stream->mutex);
+	return stream->writer.write_packets(packets, count);
+}
+
+bool DemuxPcapWriter::close()
+{
+	if (!background_thread.joinable())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	stop_requested.notify_one();
+	background_thread.join();
+
+	bool result = !failed.load(std::memory_order_relaxed);
+	for (stream_t* stream : open_streams)
+		result = stream->sink.close() && result;
+
+	open_streams.clear();
+	streams.clear();
+	last_stream = nullptr;
+	return result;
+}
+
+size_t DemuxPcapWriter::stream_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return streams.size();
+}
+
+size_t DemuxPcapWriter::open_files() const
+{
+	return open_streams.size();
+}
+
+uint64_t DemuxPcapWriter::evictions() const
+{
+	return eviction_count.load(std::memory_order_relaxed);
+}
+
+uint64_t DemuxPcapWriter::vlan_key(uint32_t link_type, const char* frame, uint32_t frame_size)
+{
+	// Offsets of the Ethernet type (or protocol) field and of the payload, where a VLAN tag begins.
+	uint32_t type_offset = 0;
+	uint32_t payload_offset = 0;
+	switch (link_type)
+	{
+	case LINKTYPE_ETHERNET:
+		type_offset = 12;
+		payload_offset = 14;
+		break;
+	case LINKTYPE_LINUX_SLL:
+		type_offset = 14;
+		payload_offset = 16;
+		break;
+	case LINKTYPE_LINUX_SLL2:
+		type_offset = 0;
+		payload_offset = 20;
+		break;
+	default:
+		return 0;
+	}
+
+	if (frame_size < payload_offset + 2)
+		return 0;
+
+	const uint8_t* packet = reinterpret_cast<const uint8_t*>(frame);
+	const uint32_t ether_type = load16(packet + type_offset);
+	if (ether_type != ETHERTYPE_VLAN && ether_type != ETHERTYPE_QINQ)
+		return 0;
+
+	// The identifier is the low 12 bits of the tag control information, after priority and drop eligibility.
+	return load16(packet + payload_offset) & 0x0fff;
+}
+
+uint64_t DemuxPcapWriter::interface_key(uint32_t link_type, const char* frame, uint32_t frame_size)
+{
+	// Interface index is a big-endian 32-bit word after protocol and reserved fields.
+	if (link_type != LINKTYPE_LINUX_SLL2 || frame_size < 8)
+		return 0;
+
+	const uint8_t* packet = reinterpret_cast<const uint8_t*>(frame);
+	return static_cast<uint64_t>(load16(packet + 4)) << 16 | load16(packet + 6);
+}
@@ -0,0 +1,287 @@
+#ifndef DEMUX_PCAP_WRITER_H_
+#define DEMUX_PCAP_WRITER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "FdSink.h"
+#include "PcapWriter.h"
+
+/**
+ * This class splits a capture which mixes several sources into one file per stream ("<prefix>.<link_type>.<key>.pcap"),
+ * e.g. one per link type or one per tenant VLAN. A stream is identified by the link type of its packets and a key,
+ * which is either chosen by the caller or parsed from the packet with vlan_key() or interface_key(). The file and
+ * PcapWriter of a stream are created with its first packet.
+ *
+ * At most max_open_files descriptors are open at once: opening one more closes the least recently written stream,
+ * which is reopened for appending, without another global header, when its next packet comes.
+ *
+ * Records of each stream are gathered in a buffer of its own and written out when it is full. One background thread,
+ * shared by every stream, writes out all buffers each flush interval, so that streams with little traffic still reach
+ * the disk in time.
+ *
+ * Only one thread may write packets.
+ *
+ * Usage:
+ *	DemuxPcapWriter writer("capture");
+ *	writer.open();
+ *	writer.write_packet(1, DemuxPcapWriter::vlan_key(1, frame, frame_size), frame, frame_size, time);
+ */
+class DemuxPcapWriter
+{
+public:
+	/// Ethernet link type
+	constexpr static uint32_t LINKTYPE_ETHERNET = 1;
+
+	/// Linux cooked capture link type
+	constexpr static uint32_t LINKTYPE_LINUX_SLL = 113;
+
+	/// Linux cooked capture v2 link type, which has the interface index
+	constexpr static uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+	/// Default size of the buffer of each open stream in bytes
+	constexpr static size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+	/**
+	 * @param path_prefix Prefix of output files.
+	 * @param max_open_files Maximum number of streams whose file is open at once, greater than zero.
+	 * @param flush_interval_ms Time between writes of all buffers by the background thread in milliseconds.
+	 * @param buffer_size Size of the buffer of each open stream in bytes.
+	 */
+	DemuxPcapWriter(const std::string& path_prefix, unsigned int max_open_files = 64,
+		unsigned int flush_interval_ms = 100, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+	/// Closes the writer if it is open.
+	~DemuxPcapWriter();
+
+	DemuxPcapWriter(const DemuxPcapWriter&) = delete;
+	DemuxPcapWriter& operator=(const DemuxPcapWriter&) = delete;
+
+	/**
+	 * Sets the snapshot length of every file (see PcapWriter::set_snaplen()). It must be called before open().
+	 *
+	 * @param snaplen The snapshot length, greater than zero.
+	 */
+	void set_snaplen(uint32_t snaplen);
+
+	/**
+	 * Starts the background thread. Files are created by the first packet of each stream.
+	 *
+	 * @return True if the writer has been opened; false if max_open_files is zero.
+	 */
+	bool open();
+
+	/**
+	 * Writes packet to the file of its stream, creating or reopening the file first if needed.
+	 *
+	 * @param link_type Data link layer type of the packet (1 = Ethernet).
+	 * @param key Key of the stream within the link type.
+	 * @return Same as PcapWriter::write_packet(), or "-1" if the file of the stream could not be opened.
+	 */
+	int write_packet(uint32_t link_type, uint64_t key, const char* frame, uint32_t frame_size, timeval time);
+
+	/**
+	 * Writes a batch of packets of one stream.
+	 *
+	 * @param link_type Data link layer type of the packets.
+	 * @param key Key of the stream within the link type.
+	 * @return Same as PcapWriter::write_packets(), or "-1" if the file of the stream could not be opened.
+	 */
+	long int write_packets(uint32_t link_type, uint64_t key, const PcapWriter::packet_t* packets, size_t count);
+
+	/**
+	 * Stops the background thread, then writes out the buffers of every stream and closes their files.
+	 *
+	 * @return True if every file has been written and closed successfully; otherwise false.
+	 */
+	bool close();
+
+	/// @return Path of the file of the given stream.
+	std::string file_path(uint32_t link_type, uint64_t key) const;
+
+	/// @return Number of streams which have been written since open().
+	size_t stream_count() const;
+
+	/// @return Number of files open now. Only the thread which writes packets may call this.
+	size_t open_files() const;
+
+	/// @return Number of files which have been closed to stay within max_open_files since open().
+	uint64_t evictions() const;
+
+	/**
+	 * Parses the VLAN identifier of the outermost 802.1Q or 802.1ad tag of a packet.
+	 *
+	 * @param link_type Data link layer type of the packet: Ethernet, Linux SLL or Linux SLL2.
+	 * @return The VLAN identifier, or 0 if the packet has no tag or another link type.
+	 */
+	static uint64_t vlan_key(uint32_t link_type, const char* frame, uint32_t frame_size);
+
+	/**
+	 * Parses the index of the interface which a packet has been captured on.
+	 *
+	 * @param link_type Data link layer type of the packet; only Linux SLL2 headers have the interface index.
+	 * @return The interface index, or 0 if the packet has another link type.
+	 */
+	static uint64_t interface_key(uint32_t link_type, const char* frame, uint32_t frame_size);
+
+private:
+	/// Sink which gathers bytes in a buffer and writes them to its file when the buffer is full or flushed
+	class BufferedSink : public PcapSink
+	{
+	public:
+		/**
+		 * @param buffer_size Size of the buffer in bytes.
+		 */
+		explicit BufferedSink(size_t buffer_size);
+
+		/**
+		 * Opens the file and allocates the buffer.
+		 *
+		 * @param path The output file path.
+		 * @param append True to write after the contents of an existing file.
+		 * @return True if the file has been opened; otherwise false.
+		 */
+		bool open(const std::string& path, bool append);
+
+		/// @return True if the file is open.
+		bool is_open() const;
+
+		bool write(const void* buffer, size_t count) override;
+
+		bool flush() override;
+
+		/// Writes out the buffer, closes the file and frees the buffer.
+		bool close() override;
+
+	private:
+		/// Output file
+		FdSink file;
+
+		/// Buffer memory, allocated while the file is open
+		std::unique_ptr<char[]> data;
+
+		/// Size of the buffer in bytes
+		size_t capacity;
+
+		/// Number of bytes in the buffer
+		size_t used;
+	};
+
+	/// Identity of a stream
+	struct stream_key_t
+	{
+		/// Data link layer type
+		uint32_t link_type;
+
+		/// Key within the link type
+		uint64_t key;
+
+		bool operator==(const stream_key_t& other) const;
+	};
+
+	/// Hash of a stream identity
+	struct stream_key_hash
+	{
+		size_t operator()(const stream_key_t& stream_key) const;
+	};
+
+	/// One output stream
+	struct stream_t
+	{
+		/**
+		 * @param stream_key Identity of the stream.
+		 * @param buffer_size Size of the buffer of the sink in bytes.
+		 */
+		stream_t(const stream_key_t& stream_key, size_t buffer_size);
+
+		/// Identity of the stream
+		stream_key_t id;
+
+		/// Guards sink and writer between the packet path and the background thread
+		std::mutex mutex;
+
+		/// Output sink
+		BufferedSink sink;
+
+		/// Pcap writer of the file
+		PcapWriter writer;
+
+		/// True once the global header has been written, so the file is reopened for appending
+		bool created;
+
+		/// Position in the list of open streams, valid while the file is open
+		std::list<stream_t*>::iterator lru_position;
+	};
+
+	/**
+	 * Finds the stream of a packet, creating it if it is new, and opens its file if it is closed.
+	 *
+	 * @param link_type Data link layer type of the packet.
+	 * @param key Key of the stream within the link type.
+	 * @return The stream, or nullptr if its file could not be opened.
+	 */
+	stream_t* open_stream(uint32_t link_type, uint64_t key);
+
+	/**
+	 * Opens the file of a closed stream, closing the least recently written stream first if max_open_files are open.
+	 *
+	 * @param stream The stream.
+	 * @return True if the file has been opened, and its global header written if it is new; otherwise false.
+	 */
+	bool reopen(stream_t* stream);
+
+	/// Background thread main loop.
+	void background();
+
+	/// Prefix of output files
+	std::string prefix;
+
+	/// Maximum number of open files
+	unsigned int max_open;
+
+	/// Time between writes of all buffers by the background thread
+	std::chrono::milliseconds flush_interval;
+
+	/// Size of the buffer of each open stream
+	size_t stream_buffer_size;
+
+	/// Snapshot length of all files, 0 for the PcapWriter default
+	uint32_t snapshot_length;
+
+	/// Every stream, guarded by mutex against insertion while the background thread walks it
+	std::unordered_map<stream_key_t, std::unique_ptr<stream_t>, stream_key_hash> streams;
+
+	/// Streams whose file is open, most recently written first; used by the packet path only
+	std::list<stream_t*> open_streams;
+
+	/// Stream of the previous packet, or nullptr
+	stream_t* last_stream;
+
+	/// Number of evicted files
+	std::atomic<uint64_t> eviction_count;
+
+	/// True if writing a buffer or closing a file has failed
+	std::atomic<bool> failed;
+
+	/// True when the background thread shall exit, guarded by mutex
+	bool stopping;
+
+	/// Guards streams and stopping
+	mutable std::mutex mutex;
+
+	/// Wakes up the background thread to exit
+	std::condition_variable stop_requested;
+
+	/// Background thread
+	std::thread background_thread;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "DirectSink.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr size_t DirectSink::BLOCK_SIZE;
+
+DirectSink::DirectSink(size_t buffer_size)
+: fd(-1)
+, staging_buffer(nullptr)
+, staging_size((buffer_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE)
+, staging_used(0)
+, file_size(0)
+{
+	if (staging_size == 0)
+		staging_size = BLOCK_SIZE;
+}
+
+DirectSink::~DirectSink()
+{
+	close();
+	free(staging_buffer);
+}
+
+bool DirectSink::open(const std::string& path)
+{
+	close();
+
+	if (!staging_buffer)
+	{
+		void* buffer = nullptr;
+		if (posix_memalign(&buffer, BLOCK_SIZE, staging_size) != 0)
+			return false;
+
+		staging_buffer = static_cast<char*>(buffer);
+	}
+
+	// 0666 means user, group and others have read and write permission on this file (minus umask).
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+	staging_used = 0;
+	file_size = 0;
+	return fd >= 0;
+}
+
+bool DirectSink::write_blocks(size_t count)
+{
+	const char* temp_buffer = staging_buffer;
+
+	ssize_t bytes_written = 0;
+	errno = 0;
+	while (count > 0)
+	{
+		if (sink_stats)
+			sink_stats->add_write_call();
+
+		if ((bytes_written = ::write(fd, temp_buffer, count)) <= 0)
+		{
+			if (errno != EINTR && errno != EAGAIN)
+				return false;
+
+			if (sink_stats)
+				sink_stats->add_retry();
+			continue;
+		}
+
+		// A short write which is not block-aligned would misalign every following write.
+		if (bytes_written % static_cast<ssize_t>(BLOCK_SIZE) != 0)
+			return false;
+
+		count -= static_cast<size_t>(bytes_written);
+		temp_buffer += bytes_written;
+
+		if (count > 0 && sink_stats)
+			sink_stats->add_retry();
+	}
+
+	return true;
+}
+
+bool DirectSink::write(const void* buffer, size_t count)
+{
+	if (fd < 0)
+		return false;
+
+	const char* temp_buffer = reinterpret_cast<const char*>(buffer);
+	file_size += count;
+
+	while (count > 0)
+	{
+		const size_t chunk = count < staging_size - staging_used ? count : staging_size - staging_used;
+		memcpy(staging_buffer + staging_used, temp_buffer, chunk);
+		staging_used += chunk;
+		temp_buffer += chunk;
+		count -= chunk;
+
+		if (staging_used == staging_size)
+		{
+			if (!write_blocks(staging_size))
+				return false;
+
+			staging_used = 0;
+		}
+	}
+
+	if (sink_stats)
+		sink_stats->set_buffered(staging_used);
+	return true;
+}
+
+bool DirectSink::flush()
+{
+	if (fd < 0)
+		return false;
+
+	const size_t whole_blocks = staging_used / BLOCK_SIZE * BLOCK_SIZE;
+	if (whole_blocks == 0)
+		return true;
+
+	if (!write_blocks(whole_blocks))
+		return false;
+
+	staging_used -= whole_blocks;
+	memmove(staging_buffer, staging_buffer + whole_blocks, staging_used);
+	if (sink_stats)
+		sink_stats->set_buffered(staging_used);
+	return true;
+}
+
+bool DirectSink::close()
+{
+	if (fd < 0)
+		return true;
+
+	bool result = true;
+	if (staging_used > 0)
+	{
+		// Pads the final partial block with zeros, writes it and cuts the padding off the file.
+		const size_t padded_size = (staging_used + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+		memset(staging_buffer + staging_used, 0, padded_size - staging_used);
+		result = write_blocks(padded_size);
+		if (result)
+			result = ftruncate(fd, static_cast<off_t>(file_size)) == 0;
+	}
+
+	result = ::close(fd) == 0 && result;
+	fd = -1;
+	staging_used = 0;
+	if (sink_stats)
+		sink_stats->set_buffered(0);
+	return result;
+}
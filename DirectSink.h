@@ -0,0 +1,75 @@
+#ifndef DIRECT_SINK_H_
+#define DIRECT_SINK_H_
+
+#include <cstdint>
+#include <string>
+
+#include "PcapSink.h"
+
+/**
+ * Pcap sink which writes to a file opened with O_DIRECT, so written data bypasses the page cache and sustained
+ * captures do not evict other data on the host. O_DIRECT requires the buffer address, file offset and length of every
+ * write to be aligned to the logical block size, so bytes are gathered in a block-aligned staging buffer owned by the
+ * sink and only whole blocks are written. On close the final partial block is padded with zeros, written, and the file
+ * is truncated back to its exact length.
+ */
+class DirectSink : public PcapSink
+{
+public:
+	/// Alignment of staging buffer, writes and file offsets
+	constexpr static size_t BLOCK_SIZE = 4096;
+
+	/**
+	 * @param buffer_size Size of staging buffer, rounded up to a multiple of BLOCK_SIZE.
+	 */
+	explicit DirectSink(size_t buffer_size = 4 * 1024 * 1024);
+
+	~DirectSink() override;
+
+	DirectSink(const DirectSink&) = delete;
+	DirectSink& operator=(const DirectSink&) = delete;
+
+	/**
+	 * Creates (or truncates) the output file with O_DIRECT. Fails on file systems without O_DIRECT support (tmpfs).
+	 *
+	 * @param path The output file path.
+	 * @return True if output file has been opened and staging buffer allocated successfully; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	bool write(const void* buffer, size_t count) override;
+
+	/**
+	 * Writes all whole blocks of the staging buffer. The trailing partial block stays buffered until it is filled or
+	 * the sink is closed.
+	 */
+	bool flush() override;
+
+	bool close() override;
+
+private:
+	/**
+	 * Writes the first count bytes of the staging buffer, which must be a multiple of BLOCK_SIZE.
+	 *
+	 * @param count Number of bytes to write.
+	 * @return True for success and false for failure to write.
+	 */
+	bool write_blocks(size_t count);
+
+	/// Output file descriptor, opened with O_DIRECT
+	int fd;
+
+	/// Block-aligned staging buffer
+	char* staging_buffer;
+
+	/// Size of staging buffer
+	size_t staging_size;
+
+	/// Number of bytes waiting in staging buffer
+	size_t staging_used;
+
+	/// Number of bytes written to the file by the user, excluding padding
+	uint64_t file_size;
+};
+
+#endif
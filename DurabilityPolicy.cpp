@@ -0,0 +1,157 @@
+#include "DurabilityPolicy.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint64_t DurabilityPolicy::DEFAULT_INTERVAL_BYTES;
+constexpr unsigned int DurabilityPolicy::DEFAULT_INTERVAL_MS;
+
+DurabilityPolicy::DurabilityPolicy(level durability, uint64_t interval_bytes, unsigned int interval_ms)
+: durability_level(durability)
+, bytes_interval(interval_bytes)
+, time_interval(interval_ms)
+, fd(-1)
+, next_offset(interval_bytes > 0 ? interval_bytes : UINT64_MAX)
+, timer_expired(false)
+, requested_offset(0)
+, stopping(false)
+, synced_offset(0)
+, sync_count(0)
+, error_count(0)
+{
+}
+
+DurabilityPolicy::~DurabilityPolicy()
+{
+	stop();
+}
+
+bool DurabilityPolicy::start(int file_descriptor)
+{
+	if (background_thread.joinable() || (file_descriptor < 0 && durability_level != level::flush))
+		return false;
+
+	fd = file_descriptor;
+	next_offset = bytes_interval > 0 ? bytes_interval : UINT64_MAX;
+	timer_expired.store(false, std::memory_order_relaxed);
+	requested_offset = 0;
+	stopping = false;
+	synced_offset.store(0, std::memory_order_relaxed);
+	sync_count.store(0, std::memory_order_relaxed);
+	error_count.store(0, std::memory_order_relaxed);
+
+	background_thread = std::thread(&DurabilityPolicy::background, this);
+	return true;
+}
+
+bool DurabilityPolicy::stop()
+{
+	if (!background_thread.joinable())
+		return error_count.load(std::memory_order_relaxed) == 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_one();
+	background_thread.join();
+
+	// Bytes written after the last checkpoint are synced too, up to the end of file.
+	struct stat file_status;
+	if (fd >= 0 && fstat(fd, &file_status) == 0)
+	{
+		if (sync(synced_offset.load(std::memory_order_relaxed), 0))
+			synced_offset.store(static_cast<uint64_t>(file_status.st_size), std::memory_order_relaxed);
+	}
+
+	return error_count.load(std::memory_order_relaxed) == 0;
+}
+
+void DurabilityPolicy::checkpoint(uint64_t offset)
+{
+	next_offset = bytes_interval > 0 ? offset + bytes_interval : UINT64_MAX;
+	timer_expired.store(false, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requested_offset = offset;
+	}
+	work_ready.notify_one();
+}
+
+uint64_t DurabilityPolicy::durable_offset() const
+{
+	return synced_offset.load(std::memory_order_relaxed);
+}
+
+uint64_t DurabilityPolicy::syncs() const
+{
+	return sync_count.load(std::memory_order_relaxed);
+}
+
+uint64_t DurabilityPolicy::errors() const
+{
+	return error_count.load(std::memory_order_relaxed);
+}
+
+void DurabilityPolicy::background()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		const uint64_t synced = synced_offset.load(std::memory_order_relaxed);
+		if (requested_offset > synced)
+		{
+			const uint64_t target = requested_offset;
+
+			lock.unlock();
+			sync(synced, target);
+			lock.lock();
+
+			// A failed range is not retried, so one bad sync does not stall every later checkpoint.
+			synced_offset.store(target, std::memory_order_relaxed);
+			continue;
+		}
+
+		if (stopping)
+			break;
+
+		if (time_interval.count() == 0)
+		{
+			work_ready.wait(lock);
+		}
+		else if (work_ready.wait_for(lock, time_interval) == std::cv_status::timeout && !stopping
+			&& requested_offset <= synced)
+		{
+			// Checkpoints are taken by the writer thread, which owns the sink; it is asked to take one.
+			timer_expired.store(true, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool DurabilityPolicy::sync(uint64_t from, uint64_t to)
+{
+	bool result = true;
+	switch (durability_level)
+	{
+		case level::flush:
+			return true;
+		case level::writeback:
+			result = sync_file_range(fd, static_cast<off64_t>(from), static_cast<off64_t>(to > from ? to - from : 0),
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) == 0;
+			break;
+		case level::data:
+			result = fdatasync(fd) == 0;
+			break;
+		case level::full:
+			result = fsync(fd) == 0;
+			break;
+	}
+
+	sync_count.store(sync_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (!result)
+		error_count.store(error_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	return result;
+}
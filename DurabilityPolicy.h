@@ -0,0 +1,178 @@
+#ifndef DURABILITY_POLICY_H_
+#define DURABILITY_POLICY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * This class bounds how much of a capture is lost if the capture process or the machine dies. Every interval_bytes
+ * written, or every interval_ms, the writer reaches a checkpoint: it flushes its sink, so the bytes written so far
+ * are in the operating system, and hands their end offset to a background thread which makes them durable. The
+ * packet path only flushes user space buffers; it never waits for storage.
+ *
+ * Durability levels, from the cheapest:
+ *
+ *	- flush: checkpoints only flush the sink. Nothing is lost if the process dies, but a crash of the machine loses
+ *	  whatever the kernel has not written back yet.
+ *	- writeback: the new bytes are also written to the device with sync_file_range(), waiting for completion. Dirty
+ *	  page cache stays bounded, but neither file metadata nor the device cache is flushed, so a crash of the machine
+ *	  may still lose them.
+ *	- data: fdatasync(), the bytes and the file size are durable.
+ *	- full: fsync(), all file metadata (e.g. modification time) is durable too.
+ *
+ * After a crash the file may end with a torn record; PcapRecovery truncates it.
+ *
+ * Usage:
+ *	DurabilityPolicy durability(DurabilityPolicy::level::data, 64 * 1024 * 1024, 1000);
+ *	durability.start(sink.descriptor());
+ *	writer.set_durability(&durability);
+ *	...
+ *	writer.flush();
+ *	durability.stop();
+ */
+class DurabilityPolicy
+{
+public:
+	/// Durability level of checkpoints
+	enum class level
+	{
+		/// Flush the sink only
+		flush,
+
+		/// Write the new bytes back to the device with sync_file_range()
+		writeback,
+
+		/// fdatasync()
+		data,
+
+		/// fsync()
+		full
+	};
+
+	/// Default number of bytes between checkpoints
+	constexpr static uint64_t DEFAULT_INTERVAL_BYTES = 64 * 1024 * 1024;
+
+	/// Default time between checkpoints in milliseconds
+	constexpr static unsigned int DEFAULT_INTERVAL_MS = 1000;
+
+	/**
+	 * @param durability Durability level of checkpoints.
+	 * @param interval_bytes Number of bytes written between checkpoints, or 0 for no size limit.
+	 * @param interval_ms Time between checkpoints in milliseconds, or 0 for no time limit.
+	 */
+	explicit DurabilityPolicy(level durability, uint64_t interval_bytes = DEFAULT_INTERVAL_BYTES,
+		unsigned int interval_ms = DEFAULT_INTERVAL_MS);
+
+	/// Stops the background thread if it is running.
+	~DurabilityPolicy();
+
+	DurabilityPolicy(const DurabilityPolicy&) = delete;
+	DurabilityPolicy& operator=(const DurabilityPolicy&) = delete;
+
+	/**
+	 * Starts the background thread.
+	 *
+	 * @param file_descriptor Descriptor of the output file, owned by the caller; may be -1 with level::flush.
+	 * @return True if the thread has been started; false if it is already running or the descriptor is missing.
+	 */
+	bool start(int file_descriptor);
+
+	/**
+	 * Makes the whole file durable at the policy level and stops the background thread. The writer must have been
+	 * flushed before.
+	 *
+	 * @return True if every checkpoint and the final sync succeeded; otherwise false.
+	 */
+	bool stop();
+
+	/**
+	 * Tells whether the writer has reached a checkpoint. Called by the writer thread after each write.
+	 *
+	 * @param offset End offset of the bytes written so far.
+	 * @return True if the writer shall flush its sink and call checkpoint().
+	 */
+	inline bool due(uint64_t offset) const;
+
+	/**
+	 * Hands a checkpoint to the background thread, which makes the bytes before it durable. Called by the writer
+	 * thread once its sink has been flushed; it does not wait for storage.
+	 *
+	 * @param offset End offset of the bytes written so far.
+	 */
+	void checkpoint(uint64_t offset);
+
+	/// @return End offset of the bytes made durable so far. May be called from any thread.
+	uint64_t durable_offset() const;
+
+	/// @return Number of sync calls issued. May be called from any thread.
+	uint64_t syncs() const;
+
+	/// @return Number of failed sync calls. May be called from any thread.
+	uint64_t errors() const;
+
+private:
+	/// Background thread main loop.
+	void background();
+
+	/**
+	 * Makes a range of the file durable at the policy level.
+	 *
+	 * @param from Start offset of the range.
+	 * @param to End offset of the range, or 0 for the end of file.
+	 * @return True for success and false for failure.
+	 */
+	bool sync(uint64_t from, uint64_t to);
+
+	/// Durability level of checkpoints
+	level durability_level;
+
+	/// Number of bytes between checkpoints, 0 for none
+	uint64_t bytes_interval;
+
+	/// Time between checkpoints, 0 for none
+	std::chrono::milliseconds time_interval;
+
+	/// Output file descriptor, or -1
+	int fd;
+
+	/// Offset of the next size checkpoint, only used by the writer thread
+	uint64_t next_offset;
+
+	/// Set by the background thread when the time interval has elapsed without any checkpoint
+	std::atomic<bool> timer_expired;
+
+	/// Offset of the last checkpoint, guarded by mutex
+	uint64_t requested_offset;
+
+	/// True when the background thread shall exit, guarded by mutex
+	bool stopping;
+
+	/// End offset of the bytes made durable
+	std::atomic<uint64_t> synced_offset;
+
+	/// Number of sync calls
+	std::atomic<uint64_t> sync_count;
+
+	/// Number of failed sync calls
+	std::atomic<uint64_t> error_count;
+
+	/// Guards state shared with the background thread
+	std::mutex mutex;
+
+	/// Wakes up the background thread
+	std::condition_variable work_ready;
+
+	/// Background thread
+	std::thread background_thread;
+};
+
+bool DurabilityPolicy::due(uint64_t offset) const
+{
+	return offset >= next_offset || timer_expired.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include "FdSink.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+FdSink::FdSink(int file_descriptor)
+: fd(file_descriptor)
+, owns_fd(false)
+{
+}
+
+FdSink::~FdSink()
+{
+	close();
+}
+
+bool FdSink::open(const std::string& path, bool append)
+{
+	close();
+
+	// 0666 means user, group and others have read and write permission on this file (minus umask).
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+	owns_fd = fd >= 0;
+	return owns_fd;
+}
+
+void FdSink::attach(int file_descriptor)
+{
+	close();
+
+	fd = file_descriptor;
+	owns_fd = false;
+}
+
+int FdSink::descriptor() const
+{
+	return fd;
+}
+
+bool FdSink::write(const void* buffer, size_t count)
+{
+	if (fd < 0)
+		return false;
+
+	const char* temp_buffer = reinterpret_cast<const char*>(buffer);
+
+	ssize_t bytes_written = 0;
+	errno = 0;
+	while (count > 0)
+	{
+		if (sink_stats)
+			sink_stats->add_write_call();
+
+		if ((bytes_written = ::write(fd, temp_buffer, count)) <= 0)
+		{
+			if (errno != EINTR && errno != EAGAIN)
+				return false;
+
+			if (sink_stats)
+				sink_stats->add_retry();
+			continue;
+		}
+
+		count -= static_cast<size_t>(bytes_written);
+		temp_buffer += bytes_written;
+
+		// A short write is retried for the remaining bytes.
+		if (count > 0 && sink_stats)
+			sink_stats->add_retry();
+	}
+
+	return true;
+}
+
+bool FdSink::write_vector(iovec* vector, int count)
+{
+	if (fd < 0)
+		return false;
+
+	errno = 0;
+	while (count > 0)
+	{
+		if (sink_stats)
+			sink_stats->add_write_call();
+
+		ssize_t bytes_written = ::writev(fd, vector, count);
+		if (bytes_written <= 0)
+		{
+			if (errno != EINTR && errno != EAGAIN)
+				return false;
+
+			if (sink_stats)
+				sink_stats->add_retry();
+			continue;
+		}
+
+		// Skips fully written vectors, then advances into the partially written one.
+		size_t remained = static_cast<size_t>(bytes_written);
+		while (count > 0 && remained >= vector->iov_len)
+		{
+			remained -= vector->iov_len;
+			++vector;
+			--count;
+		}
+
+		if (count > 0)
+		{
+			vector->iov_base = static_cast<char*>(vector->iov_base) + remained;
+			vector->iov_len -= remained;
+
+			if (sink_stats)
+				sink_stats->add_retry();
+		}
+	}
+
+	return true;
+}
+
+bool FdSink::close()
+{
+	bool result = true;
+	if (owns_fd)
+		result = ::close(fd) == 0;
+
+	fd = -1;
+	owns_fd = false;
+	return result;
+}
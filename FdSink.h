@@ -0,0 +1,58 @@
+#ifndef FD_SINK_H_
+#define FD_SINK_H_
+
+#include <string>
+
+#include "PcapSink.h"
+
+/**
+ * Pcap sink which writes straight to a file descriptor with write/writev system calls, without any user space
+ * buffering. The descriptor is either attached by user application (and stays owned by it) or opened by the sink.
+ */
+class FdSink : public PcapSink
+{
+public:
+	/**
+	 * @param file_descriptor The output file descriptor, owned by the caller, or -1 to open one later.
+	 */
+	explicit FdSink(int file_descriptor = -1);
+
+	~FdSink() override;
+
+	FdSink(const FdSink&) = delete;
+	FdSink& operator=(const FdSink&) = delete;
+
+	/**
+	 * Creates (or truncates) the output file and takes ownership of its descriptor.
+	 *
+	 * @param path The output file path.
+	 * @param append True to keep the contents of an existing file and write after them.
+	 * @return True if output file has been opened successfully; otherwise false.
+	 */
+	bool open(const std::string& path, bool append = false);
+
+	/**
+	 * Replaces the output file descriptor. The previous descriptor is closed if the sink owns it.
+	 *
+	 * @param file_descriptor The output file descriptor, owned by the caller.
+	 */
+	void attach(int file_descriptor);
+
+	/// @return The output file descriptor, or -1 if none is set.
+	int descriptor() const;
+
+	bool write(const void* buffer, size_t count) override;
+
+	bool write_vector(iovec* vector, int count) override;
+
+	bool close() override;
+
+private:
+	/// Output file descriptor
+	int fd;
+
+	/// True if the descriptor has been opened by this sink and must be closed by it
+	bool owns_fd;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "MmapSink.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+constexpr size_t MmapSink::WRITEBACK_SIZE;
+
+MmapSink::MmapSink(size_t extent_size)
+: fd(-1)
+, extent_size((extent_size + WRITEBACK_SIZE - 1) / WRITEBACK_SIZE * WRITEBACK_SIZE)
+, extent(nullptr)
+, extent_offset(0)
+, extent_used(0)
+, extent_released(0)
+{
+	if (this->extent_size == 0)
+		this->extent_size = WRITEBACK_SIZE;
+}
+
+MmapSink::~MmapSink()
+{
+	close();
+}
+
+bool MmapSink::open(const std::string& path)
+{
+	close();
+
+	// 0666 means user, group and others have read and write permission on this file (minus umask).
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		return false;
+
+	extent_offset = 0;
+	extent_used = 0;
+	if (!map_next_extent())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MmapSink::release_range(size_t begin, size_t end)
+{
+	if (end <= begin)
+		return;
+
+	// Writeback is only started here; dirty pages stay in the page cache until they reach the disk.
+	sync_file_range(fd, static_cast<off64_t>(extent_offset + begin), static_cast<off64_t>(end - begin),
+		SYNC_FILE_RANGE_WRITE);
+	madvise(extent + begin, end - begin, MADV_DONTNEED);
+}
+
+bool MmapSink::map_next_extent()
+{
+	if (extent)
+	{
+		release_range(extent_released, extent_size);
+		munmap(extent, extent_size);
+		extent = nullptr;
+		extent_offset += extent_size;
+	}
+
+	// Reserves disk blocks for the whole extent; sparse growth is used where fallocate is not supported.
+	int result = 0;
+	while ((result = posix_fallocate(fd, static_cast<off_t>(extent_offset), static_cast<off_t>(extent_size))) == EINTR)
+		;
+
+	if (result != 0 && ftruncate(fd, static_cast<off_t>(extent_offset + extent_size)) != 0)
+		return false;
+
+	void* mapping = mmap(nullptr, extent_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		static_cast<off_t>(extent_offset));
+	if (mapping == MAP_FAILED)
+		return false;
+
+	extent = static_cast<char*>(mapping);
+	extent_used = 0;
+	extent_released = 0;
+	return true;
+}
+
+bool MmapSink::write_extents(const void* buffer, size_t count)
+{
+	if (!extent)
+		return false;
+
+	const char* temp_buffer = reinterpret_cast<const char*>(buffer);
+	while (count > 0)
+	{
+		if (extent_used == extent_size && !map_next_extent())
+			return false;
+
+		const size_t chunk = count < extent_size - extent_used ? count : extent_size - extent_used;
+		memcpy(extent + extent_used, temp_buffer, chunk);
+		extent_used += chunk;
+		temp_buffer += chunk;
+		count -= chunk;
+
+		// Releases whole chunks behind the write cursor.
+		if (extent_used - extent_released >= WRITEBACK_SIZE)
+		{
+			const size_t end = extent_used / WRITEBACK_SIZE * WRITEBACK_SIZE;
+			release_range(extent_released, end);
+			extent_released = end;
+		}
+	}
+
+	return true;
+}
+
+bool MmapSink::flush()
+{
+	if (!extent)
+		return false;
+
+	return sync_file_range(fd, 0, static_cast<off64_t>(extent_offset + extent_used), SYNC_FILE_RANGE_WRITE) == 0;
+}
+
+bool MmapSink::close()
+{
+	if (fd < 0)
+		return true;
+
+	bool result = true;
+	if (extent)
+		result = munmap(extent, extent_size) == 0;
+
+	// Cuts off the preallocated but unused tail of the last extent.
+	result = ftruncate(fd, static_cast<off_t>(extent_offset + extent_used)) == 0 && result;
+	result = ::close(fd) == 0 && result;
+
+	fd = -1;
+	extent = nullptr;
+	extent_offset = 0;
+	extent_used = 0;
+	extent_released = 0;
+	return result;
+}
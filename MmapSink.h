@@ -0,0 +1,108 @@
+#ifndef MMAP_SINK_H_
+#define MMAP_SINK_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "PcapSink.h"
+
+/**
+ * Pcap sink which writes into a memory mapping of the output file, so records are stored with plain memory copies and
+ * no system call is made per flush. The file grows in large preallocated extents; only the extent under the write
+ * cursor is mapped. Behind the cursor, writeback of each completed chunk is started asynchronously and its pages are
+ * dropped from the mapping, so a long capture does not pin its whole output in memory. On close the file is truncated
+ * to the exact number of bytes written.
+ *
+ * While the capture is running the file is larger than its content and ends with zeros up to the end of the current
+ * extent.
+ */
+class MmapSink : public PcapSink
+{
+public:
+	/**
+	 * @param extent_size Size of each preallocated and mapped extent, rounded up to a multiple of WRITEBACK_SIZE.
+	 */
+	explicit MmapSink(size_t extent_size = 256 * 1024 * 1024);
+
+	~MmapSink() override;
+
+	MmapSink(const MmapSink&) = delete;
+	MmapSink& operator=(const MmapSink&) = delete;
+
+	/**
+	 * Creates (or truncates) the output file and maps its first extent.
+	 *
+	 * @param path The output file path.
+	 * @return True if output file has been opened and mapped successfully; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// Copies the bytes with an inline memcpy unless they need another extent or complete a writeback chunk.
+	inline bool write(const void* buffer, size_t count) override;
+
+	/// Starts writeback of every byte written so far, without waiting for it.
+	bool flush() override;
+
+	bool close() override;
+
+private:
+	/// Size of chunks whose writeback is started behind the write cursor
+	constexpr static size_t WRITEBACK_SIZE = 8 * 1024 * 1024;
+
+	/**
+	 * Writes bytes across extents and writeback chunks, the slow path of write().
+	 *
+	 * @param buffer Content of the buffer.
+	 * @param count Number of bytes to write.
+	 * @return True for success and false for failure.
+	 */
+	bool write_extents(const void* buffer, size_t count);
+
+	/**
+	 * Unmaps the current extent, then preallocates and maps the next one.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool map_next_extent();
+
+	/**
+	 * Starts writeback of a written range of the current extent and drops its pages from the mapping.
+	 *
+	 * @param begin Offset of the range in the current extent.
+	 * @param end Offset of the end of the range in the current extent.
+	 */
+	void release_range(size_t begin, size_t end);
+
+	/// Output file descriptor
+	int fd;
+
+	/// Size of each extent
+	size_t extent_size;
+
+	/// Mapping of the current extent, or nullptr
+	char* extent;
+
+	/// File offset of the current extent
+	uint64_t extent_offset;
+
+	/// Write cursor in the current extent
+	size_t extent_used;
+
+	/// Offset in the current extent up to which writeback has been started
+	size_t extent_released;
+};
+
+bool MmapSink::write(const void* buffer, size_t count)
+{
+	if (extent && count <= extent_size - extent_used && extent_used + count - extent_released < WRITEBACK_SIZE)
+	{
+		memcpy(extent + extent_used, buffer, count);
+		extent_used += count;
+		return true;
+	}
+
+	return write_extents(buffer, count);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#include "PacketBuffer.h"
+
+#include "PacketPool.h"
+
+void PacketBuffer::release()
+{
+	if (owner)
+		owner->release(class_index, buffer_index);
+
+	owner = nullptr;
+	buffer_data = nullptr;
+	buffer_capacity = 0;
+	frame_size = 0;
+}
+
+PacketPool* PacketBuffer::detach(uint32_t* size_class, uint32_t* index)
+{
+	PacketPool* pool = owner;
+	*size_class = class_index;
+	*index = buffer_index;
+
+	owner = nullptr;
+	buffer_data = nullptr;
+	buffer_capacity = 0;
+	frame_size = 0;
+	return pool;
+}
@@ -0,0 +1,234 @@
+#ifndef PACKET_BUFFER_H_
+#define PACKET_BUFFER_H_
+
+#include <sys/time.h>
+
+#include <cstdint>
+
+class PacketPool;
+
+/**
+ * This class is a handle on a packet buffer of a PacketPool. The capture code fills the buffer, sets the frame size
+ * and timestamp, and moves the handle into a writer (see AsyncPcapWriter::write_packet(PacketBuffer)); the buffer goes
+ * back to its pool when the last handle owning it is destroyed or released, i.e. once the writer has written it.
+ *
+ * Handles are move-only, so a buffer has one owner at a time. An empty handle (default constructed, moved from, or
+ * returned by an exhausted pool) owns nothing.
+ *
+ * Usage:
+ *	PacketBuffer buffer = pool.allocate(frame_size);
+ *	if (buffer)
+ *	{
+ *		memcpy(buffer.data(), frame, frame_size);
+ *		buffer.set_size(frame_size);
+ *		buffer.set_time(time);
+ *		writer.write_packet(std::move(buffer));
+ *	}
+ */
+class PacketBuffer
+{
+public:
+	/// Constructs an empty handle.
+	inline PacketBuffer();
+
+	/// Returns the buffer to its pool, if any.
+	inline ~PacketBuffer();
+
+	/// Takes the buffer of other, which becomes empty.
+	inline PacketBuffer(PacketBuffer&& other);
+
+	/// Returns the buffer of this handle to its pool, then takes the buffer of other, which becomes empty.
+	inline PacketBuffer& operator=(PacketBuffer&& other);
+
+	PacketBuffer(const PacketBuffer&) = delete;
+	PacketBuffer& operator=(const PacketBuffer&) = delete;
+
+	/// @return True if the handle owns a buffer.
+	inline explicit operator bool() const;
+
+	/// @return Buffer memory, capacity() bytes, or nullptr for an empty handle.
+	inline char* data();
+
+	/// @return Buffer memory, capacity() bytes, or nullptr for an empty handle.
+	inline const char* data() const;
+
+	/// @return Number of bytes of the buffer, the size of its pool size class.
+	inline uint32_t capacity() const;
+
+	/// @return Number of frame bytes filled in.
+	inline uint32_t size() const;
+
+	/**
+	 * Sets the number of frame bytes filled in.
+	 *
+	 * @param size Frame size, not greater than capacity().
+	 */
+	inline void set_size(uint32_t size);
+
+	/// @return Captured packet's timestamp.
+	inline timeval time() const;
+
+	/**
+	 * Sets the captured packet's timestamp.
+	 *
+	 * @param time Timestamp.
+	 */
+	inline void set_time(timeval time);
+
+	/// Returns the buffer to its pool; the handle becomes empty.
+	void release();
+
+	/**
+	 * Gives up ownership of the buffer without returning it to the pool; the handle becomes empty. The buffer shall
+	 * be returned later with PacketPool::release().
+	 *
+	 * @param size_class Filled with the size class of the buffer.
+	 * @param index Filled with the index of the buffer in its size class.
+	 * @return Pool of the buffer, or nullptr for an empty handle.
+	 */
+	PacketPool* detach(uint32_t* size_class, uint32_t* index);
+
+private:
+	friend class PacketPool;
+
+	/**
+	 * Constructs a handle owning a pool buffer.
+	 *
+	 * @param pool Pool of the buffer.
+	 * @param size_class Size class of the buffer.
+	 * @param index Index of the buffer in its size class.
+	 * @param data Buffer memory.
+	 * @param capacity Number of bytes of the buffer.
+	 */
+	inline PacketBuffer(PacketPool* pool, uint32_t size_class, uint32_t index, char* data, uint32_t capacity);
+
+	/// Pool of the buffer, or nullptr for an empty handle
+	PacketPool* owner;
+
+	/// Size class of the buffer
+	uint32_t class_index;
+
+	/// Index of the buffer in its size class
+	uint32_t buffer_index;
+
+	/// Buffer memory
+	char* buffer_data;
+
+	/// Number of bytes of the buffer
+	uint32_t buffer_capacity;
+
+	/// Number of frame bytes filled in
+	uint32_t frame_size;
+
+	/// Captured packet's timestamp
+	timeval timestamp;
+};
+
+PacketBuffer::PacketBuffer()
+: owner(nullptr)
+, class_index(0)
+, buffer_index(0)
+, buffer_data(nullptr)
+, buffer_capacity(0)
+, frame_size(0)
+, timestamp()
+{
+}
+
+PacketBuffer::PacketBuffer(PacketPool* pool, uint32_t size_class, uint32_t index, char* data, uint32_t capacity)
+: owner(pool)
+, class_index(size_class)
+, buffer_index(index)
+, buffer_data(data)
+, buffer_capacity(capacity)
+, frame_size(0)
+, timestamp()
+{
+}
+
+PacketBuffer::~PacketBuffer()
+{
+	if (owner)
+		release();
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer&& other)
+: owner(other.owner)
+, class_index(other.class_index)
+, buffer_index(other.buffer_index)
+, buffer_data(other.buffer_data)
+, buffer_capacity(other.buffer_capacity)
+, frame_size(other.frame_size)
+, timestamp(other.timestamp)
+{
+	other.owner = nullptr;
+	other.buffer_data = nullptr;
+	other.buffer_capacity = 0;
+	other.frame_size = 0;
+}
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer&& other)
+{
+	if (this != &other)
+	{
+		if (owner)
+			release();
+
+		owner = other.owner;
+		class_index = other.class_index;
+		buffer_index = other.buffer_index;
+		buffer_data = other.buffer_data;
+		buffer_capacity = other.buffer_capacity;
+		frame_size = other.frame_size;
+		timestamp = other.timestamp;
+
+		other.owner = nullptr;
+		other.buffer_data = nullptr;
+		other.buffer_capacity = 0;
+		other.frame_size = 0;
+	}
+
+	return *this;
+}
+
+PacketBuffer::operator bool() const
+{
+	return buffer_data != nullptr;
+}
+
+char* PacketBuffer::data()
+{
+	return buffer_data;
+}
+
+const char* PacketBuffer::data() const
+{
+	return buffer_data;
+}
+
+uint32_t PacketBuffer::capacity() const
+{
+	return buffer_capacity;
+}
+
+uint32_t PacketBuffer::size() const
+{
+	return frame_size;
+}
+
+void PacketBuffer::set_size(uint32_t size)
+{
+	frame_size = size;
+}
+
+timeval PacketBuffer::time() const
+{
+	return timestamp;
+}
+
+void PacketBuffer::set_time(timeval time)
+{
+	timestamp = time;
+}
+
+#endif
@@ -0,0 +1,278 @@
+#include "PacketDeduplicator.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+/// Number of bytes hashed at a time, one 64-bit word per lane
+constexpr size_t STRIPE_SIZE = 32;
+
+/// Keys xored into the words of each lane
+constexpr uint64_t LANE_KEYS[4] =
+{
+	0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull
+};
+
+/// Multiplier of the final mix (golden ratio)
+constexpr uint64_t PRIME = 0x9e3779b97f4a7c15ull;
+
+/// Ethernet types whose headers are skipped
+enum : uint32_t
+{
+	ETHERTYPE_IPV4 = 0x0800,
+	ETHERTYPE_IPV6 = 0x86dd,
+	ETHERTYPE_VLAN = 0x8100,
+	ETHERTYPE_QINQ = 0x88a8
+};
+
+/// Reads a big-endian 16-bit word.
+inline uint32_t load16(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 8 | data[1];
+}
+
+/// Reads a 64-bit word in host order from any address.
+inline uint64_t load64(const uint8_t* data)
+{
+	uint64_t word;
+	memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+/// Mixes all bits of a word into all others (murmur3 64-bit finalizer).
+inline uint64_t avalanche(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+/**
+ * Accumulates one stripe: each lane adds the product of the high and low halves of its keyed word, and the plain word
+ * of its neighbour lane. Both versions give the same accumulators.
+ */
+#ifdef __SSE2__
+inline void accumulate(__m128i* accumulators, const uint8_t* stripe)
+{
+	for (size_t i = 0; i < 2; ++i)
+	{
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe) + i);
+		const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(LANE_KEYS) + i);
+		const __m128i keyed = _mm_xor_si128(data, key);
+		const __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+		const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+		accumulators[i] = _mm_add_epi64(accumulators[i], _mm_add_epi64(product, swapped));
+	}
+}
+#else
+inline void accumulate(uint64_t* accumulators, const uint8_t* stripe)
+{
+	for (size_t i = 0; i < 4; ++i)
+	{
+		const uint64_t data = load64(stripe + i * 8);
+		const uint64_t keyed = data ^ LANE_KEYS[i];
+		accumulators[i] += (keyed & 0xffffffff) * (keyed >> 32) + load64(stripe + (i ^ 1) * 8);
+	}
+}
+#endif
+
+}
+
+constexpr size_t PacketDeduplicator::DEFAULT_CAPACITY;
+constexpr size_t PacketDeduplicator::PROBE_LIMIT;
+
+PacketDeduplicator::PacketDeduplicator(uint64_t window, size_t capacity)
+: index_mask(0)
+, window_nanoseconds(window)
+, packet_counters()
+{
+	size_t slots = PROBE_LIMIT;
+	while (slots < capacity)
+		slots *= 2;
+
+	table.resize(slots);
+	index_mask = slots - 1;
+}
+
+bool PacketDeduplicator::accept(const char* frame, uint32_t frame_size, uint64_t timestamp)
+{
+	++packet_counters.evaluated;
+
+	uint64_t packet_hash = frame_hash(frame, frame_size);
+	if (packet_hash == 0)		// 0 marks unused slots.
+		packet_hash = 1;
+
+	// Looks for the packet, and for the slot to remember it in: the first free or expired one, else the oldest one.
+	entry_t* slot = nullptr;
+	bool slot_live = true;
+	for (size_t i = 0; i < PROBE_LIMIT; ++i)
+	{
+		entry_t& entry = table[(packet_hash + i) & index_mask];
+		if (entry.hash == 0)
+		{
+			// Packets are remembered in the first free slot of their sequence, so none is after a free slot.
+			if (slot_live)
+			{
+				slot = &entry;
+				slot_live = false;
+			}
+			break;
+		}
+
+		const bool live = in_window(entry, timestamp);
+		if (live && entry.hash == packet_hash)
+		{
+			++packet_counters.duplicates;
+			return false;
+		}
+
+		if (slot_live && (!live || !slot || entry.timestamp < slot->timestamp))
+		{
+			slot = &entry;
+			slot_live = live;
+		}
+	}
+
+	if (slot_live)
+		++packet_counters.evictions;
+
+	slot->hash = packet_hash;
+	slot->timestamp = timestamp;
+	return true;
+}
+
+uint64_t PacketDeduplicator::window() const
+{
+	return window_nanoseconds;
+}
+
+size_t PacketDeduplicator::capacity() const
+{
+	return table.size();
+}
+
+const PacketDeduplicator::counters_t& PacketDeduplicator::counters() const
+{
+	return packet_counters;
+}
+
+void PacketDeduplicator::reset_counters()
+{
+	packet_counters = counters_t();
+}
+
+void PacketDeduplicator::clear()
+{
+	memset(table.data(), 0, table.size() * sizeof(entry_t));
+}
+
+bool PacketDeduplicator::in_window(const entry_t& entry, uint64_t timestamp) const
+{
+	const uint64_t distance = timestamp > entry.timestamp ? timestamp - entry.timestamp : entry.timestamp - timestamp;
+	return distance <= window_nanoseconds;
+}
+
+uint64_t PacketDeduplicator::frame_hash(const char* frame, uint32_t frame_size)
+{
+	const uint8_t* packet = reinterpret_cast<const uint8_t*>(frame);
+	uint32_t offset = 12;		// Ethernet type after destination and source addresses.
+
+	if (frame_size < offset + 2)
+		return hash(packet, frame_size, 0);
+
+	uint32_t ether_type = load16(packet + offset);
+	while ((ether_type == ETHERTYPE_VLAN || ether_type == ETHERTYPE_QINQ) && frame_size >= offset + 6)
+	{
+		offset += 4;
+		ether_type = load16(packet + offset);
+	}
+	offset += 2;
+
+	// Copy of the first two stripes of the IP packet, with the fields changed by each hop zeroed. IPv4 headers with
+	// options (60 bytes at most) and IPv6 headers fit in it.
+	uint8_t head[2 * STRIPE_SIZE];
+	const uint32_t size = frame_size - offset;
+	const uint32_t head_size = size < sizeof(head) ? size : static_cast<uint32_t>(sizeof(head));
+
+	if (ether_type == ETHERTYPE_IPV4 && size >= 20)
+	{
+		memcpy(head, packet + offset, head_size);
+		head[8] = 0;		// TTL
+		head[10] = 0;		// Header checksum
+		head[11] = 0;
+	}
+	else if (ether_type == ETHERTYPE_IPV6 && size >= 40)
+	{
+		memcpy(head, packet + offset, head_size);
+		head[7] = 0;		// Hop limit
+	}
+	else
+	{
+		return hash(packet, frame_size, 0);
+	}
+
+	return hash_parts(head, head_size, packet + offset + head_size, size - head_size, 0);
+}
+
+uint64_t PacketDeduplicator::hash(const void* data, size_t size, uint64_t seed)
+{
+	return hash_parts(nullptr, 0, static_cast<const uint8_t*>(data), size, seed);
+}
+
+uint64_t PacketDeduplicator::hash_parts(const uint8_t* head, size_t head_size, const uint8_t* data, size_t size,
+	uint64_t seed)
+{
+#ifdef __SSE2__
+	__m128i accumulators[2] =
+	{
+		_mm_set_epi64x(static_cast<long long int>(seed ^ LANE_KEYS[1]), static_cast<long long int>(seed + LANE_KEYS[0])),
+		_mm_set_epi64x(static_cast<long long int>(seed ^ LANE_KEYS[3]), static_cast<long long int>(seed - LANE_KEYS[2]))
+	};
+#else
+	uint64_t accumulators[4] = {seed + LANE_KEYS[0], seed ^ LANE_KEYS[1], seed - LANE_KEYS[2], seed ^ LANE_KEYS[3]};
+#endif
+
+	// The head is whole stripes unless nothing follows it, so both parts hash as one string.
+	if (size == 0)
+	{
+		data = head;
+		size = head_size;
+		head_size = 0;
+	}
+	for (size_t offset = 0; offset < head_size; offset += STRIPE_SIZE)
+		accumulate(accumulators, head + offset);
+
+	const size_t full_size = size & ~(STRIPE_SIZE - 1);
+	for (size_t offset = 0; offset < full_size; offset += STRIPE_SIZE)
+		accumulate(accumulators, data + offset);
+
+	// The last partial stripe overlaps the previous one, or is padded with zeros if there is none; the size is mixed in
+	// at the end.
+	if (size > full_size && full_size > 0)
+	{
+		accumulate(accumulators, data + size - STRIPE_SIZE);
+	}
+	else if (size > full_size)
+	{
+		uint8_t tail[STRIPE_SIZE] = {};
+		for (size_t i = 0; i < size; ++i)
+			tail[i] = data[i];
+		accumulate(accumulators, tail);
+	}
+
+	uint64_t lanes[4];
+	memcpy(lanes, accumulators, sizeof(lanes));
+
+	// Lanes are mixed in two independent pairs, so that the multiplications overlap.
+	const uint64_t low = avalanche(lanes[0] + (lanes[1] << 32 | lanes[1] >> 32));
+	const uint64_t high = avalanche(lanes[2] + (lanes[3] << 32 | lanes[3] >> 32));
+	return avalanche((head_size + size) * PRIME ^ low ^ (high * PRIME));
+}
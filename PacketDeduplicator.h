@@ -0,0 +1,148 @@
+#ifndef PACKET_DEDUPLICATOR_H_
+#define PACKET_DEDUPLICATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * This class removes duplicate packets, as seen when several SPAN ports or TAPs mirror the same traffic, or when a
+ * SPAN session copies a packet both on ingress and on egress. A packet is a duplicate if a packet with the same hash
+ * has been seen within a time window of it, in either direction since mirrored copies do not arrive in order.
+ *
+ * Only what stays the same along the path is hashed: link layer headers (addresses and VLAN tags) are skipped for
+ * IPv4 and IPv6 packets, and the IPv4 TTL and header checksum, or the IPv6 hop limit, are zeroed. Other packets are
+ * hashed whole. Payloads are hashed 32 bytes at a time in four 64-bit lanes, two per SSE2 register where available;
+ * the scalar code gives the same hashes, so results do not depend on the build.
+ *
+ * Hashes of recent packets are kept in an open-addressing table with linear probing over PROBE_LIMIT slots. Slots
+ * whose packet is out of the window are reused. If every slot of a probe sequence is in the window, the oldest one is
+ * replaced and counted as an eviction; evictions mean the table is too small for the packet rate and window, and
+ * duplicates may be missed. The table is sized once, so deduplication never allocates.
+ *
+ * A deduplicator is used by a single writer thread.
+ *
+ * Usage:
+ *	PacketDeduplicator deduplicator(100000);		// 100 us window
+ *	writer.set_deduplicator(&deduplicator);
+ *	...
+ *	deduplicator.counters().duplicates;
+ */
+class PacketDeduplicator
+{
+public:
+	/// Default number of table slots
+	constexpr static size_t DEFAULT_CAPACITY = 65536;
+
+	/// Number of slots looked at for each packet
+	constexpr static size_t PROBE_LIMIT = 8;
+
+	/// Deduplication counters
+	struct counters_t
+	{
+		/// Number of packets evaluated
+		uint64_t evaluated;
+
+		/// Number of duplicate packets removed
+		uint64_t duplicates;
+
+		/// Number of packets forgotten before the end of their window, for lack of table slots
+		uint64_t evictions;
+	};
+
+	/**
+	 * @param window Time window in nanoseconds; packets at most this far apart with the same hash are duplicates.
+	 * @param capacity Number of table slots, rounded up to a power of two. It should be a few times the number of
+	 *	packets expected within one window.
+	 */
+	explicit PacketDeduplicator(uint64_t window, size_t capacity = DEFAULT_CAPACITY);
+
+	/**
+	 * Looks up the packet among recent packets and remembers it.
+	 *
+	 * @param frame Packet data, starting at the Ethernet header.
+	 * @param frame_size Number of bytes available at frame.
+	 * @param timestamp Packet timestamp in nanoseconds.
+	 * @return True if the packet shall be written, false if it is a duplicate.
+	 */
+	bool accept(const char* frame, uint32_t frame_size, uint64_t timestamp);
+
+	/// @return Time window in nanoseconds.
+	uint64_t window() const;
+
+	/// @return Number of table slots.
+	size_t capacity() const;
+
+	/// @return Deduplication counters.
+	const counters_t& counters() const;
+
+	/// Sets the counters to zero. Remembered packets are kept.
+	void reset_counters();
+
+	/// Forgets every remembered packet.
+	void clear();
+
+	/**
+	 * Hashes a packet, skipping its link layer header and the fields changed by routers.
+	 *
+	 * @param frame Packet data, starting at the Ethernet header.
+	 * @param frame_size Number of bytes available at frame.
+	 * @return Packet hash.
+	 */
+	static uint64_t frame_hash(const char* frame, uint32_t frame_size);
+
+	/**
+	 * Hashes a byte string.
+	 *
+	 * @param data Bytes to hash.
+	 * @param size Number of bytes.
+	 * @param seed Hash seed.
+	 * @return Hash of the bytes.
+	 */
+	static uint64_t hash(const void* data, size_t size, uint64_t seed);
+
+private:
+	/// Table slot, the hash of a recent packet
+	struct entry_t
+	{
+		/// Packet hash, or 0 if the slot has never been used
+		uint64_t hash;
+
+		/// Packet timestamp in nanoseconds
+		uint64_t timestamp;
+	};
+
+	/**
+	 * Hashes a head of whole stripes followed by other bytes, as one byte string.
+	 *
+	 * @param head First bytes, a multiple of 32 bytes unless size is zero.
+	 * @param head_size Number of bytes of the head.
+	 * @param data Following bytes.
+	 * @param size Number of following bytes.
+	 * @param seed Hash seed.
+	 * @return Hash of the bytes.
+	 */
+	static uint64_t hash_parts(const uint8_t* head, size_t head_size, const uint8_t* data, size_t size,
+		uint64_t seed);
+
+	/**
+	 * @param entry A used table slot.
+	 * @param timestamp Timestamp of the current packet.
+	 * @return True if the packet of the slot is within the window of the current packet.
+	 */
+	bool in_window(const entry_t& entry, uint64_t timestamp) const;
+
+	/// Hash table, capacity slots
+	std::vector<entry_t> table;
+
+	/// Mask of the table index, capacity - 1
+	size_t index_mask;
+
+	/// Time window in nanoseconds
+	uint64_t window_nanoseconds;
+
+	/// Deduplication counters
+	counters_t packet_counters;
+};
+
+#endif
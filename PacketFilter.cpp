@@ -0,0 +1,446 @@
+#include "PacketFilter.h"
+
+#include <cstring>
+
+namespace
+{
+
+/// Reads a big-endian 16-bit word.
+inline uint32_t load16(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 8 | data[1];
+}
+
+/// Reads a big-endian 32-bit word.
+inline uint32_t load32(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16
+		| static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+/// Mixes a word into a hash (murmur3 finalizer).
+inline uint32_t mix(uint32_t hash, uint32_t word)
+{
+	hash ^= word;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+/// Ethernet types looked at by flow_hash().
+enum : uint32_t
+{
+	ETHERTYPE_IPV4 = 0x0800,
+	ETHERTYPE_IPV6 = 0x86dd,
+	ETHERTYPE_VLAN = 0x8100,
+	ETHERTYPE_QINQ = 0x88a8
+};
+
+/// Transport protocols whose ports are part of the flow.
+enum : uint8_t
+{
+	PROTOCOL_TCP = 6,
+	PROTOCOL_UDP = 17,
+	PROTOCOL_SCTP = 132
+};
+
+}
+
+PacketFilter::PacketFilter()
+: dropped_count(0)
+{
+}
+
+int PacketFilter::add_bpf(const bpf_program* program)
+{
+	const uint32_t length = program->bf_len;
+	if (length == 0 || BPF_CLASS(program->bf_insns[length - 1].code) != BPF_RET)
+		return -1;
+
+	// Jumps are forward only, so checking their targets is enough for every program to terminate.
+	for (uint32_t pc = 0; pc < length; ++pc)
+	{
+		const bpf_insn& instruction = program->bf_insns[pc];
+		const uint32_t remaining = length - pc - 1;
+
+		switch (BPF_CLASS(instruction.code))
+		{
+			case BPF_JMP:
+				if (BPF_OP(instruction.code) == BPF_JA ? instruction.k >= remaining
+					: instruction.jt >= remaining || instruction.jf >= remaining)
+					return -1;
+				break;
+			case BPF_LD:
+			case BPF_LDX:
+				if (BPF_MODE(instruction.code) == BPF_MEM && instruction.k >= BPF_MEMWORDS)
+					return -1;
+				break;
+			case BPF_ST:
+			case BPF_STX:
+				if (instruction.k >= BPF_MEMWORDS)
+					return -1;
+				break;
+			case BPF_ALU:
+				if ((BPF_OP(instruction.code) == BPF_DIV || BPF_OP(instruction.code) == BPF_MOD)
+					&& BPF_SRC(instruction.code) == BPF_K && instruction.k == 0)
+					return -1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	stage_t stage;
+	stage.type = stage_type::bpf;
+	stage.program.assign(program->bf_insns, program->bf_insns + length);
+	stage.rate = 0;
+	stage.seed = 0;
+	stage.counters = counters_t();
+	stage_list.push_back(stage);
+	return static_cast<int>(stage_list.size() - 1);
+}
+
+int PacketFilter::add_flow_sampler(uint32_t rate, uint32_t seed)
+{
+	if (rate == 0)
+		return -1;
+
+	stage_t stage;
+	stage.type = stage_type::flow_sampler;
+	stage.rate = rate;
+	stage.seed = seed;
+	stage.counters = counters_t();
+	stage_list.push_back(stage);
+	return static_cast<int>(stage_list.size() - 1);
+}
+
+bool PacketFilter::accept(const char* frame, uint32_t frame_size, uint32_t original_size)
+{
+	const uint8_t* packet = reinterpret_cast<const uint8_t*>(frame);
+
+	for (stage_t& stage : stage_list)
+	{
+		++stage.counters.evaluated;
+
+		bool accepted = false;
+		switch (stage.type)
+		{
+			case stage_type::bpf:
+				accepted = run_bpf(stage.program, packet, frame_size, original_size) != 0;
+				break;
+			case stage_type::flow_sampler:
+				// Maps the hash onto [0, rate) without a division and keeps flows which land on 0.
+				accepted = (static_cast<uint64_t>(flow_hash(frame, frame_size, stage.seed)) * stage.rate) >> 32 == 0;
+				break;
+		}
+
+		if (!accepted)
+		{
+			++dropped_count;
+			return false;
+		}
+
+		++stage.counters.hits;
+	}
+
+	return true;
+}
+
+size_t PacketFilter::stages() const
+{
+	return stage_list.size();
+}
+
+const PacketFilter::counters_t& PacketFilter::counters(size_t stage) const
+{
+	return stage_list[stage].counters;
+}
+
+uint64_t PacketFilter::dropped() const
+{
+	return dropped_count;
+}
+
+void PacketFilter::reset_counters()
+{
+	for (stage_t& stage : stage_list)
+		stage.counters = counters_t();
+
+	dropped_count = 0;
+}
+
+uint32_t PacketFilter::flow_hash(const char* frame, uint32_t frame_size, uint32_t seed)
+{
+	const uint8_t* packet = reinterpret_cast<const uint8_t*>(frame);
+	uint32_t offset = 12;		// Ethernet type after destination and source addresses.
+
+	if (frame_size < offset + 2)
+		return mix(seed, 0);
+
+	uint32_t ether_type = load16(packet + offset);
+	while ((ether_type == ETHERTYPE_VLAN || ether_type == ETHERTYPE_QINQ) && frame_size >= offset + 6)
+	{
+		offset += 4;
+		ether_type = load16(packet + offset);
+	}
+	offset += 2;
+
+	const uint8_t* source = nullptr;
+	const uint8_t* destination = nullptr;
+	size_t address_size = 0;
+	uint8_t protocol = 0;
+	uint32_t transport = 0;
+	bool has_ports = false;
+
+	if (ether_type == ETHERTYPE_IPV4 && frame_size >= offset + 20)
+	{
+		const uint8_t* header = packet + offset;
+		source = header + 12;
+		destination = header + 16;
+		address_size = 4;
+		protocol = header[9];
+		transport = offset + (header[0] & 0x0f) * 4u;
+
+		// Only unfragmented packets carry ports, so fragments of a flow hash on addresses alone.
+		has_ports = (load16(header + 6) & 0x3fff) == 0;
+	}
+	else if (ether_type == ETHERTYPE_IPV6 && frame_size >= offset + 40)
+	{
+		const uint8_t* header = packet + offset;
+		source = header + 8;
+		destination = header + 24;
+		address_size = 16;
+		protocol = header[6];
+		transport = offset + 40;
+		has_ports = true;
+	}
+	else
+	{
+		return mix(seed, 0);
+	}
+
+	uint16_t source_port = 0;
+	uint16_t destination_port = 0;
+	if (has_ports && (protocol == PROTOCOL_TCP || protocol == PROTOCOL_UDP || protocol == PROTOCOL_SCTP)
+		&& frame_size >= transport + 4)
+	{
+		source_port = static_cast<uint16_t>(load16(packet + transport));
+		destination_port = static_cast<uint16_t>(load16(packet + transport + 2));
+	}
+
+	return tuple_hash(source, destination, address_size, protocol, source_port, destination_port, seed);
+}
+
+uint32_t PacketFilter::tuple_hash(const uint8_t* source, const uint8_t* destination, size_t address_size,
+	uint8_t protocol, uint16_t source_port, uint16_t destination_port, uint32_t seed)
+{
+	// Orders the two endpoints so that both directions of a flow give the same hash.
+	const int order = memcmp(source, destination, address_size);
+	if (order > 0 || (order == 0 && source_port > destination_port))
+	{
+		const uint8_t* address = source;
+		source = destination;
+		destination = address;
+
+		const uint16_t port = source_port;
+		source_port = destination_port;
+		destination_port = port;
+	}
+
+	uint32_t hash = mix(seed, protocol);
+	for (size_t i = 0; i < address_size; i += 4)
+		hash = mix(hash, load32(source + i));
+	for (size_t i = 0; i < address_size; i += 4)
+		hash = mix(hash, load32(destination + i));
+
+	return mix(hash, static_cast<uint32_t>(source_port) << 16 | destination_port);
+}
+
+uint32_t PacketFilter::run_bpf(const std::vector<bpf_insn>& program, const uint8_t* packet, uint32_t captured_size,
+	uint32_t original_size)
+{
+	uint32_t a = 0;
+	uint32_t x = 0;
+	uint32_t memory[BPF_MEMWORDS] = {};
+
+	for (size_t pc = 0; pc < program.size(); ++pc)
+	{
+		const bpf_insn& instruction = program[pc];
+		const uint32_t k = instruction.k;
+
+		// Absolute or indexed load offset, or captured_size if it overflows.
+		uint32_t offset = 0;
+		if (BPF_CLASS(instruction.code) == BPF_LD && BPF_MODE(instruction.code) == BPF_IND)
+			offset = k > UINT32_MAX - x ? captured_size : x + k;
+		else
+			offset = k;
+
+		switch (instruction.code)
+		{
+			case BPF_RET | BPF_K:
+				return k;
+			case BPF_RET | BPF_A:
+				return a;
+
+			case BPF_LD | BPF_W | BPF_ABS:
+			case BPF_LD | BPF_W | BPF_IND:
+				if (offset > captured_size || captured_size - offset < 4)
+					return 0;
+				a = load32(packet + offset);
+				break;
+			case BPF_LD | BPF_H | BPF_ABS:
+			case BPF_LD | BPF_H | BPF_IND:
+				if (offset > captured_size || captured_size - offset < 2)
+					return 0;
+				a = load16(packet + offset);
+				break;
+			case BPF_LD | BPF_B | BPF_ABS:
+			case BPF_LD | BPF_B | BPF_IND:
+				if (offset >= captured_size)
+					return 0;
+				a = packet[offset];
+				break;
+			case BPF_LD | BPF_W | BPF_LEN:
+				a = original_size;
+				break;
+			case BPF_LDX | BPF_W | BPF_LEN:
+				x = original_size;
+				break;
+			case BPF_LDX | BPF_MSH | BPF_B:
+				if (k >= captured_size)
+					return 0;
+				x = (packet[k] & 0x0f) << 2;
+				break;
+			case BPF_LD | BPF_IMM:
+				a = k;
+				break;
+			case BPF_LDX | BPF_IMM:
+				x = k;
+				break;
+			case BPF_LD | BPF_MEM:
+				a = memory[k];
+				break;
+			case BPF_LDX | BPF_MEM:
+				x = memory[k];
+				break;
+			case BPF_ST:
+				memory[k] = a;
+				break;
+			case BPF_STX:
+				memory[k] = x;
+				break;
+
+			case BPF_JMP | BPF_JA:
+				pc += k;
+				break;
+			case BPF_JMP | BPF_JGT | BPF_K:
+				pc += a > k ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JGE | BPF_K:
+				pc += a >= k ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JEQ | BPF_K:
+				pc += a == k ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JSET | BPF_K:
+				pc += a & k ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JGT | BPF_X:
+				pc += a > x ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JGE | BPF_X:
+				pc += a >= x ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JEQ | BPF_X:
+				pc += a == x ? instruction.jt : instruction.jf;
+				break;
+			case BPF_JMP | BPF_JSET | BPF_X:
+				pc += a & x ? instruction.jt : instruction.jf;
+				break;
+
+			case BPF_ALU | BPF_ADD | BPF_K:
+				a += k;
+				break;
+			case BPF_ALU | BPF_SUB | BPF_K:
+				a -= k;
+				break;
+			case BPF_ALU | BPF_MUL | BPF_K:
+				a *= k;
+				break;
+			case BPF_ALU | BPF_DIV | BPF_K:
+				a /= k;
+				break;
+			case BPF_ALU | BPF_MOD | BPF_K:
+				a %= k;
+				break;
+			case BPF_ALU | BPF_AND | BPF_K:
+				a &= k;
+				break;
+			case BPF_ALU | BPF_OR | BPF_K:
+				a |= k;
+				break;
+			case BPF_ALU | BPF_XOR | BPF_K:
+				a ^= k;
+				break;
+			case BPF_ALU | BPF_LSH | BPF_K:
+				a = k < 32 ? a << k : 0;
+				break;
+			case BPF_ALU | BPF_RSH | BPF_K:
+				a = k < 32 ? a >> k : 0;
+				break;
+			case BPF_ALU | BPF_ADD | BPF_X:
+				a += x;
+				break;
+			case BPF_ALU | BPF_SUB | BPF_X:
+				a -= x;
+				break;
+			case BPF_ALU | BPF_MUL | BPF_X:
+				a *= x;
+				break;
+			case BPF_ALU | BPF_DIV | BPF_X:
+				if (x == 0)
+					return 0;
+				a /= x;
+				break;
+			case BPF_ALU | BPF_MOD | BPF_X:
+				if (x == 0)
+					return 0;
+				a %= x;
+				break;
+			case BPF_ALU | BPF_AND | BPF_X:
+				a &= x;
+				break;
+			case BPF_ALU | BPF_OR | BPF_X:
+				a |= x;
+				break;
+			case BPF_ALU | BPF_XOR | BPF_X:
+				a ^= x;
+				break;
+			case BPF_ALU | BPF_LSH | BPF_X:
+				a = x < 32 ? a << x : 0;
+				break;
+			case BPF_ALU | BPF_RSH | BPF_X:
+				a = x < 32 ? a >> x : 0;
+				break;
+			case BPF_ALU | BPF_NEG:
+				a = 0 - a;
+				break;
+
+			case BPF_MISC | BPF_TAX:
+				x = a;
+				break;
+			case BPF_MISC | BPF_TXA:
+				a = x;
+				break;
+
+			// Unknown instructions reject the packet, as in the kernel.
+			default:
+				return 0;
+		}
+	}
+
+	return 0;
+}
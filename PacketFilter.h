@@ -0,0 +1,156 @@
+#ifndef PACKET_FILTER_H_
+#define PACKET_FILTER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <pcap.h>
+
+/**
+ * This class decides which packets are written, before they cost any disk bandwidth. A filter is a chain of stages
+ * and a packet is kept only if every stage accepts it. Two kinds of stage are available:
+ *
+ *	- Classic BPF programs, as compiled by pcap_compile() from a tcpdump expression ("tcp port 80", "vlan 10", ...).
+ *	  Programs are run by a small interpreter here, so writing does not depend on linking libpcap.
+ *	- Flow samplers which keep 1 in N flows. A flow is identified by a hash of its IP addresses, transport protocol
+ *	  and ports, symmetric in both directions, so both directions of a kept flow are kept. VLAN tags are skipped and
+ *	  all non-IP packets belong to one flow.
+ *
+ * Every stage counts the packets it has evaluated and accepted. A filter is used by a single writer thread.
+ *
+ * Usage:
+ *	bpf_program program;
+ *	pcap_compile(pcap_open_dead(DLT_EN10MB, 65535), &program, "tcp", 1, PCAP_NETMASK_UNKNOWN);
+ *	PacketFilter filter;
+ *	filter.add_bpf(&program);
+ *	filter.add_flow_sampler(100);
+ *	writer.set_filter(&filter);
+ */
+class PacketFilter
+{
+public:
+	/// Per-stage counters
+	struct counters_t
+	{
+		/// Number of packets evaluated by the stage
+		uint64_t evaluated;
+
+		/// Number of packets accepted by the stage
+		uint64_t hits;
+	};
+
+	PacketFilter();
+
+	/**
+	 * Appends a classic BPF stage. The instructions are copied, so the program may be freed afterwards.
+	 *
+	 * @param program Program compiled for the link type of the output file.
+	 * @return Stage index, or -1 if the program is invalid (backward or out-of-range jump, out-of-range scratch
+	 *	memory, or no return at its end).
+	 */
+	int add_bpf(const bpf_program* program);
+
+	/**
+	 * Appends a flow sampling stage which keeps 1 in every rate flows.
+	 *
+	 * @param rate Sampling rate; 1 keeps every packet.
+	 * @param seed Seed of the flow hash, which selects which flows are kept.
+	 * @return Stage index, or -1 if rate is zero.
+	 */
+	int add_flow_sampler(uint32_t rate, uint32_t seed = 0);
+
+	/**
+	 * Runs the packet through the stages in order, until one of them rejects it.
+	 *
+	 * @param frame Packet data, starting at the link layer header.
+	 * @param frame_size Number of bytes available at frame.
+	 * @param original_size Actual length of packet on the wire.
+	 * @return True if the packet shall be written.
+	 */
+	bool accept(const char* frame, uint32_t frame_size, uint32_t original_size);
+
+	/// @return Number of stages.
+	size_t stages() const;
+
+	/// @return Counters of the given stage.
+	const counters_t& counters(size_t stage) const;
+
+	/// @return Number of packets rejected by any stage.
+	uint64_t dropped() const;
+
+	/// Resets every counter to zero.
+	void reset_counters();
+
+	/**
+	 * Hashes the flow of an Ethernet frame, symmetric in both directions.
+	 *
+	 * @param frame Packet data, starting at the Ethernet header.
+	 * @param frame_size Number of bytes available at frame.
+	 * @param seed Hash seed.
+	 * @return Flow hash, or a hash of seed alone for non-IP packets.
+	 */
+	static uint32_t flow_hash(const char* frame, uint32_t frame_size, uint32_t seed);
+
+	/**
+	 * Hashes a flow given by its addresses, protocol and ports, as flow_hash() does for a frame of that flow in either
+	 * direction. Fragments of a flow are hashed with both ports set to 0.
+	 *
+	 * @param source Source address in network byte order.
+	 * @param destination Destination address in network byte order.
+	 * @param address_size Size of each address, 4 for IPv4 and 16 for IPv6.
+	 * @param protocol Transport protocol.
+	 * @param source_port Source port, or 0 for protocols without ports.
+	 * @param destination_port Destination port, or 0 for protocols without ports.
+	 * @param seed Hash seed.
+	 * @return Flow hash.
+	 */
+	static uint32_t tuple_hash(const uint8_t* source, const uint8_t* destination, size_t address_size,
+		uint8_t protocol, uint16_t source_port, uint16_t destination_port, uint32_t seed);
+
+private:
+	/// Kind of stage
+	enum class stage_type
+	{
+		/// Classic BPF program
+		bpf,
+
+		/// 1 in N flow sampler
+		flow_sampler
+	};
+
+	/// One stage of the filter
+	struct stage_t
+	{
+		/// Kind of stage
+		stage_type type;
+
+		/// Program of a BPF stage
+		std::vector<bpf_insn> program;
+
+		/// Sampling rate of a flow sampler
+		uint32_t rate;
+
+		/// Hash seed of a flow sampler
+		uint32_t seed;
+
+		/// Counters of this stage
+		counters_t counters;
+	};
+
+	/**
+	 * Runs a classic BPF program with the same semantics as the kernel and libpcap: loads beyond the captured bytes
+	 * reject the packet.
+	 *
+	 * @return Return value of the program, 0 to reject the packet.
+	 */
+	static uint32_t run_bpf(const std::vector<bpf_insn>& program, const uint8_t* packet, uint32_t captured_size,
+		uint32_t original_size);
+
+	/// Stages in evaluation order
+	std::vector<stage_t> stage_list;
+
+	/// Number of rejected packets
+	uint64_t dropped_count;
+};
+
+#endif
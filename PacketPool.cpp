@@ -0,0 +1,162 @@
+#include "PacketPool.h"
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+constexpr size_t PacketPool::CLASS_COUNT;
+constexpr uint32_t PacketPool::CLASS_SIZES[CLASS_COUNT];
+constexpr size_t PacketPool::DEFAULT_ARENA_SIZE;
+
+namespace
+{
+
+/// Size of a huge page, which the arena size is rounded up to
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// Stride of the writes which fault the arena in
+constexpr size_t FAULT_STRIDE = 4096;
+
+}
+
+PacketPool::PacketPool(size_t arena_size, int numa_node)
+: arena(nullptr)
+, arena_bytes(0)
+, hugetlb(false)
+, node(-1)
+, failure_count(0)
+{
+	size_t offsets[CLASS_COUNT];
+	for (size_t i = 0; i < CLASS_COUNT; ++i)
+	{
+		const size_t count = arena_size / CLASS_COUNT / CLASS_SIZES[i];
+		classes[i].count = count > 0 ? (count < UINT32_MAX ? static_cast<uint32_t>(count) : UINT32_MAX - 1) : 1;
+		classes[i].free_top = 0;
+		classes[i].returned_top.store(0, std::memory_order_relaxed);
+
+		offsets[i] = arena_bytes;
+		arena_bytes += static_cast<size_t>(classes[i].count) * CLASS_SIZES[i];
+	}
+	arena_bytes = (arena_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+	// Reserved huge pages are used if there are enough of them; otherwise transparent huge pages are asked for.
+	void* memory = mmap(nullptr, arena_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	hugetlb = memory != MAP_FAILED;
+	if (!hugetlb)
+	{
+		memory = mmap(nullptr, arena_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			arena_bytes = 0;
+			return;
+		}
+		madvise(memory, arena_bytes, MADV_HUGEPAGE);
+	}
+	arena = static_cast<char*>(memory);
+
+	// Pages are placed when first touched, so the arena is bound before it is faulted in. mbind() is called directly,
+	// so that libnuma is not needed.
+	if (numa_node < 0)
+	{
+		unsigned int cpu = 0;
+		unsigned int cpu_node = 0;
+		if (syscall(SYS_getcpu, &cpu, &cpu_node, nullptr) == 0)
+			numa_node = static_cast<int>(cpu_node);
+	}
+
+	unsigned long node_mask = 0;
+	if (numa_node >= 0 && static_cast<size_t>(numa_node) < sizeof(node_mask) * 8)
+	{
+		node_mask = 1UL << numa_node;
+		if (syscall(SYS_mbind, arena, arena_bytes, MPOL_PREFERRED, &node_mask, sizeof(node_mask) * 8 + 1, 0) == 0)
+			node = numa_node;
+	}
+
+	for (size_t offset = 0; offset < arena_bytes; offset += FAULT_STRIDE)
+		arena[offset] = 0;
+
+	for (size_t i = 0; i < CLASS_COUNT; ++i)
+	{
+		size_class_t& size_class = classes[i];
+		size_class.base = arena + offsets[i];
+
+		// Buffers are listed in address order, so the first ones allocated are contiguous.
+		size_class.next.reset(new uint32_t[size_class.count]);
+		for (uint32_t index = 0; index < size_class.count; ++index)
+			size_class.next[index] = index + 1 < size_class.count ? index + 2 : 0;
+
+		size_class.free_top = 1;
+	}
+}
+
+PacketPool::~PacketPool()
+{
+	if (arena)
+		munmap(arena, arena_bytes);
+}
+
+bool PacketPool::valid() const
+{
+	return arena != nullptr;
+}
+
+PacketBuffer PacketPool::allocate(uint32_t size)
+{
+	if (arena)
+	{
+		for (uint32_t i = 0; i < CLASS_COUNT; ++i)
+		{
+			if (CLASS_SIZES[i] < size)
+				continue;
+
+			// Buffers returned by other threads are taken all at once when the free list runs out.
+			size_class_t& size_class = classes[i];
+			if (size_class.free_top == 0)
+				size_class.free_top = size_class.returned_top.exchange(0, std::memory_order_acquire);
+
+			if (size_class.free_top != 0)
+			{
+				const uint32_t index = size_class.free_top - 1;
+				size_class.free_top = size_class.next[index];
+				return PacketBuffer(this, i, index, size_class.base + static_cast<size_t>(index) * CLASS_SIZES[i],
+					CLASS_SIZES[i]);
+			}
+		}
+	}
+
+	failure_count.fetch_add(1, std::memory_order_relaxed);
+	return PacketBuffer();
+}
+
+void PacketPool::release(uint32_t size_class, uint32_t index)
+{
+	size_class_t& returned_class = classes[size_class];
+	uint32_t top = returned_class.returned_top.load(std::memory_order_relaxed);
+	do
+	{
+		returned_class.next[index] = top;
+	}
+	while (!returned_class.returned_top.compare_exchange_weak(top, index + 1, std::memory_order_release,
+		std::memory_order_relaxed));
+}
+
+uint32_t PacketPool::buffers(uint32_t size_class) const
+{
+	return arena ? classes[size_class].count : 0;
+}
+
+uint64_t PacketPool::allocation_failures() const
+{
+	return failure_count.load(std::memory_order_relaxed);
+}
+
+bool PacketPool::huge_pages() const
+{
+	return hugetlb;
+}
+
+int PacketPool::numa_node() const
+{
+	return node;
+}
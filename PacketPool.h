@@ -0,0 +1,134 @@
+#ifndef PACKET_POOL_H_
+#define PACKET_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "PacketBuffer.h"
+
+/**
+ * This class is a preallocated pool of packet buffers, so that steady state capture never calls the heap allocator.
+ * The capture thread takes a buffer with allocate(), fills it and moves it into a writer, and the writer thread
+ * returns it once written (see PacketBuffer).
+ *
+ * Buffers come in CLASS_COUNT fixed size classes, from small frames to the largest snapshot length, each class having
+ * an equal share of the arena. allocate() takes a buffer of the smallest class which fits the frame, or of a larger
+ * class if that one is exhausted. The arena should be sized for the packets in flight between the capture loop and
+ * the writer, not more: recently released buffers are reused first, and a larger arena only lets the capture loop run
+ * further ahead through cold memory.
+ *
+ * The arena is one mapping, backed by huge pages where the system has some reserved (MAP_HUGETLB), otherwise by
+ * transparent huge pages (MADV_HUGEPAGE). It is bound to a NUMA node with mbind() and touched when the pool is
+ * constructed, so no page fault is taken later. The node defaults to the node of the constructing thread, so the pool
+ * should be constructed by the capture thread, or by a thread pinned to the same node.
+ *
+ * Buffers are allocated by one thread, the capture thread, from a free list of its own, without any atomic operation.
+ * Any thread may release buffers: they are pushed on a lock-free stack of returned buffers, which the capture thread
+ * takes whole when its free list runs out. Since that stack is only ever emptied at once, it has no ABA problem.
+ *
+ * Usage:
+ *	PacketPool pool;
+ *	PacketBuffer buffer = pool.allocate(frame_size);
+ */
+class PacketPool
+{
+public:
+	/// Number of size classes
+	constexpr static size_t CLASS_COUNT = 5;
+
+	/// Buffer size of each size class: minimum, medium and full size Ethernet frames, jumbo frames and default snaplen
+	constexpr static uint32_t CLASS_SIZES[CLASS_COUNT] = {128, 1024, 2048, 9216, 65536};
+
+	/// Default arena size in bytes
+	constexpr static size_t DEFAULT_ARENA_SIZE = 16 * 1024 * 1024;
+
+	/**
+	 * @param arena_size Size of the arena in bytes, shared equally between size classes; every class has at least
+	 *	one buffer.
+	 * @param numa_node NUMA node of the arena, or -1 for the node of the calling thread.
+	 */
+	explicit PacketPool(size_t arena_size = DEFAULT_ARENA_SIZE, int numa_node = -1);
+
+	/// Unmaps the arena. Every buffer must have been returned before.
+	~PacketPool();
+
+	PacketPool(const PacketPool&) = delete;
+	PacketPool& operator=(const PacketPool&) = delete;
+
+	/// @return True if the arena has been mapped.
+	bool valid() const;
+
+	/**
+	 * Takes a buffer from the pool. Only one thread may call this on an instance.
+	 *
+	 * @param size Number of bytes needed.
+	 * @return A handle on a buffer of at least size bytes, or an empty handle if the size is larger than the largest
+	 *	class or if every fitting class is exhausted.
+	 */
+	PacketBuffer allocate(uint32_t size);
+
+	/**
+	 * Returns a buffer detached from its handle (see PacketBuffer::detach()). May be called from any thread.
+	 *
+	 * @param size_class Size class of the buffer.
+	 * @param index Index of the buffer in its size class.
+	 */
+	void release(uint32_t size_class, uint32_t index);
+
+	/**
+	 * @param size_class Size class.
+	 * @return Number of buffers of the class.
+	 */
+	uint32_t buffers(uint32_t size_class) const;
+
+	/// @return Number of allocate() calls which have returned an empty handle.
+	uint64_t allocation_failures() const;
+
+	/// @return True if the arena is backed by reserved huge pages.
+	bool huge_pages() const;
+
+	/// @return NUMA node the arena is bound to, or -1 if it could not be bound.
+	int numa_node() const;
+
+private:
+	/// Free buffers of one size class
+	struct size_class_t
+	{
+		/// Memory of the first buffer
+		char* base;
+
+		/// Number of buffers
+		uint32_t count;
+
+		/// Index plus one of the first buffer of the free list of the allocating thread, or 0 if it is empty
+		uint32_t free_top;
+
+		/// Index plus one of the top buffer of the stack of returned buffers, or 0 if it is empty
+		std::atomic<uint32_t> returned_top;
+
+		/// Index plus one of the buffer after each buffer of a free list or stack, or 0 for the last one
+		std::unique_ptr<uint32_t[]> next;
+	};
+
+	/// Arena memory, or nullptr
+	char* arena;
+
+	/// Size of the arena mapping in bytes
+	size_t arena_bytes;
+
+	/// True if the arena is backed by reserved huge pages
+	bool hugetlb;
+
+	/// NUMA node the arena is bound to, or -1
+	int node;
+
+	/// Size classes
+	size_class_t classes[CLASS_COUNT];
+
+	/// Number of allocate() calls which have returned an empty handle
+	std::atomic<uint64_t> failure_count;
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "PacketRing.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PacketRing::PacketRing(uint32_t block_size, uint32_t block_count, unsigned int block_timeout)
+: block_size(block_size)
+, block_count(block_count)
+, block_timeout(block_timeout)
+, socket_fd(-1)
+, ring(nullptr)
+, current_block(0)
+, block_held(false)
+, stopping(false)
+{
+}
+
+PacketRing::~PacketRing()
+{
+	close();
+}
+
+bool PacketRing::open(const std::string& interface, bool promiscuous)
+{
+	if (socket_fd >= 0)
+		return false;
+
+	const unsigned int interface_index = if_nametoindex(interface.c_str());
+	if (interface_index == 0)
+		return false;
+
+	// Protocol 0 receives nothing until bind(), so the ring only ever holds packets of the given interface.
+	socket_fd = socket(AF_PACKET, SOCK_RAW, 0);
+	if (socket_fd < 0)
+		return false;
+
+	const int version = TPACKET_V3;
+	tpacket_req3 request = tpacket_req3();
+	request.tp_block_size = block_size;
+	request.tp_block_nr = block_count;
+	request.tp_frame_size = TPACKET_ALIGNMENT << 7;		// Only a hint with TPACKET_V3, frames are packed.
+	request.tp_frame_nr = block_size / request.tp_frame_size * block_count;
+	request.tp_retire_blk_tov = block_timeout;
+
+	if (setsockopt(socket_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0
+		|| setsockopt(socket_fd, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) != 0)
+	{
+		close();
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(block_size) * block_count, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, socket_fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	ring = static_cast<char*>(mapping);
+
+	sockaddr_ll address = sockaddr_ll();
+	address.sll_family = AF_PACKET;
+	address.sll_protocol = htons(ETH_P_ALL);
+	address.sll_ifindex = static_cast<int>(interface_index);
+	if (bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close();
+		return false;
+	}
+
+	// Membership is dropped by the kernel when the socket is closed.
+	if (promiscuous)
+	{
+		packet_mreq membership = packet_mreq();
+		membership.mr_ifindex = static_cast<int>(interface_index);
+		membership.mr_type = PACKET_MR_PROMISC;
+		if (setsockopt(socket_fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+		{
+			close();
+			return false;
+		}
+	}
+
+	current_block = 0;
+	block_held = false;
+	stopping.store(false, std::memory_order_relaxed);
+	return true;
+}
+
+int PacketRing::next_block(std::vector<PcapWriter::packet_t>* packets, int timeout)
+{
+	if (!ring)
+		return -1;
+
+	if (block_held)
+		release_block();
+
+	packets->clear();
+
+	tpacket_block_desc* block = reinterpret_cast<tpacket_block_desc*>(ring + static_cast<size_t>(current_block)
+		* block_size);
+
+	// The kernel publishes a block by setting TP_STATUS_USER after it has written all of its frames.
+	while (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+	{
+		pollfd descriptor = pollfd();
+		descriptor.fd = socket_fd;
+		descriptor.events = POLLIN | POLLERR;
+
+		const int result = poll(&descriptor, 1, timeout);
+		if (result == 0 || (result < 0 && errno == EINTR))
+			return 0;
+		if (result < 0)
+			return -1;
+	}
+
+	const char* block_start = reinterpret_cast<const char*>(block);
+	uint32_t offset = block->hdr.bh1.offset_to_first_pkt;
+	for (uint32_t i = 0; i < block->hdr.bh1.num_pkts; ++i)
+	{
+		const tpacket3_hdr* header = reinterpret_cast<const tpacket3_hdr*>(block_start + offset);
+
+		PcapWriter::packet_t packet;
+		packet.frame = reinterpret_cast<const char*>(header) + header->tp_mac;
+		packet.frame_size = header->tp_snaplen;
+		packet.original_size = header->tp_len;
+		packet.time.tv_sec = static_cast<time_t>(header->tp_sec);
+		packet.time.tv_usec = static_cast<suseconds_t>(header->tp_nsec / 1000);
+		packet.time_nsec = header->tp_nsec % 1000;
+
+		// The kernel strips the 802.1Q tag of accelerated interfaces; the writer inserts it back, as libpcap does.
+		if (header->tp_status & TP_STATUS_VLAN_VALID)
+		{
+			const uint32_t tpid = header->tp_status & TP_STATUS_VLAN_TPID_VALID ? header->hv1.tp_vlan_tpid
+				: ETH_P_8021Q;
+			packet.vlan_tag = tpid << 16 | header->hv1.tp_vlan_tci;
+		}
+		packets->push_back(packet);
+
+		offset += header->tp_next_offset;
+	}
+
+	block_held = true;
+	return 1;
+}
+
+void PacketRing::release_block()
+{
+	if (!block_held)
+		return;
+
+	tpacket_block_desc* block = reinterpret_cast<tpacket_block_desc*>(ring + static_cast<size_t>(current_block)
+		* block_size);
+
+	// Frames of the block must not be read after the kernel may reuse it.
+	__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+	current_block = (current_block + 1) % block_count;
+	block_held = false;
+}
+
+long long int PacketRing::capture(PcapWriter* writer, uint64_t max_packets)
+{
+	long long int total_bytes = 0;
+	uint64_t packets = 0;
+
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		const int result = next_block(&block_packets, CAPTURE_POLL_TIMEOUT);
+		if (result < 0)
+			return -1;
+		if (result == 0)
+		{
+			// Records buffered by the writer still reach the file in time when the interface is idle.
+			if (!writer->poll())
+				return -1;
+			continue;
+		}
+
+		size_t count = block_packets.size();
+		if (max_packets > 0 && packets + count > max_packets)
+			count = static_cast<size_t>(max_packets - packets);
+
+		// Frames are written straight from the ring, which is released only after that.
+		const long int written = writer->write_packets(block_packets.data(), count);
+		release_block();
+		if (written < 0)
+			return -1;
+
+		total_bytes += written;
+		packets += count;
+		if (max_packets > 0 && packets >= max_packets)
+			break;
+	}
+
+	return total_bytes;
+}
+
+void PacketRing::stop()
+{
+	stopping.store(true, std::memory_order_relaxed);
+}
+
+bool PacketRing::statistics(uint64_t* received, uint64_t* dropped)
+{
+	tpacket_stats_v3 counters = tpacket_stats_v3();
+	socklen_t length = sizeof(counters);
+	if (socket_fd < 0 || getsockopt(socket_fd, SOL_PACKET, PACKET_STATISTICS, &counters, &length) != 0)
+		return false;
+
+	// The kernel counts dropped packets in tp_packets too.
+	*received = counters.tp_packets;
+	*dropped = counters.tp_drops;
+	return true;
+}
+
+void PacketRing::close()
+{
+	if (ring)
+	{
+		munmap(ring, static_cast<size_t>(block_size) * block_count);
+		ring = nullptr;
+	}
+
+	if (socket_fd >= 0)
+	{
+		::close(socket_fd);
+		socket_fd = -1;
+	}
+
+	block_held = false;
+}
+
+int PacketRing::descriptor() const
+{
+	return socket_fd;
+}
@@ -0,0 +1,125 @@
+#ifndef PACKET_RING_H_
+#define PACKET_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PcapWriter.h"
+
+/**
+ * This class captures packets from a network interface through an AF_PACKET socket with a memory-mapped TPACKET_V3
+ * receive ring. The kernel fills whole blocks of frames in the shared ring; each block is handed to the writer as one
+ * batch of packets pointing into the ring memory, so frames are written without being copied, and the block is given
+ * back to the kernel only after it has been written.
+ *
+ * A block is handed over when it is full or when the block timeout expires, so on a quiet interface packets reach the
+ * writer at most that long after they have been received. Capturing needs CAP_NET_RAW.
+ *
+ * Packets carry the nanosecond timestamps of the ring, kept if the writer has nanosecond resolution, and the 802.1Q
+ * tags which the kernel strips on interfaces with VLAN offload, so that the writer puts them back into the frames.
+ * The tag is inserted after the MAC addresses of an Ethernet header.
+ */
+class PacketRing
+{
+public:
+	/**
+	 * @param block_size Size of each ring block in bytes, a multiple of the page size.
+	 * @param block_count Number of ring blocks.
+	 * @param block_timeout Milliseconds after which the kernel hands over a block which is not full.
+	 */
+	PacketRing(uint32_t block_size = 1024 * 1024, uint32_t block_count = 64, unsigned int block_timeout = 10);
+
+	/// Closes the socket and unmaps the ring if they are open.
+	~PacketRing();
+
+	PacketRing(const PacketRing&) = delete;
+	PacketRing& operator=(const PacketRing&) = delete;
+
+	/**
+	 * Opens the socket, maps its receive ring and binds it to the given interface.
+	 *
+	 * @param interface Name of the interface to capture from.
+	 * @param promiscuous True to put the interface into promiscuous mode while capturing.
+	 * @return True for success and false for failure.
+	 */
+	bool open(const std::string& interface, bool promiscuous = false);
+
+	/**
+	 * Waits for the next block filled by the kernel and describes its packets. Frames point into the ring and stay
+	 * valid until release_block() is called.
+	 *
+	 * @param packets Packets of the block; cleared first.
+	 * @param timeout Maximum time to wait in milliseconds, or -1 to wait until a block is ready.
+	 * @return "1" if a block is ready, "0" on timeout, "-1" on failure.
+	 */
+	int next_block(std::vector<PcapWriter::packet_t>* packets, int timeout);
+
+	/// Gives the block returned by the last next_block() call back to the kernel.
+	void release_block();
+
+	/**
+	 * Writes captured blocks with PcapWriter::write_packets() until max_packets packets have been written or stop() is
+	 * called. Each block is released once it has been written, and the writer is polled whenever no block comes.
+	 *
+	 * @param writer Writer with its global header already written.
+	 * @param max_packets Number of packets to capture, or 0 for no limit.
+	 * @return Number of bytes written, or -1 for failure.
+	 */
+	long long int capture(PcapWriter* writer, uint64_t max_packets = 0);
+
+	/// Makes capture() return after the current block; may be called from another thread or a signal handler.
+	void stop();
+
+	/**
+	 * Reads the kernel counters of the socket. The counters are reset on every call.
+	 *
+	 * @param received Number of packets received since the last call.
+	 * @param dropped Number of packets dropped because the ring was full since the last call.
+	 * @return True for success and false for failure.
+	 */
+	bool statistics(uint64_t* received, uint64_t* dropped);
+
+	/// Unmaps the ring and closes the socket.
+	void close();
+
+	/// @return Socket descriptor, or -1 if it is not open.
+	int descriptor() const;
+
+private:
+	/**
+	 * Poll timeout of capture() in milliseconds, so that stop() is noticed on an idle interface, and records buffered
+	 * by the writer are not held much longer than its maximum latency (see PcapWriter::poll())
+	 */
+	constexpr static int CAPTURE_POLL_TIMEOUT = 20;
+
+	/// Size of each ring block
+	uint32_t block_size;
+
+	/// Number of ring blocks
+	uint32_t block_count;
+
+	/// Block retire timeout in milliseconds
+	unsigned int block_timeout;
+
+	/// Packet socket
+	int socket_fd;
+
+	/// Mapped receive ring
+	char* ring;
+
+	/// Index of the next block to read
+	uint32_t current_block;
+
+	/// True while the current block is held by user application
+	bool block_held;
+
+	/// Set by stop()
+	std::atomic<bool> stopping;
+
+	/// Packets of the current block, reused by capture()
+	std::vector<PcapWriter::packet_t> block_packets;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "PcapIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "PacketFilter.h"
+
+constexpr uint32_t PcapIndex::INDEX_MAGIC;
+constexpr uint16_t PcapIndex::INDEX_VERSION;
+constexpr uint16_t PcapIndex::UNBLOCKED_INDEX_VERSION;
+constexpr uint16_t PcapIndex::HASH_COUNT;
+constexpr uint32_t PcapIndex::BLOOM_WORD_SIZE;
+constexpr size_t PcapIndex::WRITE_CHUNK_SIZE;
+constexpr size_t PcapIndex::HASH_BATCH_SIZE;
+
+PcapIndex::PcapIndex(uint32_t packet_interval, uint64_t time_interval, uint32_t bloom_size)
+: packet_interval(packet_interval > 0 ? packet_interval : 1)
+, time_interval(time_interval)
+, bloom_size(0)
+, opened(false)
+, failed(false)
+, block_start(0)
+, block_count(0)
+{
+	// Rounds down to a power of two, so bit positions are masked instead of divided.
+	if (bloom_size > 0)
+	{
+		this->bloom_size = BLOOM_WORD_SIZE;
+		while (this->bloom_size <= bloom_size / 2)
+			this->bloom_size *= 2;
+	}
+
+	memset(&block, 0, sizeof(block));
+	bloom.resize(this->bloom_size);
+}
+
+PcapIndex::~PcapIndex()
+{
+	close();
+}
+
+bool PcapIndex::open(const std::string& path)
+{
+	close();
+
+	if (!file.open(path))
+		return false;
+
+	index_header_t header;
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.hash_count = HASH_COUNT;
+	header.bloom_size = bloom_size;
+	header.packet_interval = packet_interval;
+	header.time_interval = time_interval;
+
+	if (!file.write(&header, sizeof(header)))
+	{
+		file.close();
+		return false;
+	}
+
+	memset(&block, 0, sizeof(block));
+	buffer.clear();
+	buffer.reserve(WRITE_CHUNK_SIZE + sizeof(block_t) + bloom_size);
+	block_count = 0;
+	failed = false;
+	opened = true;
+	return true;
+}
+
+void PcapIndex::add(uint64_t timestamp, uint64_t offset, uint32_t record_size, const char* frame,
+	uint32_t frame_size)
+{
+	record_t record;
+	record.timestamp = timestamp;
+	record.offset = offset;
+	record.frame = frame;
+	record.size = record_size;
+	record.frame_size = frame_size;
+	add(&record, 1);
+}
+
+void PcapIndex::add(const record_t* records, size_t count)
+{
+	if (!opened)
+		return;
+
+	uint8_t* const filter = bloom.data();
+	uint32_t hashes[HASH_BATCH_SIZE];
+	for (size_t first = 0; first < count; first += HASH_BATCH_SIZE)
+	{
+		const size_t size = count - first < HASH_BATCH_SIZE ? count - first : HASH_BATCH_SIZE;
+		const record_t* const batch = records + first;
+
+		// Hashes do not depend on each other, so computing them apart from the inserts lets them overlap.
+		if (bloom_size > 0)
+		{
+			for (size_t i = 0; i < size; ++i)
+				hashes[i] = PacketFilter::flow_hash(batch[i].frame, batch[i].frame_size, 0);
+		}
+
+		// The block is kept in locals: the filter is written through a byte pointer, which could alias the members.
+		block_t current = block;
+		uint64_t current_start = block_start;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const uint64_t timestamp = batch[i].timestamp;
+
+			// Timestamps going backwards (e.g. merged sources) do not start a block; they widen its time range instead.
+			if (current.packets >= packet_interval || (current.packets > 0 && time_interval > 0
+				&& timestamp > current_start && timestamp - current_start >= time_interval))
+			{
+				block = current;
+				finish_block();
+				current = block;
+			}
+
+			if (current.packets == 0)
+			{
+				current.offset = batch[i].offset;
+				current.first_timestamp = timestamp;
+				current.last_timestamp = timestamp;
+				current_start = timestamp;
+			}
+			else if (timestamp < current.first_timestamp)
+			{
+				current.first_timestamp = timestamp;
+			}
+			else if (timestamp > current.last_timestamp)
+			{
+				current.last_timestamp = timestamp;
+			}
+
+			current.size += batch[i].size;
+			++current.packets;
+
+			if (bloom_size > 0)
+				bloom_insert(filter, bloom_size, hashes[i]);
+		}
+
+		block = current;
+		block_start = current_start;
+	}
+}
+
+void PcapIndex::finish_block()
+{
+	const char* entry = reinterpret_cast<const char*>(&block);
+	buffer.insert(buffer.end(), entry, entry + sizeof(block));
+	buffer.insert(buffer.end(), bloom.begin(), bloom.end());
+	++block_count;
+
+	memset(&block, 0, sizeof(block));
+	std::fill(bloom.begin(), bloom.end(), 0);
+
+	if (buffer.size() >= WRITE_CHUNK_SIZE)
+	{
+		failed = !file.write(buffer.data(), buffer.size()) || failed;
+		buffer.clear();
+	}
+}
+
+bool PcapIndex::close()
+{
+	if (!opened)
+		return true;
+
+	if (block.packets > 0)
+		finish_block();
+
+	if (!buffer.empty())
+		failed = !file.write(buffer.data(), buffer.size()) || failed;
+	buffer.clear();
+
+	opened = false;
+	const bool result = file.close() && !failed;
+	failed = false;
+	return result;
+}
+
+uint64_t PcapIndex::blocks() const
+{
+	return block_count;
+}
+
+uint32_t PcapIndex::bloom_word(uint32_t bloom_size, uint32_t hash)
+{
+	// The word comes from a multiplicative hash, so that it does not depend only on the bits which give positions.
+	const uint32_t words = bloom_size / BLOOM_WORD_SIZE;
+	return (static_cast<uint32_t>((hash * 0x9e3779b97f4a7c15ull) >> 32) & (words - 1)) * BLOOM_WORD_SIZE;
+}
+
+void PcapIndex::bloom_insert(uint8_t* bloom, uint32_t bloom_size, uint32_t hash)
+{
+	// Bit i of a flow is taken from bits 6i to 6i+5 of its hash, within its word.
+	uint8_t* const word = bloom + bloom_word(bloom_size, hash);
+	const uint32_t bit0 = hash & 63;
+	const uint32_t bit1 = (hash >> 6) & 63;
+	const uint32_t bit2 = (hash >> 12) & 63;
+
+	// Flows come in bursts, so most inserts find their bits set; not storing them spares a read-modify-write chain.
+	if ((word[bit0 >> 3] & (1 << (bit0 & 7))) && (word[bit1 >> 3] & (1 << (bit1 & 7)))
+		&& (word[bit2 >> 3] & (1 << (bit2 & 7))))
+		return;
+
+	word[bit0 >> 3] |= static_cast<uint8_t>(1 << (bit0 & 7));
+	word[bit1 >> 3] |= static_cast<uint8_t>(1 << (bit1 & 7));
+	word[bit2 >> 3] |= static_cast<uint8_t>(1 << (bit2 & 7));
+}
+
+bool PcapIndex::bloom_contains(const uint8_t* bloom, uint32_t bloom_size, uint32_t hash, uint16_t version)
+{
+	if (version == UNBLOCKED_INDEX_VERSION)
+	{
+		// Double hashing over the whole filter: bit i is h1 + i * h2, with h2 odd so that the positions differ.
+		const uint32_t mask = bloom_size * 8 - 1;
+		const uint32_t step = ((hash >> 16 | hash << 16) * 0x9e3779b1) | 1;
+
+		for (uint32_t i = 0; i < HASH_COUNT; ++i)
+		{
+			const uint32_t bit = (hash + i * step) & mask;
+			if (!(bloom[bit >> 3] & (1 << (bit & 7))))
+				return false;
+		}
+
+		return true;
+	}
+
+	const uint8_t* const word = bloom + bloom_word(bloom_size, hash);
+	for (uint32_t i = 0; i < HASH_COUNT; ++i)
+	{
+		const uint32_t bit = (hash >> (i * 6)) & 63;
+		if (!(word[bit >> 3] & (1 << (bit & 7))))
+			return false;
+	}
+
+	return true;
+}
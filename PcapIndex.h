@@ -0,0 +1,238 @@
+#ifndef PCAP_INDEX_H_
+#define PCAP_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FdSink.h"
+
+/**
+ * This class builds a sidecar index of a pcap file while PcapWriter writes it (see PcapWriter::set_index()). Records
+ * are grouped into blocks of consecutive records, and a new block starts every packet_interval packets or whenever
+ * time_interval nanoseconds have passed since the first packet of the block. For every block the index keeps its file
+ * offset and size, its number of packets, the lowest and highest timestamp of its packets and, optionally, a bloom
+ * filter of the flows of its packets (see PacketFilter::flow_hash()). PcapIndexReader uses the index to find the
+ * regions of the pcap file which may hold a time range or a flow, so they are read without scanning the whole file.
+ *
+ * The bloom filter is blocked: the bits of a flow all fall into one 8-byte word of the filter, chosen by the flow
+ * hash, so an insert touches a single cache line, and a flow whose bits are already set writes nothing.
+ * PcapWriter::write_packets() adds the records of a batch at once, and their flows are hashed in one pass before any
+ * bit is set, so the hashes of consecutive packets are computed in parallel instead of one after the other.
+ *
+ * Finished blocks are buffered and appended to the index file in chunks, and the last block is written by close().
+ * The index file starts with a header (index_header_t) followed by one entry per block: a block_t and the bloom
+ * filter bytes of the block.
+ *
+ * Usage:
+ *	PcapIndex index(4096, 100000000, 512);
+ *	index.open("capture.pcap.idx");
+ *	writer.set_index(&index);
+ *	... write packets ...
+ *	index.close();
+ */
+class PcapIndex
+{
+public:
+	/// Header at the beginning of an index file
+	struct index_header_t
+	{
+		/// Magic number, INDEX_MAGIC
+		uint32_t magic;
+
+		/// Format version, INDEX_VERSION
+		uint16_t version;
+
+		/// Number of bits set in the bloom filter for each flow
+		uint16_t hash_count;
+
+		/// Size of the bloom filter of each block in bytes, 0 if flows are not indexed
+		uint32_t bloom_size;
+
+		/// Maximum number of packets in a block
+		uint32_t packet_interval;
+
+		/// Maximum time span of a block in nanoseconds
+		uint64_t time_interval;
+	} __attribute__((packed));
+
+	/// Index entry of one block, followed in the file by bloom_size bytes of bloom filter
+	struct block_t
+	{
+		/// File offset of the first record of the block
+		uint64_t offset;
+
+		/// Number of bytes of the block's records, headers included
+		uint64_t size;
+
+		/// Lowest timestamp of the block's packets in nanoseconds
+		uint64_t first_timestamp;
+
+		/// Highest timestamp of the block's packets in nanoseconds
+		uint64_t last_timestamp;
+
+		/// Number of packets in the block
+		uint32_t packets;
+
+		/// Reserved, zero
+		uint32_t reserved;
+	} __attribute__((packed));
+
+	/// Magic number of index files ("PIDX" in file byte order)
+	constexpr static uint32_t INDEX_MAGIC = 0x58444950;
+
+	/// Version of the index file format
+	constexpr static uint16_t INDEX_VERSION = 2;
+
+	/// Version of index files whose bloom filters spread the bits of a flow over the whole filter, which are still read
+	constexpr static uint16_t UNBLOCKED_INDEX_VERSION = 1;
+
+	/// Number of bits set in the bloom filter for each flow
+	constexpr static uint16_t HASH_COUNT = 3;
+
+	/// Size of the bloom filter word which holds all the bits of a flow, and smallest bloom filter size
+	constexpr static uint32_t BLOOM_WORD_SIZE = 8;
+
+	/// A record added to the index, see add()
+	struct record_t
+	{
+		/// Timestamp of the packet in nanoseconds
+		uint64_t timestamp;
+
+		/// File offset of the record header
+		uint64_t offset;
+
+		/// Packet data, starting at the link layer header
+		const char* frame;
+
+		/// Size of the record, header included
+		uint32_t size;
+
+		/// Number of bytes written from frame
+		uint32_t frame_size;
+	};
+
+	/**
+	 * @param packet_interval Maximum number of packets in a block.
+	 * @param time_interval Maximum time span of a block in nanoseconds, or 0 for no limit.
+	 * @param bloom_size Size of the bloom filter of each block in bytes, rounded down to a power of two and at
+	 *	least BLOOM_WORD_SIZE, or 0 not to index flows.
+	 */
+	PcapIndex(uint32_t packet_interval = 4096, uint64_t time_interval = 100000000, uint32_t bloom_size = 0);
+
+	/// Closes the index if it is open.
+	~PcapIndex();
+
+	PcapIndex(const PcapIndex&) = delete;
+	PcapIndex& operator=(const PcapIndex&) = delete;
+
+	/**
+	 * Creates (or truncates) the index file and writes its header.
+	 *
+	 * @param path The index file path, usually the pcap file path followed by ".idx".
+	 * @return True for success and false for failure.
+	 */
+	bool open(const std::string& path);
+
+	/**
+	 * Adds a record to the index. Called by PcapWriter for every record it writes.
+	 *
+	 * @param timestamp Timestamp of the packet in nanoseconds.
+	 * @param offset File offset of the record header.
+	 * @param record_size Size of the record, header included.
+	 * @param frame Packet data, starting at the link layer header.
+	 * @param frame_size Number of bytes written from frame.
+	 */
+	void add(uint64_t timestamp, uint64_t offset, uint32_t record_size, const char* frame, uint32_t frame_size);
+
+	/**
+	 * Adds consecutive records to the index. Called by PcapWriter::write_packets() for every batch it writes.
+	 *
+	 * @param records Records in file order.
+	 * @param count Number of records.
+	 */
+	void add(const record_t* records, size_t count);
+
+	/**
+	 * Writes the current block and every buffered block to the index file, then closes it.
+	 *
+	 * @return True for success, false if any write to the index file has failed.
+	 */
+	bool close();
+
+	/// @return Number of blocks finished so far.
+	uint64_t blocks() const;
+
+	/**
+	 * Sets the bits of a flow in a bloom filter.
+	 *
+	 * @param bloom Bloom filter.
+	 * @param bloom_size Size of the bloom filter in bytes, a power of two, at least BLOOM_WORD_SIZE.
+	 * @param hash Flow hash, see PacketFilter::flow_hash().
+	 */
+	static void bloom_insert(uint8_t* bloom, uint32_t bloom_size, uint32_t hash);
+
+	/**
+	 * Tests whether a flow may be in a bloom filter.
+	 *
+	 * @param bloom Bloom filter.
+	 * @param bloom_size Size of the bloom filter in bytes, a power of two, at least BLOOM_WORD_SIZE.
+	 * @param hash Flow hash, see PacketFilter::flow_hash().
+	 * @param version Version of the index file the filter comes from, INDEX_VERSION or UNBLOCKED_INDEX_VERSION.
+	 * @return False if the flow is certainly not in the filter.
+	 */
+	static bool bloom_contains(const uint8_t* bloom, uint32_t bloom_size, uint32_t hash,
+		uint16_t version = INDEX_VERSION);
+
+private:
+	/// Number of buffered bytes which makes the buffer written to the index file
+	constexpr static size_t WRITE_CHUNK_SIZE = 64 * 1024;
+
+	/// Number of records whose flows are hashed in one pass by add()
+	constexpr static size_t HASH_BATCH_SIZE = 64;
+
+	/**
+	 * @param bloom_size Size of the bloom filter in bytes, a power of two.
+	 * @param hash Flow hash.
+	 * @return Offset of the word of the flow in the bloom filter.
+	 */
+	static uint32_t bloom_word(uint32_t bloom_size, uint32_t hash);
+
+	/// Appends the current block to the buffer, and writes the buffer if it is large enough.
+	void finish_block();
+
+	/// Maximum number of packets in a block
+	uint32_t packet_interval;
+
+	/// Maximum time span of a block in nanoseconds, or 0
+	uint64_t time_interval;
+
+	/// Size of the bloom filter of each block in bytes, or 0
+	uint32_t bloom_size;
+
+	/// Index file
+	FdSink file;
+
+	/// True while the index file is open
+	bool opened;
+
+	/// True if any write to the index file has failed
+	bool failed;
+
+	/// Entry of the current block
+	block_t block;
+
+	/// Timestamp of the first packet of the current block
+	uint64_t block_start;
+
+	/// Bloom filter of the current block
+	std::vector<uint8_t> bloom;
+
+	/// Finished blocks not yet written to the index file
+	std::vector<char> buffer;
+
+	/// Number of finished blocks
+	uint64_t block_count;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "PcapIndexReader.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PcapIndexReader::PcapIndexReader()
+: data(nullptr)
+, file_size(0)
+, entry_size(0)
+, block_count(0)
+{
+	memset(&index_header, 0, sizeof(index_header));
+}
+
+PcapIndexReader::~PcapIndexReader()
+{
+	close();
+}
+
+bool PcapIndexReader::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(PcapIndex::index_header_t))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data = static_cast<const char*>(mapping);
+	file_size = static_cast<uint64_t>(file_stat.st_size);
+
+	memcpy(&index_header, data, sizeof(index_header));
+	const uint32_t bloom_size = index_header.bloom_size;
+
+	// Blocked filters of the current version hold at least one word.
+	const bool blocked = index_header.version == PcapIndex::INDEX_VERSION;
+	if (index_header.magic != PcapIndex::INDEX_MAGIC
+		|| (!blocked && index_header.version != PcapIndex::UNBLOCKED_INDEX_VERSION)
+		|| (bloom_size & (bloom_size - 1)) != 0
+		|| (blocked && bloom_size > 0 && bloom_size < PcapIndex::BLOOM_WORD_SIZE))
+	{
+		close();
+		return false;
+	}
+
+	entry_size = sizeof(PcapIndex::block_t) + bloom_size;
+	block_count = static_cast<size_t>((file_size - sizeof(index_header)) / entry_size);
+	return true;
+}
+
+void PcapIndexReader::close()
+{
+	if (data)
+		munmap(const_cast<char*>(data), file_size);
+
+	data = nullptr;
+	file_size = 0;
+	entry_size = 0;
+	block_count = 0;
+}
+
+const PcapIndex::index_header_t& PcapIndexReader::header() const
+{
+	return index_header;
+}
+
+size_t PcapIndexReader::blocks() const
+{
+	return block_count;
+}
+
+PcapIndex::block_t PcapIndexReader::block(size_t index) const
+{
+	PcapIndex::block_t entry;
+	memcpy(&entry, data + sizeof(index_header) + index * entry_size, sizeof(entry));
+	return entry;
+}
+
+size_t PcapIndexReader::find(uint64_t from, uint64_t to, std::vector<region_t>* regions) const
+{
+	return collect(nullptr, from, to, regions);
+}
+
+size_t PcapIndexReader::find_flow(uint32_t flow_hash, uint64_t from, uint64_t to, std::vector<region_t>* regions) const
+{
+	return collect(index_header.bloom_size > 0 ? &flow_hash : nullptr, from, to, regions);
+}
+
+size_t PcapIndexReader::collect(const uint32_t* flow_hash, uint64_t from, uint64_t to,
+	std::vector<region_t>* regions) const
+{
+	regions->clear();
+
+	// Timestamps of blocks are not sorted when sources have been merged out of order, so every entry is compared.
+	for (size_t i = 0; i < block_count; ++i)
+	{
+		const char* entry = data + sizeof(index_header) + i * entry_size;
+		PcapIndex::block_t current;
+		memcpy(&current, entry, sizeof(current));
+
+		if (current.last_timestamp < from || current.first_timestamp > to)
+			continue;
+
+		if (flow_hash && !PcapIndex::bloom_contains(reinterpret_cast<const uint8_t*>(entry + sizeof(current)),
+			index_header.bloom_size, *flow_hash, index_header.version))
+			continue;
+
+		if (!regions->empty() && regions->back().offset + regions->back().size == current.offset)
+		{
+			regions->back().size += current.size;
+			regions->back().packets += current.packets;
+		}
+		else
+		{
+			region_t region;
+			region.offset = current.offset;
+			region.size = current.size;
+			region.packets = current.packets;
+			regions->push_back(region);
+		}
+	}
+
+	return regions->size();
+}
@@ -0,0 +1,117 @@
+#ifndef PCAP_INDEX_READER_H_
+#define PCAP_INDEX_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PcapIndex.h"
+
+/**
+ * This class answers queries on a sidecar index written by PcapIndex. A query returns the regions of the pcap file
+ * which may hold the packets asked for; every record of the pcap file outside of them certainly does not match. Blocks
+ * are compared by their time range and, for flow queries, their bloom filter, and adjacent matching blocks are merged
+ * into one region. Regions start at a record header, so PcapReader::seek() can jump straight to them.
+ *
+ * Usage:
+ *	PcapIndexReader index;
+ *	index.open("capture.pcap.idx");
+ *	std::vector<PcapIndexReader::region_t> regions;
+ *	index.find(from, to, &regions);
+ *	for (const PcapIndexReader::region_t& region : regions)
+ *		... reader.seek(region.offset), then read records until region.offset + region.size ...
+ */
+class PcapIndexReader
+{
+public:
+	/// A region of consecutive records of the pcap file
+	struct region_t
+	{
+		/// File offset of the first record
+		uint64_t offset;
+
+		/// Number of bytes of the region's records, headers included
+		uint64_t size;
+
+		/// Number of packets in the region
+		uint64_t packets;
+	};
+
+	PcapIndexReader();
+
+	~PcapIndexReader();
+
+	PcapIndexReader(const PcapIndexReader&) = delete;
+	PcapIndexReader& operator=(const PcapIndexReader&) = delete;
+
+	/**
+	 * Maps the index file and validates its header. A partial entry at the end of the file (e.g. of an index whose
+	 * writer has not been closed) is ignored.
+	 *
+	 * @param path The index file path.
+	 * @return True if the file has been mapped and has a valid header; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// Unmaps the index file.
+	void close();
+
+	/// @return Header of the index file.
+	const PcapIndex::index_header_t& header() const;
+
+	/// @return Number of blocks in the index.
+	size_t blocks() const;
+
+	/**
+	 * @param index Block index, less than blocks().
+	 * @return Index entry of the block.
+	 */
+	PcapIndex::block_t block(size_t index) const;
+
+	/**
+	 * Finds the regions which may hold packets with timestamps in a range.
+	 *
+	 * @param from Lowest timestamp in nanoseconds.
+	 * @param to Highest timestamp in nanoseconds.
+	 * @param regions Filled with the regions in file order.
+	 * @return Number of regions.
+	 */
+	size_t find(uint64_t from, uint64_t to, std::vector<region_t>* regions) const;
+
+	/**
+	 * Finds the regions which may hold packets of a flow with timestamps in a range. If the index has no bloom filters,
+	 * this is the same as find().
+	 *
+	 * @param flow_hash Hash of the flow with seed 0, see PacketFilter::flow_hash() and PacketFilter::tuple_hash().
+	 * @param from Lowest timestamp in nanoseconds.
+	 * @param to Highest timestamp in nanoseconds.
+	 * @param regions Filled with the regions in file order.
+	 * @return Number of regions.
+	 */
+	size_t find_flow(uint32_t flow_hash, uint64_t from, uint64_t to, std::vector<region_t>* regions) const;
+
+private:
+	/**
+	 * Collects the blocks in a time range, optionally of a flow.
+	 *
+	 * @param flow_hash Pointer to the flow hash, or nullptr for any flow.
+	 */
+	size_t collect(const uint32_t* flow_hash, uint64_t from, uint64_t to, std::vector<region_t>* regions) const;
+
+	/// File mapping, or nullptr
+	const char* data;
+
+	/// Size of the file
+	uint64_t file_size;
+
+	/// Size of each entry, block_t and bloom filter
+	uint64_t entry_size;
+
+	/// Number of complete entries
+	size_t block_count;
+
+	/// Header of the index file
+	PcapIndex::index_header_t index_header;
+};
+
+#endif
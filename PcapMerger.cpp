@@ -0,0 +1,103 @@
+#include "PcapMerger.h"
+
+#include <algorithm>
+
+constexpr size_t PcapMerger::MERGE_BATCH_PACKETS;
+
+bool PcapMerger::add_input(const std::string& path)
+{
+	std::unique_ptr<PcapReader> reader(new PcapReader());
+	if (!reader->open(path))
+		return false;
+
+	if (!inputs.empty() && inputs.front()->header().linktype != reader->header().linktype)
+		return false;
+
+	inputs.push_back(std::move(reader));
+	return true;
+}
+
+bool PcapMerger::later(const node_t& left, const node_t& right)
+{
+	if (left.record.ts_sec != right.record.ts_sec)
+		return left.record.ts_sec > right.record.ts_sec;
+	if (left.record.ts_nsec != right.record.ts_nsec)
+		return left.record.ts_nsec > right.record.ts_nsec;
+
+	return left.input > right.input;
+}
+
+void PcapMerger::set_deduplicator(PacketDeduplicator* deduplicator)
+{
+	writer.set_deduplicator(deduplicator);
+}
+
+long long int PcapMerger::merge(PcapSink* sink)
+{
+	if (inputs.empty())
+		return -1;
+
+	// Output keeps every record whole, so its snapshot length is the largest one of the inputs.
+	uint32_t snaplen = 0;
+	for (const std::unique_ptr<PcapReader>& input : inputs)
+		if (input->header().snaplen > snaplen)
+			snaplen = input->header().snaplen;
+	writer.set_snaplen(snaplen);
+
+	// Output has the finest resolution of the inputs.
+	PcapWriter::ts_resolution resolution = PcapWriter::ts_resolution::microseconds;
+	for (const std::unique_ptr<PcapReader>& input : inputs)
+		if (input->nanoseconds())
+			resolution = PcapWriter::ts_resolution::nanoseconds;
+
+	const int header_size = writer.write_pcap_header(sink, inputs.front()->header().linktype, resolution);
+	if (header_size < 0)
+		return -1;
+
+	long long int total_bytes = header_size;
+
+	// Heap of the current record of every input which is not exhausted.
+	std::vector<node_t> heap;
+	heap.reserve(inputs.size());
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		node_t node;
+		node.input = i;
+		if (inputs[i]->next(&node.record))
+			heap.push_back(node);
+	}
+	std::make_heap(heap.begin(), heap.end(), later);
+
+	std::vector<PcapWriter::packet_t> batch(MERGE_BATCH_PACKETS);
+	size_t count = 0;
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), later);
+		node_t& node = heap.back();
+
+		PcapWriter::packet_t& packet = batch[count++];
+		packet.frame = node.record.frame;
+		packet.frame_size = node.record.caplen;
+		packet.original_size = node.record.len;
+		packet.time.tv_sec = node.record.ts_sec;
+		packet.time.tv_usec = node.record.ts_nsec / 1000;
+		packet.time_nsec = node.record.ts_nsec % 1000;
+
+		if (inputs[node.input]->next(&node.record))
+			std::push_heap(heap.begin(), heap.end(), later);
+		else
+			heap.pop_back();
+
+		if (count == MERGE_BATCH_PACKETS || heap.empty())
+		{
+			const long int written = writer.write_packets(batch.data(), count);
+			if (written < 0)
+				return -1;
+
+			total_bytes += written;
+			count = 0;
+		}
+	}
+
+	return total_bytes;
+}
@@ -0,0 +1,76 @@
+#ifndef PCAP_MERGER_H_
+#define PCAP_MERGER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PcapReader.h"
+#include "PcapSink.h"
+#include "PcapWriter.h"
+
+/**
+ * This class merges pcap files (e.g. the shards of ShardedPcapWriter or the files of a rotation) into one file in
+ * timestamp order. Inputs are memory-mapped with PcapReader and merged with a binary heap keyed on (ts_sec, ts_nsec),
+ * so memory use does not depend on file sizes. Records with equal timestamps keep the order of their inputs. Frames
+ * are passed to PcapWriter::write_packets() as pointers into the input mappings, so payloads are copied only once,
+ * by the kernel into the output. Inputs may have microsecond or nanosecond timestamps; the output has nanosecond ones if
+ * any input has them, so that no timestamp is truncated, and microsecond ones otherwise.
+ */
+class PcapMerger
+{
+public:
+	/**
+	 * Opens an input file.
+	 *
+	 * @param path The input file path.
+	 * @return True if the input has been opened and has the same link type as the previous inputs; otherwise false.
+	 */
+	bool add_input(const std::string& path);
+
+	/**
+	 * Sets a deduplicator which removes packets seen by several inputs, e.g. captures of several SPAN ports (see
+	 * PcapWriter::set_deduplicator()). The deduplicator is not owned by the merger and must outlive it.
+	 *
+	 * @param deduplicator The deduplicator, or nullptr to write every packet.
+	 */
+	void set_deduplicator(PacketDeduplicator* deduplicator);
+
+	/**
+	 * Merges all inputs into the sink, writing the global header first. Inputs are consumed.
+	 *
+	 * @param sink The output sink.
+	 * @return Number of bytes written to the sink including global header, or -1 for failure.
+	 */
+	long long int merge(PcapSink* sink);
+
+private:
+	/// Maximum number of packets passed to one PcapWriter::write_packets() call
+	constexpr static size_t MERGE_BATCH_PACKETS = 512;
+
+	/// Heap node, the current record of an input
+	struct node_t
+	{
+		/// Current record of the input
+		PcapReader::record_t record;
+
+		/// Index of the input
+		size_t input;
+	};
+
+	/**
+	 * Orders heap nodes so that the earliest record is at the top of std::push_heap/std::pop_heap heaps.
+	 *
+	 * @return True if left shall be written after right.
+	 */
+	static bool later(const node_t& left, const node_t& right);
+
+	/// Input readers
+	std::vector<std::unique_ptr<PcapReader>> inputs;
+
+	/// Writer of the merged output
+	PcapWriter writer;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "PcapNgWriter.h"
+
+#include <cstring>
+
+constexpr uint32_t PcapNgWriter::SECTION_HEADER_BLOCK;
+constexpr uint32_t PcapNgWriter::INTERFACE_DESCRIPTION_BLOCK;
+constexpr uint32_t PcapNgWriter::INTERFACE_STATISTICS_BLOCK;
+constexpr uint32_t PcapNgWriter::ENHANCED_PACKET_BLOCK;
+constexpr uint32_t PcapNgWriter::BYTE_ORDER_MAGIC;
+constexpr size_t PcapNgWriter::MAX_BATCH_PACKETS;
+
+namespace
+{
+
+/// Option codes used by this writer
+enum : uint16_t
+{
+	OPT_ENDOFOPT = 0,
+	IF_NAME = 2,
+	IF_TSRESOL = 9,
+	ISB_IFRECV = 4,
+	ISB_IFDROP = 5
+};
+
+/**
+ * Appends a block option, padded to 32 bits, to a block being built.
+ *
+ * @param block Block being built.
+ * @param code Option code.
+ * @param value Option value.
+ * @param length Length of option value.
+ */
+void append_option(std::vector<char>* block, uint16_t code, const void* value, uint16_t length)
+{
+	const uint16_t option_header[2] = {code, length};
+	const char* header_bytes = reinterpret_cast<const char*>(option_header);
+	block->insert(block->end(), header_bytes, header_bytes + sizeof(option_header));
+
+	const char* value_bytes = reinterpret_cast<const char*>(value);
+	block->insert(block->end(), value_bytes, value_bytes + length);
+	block->resize((block->size() + 3) / 4 * 4, 0);
+}
+
+/**
+ * Appends a 32-bit value to a block being built.
+ *
+ * @param block Block being built.
+ * @param value The value.
+ */
+void append_word(std::vector<char>* block, uint32_t value)
+{
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	block->insert(block->end(), bytes, bytes + sizeof(value));
+}
+
+/**
+ * Finishes a block being built: appends end of options and the trailing block length, and fills the leading one.
+ *
+ * @param block Block being built, starting with block type and a placeholder block length.
+ */
+void finish_block(std::vector<char>* block)
+{
+	append_option(block, OPT_ENDOFOPT, nullptr, 0);
+	const uint32_t block_length = static_cast<uint32_t>(block->size() + sizeof(uint32_t));
+	append_word(block, block_length);
+	memcpy(block->data() + sizeof(uint32_t), &block_length, sizeof(block_length));
+}
+
+}
+
+PcapNgWriter::PcapNgWriter()
+: pcap_sink(nullptr)
+, batch_headers(MAX_BATCH_PACKETS)
+, batch_trailers(MAX_BATCH_PACKETS)
+, batch_vectors(MAX_BATCH_PACKETS * 3)
+{
+}
+
+int PcapNgWriter::write_section_header(PcapSink* sink)
+{
+	pcap_sink = sink;
+	interfaces.clear();
+
+	std::vector<char> block;
+	append_word(&block, SECTION_HEADER_BLOCK);
+	append_word(&block, 0);		// Block length, filled by finish_block().
+	append_word(&block, BYTE_ORDER_MAGIC);
+	append_word(&block, 1);		// Major version 1, minor version 0.
+	append_word(&block, 0xffffffff);		// Section length -1 (unknown), 64 bits.
+	append_word(&block, 0xffffffff);
+	finish_block(&block);
+
+	if (!pcap_sink || !pcap_sink->write(block.data(), block.size()))
+	{
+		pcap_sink = nullptr;
+		return -1;
+	}
+
+	return static_cast<int>(block.size());
+}
+
+int PcapNgWriter::add_interface(uint16_t link_type, ts_resolution resolution, const std::string& name,
+	uint32_t snaplen)
+{
+	if (!pcap_sink)
+		return -1;
+
+	std::vector<char> block;
+	append_word(&block, INTERFACE_DESCRIPTION_BLOCK);
+	append_word(&block, 0);		// Block length, filled by finish_block().
+	append_word(&block, link_type);		// Link type (16 bits) and reserved (16 bits).
+	append_word(&block, snaplen);
+
+	if (!name.empty())
+		append_option(&block, IF_NAME, name.data(), static_cast<uint16_t>(name.size()));
+
+	if (resolution == ts_resolution::nanoseconds)
+	{
+		const uint8_t tsresol = 9;		// 10^-9 seconds.
+		append_option(&block, IF_TSRESOL, &tsresol, sizeof(tsresol));
+	}
+
+	finish_block(&block);
+
+	if (!pcap_sink->write(block.data(), block.size()))
+		return -1;
+
+	interface_t interface;
+	interface.nanoseconds = resolution == ts_resolution::nanoseconds;
+	interface.snaplen = snaplen;
+	interfaces.push_back(interface);
+	return static_cast<int>(interfaces.size() - 1);
+}
+
+uint64_t PcapNgWriter::timestamp_units(uint32_t interface_id, uint64_t seconds, uint64_t nanoseconds) const
+{
+	if (interfaces[interface_id].nanoseconds)
+		return seconds * 1000000000 + nanoseconds;
+
+	return seconds * 1000000 + nanoseconds / 1000;
+}
+
+uint32_t PcapNgWriter::fill_packet_block(uint32_t interface_id, const char* frame, uint32_t frame_size,
+	uint32_t original_size, uint64_t timestamp, epb_header_t* header, epb_trailer_t* trailer, iovec* vector)
+{
+	const uint32_t snaplen = interfaces[interface_id].snaplen;
+	if (snaplen > 0 && frame_size > snaplen)
+		frame_size = snaplen;
+
+	const uint32_t padding = (4 - frame_size % 4) % 4;
+	const uint32_t block_length = static_cast<uint32_t>(sizeof(epb_header_t) + frame_size + padding
+		+ sizeof(uint32_t));
+
+	header->block_type = ENHANCED_PACKET_BLOCK;
+	header->block_length = block_length;
+	header->interface_id = interface_id;
+	header->ts_high = static_cast<uint32_t>(timestamp >> 32);
+	header->ts_low = static_cast<uint32_t>(timestamp);
+	header->caplen = frame_size;
+	header->len = original_size;
+
+	memset(trailer->padding, 0, sizeof(trailer->padding));
+	trailer->block_length = block_length;
+
+	vector[0].iov_base = header;
+	vector[0].iov_len = sizeof(epb_header_t);
+	vector[1].iov_base = const_cast<char*>(frame);
+	vector[1].iov_len = frame_size;
+	vector[2].iov_base = trailer->padding + sizeof(trailer->padding) - padding;
+	vector[2].iov_len = padding + sizeof(uint32_t);
+
+	return block_length;
+}
+
+int PcapNgWriter::write_packet(uint32_t interface_id, const char* frame, uint32_t frame_size, timeval time)
+{
+	if (!pcap_sink || interface_id >= interfaces.size())
+		return -1;
+
+	epb_header_t header;
+	epb_trailer_t trailer;
+	iovec vector[3];
+	const uint32_t block_length = fill_packet_block(interface_id, frame, frame_size, frame_size,
+		timestamp_units(interface_id, static_cast<uint64_t>(time.tv_sec), static_cast<uint64_t>(time.tv_usec) * 1000),
+		&header, &trailer, vector);
+
+	if (!pcap_sink->write_vector(vector, 3))
+		return -1;
+
+	return static_cast<int>(block_length);
+}
+
+int PcapNgWriter::write_packet(uint32_t interface_id, const char* frame, uint32_t frame_size, timespec time)
+{
+	if (!pcap_sink || interface_id >= interfaces.size())
+		return -1;
+
+	epb_header_t header;
+	epb_trailer_t trailer;
+	iovec vector[3];
+	const uint32_t block_length = fill_packet_block(interface_id, frame, frame_size, frame_size,
+		timestamp_units(interface_id, static_cast<uint64_t>(time.tv_sec), static_cast<uint64_t>(time.tv_nsec)),
+		&header, &trailer, vector);
+
+	if (!pcap_sink->write_vector(vector, 3))
+		return -1;
+
+	return static_cast<int>(block_length);
+}
+
+long int PcapNgWriter::write_packets(uint32_t interface_id, const PcapWriter::packet_t* packets, size_t count)
+{
+	if (!pcap_sink || interface_id >= interfaces.size())
+		return -1;
+
+	long int total_bytes = 0;
+	while (count > 0)
+	{
+		const size_t batch_size = count < MAX_BATCH_PACKETS ? count : MAX_BATCH_PACKETS;
+
+		for (size_t i = 0; i < batch_size; ++i)
+		{
+			const PcapWriter::packet_t& packet = packets[i];
+			total_bytes += fill_packet_block(interface_id, packet.frame, packet.frame_size,
+				packet.original_size > packet.frame_size ? packet.original_size : packet.frame_size,
+				timestamp_units(interface_id, static_cast<uint64_t>(packet.time.tv_sec),
+					static_cast<uint64_t>(packet.time.tv_usec) * 1000 + packet.time_nsec),
+				&batch_headers[i], &batch_trailers[i], &batch_vectors[i * 3]);
+		}
+
+		if (!pcap_sink->write_vector(batch_vectors.data(), static_cast<int>(batch_size * 3)))
+			return -1;
+
+		packets += batch_size;
+		count -= batch_size;
+	}
+
+	return total_bytes;
+}
+
+int PcapNgWriter::write_statistics(uint32_t interface_id, timeval time, uint64_t received, uint64_t dropped)
+{
+	if (!pcap_sink || interface_id >= interfaces.size())
+		return -1;
+
+	const uint64_t timestamp = timestamp_units(interface_id, static_cast<uint64_t>(time.tv_sec),
+		static_cast<uint64_t>(time.tv_usec) * 1000);
+
+	std::vector<char> block;
+	append_word(&block, INTERFACE_STATISTICS_BLOCK);
+	append_word(&block, 0);		// Block length, filled by finish_block().
+	append_word(&block, interface_id);
+	append_word(&block, static_cast<uint32_t>(timestamp >> 32));
+	append_word(&block, static_cast<uint32_t>(timestamp));
+	append_option(&block, ISB_IFRECV, &received, sizeof(received));
+	append_option(&block, ISB_IFDROP, &dropped, sizeof(dropped));
+	finish_block(&block);
+
+	if (!pcap_sink->write(block.data(), block.size()))
+		return -1;
+
+	return static_cast<int>(block.size());
+}
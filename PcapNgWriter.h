@@ -0,0 +1,199 @@
+#ifndef PCAP_NG_WRITER_H_
+#define PCAP_NG_WRITER_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include "PcapSink.h"
+#include "PcapWriter.h"
+
+/**
+ * This class writes pcapng files: a Section Header Block, one Interface Description Block per capture interface,
+ * Enhanced Packet Blocks for packets and Interface Statistics Blocks. Several interfaces (with different link types
+ * and timestamp resolutions) can share one file. Interfaces may declare nanosecond resolution with the if_tsresol
+ * option.
+ *
+ * Enhanced Packet Block headers and trailers are built in scratch areas allocated once, and frames are written
+ * straight from the caller's memory with PcapSink::write_vector(), so writing packets allocates nothing.
+ *
+ * For more information about pcapng file format see "https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng".
+ */
+class PcapNgWriter
+{
+public:
+	/// Timestamp resolution of an interface, microseconds (if_tsresol = 6, the default) or nanoseconds (9)
+	typedef PcapWriter::ts_resolution ts_resolution;
+
+	PcapNgWriter();
+
+	/**
+	 * Writes Section Header Block to the beginning of the given sink. You must use this function before adding any
+	 * interface. Interfaces of a previous section are forgotten.
+	 *
+	 * @param sink The output sink.
+	 * @return -1 for failure or number of bytes has been written to the file for success.
+	 */
+	int write_section_header(PcapSink* sink);
+
+	/**
+	 * Writes Interface Description Block of a new capture interface.
+	 *
+	 * @param link_type Data link layer type (1 = Ethernet).
+	 * @param resolution Timestamp resolution of packets of this interface.
+	 * @param name Interface name (if_name option), or empty for none.
+	 * @param snaplen Maximum number of bytes written from each packet, or 0 for no limit.
+	 * @return Interface id used by write_packet(), or -1 for failure.
+	 */
+	int add_interface(uint16_t link_type, ts_resolution resolution = ts_resolution::microseconds,
+		const std::string& name = std::string(), uint32_t snaplen = 0);
+
+	/**
+	 * Writes Enhanced Packet Block of a packet.
+	 *
+	 * @param interface_id Interface id returned by add_interface().
+	 * @param frame Packet data shall to be written in pcapng file.
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 * @return Number of bytes written to the file, or -1 for failure.
+	 */
+	int write_packet(uint32_t interface_id, const char* frame, uint32_t frame_size, timeval time);
+
+	/**
+	 * Writes Enhanced Packet Block of a packet with a nanosecond timestamp. The timestamp is reduced to microseconds
+	 * for interfaces with microsecond resolution.
+	 *
+	 * @param interface_id Interface id returned by add_interface().
+	 * @param frame Packet data shall to be written in pcapng file.
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 * @return Number of bytes written to the file, or -1 for failure.
+	 */
+	int write_packet(uint32_t interface_id, const char* frame, uint32_t frame_size, timespec time);
+
+	/**
+	 * Writes Enhanced Packet Blocks of a batch of packets captured on one interface, with one vectored write per
+	 * MAX_BATCH_PACKETS packets. The original length and the time_nsec of each packet are kept (see
+	 * PcapWriter::packet_t); VLAN tags are not inserted.
+	 *
+	 * @param interface_id Interface id returned by add_interface().
+	 * @param packets Array of packets to be written in pcapng file.
+	 * @param count Number of packets in the array.
+	 * @return Number of bytes written to the file, or -1 for failure.
+	 */
+	long int write_packets(uint32_t interface_id, const PcapWriter::packet_t* packets, size_t count);
+
+	/**
+	 * Writes Interface Statistics Block of an interface.
+	 *
+	 * @param interface_id Interface id returned by add_interface().
+	 * @param time Time the statistics refer to.
+	 * @param received Number of packets received by the interface (isb_ifrecv).
+	 * @param dropped Number of packets dropped by the interface (isb_ifdrop).
+	 * @return Number of bytes written to the file, or -1 for failure.
+	 */
+	int write_statistics(uint32_t interface_id, timeval time, uint64_t received, uint64_t dropped);
+
+private:
+	/// Block type of Section Header Block
+	constexpr static uint32_t SECTION_HEADER_BLOCK = 0x0a0d0d0a;
+
+	/// Block type of Interface Description Block
+	constexpr static uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+
+	/// Block type of Interface Statistics Block
+	constexpr static uint32_t INTERFACE_STATISTICS_BLOCK = 0x00000005;
+
+	/// Block type of Enhanced Packet Block
+	constexpr static uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+
+	/// Byte-order magic, the reading application detects swapped files by it
+	constexpr static uint32_t BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+	/// Maximum number of packets of one vectored write, 3 I/O vectors per packet within IOV_MAX (1024)
+	constexpr static size_t MAX_BATCH_PACKETS = 341;
+
+	/// Enhanced Packet Block fields before packet data
+	struct epb_header_t
+	{
+		/// Block type, ENHANCED_PACKET_BLOCK
+		uint32_t block_type;
+
+		/// Total block length, including header, padded data and trailer
+		uint32_t block_length;
+
+		/// Interface id
+		uint32_t interface_id;
+
+		/// Upper 32 bits of timestamp
+		uint32_t ts_high;
+
+		/// Lower 32 bits of timestamp
+		uint32_t ts_low;
+
+		/// Number of packet bytes saved in file
+		uint32_t caplen;
+
+		/// Actual length of packet
+		uint32_t len;
+	} __attribute__((packed));
+
+	/// Padding of packet data to 32 bits followed by repeated block length
+	struct epb_trailer_t
+	{
+		/// Zero padding, only the first (4 - caplen % 4) % 4 bytes are written
+		uint8_t padding[4];
+
+		/// Total block length, repeated
+		uint32_t block_length;
+	} __attribute__((packed));
+
+	/// Capture interface of the current section
+	struct interface_t
+	{
+		/// True for nanosecond timestamps
+		bool nanoseconds;
+
+		/// Maximum number of bytes written from each packet, 0 for no limit
+		uint32_t snaplen;
+	};
+
+	/**
+	 * Fills Enhanced Packet Block header and trailer of a packet, and the three I/O vectors which write it. The frame
+	 * is truncated to the snaplen of the interface, the original length is kept in the header.
+	 *
+	 * @return Total block length.
+	 */
+	uint32_t fill_packet_block(uint32_t interface_id, const char* frame, uint32_t frame_size, uint32_t original_size,
+		uint64_t timestamp, epb_header_t* header, epb_trailer_t* trailer, iovec* vector);
+
+	/**
+	 * Converts a timestamp to the units of an interface.
+	 *
+	 * @param interface_id Interface id, which must be valid.
+	 * @param seconds Timestamp seconds.
+	 * @param nanoseconds Timestamp nanoseconds.
+	 */
+	uint64_t timestamp_units(uint32_t interface_id, uint64_t seconds, uint64_t nanoseconds) const;
+
+	/// Output sink for this pcapng writer
+	PcapSink* pcap_sink;
+
+	/// Interfaces of the current section
+	std::vector<interface_t> interfaces;
+
+	/// Scratch area for block headers of a batch, reused between write_packets() calls
+	std::vector<epb_header_t> batch_headers;
+
+	/// Scratch area for block trailers of a batch, reused between write_packets() calls
+	std::vector<epb_trailer_t> batch_trailers;
+
+	/// Scratch area for I/O vectors of a batch, reused between write_packets() calls
+	std::vector<iovec> batch_vectors;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "PcapReader.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint32_t PcapReader::TCPDUMP_MAGIC;
+constexpr uint32_t PcapReader::NSEC_TCPDUMP_MAGIC;
+constexpr uint64_t PcapReader::READAHEAD_WINDOW;
+
+PcapReader::PcapReader()
+: data(nullptr)
+, size(0)
+, position(0)
+, nanosecond_timestamps(false)
+, swapped_bytes(false)
+, readahead_end(0)
+{
+	memset(&file_header, 0, sizeof(file_header));
+}
+
+PcapReader::~PcapReader()
+{
+	close();
+}
+
+bool PcapReader::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(pcap_file_header))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data = static_cast<const char*>(mapping);
+	size = static_cast<uint64_t>(file_stat.st_size);
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	memcpy(&file_header, data, sizeof(file_header));
+	const uint32_t magic = file_header.magic;
+	swapped_bytes = magic == __builtin_bswap32(TCPDUMP_MAGIC) || magic == __builtin_bswap32(NSEC_TCPDUMP_MAGIC);
+	if (swapped_bytes)
+	{
+		file_header.magic = __builtin_bswap32(file_header.magic);
+		file_header.version_major = __builtin_bswap16(file_header.version_major);
+		file_header.version_minor = __builtin_bswap16(file_header.version_minor);
+		file_header.thiszone = static_cast<int32_t>(__builtin_bswap32(static_cast<uint32_t>(file_header.thiszone)));
+		file_header.sigfigs = __builtin_bswap32(file_header.sigfigs);
+		file_header.snaplen = __builtin_bswap32(file_header.snaplen);
+		file_header.linktype = __builtin_bswap32(file_header.linktype);
+	}
+
+	if (file_header.magic != TCPDUMP_MAGIC && file_header.magic != NSEC_TCPDUMP_MAGIC)
+	{
+		close();
+		return false;
+	}
+
+	nanosecond_timestamps = file_header.magic == NSEC_TCPDUMP_MAGIC;
+	position = sizeof(file_header);
+	readahead_end = 0;
+	return true;
+}
+
+void PcapReader::close()
+{
+	if (data)
+		munmap(const_cast<char*>(data), size);
+
+	data = nullptr;
+	size = 0;
+	position = 0;
+	readahead_end = 0;
+}
+
+bool PcapReader::read_header(uint64_t offset, pcaprec_hdr_t* record_header) const
+{
+	if (size - offset < sizeof(pcaprec_hdr_t))
+		return false;
+
+	memcpy(record_header, data + offset, sizeof(*record_header));
+	if (swapped_bytes)
+	{
+		record_header->ts_sec = __builtin_bswap32(record_header->ts_sec);
+		record_header->ts_usec = __builtin_bswap32(record_header->ts_usec);
+		record_header->caplen = __builtin_bswap32(record_header->caplen);
+		record_header->len = __builtin_bswap32(record_header->len);
+	}
+
+	return size - offset - sizeof(*record_header) >= record_header->caplen;
+}
+
+bool PcapReader::next(record_t* record)
+{
+	pcaprec_hdr_t record_header;
+	if (!data || !read_header(position, &record_header))
+		return false;
+
+	// Asks for the next window once the current one is half consumed, so the kernel reads while records are used.
+	if (position + READAHEAD_WINDOW / 2 > readahead_end && readahead_end < size)
+	{
+		const uint64_t start = readahead_end > position ? readahead_end : position & ~(READAHEAD_WINDOW - 1);
+		const uint64_t length = size - start < READAHEAD_WINDOW ? size - start : READAHEAD_WINDOW;
+		madvise(const_cast<char*>(data) + start, length, MADV_WILLNEED);
+		readahead_end = start + length;
+	}
+
+	record->ts_sec = record_header.ts_sec;
+	if (nanosecond_timestamps)
+	{
+		record->ts_nsec = record_header.ts_usec;
+		record->ts_usec = record_header.ts_usec / 1000;
+	}
+	else
+	{
+		record->ts_nsec = record_header.ts_usec * 1000;
+		record->ts_usec = record_header.ts_usec;
+	}
+	record->caplen = record_header.caplen;
+	record->len = record_header.len;
+	record->frame = data + position + sizeof(record_header);
+
+	position += sizeof(record_header) + record_header.caplen;
+
+	// The next record header is usually in the cache line after the frame; it is fetched while the frame is used.
+	__builtin_prefetch(data + position);
+	return true;
+}
+
+bool PcapReader::scan(summary_t* summary) const
+{
+	if (!data)
+		return false;
+
+	memset(summary, 0, sizeof(*summary));
+	const uint64_t fraction_scale = nanosecond_timestamps ? 1 : 1000;
+
+	uint64_t offset = sizeof(file_header);
+	pcaprec_hdr_t record_header;
+	while (read_header(offset, &record_header))
+	{
+		const uint64_t timestamp = record_header.ts_sec * 1000000000ull + record_header.ts_usec * fraction_scale;
+		if (summary->packets == 0)
+			summary->first_timestamp = timestamp;
+		summary->last_timestamp = timestamp;
+
+		++summary->packets;
+		summary->captured_bytes += record_header.caplen;
+		summary->original_bytes += record_header.len;
+		offset += sizeof(record_header) + record_header.caplen;
+	}
+
+	summary->truncated = offset != size;
+	return true;
+}
+
+const pcap_file_header& PcapReader::header() const
+{
+	return file_header;
+}
+
+bool PcapReader::nanoseconds() const
+{
+	return nanosecond_timestamps;
+}
+
+bool PcapReader::swapped() const
+{
+	return swapped_bytes;
+}
+
+bool PcapReader::truncated() const
+{
+	return data && position != size;
+}
+
+uint64_t PcapReader::offset() const
+{
+	return position;
+}
+
+bool PcapReader::seek(uint64_t offset)
+{
+	if (!data || offset < sizeof(file_header) || offset > size)
+		return false;
+
+	position = offset;
+	return true;
+}
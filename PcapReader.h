@@ -0,0 +1,183 @@
+#ifndef PCAP_READER_H_
+#define PCAP_READER_H_
+
+#include <cstdint>
+#include <string>
+
+#include <pcap.h>
+
+/**
+ * This class reads pcap files written by PcapWriter (or any libpcap compatible writer) through a read-only memory
+ * mapping of the whole file. Records are returned as pointers into the mapping, so frames are never copied by the
+ * reader and stay valid until the reader is closed.
+ *
+ * Files with microsecond (0xA1B2C3D4) or nanosecond (0xA1B23C4D) timestamps are read, in either byte order; headers
+ * of files written on a host of the other byte order are swapped. While records are read in order, the kernel is asked
+ * to read the next READAHEAD_WINDOW bytes of the file ahead of time, so page faults rarely wait for the disk. scan()
+ * walks record headers only, to count packets and bytes without reading payloads.
+ *
+ * Both walks are scalar: the offset of a record header depends on the caplen of the header before it, so headers
+ * cannot be located several at a time with SIMD instructions. next() prefetches the following header instead, and
+ * the readahead keeps page faults off that serial chain.
+ */
+class PcapReader
+{
+public:
+	/// A record of the pcap file
+	struct record_t
+	{
+		/// Timestamp seconds
+		uint32_t ts_sec;
+
+		/// Timestamp microseconds, nanoseconds reduced to microseconds
+		uint32_t ts_usec;
+
+		/// Timestamp nanoseconds, at the full resolution of the file
+		uint32_t ts_nsec;
+
+		/// Number of packet bytes saved in file
+		uint32_t caplen;
+
+		/// Actual length of packet
+		uint32_t len;
+
+		/// Packet data, points into the file mapping
+		const char* frame;
+	};
+
+	/// Summary of a file computed by scan()
+	struct summary_t
+	{
+		/// Number of records
+		uint64_t packets;
+
+		/// Sum of the saved lengths of records
+		uint64_t captured_bytes;
+
+		/// Sum of the actual lengths of packets
+		uint64_t original_bytes;
+
+		/// Timestamp of the first record in nanoseconds
+		uint64_t first_timestamp;
+
+		/// Timestamp of the last record in nanoseconds
+		uint64_t last_timestamp;
+
+		/// True if the file ends with a truncated record
+		bool truncated;
+	};
+
+	PcapReader();
+
+	~PcapReader();
+
+	PcapReader(const PcapReader&) = delete;
+	PcapReader& operator=(const PcapReader&) = delete;
+
+	/**
+	 * Maps the pcap file and validates its global header. The header returned by header() is in host byte order.
+	 *
+	 * @param path The input file path.
+	 * @return True if the file has been mapped and has a valid global header; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// Unmaps the file. Records returned before become invalid.
+	void close();
+
+	/**
+	 * Reads the next record.
+	 *
+	 * @param record Filled with the next record.
+	 * @return True if a record has been read; false at the end of file or if the last record is truncated.
+	 */
+	bool next(record_t* record);
+
+	/**
+	 * Walks the headers of every record, from the first one to the end of file, without reading any payload. Pages
+	 * holding only payload bytes (of records larger than a page) are not touched. The position of next() is kept.
+	 *
+	 * @param summary Filled with the number of records, their sizes and the first and last timestamps.
+	 * @return True if the file is open; otherwise false.
+	 */
+	bool scan(summary_t* summary) const;
+
+	/// @return Global header of the file.
+	const pcap_file_header& header() const;
+
+	/// @return True if record timestamps have nanosecond resolution.
+	bool nanoseconds() const;
+
+	/// @return True if the file has been written in the other byte order.
+	bool swapped() const;
+
+	/// @return True if the file ends with a truncated record; valid once next() has returned false.
+	bool truncated() const;
+
+	/// @return File offset of the next record.
+	uint64_t offset() const;
+
+	/**
+	 * Moves to a record, e.g. the first record of a region found by PcapIndexReader.
+	 *
+	 * @param offset File offset of a record header, at or after the global header.
+	 * @return True for success, false if the offset is outside of the file.
+	 */
+	bool seek(uint64_t offset);
+
+private:
+	/// Magic number of pcap files with microsecond timestamps in native byte order
+	constexpr static uint32_t TCPDUMP_MAGIC = 0xa1b2c3d4;
+
+	/// Magic number of pcap files with nanosecond timestamps in native byte order
+	constexpr static uint32_t NSEC_TCPDUMP_MAGIC = 0xa1b23c4d;
+
+	/// Number of bytes the kernel is asked to read ahead of the current record, a multiple of the page size
+	constexpr static uint64_t READAHEAD_WINDOW = 16 * 1024 * 1024;
+
+	/// Pcap recorded packet header, as stored in the file
+	struct pcaprec_hdr_t
+	{
+		/// Timestamp seconds
+		uint32_t ts_sec;
+
+		/// Timestamp microseconds or nanoseconds, depending on the magic number
+		uint32_t ts_usec;
+
+		/// Number of packet bytes saved in file
+		uint32_t caplen;
+
+		/// Actual length of packet
+		uint32_t len;
+	} __attribute__((packed));
+
+	/**
+	 * Reads a record header at a file offset, swapping its fields if needed.
+	 *
+	 * @return True if the whole record is within the file.
+	 */
+	bool read_header(uint64_t offset, pcaprec_hdr_t* record_header) const;
+
+	/// File mapping, or nullptr
+	const char* data;
+
+	/// Size of the file
+	uint64_t size;
+
+	/// File offset of the next record
+	uint64_t position;
+
+	/// Global header of the file, in host byte order
+	pcap_file_header file_header;
+
+	/// True if record timestamps have nanosecond resolution
+	bool nanosecond_timestamps;
+
+	/// True if the file has been written in the other byte order
+	bool swapped_bytes;
+
+	/// File offset up to which the kernel has been asked to read ahead
+	uint64_t readahead_end;
+};
+
+#endif
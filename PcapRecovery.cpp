@@ -0,0 +1,112 @@
+#include "PcapRecovery.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PcapReader.h"
+
+namespace
+{
+
+/**
+ * Finds where the zero bytes at the end of a file begin.
+ *
+ * @param path The file path.
+ * @param size Size of the file.
+ * @return Offset of the first byte of the trailing run of zeros, or size if the file does not end with zero.
+ */
+uint64_t zero_tail(const std::string& path, uint64_t size)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return size;
+
+	char buffer[65536];
+	uint64_t end = size;
+	while (end > 0)
+	{
+		const uint64_t start = end > sizeof(buffer) ? end - sizeof(buffer) : 0;
+		if (pread(fd, buffer, end - start, static_cast<off_t>(start)) != static_cast<ssize_t>(end - start))
+			break;
+
+		uint64_t zero_start = end;
+		while (zero_start > start && buffer[zero_start - start - 1] == 0)
+			--zero_start;
+
+		if (zero_start > start)
+		{
+			end = zero_start;
+			break;
+		}
+		end = start;
+	}
+
+	close(fd);
+	return end;
+}
+
+}
+
+constexpr uint32_t PcapRecovery::MAX_SNAPLEN;
+
+bool PcapRecovery::inspect(const std::string& path, report_t* report)
+{
+	report->packets = 0;
+	report->valid_size = 0;
+	report->file_size = 0;
+
+	struct stat file_stat;
+	if (stat(path.c_str(), &file_stat) != 0)
+		return false;
+	report->file_size = static_cast<uint64_t>(file_stat.st_size);
+
+	PcapReader reader;
+	if (!reader.open(path))
+		return false;
+
+	const uint32_t snaplen = reader.header().snaplen;
+	const uint32_t max_caplen = snaplen > MAX_SNAPLEN ? snaplen : MAX_SNAPLEN;
+
+	// next() stops at a record which is not complete; the others are checked for plausibility.
+	report->valid_size = reader.offset();
+	uint64_t previous_size = report->valid_size;
+	PcapReader::record_t record;
+	while (reader.next(&record))
+	{
+		if (record.len == 0 || record.caplen > record.len || record.caplen > max_caplen)
+			break;
+
+		++report->packets;
+		previous_size = report->valid_size;
+		report->valid_size = reader.offset();
+	}
+
+	// A torn file which ends with zeros has had blocks allocated but never written. The last record may run into
+	// them, its frame completed with zeros, so it is dropped too.
+	if (report->valid_size < report->file_size && report->packets > 0
+		&& report->valid_size > zero_tail(path, report->file_size))
+	{
+		--report->packets;
+		report->valid_size = previous_size;
+	}
+
+	return true;
+}
+
+bool PcapRecovery::repair(const std::string& path, report_t* report)
+{
+	if (!inspect(path, report))
+		return false;
+
+	if (report->valid_size == report->file_size)
+		return true;
+
+	const int fd = open(path.c_str(), O_WRONLY);
+	if (fd < 0)
+		return false;
+
+	bool result = ftruncate(fd, static_cast<off_t>(report->valid_size)) == 0;
+	result = fsync(fd) == 0 && result;
+	return close(fd) == 0 && result;
+}
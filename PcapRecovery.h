@@ -0,0 +1,60 @@
+#ifndef PCAP_RECOVERY_H_
+#define PCAP_RECOVERY_H_
+
+#include <cstdint>
+#include <string>
+
+/**
+ * This class makes a pcap file valid again after the writing process or the machine has died. Such a file may end with
+ * a torn record: a record header or frame only partly written, or, after a crash of the machine, blocks allocated to
+ * the file but never written, which read back as zeros. Records are walked from the first one; the file is valid up to
+ * the end of the last plausible record, and anything after it is truncated.
+ *
+ * A record is plausible if it is complete, its original length is not zero, and its saved length is not greater than
+ * its original length nor than the larger of the file snapshot length and MAX_SNAPLEN. If the file is torn and ends
+ * with zeros, a last record which runs into them is dropped too, since its frame may have been completed with zeros.
+ *
+ * Usage:
+ *	PcapRecovery::report_t report;
+ *	if (PcapRecovery::repair("capture.pcap", &report))
+ *		printf("%llu bytes removed\n", report.file_size - report.valid_size);
+ */
+class PcapRecovery
+{
+public:
+	/// Largest saved length of a record accepted whatever the snapshot length, as in libpcap
+	constexpr static uint32_t MAX_SNAPLEN = 262144;
+
+	/// State of a file found by inspect()
+	struct report_t
+	{
+		/// Number of plausible records
+		uint64_t packets;
+
+		/// Size of the file up to the end of the last plausible record, global header included
+		uint64_t valid_size;
+
+		/// Size of the file
+		uint64_t file_size;
+	};
+
+	/**
+	 * Walks the records of a file, without changing it.
+	 *
+	 * @param path The file path.
+	 * @param report Filled with the number of plausible records and the valid size of the file.
+	 * @return True if the file has been read; false if it cannot be opened or has no valid global header.
+	 */
+	static bool inspect(const std::string& path, report_t* report);
+
+	/**
+	 * Truncates a file after its last plausible record, and syncs it.
+	 *
+	 * @param path The file path.
+	 * @param report Filled as by inspect(), before the file is truncated.
+	 * @return True if the file is valid, whether it had to be truncated or not; otherwise false.
+	 */
+	static bool repair(const std::string& path, report_t* report);
+};
+
+#endif
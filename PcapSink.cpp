@@ -0,0 +1,34 @@
+#include "PcapSink.h"
+
+PcapSink::PcapSink()
+: sink_stats(nullptr)
+{
+}
+
+PcapSink::~PcapSink()
+{
+}
+
+bool PcapSink::write_vector(iovec* vector, int count)
+{
+	for (int i = 0; i < count; ++i)
+		if (!write(vector[i].iov_base, vector[i].iov_len))
+			return false;
+
+	return true;
+}
+
+bool PcapSink::flush()
+{
+	return true;
+}
+
+bool PcapSink::close()
+{
+	return flush();
+}
+
+void PcapSink::set_stats(WriterStats* stats)
+{
+	sink_stats = stats;
+}
@@ -0,0 +1,69 @@
+#ifndef PCAP_SINK_H_
+#define PCAP_SINK_H_
+
+#include <cstddef>
+
+#include <sys/uio.h>
+
+#include "WriterStats.h"
+
+/**
+ * This class is the output backend interface of PcapWriter. A sink receives the global header and record bytes in file
+ * order and is responsible for getting them to storage. Backends decide how bytes are buffered and which system calls
+ * are used, so PcapWriter does not depend on std::fstream or any specific file API.
+ *
+ * Backends which issue system calls count them, and their retries, in the writer statistics set by set_stats().
+ */
+class PcapSink
+{
+public:
+	PcapSink();
+
+	virtual ~PcapSink();
+
+	/**
+	 * Writes all the buffer contents to the output.
+	 *
+	 * @param buffer Content of the buffer.
+	 * @param count Number of bytes that you want to be written.
+	 * @return True for success and false for failure to write.
+	 */
+	virtual bool write(const void* buffer, size_t count) = 0;
+
+	/**
+	 * Writes all the I/O vectors contents to the output. The default implementation writes each vector in turn.
+	 *
+	 * @param vector Array of I/O vectors; backends may modify it while resuming short writes.
+	 * @param count Number of I/O vectors in the array.
+	 * @return True for success and false for failure to write.
+	 */
+	virtual bool write_vector(iovec* vector, int count);
+
+	/**
+	 * Pushes buffered bytes to the operating system. The default implementation has nothing to flush.
+	 *
+	 * @return True for success and false for failure to write.
+	 */
+	virtual bool flush();
+
+	/**
+	 * Flushes buffered bytes and releases the output. The default implementation only flushes.
+	 *
+	 * @return True for success and false for failure to write.
+	 */
+	virtual bool close();
+
+	/**
+	 * Sets the statistics which system calls of this sink are counted in (see WriterStats). PcapWriter sets its own
+	 * statistics on its sink. The statistics are not owned by the sink and must outlive it.
+	 *
+	 * @param stats The statistics, or nullptr not to count.
+	 */
+	virtual void set_stats(WriterStats* stats);
+
+protected:
+	/// Statistics of this sink, or nullptr
+	WriterStats* sink_stats;
+};
+
+#endif
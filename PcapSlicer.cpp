@@ -0,0 +1,314 @@
+#include "PcapSlicer.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr uint64_t PcapSlicer::MIN_KERNEL_COPY;
+constexpr size_t PcapSlicer::BUFFER_SIZE;
+
+PcapSlicer::PcapSlicer()
+: input_fd(-1)
+, time_from(0)
+, time_to(UINT64_MAX)
+, index(nullptr)
+, packet_filter(nullptr)
+, snapshot_length(0)
+, time_shift(0)
+, run_begin(0)
+, run_end(0)
+, run_data(nullptr)
+, use_copy_file_range(true)
+{
+	pipe_fds[0] = -1;
+	pipe_fds[1] = -1;
+	memset(&counters, 0, sizeof(counters));
+}
+
+PcapSlicer::~PcapSlicer()
+{
+	close();
+}
+
+bool PcapSlicer::open(const std::string& path)
+{
+	close();
+
+	if (!reader.open(path))
+		return false;
+
+	input_fd = ::open(path.c_str(), O_RDONLY);
+	if (input_fd < 0)
+	{
+		reader.close();
+		return false;
+	}
+
+	return true;
+}
+
+void PcapSlicer::close()
+{
+	reader.close();
+	if (input_fd >= 0)
+		::close(input_fd);
+	input_fd = -1;
+
+	for (int& fd : pipe_fds)
+	{
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+	}
+}
+
+void PcapSlicer::set_time_range(uint64_t from, uint64_t to)
+{
+	time_from = from;
+	time_to = to;
+}
+
+void PcapSlicer::set_index(const PcapIndexReader* index)
+{
+	this->index = index;
+}
+
+void PcapSlicer::set_filter(PacketFilter* filter)
+{
+	packet_filter = filter;
+}
+
+void PcapSlicer::set_snaplen(uint32_t snaplen)
+{
+	snapshot_length = snaplen;
+}
+
+void PcapSlicer::set_time_shift(int64_t shift)
+{
+	time_shift = shift;
+}
+
+long long int PcapSlicer::slice(const std::string& path)
+{
+	if (input_fd < 0 || !output.open(path))
+		return -1;
+
+	memset(&counters, 0, sizeof(counters));
+	buffer.clear();
+	buffer.reserve(BUFFER_SIZE);
+	run_begin = 0;
+	run_end = 0;
+	run_data = nullptr;
+	use_copy_file_range = true;
+
+	const pcap_file_header& input_header = reader.header();
+	PcapWriter writer;
+	writer.set_snaplen(snapshot_length > 0 ? snapshot_length : input_header.snaplen);
+	const int header_size = writer.write_pcap_header(&output, input_header.linktype,
+		reader.nanoseconds() ? PcapWriter::ts_resolution::nanoseconds : PcapWriter::ts_resolution::microseconds);
+	if (header_size < 0)
+	{
+		output.close();
+		return -1;
+	}
+
+	bool result = true;
+	if (index)
+	{
+		std::vector<PcapIndexReader::region_t> regions;
+		index->find(time_from, time_to, &regions);
+		for (size_t i = 0; i < regions.size() && result; ++i)
+			result = slice_range(regions[i].offset, regions[i].offset + regions[i].size);
+	}
+	else
+	{
+		result = slice_range(sizeof(pcap_file_header), UINT64_MAX);
+	}
+
+	result = result && flush_run() && flush_buffer();
+	result = output.close() && result;
+	if (!result)
+		return -1;
+
+	return header_size + static_cast<long long int>(counters.kernel_bytes + counters.buffered_bytes);
+}
+
+bool PcapSlicer::slice_range(uint64_t begin, uint64_t end)
+{
+	if (!reader.seek(begin))
+		return false;
+
+	const uint32_t snaplen = snapshot_length > 0 ? snapshot_length : reader.header().snaplen;
+	const uint64_t fraction_scale = reader.nanoseconds() ? 1 : 1000;
+	const uint32_t header_size = 16;		// Size of a record header.
+
+	PcapReader::record_t record;
+	while (reader.offset() < end)
+	{
+		const uint64_t offset = reader.offset();
+		if (!reader.next(&record))
+			break;
+
+		const uint64_t timestamp = record.ts_sec * 1000000000ull + record.ts_nsec;
+		if (timestamp < time_from || timestamp > time_to
+			|| (packet_filter && !packet_filter->accept(record.frame, record.caplen, record.len)))
+		{
+			if (!flush_run())
+				return false;
+			continue;
+		}
+
+		++counters.records;
+		const uint64_t record_end = offset + header_size + record.caplen;
+		if (!reader.swapped() && record.caplen <= snaplen && time_shift == 0)
+		{
+			// The record is copied as it is, extending the current run if it directly follows it.
+			if (run_end != offset && !flush_run())
+				return false;
+			if (run_end != offset)
+			{
+				run_begin = offset;
+				run_data = record.frame - header_size;
+			}
+			run_end = record_end;
+			continue;
+		}
+
+		// The header is rewritten, then the kept part of the payload starts a new run.
+		if (!flush_run())
+			return false;
+
+		int64_t shifted = static_cast<int64_t>(timestamp) + time_shift;
+		if (shifted < 0)
+			shifted = 0;
+
+		const uint32_t saved_size = record.caplen < snaplen ? record.caplen : snaplen;
+		const uint32_t record_header[4] = {static_cast<uint32_t>(shifted / 1000000000),
+			static_cast<uint32_t>(static_cast<uint64_t>(shifted % 1000000000) / fraction_scale), saved_size, record.len};
+		if (!buffer_bytes(record_header, sizeof(record_header)))
+			return false;
+		++counters.rewritten;
+
+		run_begin = offset + header_size;
+		run_end = run_begin + saved_size;
+		run_data = record.frame;
+	}
+
+	return true;
+}
+
+bool PcapSlicer::flush_run()
+{
+	const uint64_t begin = run_begin;
+	const uint64_t count = run_end - run_begin;
+	run_begin = 0;
+	run_end = 0;
+	if (count == 0)
+		return true;
+
+	if (count < MIN_KERNEL_COPY)
+		return buffer_bytes(run_data, static_cast<size_t>(count));
+
+	// Buffered bytes come first in the output.
+	return flush_buffer() && kernel_copy(begin, count);
+}
+
+bool PcapSlicer::buffer_bytes(const void* bytes, size_t count)
+{
+	if (buffer.size() + count > BUFFER_SIZE && !flush_buffer())
+		return false;
+
+	const char* first = static_cast<const char*>(bytes);
+	buffer.insert(buffer.end(), first, first + count);
+	counters.buffered_bytes += count;
+	return true;
+}
+
+bool PcapSlicer::flush_buffer()
+{
+	if (buffer.empty())
+		return true;
+
+	const bool result = output.write(buffer.data(), buffer.size());
+	buffer.clear();
+	return result;
+}
+
+bool PcapSlicer::kernel_copy(uint64_t offset, uint64_t count)
+{
+	const int output_fd = output.descriptor();
+	loff_t input_offset = static_cast<loff_t>(offset);
+	uint64_t left = count;
+
+	while (left > 0 && use_copy_file_range)
+	{
+		const ssize_t copied = copy_file_range(input_fd, &input_offset, output_fd, nullptr, left, 0);
+		if (copied > 0)
+		{
+			left -= static_cast<uint64_t>(copied);
+			continue;
+		}
+
+		if (copied < 0 && errno == EINTR)
+			continue;
+
+		// Older kernels and some file system pairs do not support copy_file_range; splice works on any of them.
+		if (copied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+		{
+			use_copy_file_range = false;
+			break;
+		}
+
+		return false;
+	}
+
+	if (left > 0 && pipe_fds[0] < 0)
+	{
+		if (pipe(pipe_fds) != 0)
+		{
+			pipe_fds[0] = -1;
+			pipe_fds[1] = -1;
+			return false;
+		}
+
+		// A larger pipe moves more pages per splice pair; the default size is kept if the limit does not allow it.
+		fcntl(pipe_fds[1], F_SETPIPE_SZ, static_cast<int>(BUFFER_SIZE));
+	}
+
+	while (left > 0)
+	{
+		const ssize_t moved = splice(input_fd, &input_offset, pipe_fds[1], nullptr, left, SPLICE_F_MOVE);
+		if (moved <= 0)
+		{
+			if (moved < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		for (ssize_t pending = moved; pending > 0;)
+		{
+			const ssize_t written = splice(pipe_fds[0], nullptr, output_fd, nullptr, static_cast<size_t>(pending),
+				SPLICE_F_MOVE);
+			if (written <= 0)
+			{
+				if (written < 0 && errno == EINTR)
+					continue;
+				return false;
+			}
+			pending -= written;
+		}
+
+		left -= static_cast<uint64_t>(moved);
+	}
+
+	++counters.kernel_copies;
+	counters.kernel_bytes += count;
+	return true;
+}
+
+const PcapSlicer::statistics_t& PcapSlicer::statistics() const
+{
+	return counters;
+}
@@ -0,0 +1,214 @@
+#ifndef PCAP_SLICER_H_
+#define PCAP_SLICER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FdSink.h"
+#include "PacketFilter.h"
+#include "PcapIndexReader.h"
+#include "PcapReader.h"
+#include "PcapWriter.h"
+
+/**
+ * This class rewrites a pcap file into a new one keeping only some of its records: those in a time range and accepted
+ * by a filter. Record headers are walked through PcapReader, and contiguous runs of kept records are copied from the
+ * input file to the output file inside the kernel with copy_file_range (or splice through a pipe where the file
+ * systems do not support it), so their bytes never pass through user space. A record header is rewritten only when it
+ * changes: when the record is truncated to a shorter snapshot length, when timestamps are shifted, or when the input
+ * has the other byte order. The payload behind a rewritten header is still copied by the kernel.
+ *
+ * Runs shorter than MIN_KERNEL_COPY bytes, and rewritten headers, are gathered in a buffer and written with write()
+ * instead, as a system call per small run would cost more than copying it.
+ *
+ * The output has the link type and timestamp resolution of the input; its global header is written by PcapWriter.
+ *
+ * Usage:
+ *	PcapSlicer slicer;
+ *	slicer.open("capture.pcap");
+ *	slicer.set_time_range(from, to);
+ *	slicer.slice("slice.pcap");
+ */
+class PcapSlicer
+{
+public:
+	/// Counters of the last slice() call
+	struct statistics_t
+	{
+		/// Number of records written
+		uint64_t records;
+
+		/// Number of records whose header has been rewritten
+		uint64_t rewritten;
+
+		/// Number of bytes copied inside the kernel
+		uint64_t kernel_bytes;
+
+		/// Number of bytes written from user space
+		uint64_t buffered_bytes;
+
+		/// Number of kernel copy calls (copy_file_range or splice pairs)
+		uint64_t kernel_copies;
+	};
+
+	PcapSlicer();
+
+	/// Closes the input if it is open.
+	~PcapSlicer();
+
+	PcapSlicer(const PcapSlicer&) = delete;
+	PcapSlicer& operator=(const PcapSlicer&) = delete;
+
+	/**
+	 * Opens the input file.
+	 *
+	 * @param path The input file path.
+	 * @return True if the input has been opened and has a valid global header; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// Closes the input.
+	void close();
+
+	/**
+	 * Keeps only records with timestamps in a range.
+	 *
+	 * @param from Lowest timestamp in nanoseconds.
+	 * @param to Highest timestamp in nanoseconds.
+	 */
+	void set_time_range(uint64_t from, uint64_t to);
+
+	/**
+	 * Uses a sidecar index of the input (see PcapIndex) to read only the regions which may hold the time range, instead
+	 * of walking every record. The index is not owned by the slicer and must outlive it.
+	 *
+	 * @param index The opened index, or nullptr to walk every record.
+	 */
+	void set_index(const PcapIndexReader* index);
+
+	/**
+	 * Keeps only records accepted by a filter. Filtering reads packet data, so the payload pages of the input are read
+	 * by user space. The filter is not owned by the slicer and must outlive it.
+	 *
+	 * @param filter The filter, or nullptr to keep every record.
+	 */
+	void set_filter(PacketFilter* filter);
+
+	/**
+	 * Sets the snapshot length of the output. Longer records are truncated and get a rewritten header.
+	 *
+	 * @param snaplen The snapshot length, or 0 to keep the snapshot length of the input.
+	 */
+	void set_snaplen(uint32_t snaplen);
+
+	/**
+	 * Shifts every timestamp of the output, so every record gets a rewritten header.
+	 *
+	 * @param shift Shift in nanoseconds, which may be negative.
+	 */
+	void set_time_shift(int64_t shift);
+
+	/**
+	 * Writes the kept records to a new output file, created or truncated.
+	 *
+	 * @param path The output file path.
+	 * @return Number of bytes written including global header, or -1 for failure.
+	 */
+	long long int slice(const std::string& path);
+
+	/// @return Counters of the last slice() call.
+	const statistics_t& statistics() const;
+
+private:
+	/// Runs shorter than this number of bytes are written from user space
+	constexpr static uint64_t MIN_KERNEL_COPY = 16 * 1024;
+
+	/// Size of the buffer of small runs and rewritten headers
+	constexpr static size_t BUFFER_SIZE = 1024 * 1024;
+
+	/**
+	 * Walks the records in [begin, end) of the input and writes those which are kept.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool slice_range(uint64_t begin, uint64_t end);
+
+	/**
+	 * Ends the current run of the input, copying it to the output.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool flush_run();
+
+	/**
+	 * Appends bytes to the buffer, writing it when it is full.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool buffer_bytes(const void* bytes, size_t count);
+
+	/**
+	 * Writes the buffer to the output.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool flush_buffer();
+
+	/**
+	 * Copies bytes of the input at an offset to the current end of the output, inside the kernel.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool kernel_copy(uint64_t offset, uint64_t count);
+
+	/// Reader of the input
+	PcapReader reader;
+
+	/// Input file descriptor used by kernel copies, or -1
+	int input_fd;
+
+	/// Output file
+	FdSink output;
+
+	/// Lowest kept timestamp in nanoseconds
+	uint64_t time_from;
+
+	/// Highest kept timestamp in nanoseconds
+	uint64_t time_to;
+
+	/// Sidecar index of the input, or nullptr
+	const PcapIndexReader* index;
+
+	/// Filter of kept records, or nullptr
+	PacketFilter* packet_filter;
+
+	/// Snapshot length of the output, or 0 for the input's one
+	uint32_t snapshot_length;
+
+	/// Shift of timestamps in nanoseconds
+	int64_t time_shift;
+
+	/// Start of the current run in the input
+	uint64_t run_begin;
+
+	/// End of the current run in the input
+	uint64_t run_end;
+
+	/// Bytes of the current run in the input mapping
+	const char* run_data;
+
+	/// Small runs and rewritten headers not yet written
+	std::vector<char> buffer;
+
+	/// True while copy_file_range works between the input and the output
+	bool use_copy_file_range;
+
+	/// Pipe used by splice, or -1
+	int pipe_fds[2];
+
+	/// Counters of the last slice() call
+	statistics_t counters;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "RotatingPcapWriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+/// @return Number of frame bytes which PcapWriter writes for a packet before snaplen, with its VLAN tag inserted back.
+inline uint32_t tagged_frame_size(const PcapWriter::packet_t& packet)
+{
+	return packet.frame_size + (packet.vlan_tag && packet.frame_size >= 12 ? 4 : 0);
+}
+
+}
+
+RotatingPcapWriter::RotatingPcapWriter(const std::string& path_prefix, uint64_t max_file_bytes,
+	unsigned int max_file_seconds, unsigned int max_files)
+: prefix(path_prefix)
+, max_bytes(max_file_bytes)
+, max_seconds(max_file_seconds)
+, keep_files(max_files)
+, link(0)
+, snapshot_length(0)
+, next_sequence(0)
+, failed(false)
+, stopping(false)
+{
+}
+
+RotatingPcapWriter::~RotatingPcapWriter()
+{
+	close();
+}
+
+void RotatingPcapWriter::set_snaplen(uint32_t snaplen)
+{
+	snapshot_length = snaplen;
+}
+
+std::string RotatingPcapWriter::file_path(uint64_t sequence) const
+{
+	return prefix + "." + std::to_string(sequence) + ".pcap";
+}
+
+std::unique_ptr<RotatingPcapWriter::file_t> RotatingPcapWriter::prepare_file(uint64_t sequence)
+{
+	std::unique_ptr<file_t> file(new file_t());
+	file->sequence = sequence;
+	file->packets = 0;
+	file->first_second = 0;
+	file->rotated = false;
+
+	if (!file->sink.open(file_path(sequence)))
+		return nullptr;
+
+	// Reserves disk blocks for the whole file without changing its size; failure only loses the optimization.
+	fallocate(file->sink.descriptor(), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(max_bytes));
+
+	file->writer.set_snaplen(snapshot_length);
+	const int result = file->writer.write_pcap_header(&file->sink, link);
+	if (result < 0)
+		return nullptr;
+
+	file->bytes = static_cast<uint64_t>(result);
+	return file;
+}
+
+bool RotatingPcapWriter::finish_file(std::unique_ptr<file_t> file)
+{
+	const int fd = file->sink.descriptor();
+
+	// Releases preallocated blocks beyond the written data, then makes the data durable.
+	bool result = ftruncate(fd, static_cast<off_t>(file->bytes)) == 0;
+	result = fdatasync(fd) == 0 && result;
+	result = file->sink.close() && result;
+
+	// The file which replaced this one and keep_files - 1 files before it are kept.
+	if (file->rotated && keep_files > 0 && file->sequence + 1 >= keep_files)
+		unlink(file_path(file->sequence + 1 - keep_files).c_str());
+
+	return result;
+}
+
+bool RotatingPcapWriter::open(uint32_t link_type)
+{
+	close();
+
+	link = link_type;
+	current = prepare_file(0);
+	if (!current)
+		return false;
+
+	next_sequence = 1;
+	failed = false;
+	stopping = false;
+	background_thread = std::thread(&RotatingPcapWriter::background, this);
+	return true;
+}
+
+void RotatingPcapWriter::background()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		if (!closing.empty())
+		{
+			std::unique_ptr<file_t> file = std::move(closing.front());
+			closing.erase(closing.begin());
+
+			lock.unlock();
+			const bool finished = finish_file(std::move(file));
+			lock.lock();
+
+			failed = failed || !finished;
+			continue;
+		}
+
+		if (stopping)
+			break;
+
+		if (!next && !failed)
+		{
+			const uint64_t sequence = next_sequence++;
+
+			lock.unlock();
+			std::unique_ptr<file_t> file = prepare_file(sequence);
+			lock.lock();
+
+			failed = failed || !file;
+			next = std::move(file);
+			file_ready.notify_all();
+			continue;
+		}
+
+		work_ready.wait(lock);
+	}
+}
+
+bool RotatingPcapWriter::must_rotate(uint32_t frame_size, timeval time) const
+{
+	// Every file gets at least one packet, whatever its size.
+	if (current->packets == 0)
+		return false;
+
+	// Only snaplen bytes of the frame are written.
+	const uint32_t snaplen = current->writer.snaplen();
+	if (current->bytes + 16 + (frame_size < snaplen ? frame_size : snaplen) > max_bytes)		// Record header is 16 bytes.
+		return true;
+
+	return max_seconds > 0 && time.tv_sec - current->first_second >= static_cast<time_t>(max_seconds);
+}
+
+bool RotatingPcapWriter::rotate()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	file_ready.wait(lock, [this]() { return next || failed; });
+	if (!next)
+		return false;
+
+	current->rotated = true;
+	closing.push_back(std::move(current));
+	current = std::move(next);
+	lock.unlock();
+
+	work_ready.notify_one();
+	return true;
+}
+
+int RotatingPcapWriter::write_packet(const char* frame, uint32_t frame_size, timeval time)
+{
+	if (!current)
+		return -1;
+
+	if (must_rotate(frame_size, time) && !rotate())
+		return -1;
+
+	const int result = current->writer.write_packet(frame, frame_size, time);
+	if (result > 0)
+	{
+		if (current->packets++ == 0)
+			current->first_second = time.tv_sec;
+		current->bytes += static_cast<uint64_t>(result);
+	}
+
+	return result;
+}
+
+long int RotatingPcapWriter::write_packets(const PcapWriter::packet_t* packets, size_t count)
+{
+	if (!current)
+		return -1;
+
+	long int total_bytes = 0;
+	while (count > 0)
+	{
+		if (must_rotate(tagged_frame_size(packets[0]), packets[0].time) && !rotate())
+			return -1;
+
+		// Takes the longest run of packets which fits in the current file, if every one of them is written.
+		uint64_t bytes = current->bytes;
+		uint64_t run_packets = current->packets;
+		const time_t first_second = run_packets == 0 ? packets[0].time.tv_sec : current->first_second;
+		const uint32_t snaplen = current->writer.snaplen();
+		size_t run = 0;
+		for (; run < count; ++run)
+		{
+			const uint32_t frame_size = tagged_frame_size(packets[run]);
+			const uint64_t record_size = 16 + (frame_size < snaplen ? frame_size : snaplen);		// Record header is 16 bytes.
+			if (run_packets > 0 && (bytes + record_size > max_bytes
+				|| (max_seconds > 0 && packets[run].time.tv_sec - first_second >= static_cast<time_t>(max_seconds))))
+				break;
+
+			bytes += record_size;
+			++run_packets;
+		}
+
+		// Limits are checked against what has been written, as the writer may skip packets.
+		size_t records = 0;
+		const long int result = current->writer.write_packets(packets, run, &records);
+		if (result < 0)
+			return -1;
+
+		if (current->packets == 0 && records > 0)
+			current->first_second = first_second;
+		current->packets += records;
+		current->bytes += static_cast<uint64_t>(result);
+
+		total_bytes += result;
+		packets += run;
+		count -= run;
+	}
+
+	return total_bytes;
+}
+
+bool RotatingPcapWriter::close()
+{
+	if (!background_thread.joinable())
+		return true;
+
+	std::unique_ptr<file_t> prepared;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing.push_back(std::move(current));
+		stopping = true;
+	}
+	work_ready.notify_one();
+	background_thread.join();
+
+	// The prepared file has no packets, so it is removed instead of being kept.
+	prepared = std::move(next);
+	if (prepared)
+	{
+		prepared->sink.close();
+		unlink(file_path(prepared->sequence).c_str());
+	}
+
+	const bool result = !failed;
+	failed = false;
+	return result;
+}
@@ -0,0 +1,191 @@
+#ifndef ROTATING_PCAP_WRITER_H_
+#define ROTATING_PCAP_WRITER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FdSink.h"
+#include "PcapWriter.h"
+
+/**
+ * This class writes a long-running capture to a ring of files ("<prefix>.<sequence>.pcap"), starting a new file when
+ * the current one reaches a size or time limit and keeping only the newest files. A background thread keeps the next
+ * file open, preallocated and with its global header already written, and closes, syncs and deletes old files, so a
+ * rotation on the packet path only swaps the current file for the prepared one.
+ *
+ * The time limit is measured on packet timestamps, from the first packet of each file.
+ */
+class RotatingPcapWriter
+{
+public:
+	/**
+	 * @param path_prefix Prefix of output files.
+	 * @param max_file_bytes Size limit of each file, including global header.
+	 * @param max_file_seconds Time limit of each file in seconds, or 0 for no time limit.
+	 * @param max_files Number of newest files to keep, or 0 to keep every file.
+	 */
+	RotatingPcapWriter(const std::string& path_prefix, uint64_t max_file_bytes = 1024 * 1024 * 1024,
+		unsigned int max_file_seconds = 60, unsigned int max_files = 0);
+
+	/// Closes the writer if it is open.
+	~RotatingPcapWriter();
+
+	RotatingPcapWriter(const RotatingPcapWriter&) = delete;
+	RotatingPcapWriter& operator=(const RotatingPcapWriter&) = delete;
+
+	/**
+	 * Sets the snapshot length of every file (see PcapWriter::set_snaplen()). It must be called before open().
+	 *
+	 * @param snaplen The snapshot length, greater than zero.
+	 */
+	void set_snaplen(uint32_t snaplen);
+
+	/**
+	 * Opens the first file and starts the background thread, which prepares the next one.
+	 *
+	 * @param link_type Data link layer type (1 = Ethernet).
+	 * @return True if the first file has been opened and its global header written successfully; otherwise false.
+	 */
+	bool open(uint32_t link_type);
+
+	/**
+	 * Writes packet to the current file, rotating first if the packet would exceed a limit.
+	 *
+	 * @return Same as PcapWriter::write_packet(), or "-1" if rotating has failed.
+	 */
+	int write_packet(const char* frame, uint32_t frame_size, timeval time);
+
+	/**
+	 * Writes a batch of packets, rotating between packets whenever a limit would be exceeded.
+	 *
+	 * @return Same as PcapWriter::write_packets().
+	 */
+	long int write_packets(const PcapWriter::packet_t* packets, size_t count);
+
+	/**
+	 * Closes and syncs the current file, removes the prepared one and stops the background thread.
+	 *
+	 * @return True if every file has been written and closed successfully; otherwise false.
+	 */
+	bool close();
+
+	/// @return Path of the file with the given sequence number.
+	std::string file_path(uint64_t sequence) const;
+
+private:
+	/// One output file
+	struct file_t
+	{
+		/// Sequence number of the file
+		uint64_t sequence;
+
+		/// Output sink
+		FdSink sink;
+
+		/// Pcap writer of the file
+		PcapWriter writer;
+
+		/// Number of bytes written, including global header
+		uint64_t bytes;
+
+		/// Number of packets written
+		uint64_t packets;
+
+		/// Timestamp seconds of the first packet
+		time_t first_second;
+
+		/// True if a newer file has replaced this one as the current file
+		bool rotated;
+	};
+
+	/**
+	 * Opens, preallocates and writes the global header of a file.
+	 *
+	 * @param sequence Sequence number of the file.
+	 * @return The file, or nullptr for failure.
+	 */
+	std::unique_ptr<file_t> prepare_file(uint64_t sequence);
+
+	/**
+	 * Syncs and closes a file, releases its unused preallocation and, if the file has been rotated, deletes files older
+	 * than the kept ones.
+	 *
+	 * @param file The file.
+	 * @return True for success and false for failure.
+	 */
+	bool finish_file(std::unique_ptr<file_t> file);
+
+	/// Background thread main loop.
+	void background();
+
+	/**
+	 * Returns true if a packet of the given size and time must go to a new file.
+	 *
+	 * @param frame_size Length of packet.
+	 * @param time Captured packet's timestamp.
+	 */
+	bool must_rotate(uint32_t frame_size, timeval time) const;
+
+	/**
+	 * Swaps the current file for the prepared one, waiting for it if it is not ready yet, and hands the current file
+	 * to the background thread.
+	 *
+	 * @return True for success and false if the next file could not be prepared.
+	 */
+	bool rotate();
+
+	/// Prefix of output files
+	std::string prefix;
+
+	/// Size limit of each file
+	uint64_t max_bytes;
+
+	/// Time limit of each file in seconds, 0 for none
+	unsigned int max_seconds;
+
+	/// Number of newest files to keep, 0 for all
+	unsigned int keep_files;
+
+	/// Data link layer type of all files
+	uint32_t link;
+
+	/// Snapshot length of all files, 0 for the PcapWriter default
+	uint32_t snapshot_length;
+
+	/// File written by the packet path
+	std::unique_ptr<file_t> current;
+
+	/// Prepared next file, guarded by mutex
+	std::unique_ptr<file_t> next;
+
+	/// Files waiting to be closed by the background thread, guarded by mutex
+	std::vector<std::unique_ptr<file_t>> closing;
+
+	/// Sequence number of the next prepared file, guarded by mutex
+	uint64_t next_sequence;
+
+	/// True if preparing or closing a file has failed, guarded by mutex
+	bool failed;
+
+	/// True when the background thread shall exit, guarded by mutex
+	bool stopping;
+
+	/// Guards state shared with the background thread
+	std::mutex mutex;
+
+	/// Wakes up the background thread
+	std::condition_variable work_ready;
+
+	/// Wakes up the packet path waiting for the next file
+	std::condition_variable file_ready;
+
+	/// Background thread
+	std::thread background_thread;
+};
+
+#endif
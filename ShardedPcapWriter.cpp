@@ -0,0 +1,223 @@
+#include "ShardedPcapWriter.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <thread>
+
+ShardedPcapWriter::Shard::Shard(ShardedPcapWriter* owner, unsigned int index, int cpu)
+: owner(owner)
+, shard_index(index)
+, shard_cpu(cpu)
+, path(owner->prefix + "." + std::to_string(index) + ".pcap")
+, bytes(0)
+, packets(0)
+, checkpoint_offset(0)
+{
+}
+
+bool ShardedPcapWriter::Shard::checkpoint_due() const
+{
+	// The first record always gets a checkpoint, so that every shard can be ordered.
+	return packets == 0 || bytes - checkpoint_offset >= owner->checkpoint_interval;
+}
+
+void ShardedPcapWriter::Shard::checkpoint(timeval time)
+{
+	checkpoint_t point;
+	point.sequence = owner->sequence.fetch_add(1, std::memory_order_relaxed);
+	point.offset = bytes;
+	point.packet_index = packets;
+	point.time = time;
+	checkpoints.push_back(point);
+
+	checkpoint_offset = bytes;
+}
+
+int ShardedPcapWriter::Shard::write_packet(const char* frame, uint32_t frame_size, timeval time)
+{
+	// Checkpoints are taken after the record has been written, so failed and filtered packets get none.
+	const int result = writer.write_packet(frame, frame_size, time);
+	if (result > 0)
+	{
+		if (checkpoint_due())
+			checkpoint(time);
+		bytes += static_cast<uint64_t>(result);
+		++packets;
+	}
+
+	return result;
+}
+
+long int ShardedPcapWriter::Shard::write_packets(const PcapWriter::packet_t* packets, size_t count)
+{
+	// Filtered packets are not written, so the records are counted by the writer. While a checkpoint is due, packets
+	// are written one by one, so that it gets the time of the first record actually written.
+	long int total_bytes = 0;
+	size_t records = 0;
+	for (; count > 0 && checkpoint_due(); ++packets, --count)
+	{
+		const long int result = writer.write_packets(packets, 1, &records);
+		if (result < 0)
+			return -1;
+
+		if (records > 0)
+		{
+			checkpoint(packets->time);
+			bytes += static_cast<uint64_t>(result);
+			++this->packets;
+			total_bytes += result;
+		}
+	}
+
+	if (count == 0)
+		return total_bytes;
+
+	const long int result = writer.write_packets(packets, count, &records);
+	if (result < 0)
+		return -1;
+
+	bytes += static_cast<uint64_t>(result);
+	this->packets += records;
+	return total_bytes + result;
+}
+
+unsigned int ShardedPcapWriter::Shard::index() const
+{
+	return shard_index;
+}
+
+int ShardedPcapWriter::Shard::cpu() const
+{
+	return shard_cpu;
+}
+
+const WriterStats& ShardedPcapWriter::Shard::stats() const
+{
+	return shard_stats;
+}
+
+ShardedPcapWriter::ShardedPcapWriter(const std::string& path_prefix, unsigned int shard_count,
+	uint64_t checkpoint_bytes)
+: prefix(path_prefix)
+, checkpoint_interval(checkpoint_bytes)
+, sequence(0)
+, opened(false)
+{
+	shards.resize(shard_count);
+}
+
+ShardedPcapWriter::~ShardedPcapWriter()
+{
+	close();
+}
+
+bool ShardedPcapWriter::open(uint32_t link_type, const std::vector<int>& cpus)
+{
+	close();
+
+	const long int cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	for (unsigned int i = 0; i < shards.size(); ++i)
+	{
+		int cpu = -1;
+		if (i < cpus.size())
+			cpu = cpus[i];
+		else if (cpus.empty() && cpu_count > 0)
+			cpu = static_cast<int>(i % cpu_count);
+
+		shards[i].reset(new Shard(this, i, cpu));
+		Shard& shard = *shards[i];
+		if (!shard.sink.open(shard.path))
+			return false;
+
+		shard.writer.set_stats(&shard.shard_stats);
+		const int result = shard.writer.write_pcap_header(&shard.sink, link_type);
+		if (result < 0)
+			return false;
+
+		shard.bytes = static_cast<uint64_t>(result);
+	}
+
+	sequence.store(0, std::memory_order_relaxed);
+	opened = true;
+	return true;
+}
+
+bool ShardedPcapWriter::run(const std::function<void(Shard&)>& worker)
+{
+	std::vector<std::thread> threads;
+	std::atomic<bool> pinned(true);
+
+	for (std::unique_ptr<Shard>& shard : shards)
+	{
+		Shard* current = shard.get();
+		threads.push_back(std::thread([current, &worker, &pinned]()
+		{
+			if (current->cpu() >= 0 && !pin_thread(current->cpu()))
+				pinned.store(false, std::memory_order_relaxed);
+
+			worker(*current);
+		}));
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return pinned.load(std::memory_order_relaxed);
+}
+
+ShardedPcapWriter::Shard& ShardedPcapWriter::shard(unsigned int index)
+{
+	return *shards[index];
+}
+
+unsigned int ShardedPcapWriter::shard_count() const
+{
+	return static_cast<unsigned int>(shards.size());
+}
+
+bool ShardedPcapWriter::pin_thread(int cpu)
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+bool ShardedPcapWriter::write_manifest() const
+{
+	FILE* manifest = fopen((prefix + ".manifest").c_str(), "w");
+	if (!manifest)
+		return false;
+
+	fprintf(manifest, "# pcap-writer shard manifest\n");
+	for (const std::unique_ptr<Shard>& shard : shards)
+		fprintf(manifest, "shard %u %d %s %" PRIu64 " %" PRIu64 "\n", shard->shard_index, shard->shard_cpu,
+			shard->path.c_str(), shard->packets, shard->bytes);
+
+	for (const std::unique_ptr<Shard>& shard : shards)
+		for (const Shard::checkpoint_t& point : shard->checkpoints)
+			fprintf(manifest, "checkpoint %" PRIu64 " %u %" PRIu64 " %" PRIu64 " %ld %ld\n", point.sequence,
+				shard->shard_index, point.offset, point.packet_index, static_cast<long int>(point.time.tv_sec),
+				static_cast<long int>(point.time.tv_usec));
+
+	return fclose(manifest) == 0;
+}
+
+bool ShardedPcapWriter::close()
+{
+	if (!opened)
+		return true;
+
+	bool result = true;
+	for (std::unique_ptr<Shard>& shard : shards)
+		result = shard->sink.close() && result;
+
+	result = write_manifest() && result;
+	opened = false;
+	return result;
+}
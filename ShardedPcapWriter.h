@@ -0,0 +1,204 @@
+#ifndef SHARDED_PCAP_WRITER_H_
+#define SHARDED_PCAP_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FdSink.h"
+#include "PcapWriter.h"
+#include "WriterStats.h"
+
+/**
+ * This class splits a capture into per-core shards. Every shard has its own PcapWriter, its own batch buffers and its
+ * own output file ("<prefix>.<index>.pcap"), and is written by exactly one worker thread pinned to one CPU, so writes
+ * scale with cores instead of serializing on one stream. Shards share nothing on the packet path except a global
+ * sequence counter which is incremented once per checkpoint.
+ *
+ * A checkpoint is recorded whenever a shard has written checkpoint_bytes since its last one. It keeps the global
+ * sequence number, the file offset and the timestamp of the next record, so shards can be put back in global order
+ * later. On close the checkpoints are written to a text manifest ("<prefix>.manifest") with one line per shard and
+ * one line per checkpoint:
+ *
+ *	shard <index> <cpu> <path> <packets> <bytes>
+ *	checkpoint <sequence> <shard> <offset> <packet_index> <ts_sec> <ts_usec>
+ */
+class ShardedPcapWriter
+{
+public:
+	/// One shard of the capture. Only the worker thread which owns a shard may write to it.
+	class Shard
+	{
+	public:
+		/// Same as PcapWriter::write_packet(), for this shard.
+		int write_packet(const char* frame, uint32_t frame_size, timeval time);
+
+		/// Same as PcapWriter::write_packets(), for this shard.
+		long int write_packets(const PcapWriter::packet_t* packets, size_t count);
+
+		/// @return Index of this shard.
+		unsigned int index() const;
+
+		/// @return CPU the worker thread of this shard is pinned to, or -1 if it is not pinned.
+		int cpu() const;
+
+		/// @return Statistics of this shard's writer, which any thread may take a snapshot of.
+		const WriterStats& stats() const;
+
+	private:
+		friend class ShardedPcapWriter;
+
+		/// Checkpoint of shard output for ordering shards globally
+		struct checkpoint_t
+		{
+			/// Global sequence number
+			uint64_t sequence;
+
+			/// File offset of the next record
+			uint64_t offset;
+
+			/// Index of the next packet in this shard
+			uint64_t packet_index;
+
+			/// Timestamp of the next packet
+			timeval time;
+		};
+
+		/**
+		 * @param owner Sharded writer this shard belongs to.
+		 * @param index Index of this shard.
+		 * @param cpu CPU to pin the worker thread to, or -1.
+		 */
+		Shard(ShardedPcapWriter* owner, unsigned int index, int cpu);
+
+		/// @return True if the next record written shall get a checkpoint: it is the first one, or checkpoint_bytes
+		///	have been written since the last checkpoint.
+		bool checkpoint_due() const;
+
+		/**
+		 * Records a checkpoint before a record which has just been written, before bytes and packets count it.
+		 *
+		 * @param time Timestamp of the record.
+		 */
+		void checkpoint(timeval time);
+
+		/// Sharded writer this shard belongs to
+		ShardedPcapWriter* owner;
+
+		/// Index of this shard
+		unsigned int shard_index;
+
+		/// CPU of the worker thread
+		int shard_cpu;
+
+		/// Output file path
+		std::string path;
+
+		/// Output sink
+		FdSink sink;
+
+		/// Pcap writer of this shard
+		PcapWriter writer;
+
+		/// Statistics of this shard, updated by its worker thread only
+		WriterStats shard_stats;
+
+		/// Number of bytes written, including global header
+		uint64_t bytes;
+
+		/// Number of packets written
+		uint64_t packets;
+
+		/// File offset of the last checkpoint
+		uint64_t checkpoint_offset;
+
+		/// Checkpoints of this shard
+		std::vector<checkpoint_t> checkpoints;
+	};
+
+	/**
+	 * @param path_prefix Prefix of shard files and of the manifest.
+	 * @param shard_count Number of shards.
+	 * @param checkpoint_bytes Number of bytes between checkpoints of a shard.
+	 */
+	ShardedPcapWriter(const std::string& path_prefix, unsigned int shard_count,
+		uint64_t checkpoint_bytes = 64 * 1024 * 1024);
+
+	/// Closes shard files and writes the manifest if it has not been done.
+	~ShardedPcapWriter();
+
+	ShardedPcapWriter(const ShardedPcapWriter&) = delete;
+	ShardedPcapWriter& operator=(const ShardedPcapWriter&) = delete;
+
+	/**
+	 * Creates shard files and writes their global headers.
+	 *
+	 * @param link_type Data link layer type (1 = Ethernet).
+	 * @param cpus CPU of each shard's worker thread; if empty, shard i uses CPU i modulo the number of CPUs.
+	 * @return True if every shard file has been opened successfully; otherwise false.
+	 */
+	bool open(uint32_t link_type, const std::vector<int>& cpus = std::vector<int>());
+
+	/**
+	 * Starts one worker thread per shard, pins it to the CPU of its shard, runs worker on it and waits for all of
+	 * them to finish.
+	 *
+	 * @param worker Function run by each worker thread with its own shard.
+	 * @return True if every worker thread has been pinned successfully; otherwise false (workers still run).
+	 */
+	bool run(const std::function<void(Shard&)>& worker);
+
+	/**
+	 * Returns a shard, for applications which manage their own worker threads (see pin_thread()).
+	 *
+	 * @param index Index of the shard.
+	 * @return The shard.
+	 */
+	Shard& shard(unsigned int index);
+
+	/// @return Number of shards.
+	unsigned int shard_count() const;
+
+	/**
+	 * Closes all shard files and writes the manifest. Worker threads must have stopped writing.
+	 *
+	 * @return True if files have been closed and the manifest written successfully; otherwise false.
+	 */
+	bool close();
+
+	/**
+	 * Pins the calling thread to a CPU.
+	 *
+	 * @param cpu The CPU.
+	 * @return True for success and false for failure.
+	 */
+	static bool pin_thread(int cpu);
+
+private:
+	/**
+	 * Writes the manifest of all shards and their checkpoints.
+	 *
+	 * @return True for success and false for failure.
+	 */
+	bool write_manifest() const;
+
+	/// Prefix of shard files and of the manifest
+	std::string prefix;
+
+	/// Number of bytes between checkpoints of a shard
+	uint64_t checkpoint_interval;
+
+	/// Shards
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	/// Global checkpoint sequence, shared by all shards
+	std::atomic<uint64_t> sequence;
+
+	/// True while shard files are open
+	bool opened;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "StatsDumper.h"
+
+#include <cinttypes>
+
+StatsDumper::StatsDumper()
+: output(nullptr)
+, interval(1000)
+, stopping(false)
+, failed(false)
+{
+}
+
+StatsDumper::~StatsDumper()
+{
+	stop();
+}
+
+void StatsDumper::add(const std::string& name, const WriterStats* stats)
+{
+	source_t source;
+	source.name = name;
+	source.stats = stats;
+	source.packets = 0;
+	source.bytes = 0;
+	sources.push_back(source);
+}
+
+bool StatsDumper::start(const std::string& path, unsigned int interval_ms)
+{
+	if (dump_thread.joinable())
+		return false;
+
+	output = fopen(path.c_str(), "a");
+	if (!output)
+		return false;
+
+	interval = std::chrono::milliseconds(interval_ms > 0 ? interval_ms : 1);
+	previous_time = std::chrono::steady_clock::now();
+	stopping = false;
+	failed = false;
+	dump_thread = std::thread(&StatsDumper::run, this);
+	return true;
+}
+
+bool StatsDumper::stop()
+{
+	if (!dump_thread.joinable())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_one();
+	dump_thread.join();
+
+	// The last dump holds the final counters.
+	bool result = dump(output) && !failed;
+	result = fclose(output) == 0 && result;
+	output = nullptr;
+	return result;
+}
+
+void StatsDumper::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!wakeup.wait_for(lock, interval, [this] { return stopping; }))
+	{
+		lock.unlock();
+		if (!dump(output))
+			failed = true;
+		lock.lock();
+	}
+}
+
+bool StatsDumper::dump(FILE* file)
+{
+	const std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(current_time - previous_time).count();
+	previous_time = current_time;
+
+	const long long int unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	for (source_t& source : sources)
+	{
+		source.stats->snapshot(&snapshot);
+		const double packet_rate = seconds > 0 ? static_cast<double>(snapshot.packets - source.packets) / seconds : 0;
+		const double byte_rate = seconds > 0 ? static_cast<double>(snapshot.bytes - source.bytes) / seconds : 0;
+		source.packets = snapshot.packets;
+		source.bytes = snapshot.bytes;
+
+		fprintf(file, "%lld %s packets=%" PRIu64 " bytes=%" PRIu64 " pps=%.0f bps=%.0f write_calls=%" PRIu64
+			" retries=%" PRIu64 " errors=%" PRIu64 " buffered=%" PRIu64, unix_ms, source.name.c_str(), snapshot.packets,
+			snapshot.bytes, packet_rate, byte_rate, snapshot.write_calls, snapshot.retries, snapshot.errors,
+			snapshot.buffered_bytes);
+		fprintf(file, " sampled_writes=%" PRIu64 " write_p50=%" PRIu64 " write_p99=%" PRIu64 " write_p999=%" PRIu64
+			" write_max=%" PRIu64, WriterStats::count(snapshot.write_latency),
+			WriterStats::percentile(snapshot.write_latency, 0.5), WriterStats::percentile(snapshot.write_latency, 0.99),
+			WriterStats::percentile(snapshot.write_latency, 0.999), WriterStats::percentile(snapshot.write_latency, 1));
+		fprintf(file, " flushes=%" PRIu64 " flush_p50=%" PRIu64 " flush_p99=%" PRIu64 " flush_max=%" PRIu64 "\n",
+			WriterStats::count(snapshot.flush_latency), WriterStats::percentile(snapshot.flush_latency, 0.5),
+			WriterStats::percentile(snapshot.flush_latency, 0.99), WriterStats::percentile(snapshot.flush_latency, 1));
+	}
+
+	return fflush(file) == 0 && !ferror(file);
+}
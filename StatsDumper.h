@@ -0,0 +1,130 @@
+#ifndef STATS_DUMPER_H_
+#define STATS_DUMPER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "WriterStats.h"
+
+/**
+ * This class appends the counters of one or more writers (see WriterStats) to a text file at a fixed interval, from a
+ * thread of its own, so a running capture can be watched without touching its writer threads. Every dump writes one
+ * line per writer:
+ *
+ *	<unix time ms> <name> packets=<n> bytes=<n> pps=<n> bps=<n> write_calls=<n> retries=<n> errors=<n>
+ *		buffered=<n> sampled_writes=<n> write_p50=<ns> write_p99=<ns> write_p999=<ns> write_max=<ns>
+ *		flushes=<n> flush_p50=<ns> flush_p99=<ns> flush_max=<ns>
+ *
+ * pps and bps are packet and byte rates since the previous dump. Latencies are upper bounds of histogram buckets;
+ * write latencies are those of the sampled write calls (see WriterStats::sample_write()).
+ *
+ * Usage:
+ *	StatsDumper dumper;
+ *	dumper.add("writer", &stats);
+ *	dumper.start("writer.stats", 1000);
+ *	...
+ *	dumper.stop();
+ */
+class StatsDumper
+{
+public:
+	StatsDumper();
+
+	/// Stops the dump thread if it is running.
+	~StatsDumper();
+
+	StatsDumper(const StatsDumper&) = delete;
+	StatsDumper& operator=(const StatsDumper&) = delete;
+
+	/**
+	 * Adds a writer to the dump. Writers must be added before start(). The counters are not owned by the dumper and
+	 * must outlive it.
+	 *
+	 * @param name Name of the writer in the dump, without spaces.
+	 * @param stats Counters of the writer.
+	 */
+	void add(const std::string& name, const WriterStats* stats);
+
+	/**
+	 * Opens the dump file for appending and starts the dump thread.
+	 *
+	 * @param path The dump file path.
+	 * @param interval_ms Interval between dumps in milliseconds.
+	 * @return True if the file has been opened and the thread started; otherwise false.
+	 */
+	bool start(const std::string& path, unsigned int interval_ms);
+
+	/**
+	 * Stops the dump thread, writes a last dump and closes the file.
+	 *
+	 * @return True if every dump has been written successfully; otherwise false.
+	 */
+	bool stop();
+
+	/**
+	 * Writes one dump of every writer. Used by the dump thread; may also be called to dump to another file while the
+	 * thread is not running.
+	 *
+	 * @param file The output file.
+	 * @return True for success and false for failure to write.
+	 */
+	bool dump(FILE* file);
+
+private:
+	/// A writer in the dump
+	struct source_t
+	{
+		/// Name of the writer
+		std::string name;
+
+		/// Counters of the writer
+		const WriterStats* stats;
+
+		/// Packet count at the previous dump
+		uint64_t packets;
+
+		/// Byte count at the previous dump
+		uint64_t bytes;
+	};
+
+	/// Body of the dump thread.
+	void run();
+
+	/// Writers in the dump
+	std::vector<source_t> sources;
+
+	/// Snapshot area, reused between dumps
+	WriterStats::snapshot_t snapshot;
+
+	/// Time of the previous dump
+	std::chrono::steady_clock::time_point previous_time;
+
+	/// Dump file, or nullptr
+	FILE* output;
+
+	/// Interval between dumps
+	std::chrono::milliseconds interval;
+
+	/// Dump thread
+	std::thread dump_thread;
+
+	/// Guards stopping
+	std::mutex mutex;
+
+	/// Wakes the dump thread up when it shall stop
+	std::condition_variable wakeup;
+
+	/// True when the dump thread shall stop, guarded by mutex
+	bool stopping;
+
+	/// True if a dump has failed
+	bool failed;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "StreamSink.h"
+
+#include <cerrno>
+
+StreamSink::StreamSink(std::fstream* file_stream)
+: stream(file_stream)
+{
+}
+
+void StreamSink::set_stream(std::fstream* file_stream)
+{
+	stream = file_stream;
+}
+
+bool StreamSink::write(const void* buffer, size_t count)
+{
+	if (!stream)
+		return false;
+
+	const char* temp_buffer = reinterpret_cast<const char*>(buffer);
+
+	std::streamsize bytes_written = 0;
+	errno = 0;
+	while (count > 0)
+	{
+		if ((bytes_written = stream->rdbuf()->sputn(temp_buffer, static_cast<std::streamsize>(count))) <= 0)
+		{
+			if (errno != EINTR && errno != EAGAIN)
+				return false;
+
+			if (sink_stats)
+				sink_stats->add_retry();
+			continue;
+		}
+
+		count -= static_cast<size_t>(bytes_written);
+		temp_buffer += bytes_written;
+	}
+
+	return true;
+}
+
+bool StreamSink::flush()
+{
+	if (!stream)
+		return false;
+
+	return stream->rdbuf()->pubsync() == 0;
+}
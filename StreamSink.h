@@ -0,0 +1,36 @@
+#ifndef STREAM_SINK_H_
+#define STREAM_SINK_H_
+
+#include <fstream>
+
+#include "PcapSink.h"
+
+/**
+ * Pcap sink which writes through the stream buffer of a std::fstream opened by user application. The stream is not
+ * owned by the sink, so closing the sink only flushes it.
+ */
+class StreamSink : public PcapSink
+{
+public:
+	/**
+	 * @param file_stream The output file stream, or nullptr for a sink which fails every write.
+	 */
+	explicit StreamSink(std::fstream* file_stream = nullptr);
+
+	/**
+	 * Replaces the output file stream.
+	 *
+	 * @param file_stream The output file stream.
+	 */
+	void set_stream(std::fstream* file_stream);
+
+	bool write(const void* buffer, size_t count) override;
+
+	bool flush() override;
+
+private:
+	/// Output file stream for this sink
+	std::fstream* stream;
+};
+
+#endif
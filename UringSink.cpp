@@ -0,0 +1,345 @@
+#include "UringSink.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+UringSink::UringSink(unsigned int queue_depth, size_t buffer_size)
+: fd(-1)
+, ring_fd(-1)
+, depth(queue_depth > 0 ? queue_depth : 1)
+, staging_size(buffer_size > 0 ? buffer_size : 4096)
+, staging_area(nullptr)
+, current(0)
+, in_flight(0)
+, file_offset(0)
+, failed(false)
+, sq_ring(MAP_FAILED)
+, sq_ring_size(0)
+, cq_ring(MAP_FAILED)
+, cq_ring_size(0)
+, sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+, sq_entries(0)
+, sq_tail(nullptr)
+, sq_mask(nullptr)
+, sq_array(nullptr)
+, cq_head(nullptr)
+, cq_tail(nullptr)
+, cq_mask(nullptr)
+, cqes(nullptr)
+{
+}
+
+UringSink::~UringSink()
+{
+	close();
+	free(staging_area);
+}
+
+bool UringSink::open(const std::string& path)
+{
+	close();
+
+	// 0666 means user, group and others have read and write permission on this file (minus umask).
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		return false;
+
+	failed = false;
+	if (!setup_ring())
+	{
+		// Synchronous path, the fallback sink owns nothing and fd is closed by close().
+		teardown_ring();
+		fallback.attach(fd);
+	}
+
+	return true;
+}
+
+bool UringSink::uses_uring() const
+{
+	return ring_fd >= 0;
+}
+
+bool UringSink::setup_ring()
+{
+	if (!staging_area)
+	{
+		void* area = nullptr;
+		if (posix_memalign(&area, 4096, staging_size * depth) != 0)
+			return false;
+
+		staging_area = static_cast<char*>(area);
+	}
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+	if (ring_fd < 0)
+		return false;
+
+	sq_entries = params.sq_entries;
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cq_ring_size > sq_ring_size)
+			sq_ring_size = cq_ring_size;
+		cq_ring_size = sq_ring_size;
+	}
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+		IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED)
+		return false;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ring = sq_ring;
+	else
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+			IORING_OFF_CQ_RING);
+	if (cq_ring == MAP_FAILED)
+		return false;
+
+	sqes = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+	if (sqes == MAP_FAILED)
+		return false;
+
+	char* sq_base = static_cast<char*>(sq_ring);
+	sq_tail = reinterpret_cast<unsigned int*>(sq_base + params.sq_off.tail);
+	sq_mask = reinterpret_cast<unsigned int*>(sq_base + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned int*>(sq_base + params.sq_off.array);
+
+	char* cq_base = static_cast<char*>(cq_ring);
+	cq_head = reinterpret_cast<unsigned int*>(cq_base + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned int*>(cq_base + params.cq_off.tail);
+	cq_mask = reinterpret_cast<unsigned int*>(cq_base + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq_base + params.cq_off.cqes);
+
+	// Registers staging buffers once, so the kernel does not map user pages on every write.
+	std::vector<iovec> vectors(depth);
+	buffers.assign(depth, buffer_t());
+	for (unsigned int i = 0; i < depth; ++i)
+	{
+		buffers[i].data = staging_area + i * staging_size;
+		vectors[i].iov_base = buffers[i].data;
+		vectors[i].iov_len = staging_size;
+	}
+
+	if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, vectors.data(), depth) < 0)
+		return false;
+
+	current = 0;
+	in_flight = 0;
+	file_offset = 0;
+	return true;
+}
+
+void UringSink::teardown_ring()
+{
+	if (sqes != MAP_FAILED)
+		munmap(sqes, sq_entries * sizeof(io_uring_sqe));
+	if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	if (sq_ring != MAP_FAILED)
+		munmap(sq_ring, sq_ring_size);
+
+	// Closing the instance also unregisters its buffers.
+	if (ring_fd >= 0)
+		::close(ring_fd);
+
+	ring_fd = -1;
+	sq_ring = MAP_FAILED;
+	cq_ring = MAP_FAILED;
+	sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	buffers.clear();
+}
+
+bool UringSink::submit(unsigned int index)
+{
+	buffer_t& buffer = buffers[index];
+
+	const unsigned int tail = *sq_tail;
+	const unsigned int slot = tail & *sq_mask;
+	io_uring_sqe* sqe = &sqes[slot];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(buffer.data + buffer.completed);
+	sqe->len = static_cast<uint32_t>(buffer.used - buffer.completed);
+	sqe->off = buffer.offset + buffer.completed;
+	sqe->buf_index = static_cast<uint16_t>(index);
+	sqe->user_data = index;
+	sq_array[slot] = slot;
+
+	// The kernel must see the entry before the new tail.
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (sink_stats)
+		sink_stats->add_write_call();
+
+	long int result = 0;
+	while ((result = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0)) < 0)
+	{
+		if (errno != EINTR && errno != EAGAIN)
+			return false;
+
+		if (sink_stats)
+			sink_stats->add_retry();
+	}
+
+	if (!buffer.in_flight)
+	{
+		buffer.in_flight = true;
+		++in_flight;
+	}
+
+	return true;
+}
+
+bool UringSink::reap(bool wait)
+{
+	unsigned int head = *cq_head;
+	if (wait && head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+	{
+		while (syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0)
+		{
+			if (errno != EINTR && errno != EAGAIN)
+				return false;
+		}
+	}
+
+	const unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe& cqe = cqes[head & *cq_mask];
+		const unsigned int index = static_cast<unsigned int>(cqe.user_data);
+		buffer_t& buffer = buffers[index];
+
+		// A write of zero bytes would be resubmitted forever, so it fails as in FdSink.
+		bool written = true;
+		if (cqe.res > 0)
+			buffer.completed += static_cast<size_t>(cqe.res);
+		else if (cqe.res == 0 || (cqe.res != -EINTR && cqe.res != -EAGAIN))
+			written = false;
+
+		// Short and interrupted writes are resubmitted for their remaining bytes, unless a write has failed already.
+		if (written && buffer.completed < buffer.used)
+		{
+			if (!failed && submit(index))
+			{
+				if (sink_stats)
+					sink_stats->add_retry();
+				continue;
+			}
+
+			written = false;
+		}
+
+		buffer.in_flight = false;
+		--in_flight;
+		if (!written)
+			failed = true;
+	}
+
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	return !failed;
+}
+
+bool UringSink::write(const void* buffer, size_t count)
+{
+	if (fd < 0)
+		return false;
+
+	if (ring_fd < 0)
+		return fallback.write(buffer, count);
+
+	const char* temp_buffer = reinterpret_cast<const char*>(buffer);
+	while (count > 0)
+	{
+		buffer_t& staging = buffers[current];
+		const size_t chunk = count < staging_size - staging.used ? count : staging_size - staging.used;
+		memcpy(staging.data + staging.used, temp_buffer, chunk);
+		staging.used += chunk;
+		temp_buffer += chunk;
+		count -= chunk;
+
+		if (staging.used < staging_size)
+			break;
+
+		staging.offset = file_offset;
+		staging.completed = 0;
+		file_offset += staging.used;
+		if (!submit(current))
+			return false;
+
+		// Moves to the next buffer, waiting for its previous write if it is still in flight.
+		current = (current + 1) % depth;
+		while (buffers[current].in_flight)
+			if (!reap(true))
+				return false;
+
+		buffers[current].used = 0;
+	}
+
+	if (sink_stats)
+		sink_stats->set_buffered(buffers[current].used);
+	return true;
+}
+
+bool UringSink::flush()
+{
+	if (fd < 0)
+		return false;
+
+	if (ring_fd < 0)
+		return fallback.flush();
+
+	buffer_t& staging = buffers[current];
+	if (staging.used > 0)
+	{
+		staging.offset = file_offset;
+		staging.completed = 0;
+		file_offset += staging.used;
+		if (!submit(current))
+			return false;
+
+		current = (current + 1) % depth;
+	}
+
+	while (in_flight > 0)
+		if (!reap(true))
+			return false;
+
+	buffers[current].used = 0;
+	if (sink_stats)
+		sink_stats->set_buffered(0);
+	return !failed;
+}
+
+void UringSink::set_stats(WriterStats* stats)
+{
+	sink_stats = stats;
+	fallback.set_stats(stats);
+}
+
+bool UringSink::close()
+{
+	if (fd < 0)
+		return true;
+
+	const bool result = flush();
+
+	teardown_ring();
+	fallback.attach(-1);
+	const bool closed = ::close(fd) == 0;
+	fd = -1;
+	return result && closed;
+}
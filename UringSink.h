@@ -0,0 +1,177 @@
+#ifndef URING_SINK_H_
+#define URING_SINK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+#include "FdSink.h"
+#include "PcapSink.h"
+
+/**
+ * Pcap sink which keeps many writes in flight with io_uring. Bytes are gathered in a set of staging buffers that are
+ * registered with the kernel once (fixed buffers), and each full buffer is submitted as a write at its own file
+ * offset, so completions may arrive in any order. Short writes are resubmitted for their remaining bytes when their
+ * completion is reaped. The capture thread only blocks when every buffer is in flight.
+ *
+ * If io_uring is not available (old kernel, seccomp filter), the sink falls back to synchronous writes through an
+ * FdSink.
+ */
+class UringSink : public PcapSink
+{
+public:
+	/**
+	 * @param queue_depth Maximum number of writes in flight, which is also the number of staging buffers.
+	 * @param buffer_size Size of each staging buffer.
+	 */
+	explicit UringSink(unsigned int queue_depth = 32, size_t buffer_size = 1024 * 1024);
+
+	~UringSink() override;
+
+	UringSink(const UringSink&) = delete;
+	UringSink& operator=(const UringSink&) = delete;
+
+	/**
+	 * Creates (or truncates) the output file and sets up the io_uring instance.
+	 *
+	 * @param path The output file path.
+	 * @return True if output file has been opened successfully, with or without io_uring; otherwise false.
+	 */
+	bool open(const std::string& path);
+
+	/// @return True if writes are submitted through io_uring, false if the synchronous fallback is used.
+	bool uses_uring() const;
+
+	bool write(const void* buffer, size_t count) override;
+
+	/// Submits the partially filled staging buffer and waits for every write in flight.
+	bool flush() override;
+
+	bool close() override;
+
+	/// Sets the statistics of this sink and of its synchronous fallback.
+	void set_stats(WriterStats* stats) override;
+
+private:
+	/// Staging buffer and the state of its write
+	struct buffer_t
+	{
+		/// Buffer memory, part of the registered area
+		char* data;
+
+		/// Number of bytes filled
+		size_t used;
+
+		/// Number of bytes completed by the kernel
+		size_t completed;
+
+		/// File offset of the first byte
+		uint64_t offset;
+
+		/// True while a write of this buffer is in flight
+		bool in_flight;
+	};
+
+	/**
+	 * Sets up the io_uring instance, maps its rings and registers the staging buffers.
+	 *
+	 * @return True if io_uring is ready; otherwise false.
+	 */
+	bool setup_ring();
+
+	/// Unregisters the staging buffers, unmaps the rings and closes the io_uring instance.
+	void teardown_ring();
+
+	/**
+	 * Queues a write of the uncompleted part of a buffer and submits it to the kernel.
+	 *
+	 * @param index Index of the buffer.
+	 * @return True for success and false for failure to submit.
+	 */
+	bool submit(unsigned int index);
+
+	/**
+	 * Processes available completions, resubmitting short and interrupted writes. A failed write, a write of zero
+	 * bytes or a short write after a failure fails the sink until it is reopened.
+	 *
+	 * @param wait True to wait for at least one completion if none is available.
+	 * @return True for success and false if a write has failed since the file was opened.
+	 */
+	bool reap(bool wait);
+
+	/// Synchronous sink used when io_uring is not available
+	FdSink fallback;
+
+	/// Output file descriptor
+	int fd;
+
+	/// io_uring instance descriptor, -1 if io_uring is not used
+	int ring_fd;
+
+	/// Number of staging buffers and maximum number of writes in flight
+	unsigned int depth;
+
+	/// Size of each staging buffer
+	size_t staging_size;
+
+	/// Memory of all staging buffers
+	char* staging_area;
+
+	/// Staging buffers
+	std::vector<buffer_t> buffers;
+
+	/// Index of the buffer being filled
+	unsigned int current;
+
+	/// Number of writes in flight
+	unsigned int in_flight;
+
+	/// File offset of the next filled buffer
+	uint64_t file_offset;
+
+	/// True once a write has failed, as its bytes are missing from the file
+	bool failed;
+
+	/// Mapped submission queue ring
+	void* sq_ring;
+
+	/// Size of mapped submission queue ring
+	size_t sq_ring_size;
+
+	/// Mapped completion queue ring, same as sq_ring if the kernel maps both at once
+	void* cq_ring;
+
+	/// Size of mapped completion queue ring
+	size_t cq_ring_size;
+
+	/// Mapped submission queue entries
+	io_uring_sqe* sqes;
+
+	/// Number of submission queue entries
+	unsigned int sq_entries;
+
+	/// Submission queue tail, shared with the kernel
+	unsigned int* sq_tail;
+
+	/// Submission queue index mask
+	unsigned int* sq_mask;
+
+	/// Submission queue index array
+	unsigned int* sq_array;
+
+	/// Completion queue head, shared with the kernel
+	unsigned int* cq_head;
+
+	/// Completion queue tail, shared with the kernel
+	unsigned int* cq_tail;
+
+	/// Completion queue index mask
+	unsigned int* cq_mask;
+
+	/// Completion queue entries
+	io_uring_cqe* cqes;
+};
+
+#endif
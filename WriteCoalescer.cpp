@@ -0,0 +1,134 @@
+#include "WriteCoalescer.h"
+
+#include <unistd.h>
+
+constexpr size_t WriteCoalescer::MIN_BUFFER_SIZE;
+constexpr size_t WriteCoalescer::MAX_BUFFER_SIZE;
+constexpr size_t WriteCoalescer::DEFAULT_BUFFER_SIZE;
+constexpr unsigned int WriteCoalescer::DEFAULT_MAX_LATENCY_MS;
+constexpr size_t WriteCoalescer::MIN_FLUSH_SIZE;
+constexpr size_t WriteCoalescer::DEFAULT_MAX_FLUSH_SIZE;
+
+namespace
+{
+
+/// Weight of the newest measurement in the smoothed throughput
+constexpr double THROUGHPUT_WEIGHT = 0.25;
+
+/// Fraction of the maximum latency which a buffer takes to reach the flush threshold at the observed throughput
+constexpr double FILL_TIME_FRACTION = 0.25;
+
+/// Shortest fill time measured, so that a buffer filled faster than the clock resolution gives a finite throughput
+constexpr uint64_t MIN_FILL_NANOSECONDS = 1000;
+
+}
+
+WriteCoalescer::WriteCoalescer()
+: buffer_size(0)
+, used(0)
+, threshold(0)
+, max_threshold(0)
+, max_latency(0)
+, deadline(UINT64_MAX)
+, fill_start(0)
+, bytes_per_second(0)
+, size_flush_count(0)
+, deadline_flush_count(0)
+{
+}
+
+bool WriteCoalescer::reset(size_t size, unsigned int max_latency_ms)
+{
+	if (size != 0 && (size < MIN_BUFFER_SIZE || size > MAX_BUFFER_SIZE))
+		return false;
+
+	// Pages of the buffer are only faulted in when first written, so a large buffer costs nothing until it is used.
+	buffer.reset(size > 0 ? new char[size] : nullptr);
+	buffer_size = size;
+	used = 0;
+	max_latency = static_cast<uint64_t>(max_latency_ms) * 1000000;
+	deadline = UINT64_MAX;
+	bytes_per_second = 0;
+	size_flush_count = 0;
+	deadline_flush_count = 0;
+
+	const long int cache_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	max_threshold = cache_size > 0 ? static_cast<size_t>(cache_size) : DEFAULT_MAX_FLUSH_SIZE;
+	if (max_threshold < MIN_FLUSH_SIZE)
+		max_threshold = MIN_FLUSH_SIZE;
+
+	// Without a latency limit, nothing bounds the threshold but the buffer size.
+	if (max_latency == 0 || max_threshold > buffer_size)
+		max_threshold = buffer_size;
+	threshold = max_latency > 0 && MIN_FLUSH_SIZE < max_threshold ? MIN_FLUSH_SIZE : max_threshold;
+	return true;
+}
+
+size_t WriteCoalescer::capacity() const
+{
+	return buffer_size;
+}
+
+const char* WriteCoalescer::data() const
+{
+	return buffer.get();
+}
+
+size_t WriteCoalescer::size() const
+{
+	return used;
+}
+
+void WriteCoalescer::drained(bool by_size)
+{
+	if (used == 0)
+		return;
+
+	if (by_size)
+		++size_flush_count;
+	else
+		++deadline_flush_count;
+
+	const uint64_t elapsed = precise_now() - fill_start;
+	const double measured = static_cast<double>(used) * 1e9
+		/ static_cast<double>(elapsed > MIN_FILL_NANOSECONDS ? elapsed : MIN_FILL_NANOSECONDS);
+	bytes_per_second = bytes_per_second > 0 ? bytes_per_second + (measured - bytes_per_second) * THROUGHPUT_WEIGHT
+		: measured;
+
+	used = 0;
+	deadline = UINT64_MAX;
+
+	if (max_latency > 0)
+	{
+		const double target = bytes_per_second * static_cast<double>(max_latency) * FILL_TIME_FRACTION / 1e9;
+		threshold = target > static_cast<double>(max_threshold) ? max_threshold
+			: target < static_cast<double>(MIN_FLUSH_SIZE) ? MIN_FLUSH_SIZE : static_cast<size_t>(target);
+	}
+}
+
+size_t WriteCoalescer::flush_threshold() const
+{
+	return threshold;
+}
+
+uint64_t WriteCoalescer::throughput() const
+{
+	return static_cast<uint64_t>(bytes_per_second);
+}
+
+uint64_t WriteCoalescer::size_flushes() const
+{
+	return size_flush_count;
+}
+
+uint64_t WriteCoalescer::deadline_flushes() const
+{
+	return deadline_flush_count;
+}
+
+uint64_t WriteCoalescer::precise_now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+}
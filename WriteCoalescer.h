@@ -0,0 +1,201 @@
+#ifndef WRITE_COALESCER_H_
+#define WRITE_COALESCER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <time.h>
+
+/**
+ * This class is the output buffer of a writer (see BasicPcapWriter::set_coalescing()). Records are copied into it and
+ * written to the sink in one call once it holds flush_threshold() bytes, so small packets cost one large write
+ * instead of two small ones each. A record which arrives after the maximum latency has elapsed since the oldest
+ * buffered byte makes the writer flush, so bytes of a slow link still reach the file in time; capture loops call
+ * BasicPcapWriter::poll() when they wake up without packets, for links which have gone idle.
+ *
+ * The flush threshold follows the observed throughput: it is the number of bytes which arrive in a quarter of the
+ * maximum latency, so that at a steady rate records reach the file well within it and the deadline only catches
+ * slowdowns. It is at least MIN_FLUSH_SIZE, so a slow link does not pay a system call for every few records, and at
+ * most the size of the L2 cache: records are copied into the buffer and then out of it by the kernel, and a buffer
+ * which no longer fits in the cache makes both copies miss, which costs more than the system calls saved. Only the
+ * first flush_threshold() bytes of the buffer are ever touched. Throughput is measured on each filled buffer, from
+ * its first byte to its write, and smoothed over the last few.
+ *
+ * Without a maximum latency the threshold is the whole buffer, whatever its size.
+ *
+ * Only the thread which owns the writer uses an instance; the deadline is checked with the coarse monotonic clock,
+ * which costs a few nanoseconds per record.
+ */
+class WriteCoalescer
+{
+public:
+	/// Minimum buffer size in bytes, which fits any record of the default snapshot length
+	constexpr static size_t MIN_BUFFER_SIZE = 1024 * 1024;
+
+	/// Maximum buffer size in bytes
+	constexpr static size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
+	/// Default buffer size in bytes
+	constexpr static size_t DEFAULT_BUFFER_SIZE = 8 * 1024 * 1024;
+
+	/// Default maximum latency in milliseconds
+	constexpr static unsigned int DEFAULT_MAX_LATENCY_MS = 100;
+
+	/// Lowest flush threshold in bytes, which keeps writes large enough to amortize the system call
+	constexpr static size_t MIN_FLUSH_SIZE = 64 * 1024;
+
+	/// Highest flush threshold in bytes if the size of the L2 cache is unknown
+	constexpr static size_t DEFAULT_MAX_FLUSH_SIZE = 1024 * 1024;
+
+	/// Constructs a disabled buffer.
+	WriteCoalescer();
+
+	WriteCoalescer(const WriteCoalescer&) = delete;
+	WriteCoalescer& operator=(const WriteCoalescer&) = delete;
+
+	/**
+	 * Replaces the buffer with an empty one and clears the throughput estimate. Buffered bytes are lost, so they must
+	 * have been written before.
+	 *
+	 * @param size Size of the buffer in bytes, from MIN_BUFFER_SIZE to MAX_BUFFER_SIZE, or 0 to disable it.
+	 * @param max_latency_ms Maximum time bytes may stay in the buffer in milliseconds, or 0 for no limit.
+	 * @return True for success; false if the size is out of range, which leaves the buffer unchanged.
+	 */
+	bool reset(size_t size, unsigned int max_latency_ms);
+
+	/// @return True if a buffer has been set.
+	inline bool enabled() const;
+
+	/// @return Size of the buffer in bytes, 0 if it is disabled.
+	size_t capacity() const;
+
+	/**
+	 * @param count Number of bytes.
+	 * @return True if count bytes fit in the free part of the buffer.
+	 */
+	inline bool fits(size_t count) const;
+
+	/**
+	 * Copies bytes into the buffer, which must have room for them (see fits()).
+	 *
+	 * @param data Bytes to copy.
+	 * @param count Number of bytes.
+	 */
+	inline void append(const void* data, size_t count);
+
+	/// @return True if the buffer holds at least flush_threshold() bytes.
+	inline bool full() const;
+
+	/// @return True if the buffer holds bytes older than the maximum latency.
+	inline bool expired() const;
+
+	/// @return Buffered bytes.
+	const char* data() const;
+
+	/// @return Number of buffered bytes.
+	size_t size() const;
+
+	/**
+	 * Empties the buffer once its bytes have been written, measures the throughput of the filled buffer and adapts
+	 * the flush threshold to it.
+	 *
+	 * @param by_size True if the buffer has been written because it reached the flush threshold or had no room left.
+	 */
+	void drained(bool by_size);
+
+	/// @return Number of buffered bytes at which the buffer is written.
+	size_t flush_threshold() const;
+
+	/// @return Smoothed throughput in bytes per second, 0 until a buffer has been written.
+	uint64_t throughput() const;
+
+	/// @return Number of buffers written because they had reached the flush threshold or were full.
+	uint64_t size_flushes() const;
+
+	/// @return Number of buffers written for any other reason: expired deadline, poll() or flush().
+	uint64_t deadline_flushes() const;
+
+private:
+	/// @return Monotonic time in nanoseconds, precise.
+	static uint64_t precise_now();
+
+	/// @return Monotonic time in nanoseconds, with the resolution of the scheduler tick.
+	inline static uint64_t coarse_now();
+
+	/// Buffer memory, or nullptr if disabled
+	std::unique_ptr<char[]> buffer;
+
+	/// Size of the buffer
+	size_t buffer_size;
+
+	/// Number of buffered bytes
+	size_t used;
+
+	/// Number of buffered bytes at which the buffer is written
+	size_t threshold;
+
+	/// Highest threshold: the size of the L2 cache, or of the buffer if it is smaller
+	size_t max_threshold;
+
+	/// Maximum time bytes may stay in the buffer in nanoseconds, 0 for no limit
+	uint64_t max_latency;
+
+	/// Coarse time after which the buffered bytes are late, UINT64_MAX if the buffer is empty
+	uint64_t deadline;
+
+	/// Precise time of the first byte of the buffer
+	uint64_t fill_start;
+
+	/// Smoothed throughput in bytes per second
+	double bytes_per_second;
+
+	/// Number of buffers written at the flush threshold
+	uint64_t size_flush_count;
+
+	/// Number of buffers written for other reasons
+	uint64_t deadline_flush_count;
+};
+
+bool WriteCoalescer::enabled() const
+{
+	return buffer_size > 0;
+}
+
+bool WriteCoalescer::fits(size_t count) const
+{
+	return count <= buffer_size - used;
+}
+
+void WriteCoalescer::append(const void* data, size_t count)
+{
+	// The deadline and throughput window start with the first byte.
+	if (used == 0)
+	{
+		fill_start = precise_now();
+		deadline = max_latency > 0 ? coarse_now() + max_latency : UINT64_MAX;
+	}
+
+	memcpy(buffer.get() + used, data, count);
+	used += count;
+}
+
+bool WriteCoalescer::full() const
+{
+	return used >= threshold;
+}
+
+bool WriteCoalescer::expired() const
+{
+	return used > 0 && coarse_now() >= deadline;
+}
+
+uint64_t WriteCoalescer::coarse_now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "WriterStats.h"
+
+constexpr size_t WriterStats::SUB_BUCKETS;
+constexpr size_t WriterStats::BUCKET_COUNT;
+constexpr uint32_t WriterStats::WRITE_SAMPLE_INTERVAL;
+
+WriterStats::WriterStats()
+{
+	reset();
+}
+
+void WriterStats::snapshot(snapshot_t* snapshot) const
+{
+	snapshot->packets = packet_count.load(std::memory_order_relaxed);
+	snapshot->bytes = byte_count.load(std::memory_order_relaxed);
+	snapshot->write_calls = write_call_count.load(std::memory_order_relaxed);
+	snapshot->retries = retry_count.load(std::memory_order_relaxed);
+	snapshot->errors = error_count.load(std::memory_order_relaxed);
+	snapshot->buffered_bytes = buffered_byte_count.load(std::memory_order_relaxed);
+
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		snapshot->write_latency[i] = write_histogram[i].load(std::memory_order_relaxed);
+		snapshot->flush_latency[i] = flush_histogram[i].load(std::memory_order_relaxed);
+	}
+}
+
+void WriterStats::reset()
+{
+	packet_count.store(0, std::memory_order_relaxed);
+	byte_count.store(0, std::memory_order_relaxed);
+	write_call_count.store(0, std::memory_order_relaxed);
+	retry_count.store(0, std::memory_order_relaxed);
+	error_count.store(0, std::memory_order_relaxed);
+	buffered_byte_count.store(0, std::memory_order_relaxed);
+	writes_to_sample = 0;
+
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		write_histogram[i].store(0, std::memory_order_relaxed);
+		flush_histogram[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t WriterStats::bucket_limit(size_t index)
+{
+	if (index < SUB_BUCKETS)
+		return index;
+
+	// Inverse of bucket(): the bucket starts at (SUB_BUCKETS + sub_bucket) << (exponent - 3).
+	const unsigned int exponent = static_cast<unsigned int>(index / SUB_BUCKETS) + 2;
+	const uint64_t sub_bucket = index % SUB_BUCKETS;
+	const uint64_t width = uint64_t(1) << (exponent - 3);
+	return ((SUB_BUCKETS + sub_bucket) << (exponent - 3)) + width - 1;
+}
+
+uint64_t WriterStats::count(const uint64_t* histogram)
+{
+	uint64_t total = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+		total += histogram[i];
+
+	return total;
+}
+
+uint64_t WriterStats::percentile(const uint64_t* histogram, double fraction)
+{
+	const uint64_t total = count(histogram);
+	if (total == 0)
+		return 0;
+
+	// Rank of the percentile value, counted from one.
+	uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > total)
+		rank = total;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += histogram[i];
+		if (seen >= rank)
+			return bucket_limit(i);
+	}
+
+	return bucket_limit(BUCKET_COUNT - 1);
+}
@@ -0,0 +1,267 @@
+#ifndef WRITER_STATS_H_
+#define WRITER_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <time.h>
+
+/**
+ * This class counts what a writer and its sink do, so a capture which drops packets can tell whether the writer is
+ * the bottleneck. It counts packets and bytes written, system calls issued by the sink, retried calls (short writes,
+ * EINTR and EAGAIN), failed writes and bytes held in sink buffers, and keeps histograms of how long each flush and
+ * a sample of the write calls took. One write call in WRITE_SAMPLE_INTERVAL is timed (see sample_write()), so that
+ * write_packet() does not read the clock twice per record.
+ *
+ * Only one thread updates an instance: the thread which owns the writer. Counters are relaxed atomics updated with a
+ * plain load and store, without any locked instruction, so instrumentation can be left on in production. Any thread
+ * may take a snapshot at any time; each counter of a snapshot is exact, but counters are not read at one instant.
+ * Writers used by several threads (e.g. shards of ShardedPcapWriter) have one instance each.
+ *
+ * Histograms are log-linear, as HDR histograms: each power of two of nanoseconds is split in SUB_BUCKETS buckets, so
+ * a latency is known within 1/SUB_BUCKETS of its value, from 1 ns to hundreds of years, in 496 buckets.
+ *
+ * Usage:
+ *	WriterStats stats;
+ *	writer.set_stats(&stats);
+ *	...
+ *	WriterStats::snapshot_t snapshot;
+ *	stats.snapshot(&snapshot);
+ *	WriterStats::percentile(snapshot.write_latency, 0.99);
+ */
+class WriterStats
+{
+public:
+	/// Number of buckets per power of two of a histogram
+	constexpr static size_t SUB_BUCKETS = 8;
+
+	/// Number of buckets of a histogram
+	constexpr static size_t BUCKET_COUNT = 62 * SUB_BUCKETS;
+
+	/// Number of write calls per timed write call
+	constexpr static uint32_t WRITE_SAMPLE_INTERVAL = 64;
+
+	/// Values of the counters at one time
+	struct snapshot_t
+	{
+		/// Number of packets written
+		uint64_t packets;
+
+		/// Number of bytes written, record headers included
+		uint64_t bytes;
+
+		/// Number of write system calls issued by the sink
+		uint64_t write_calls;
+
+		/// Number of write system calls which had to be retried, after a short write, EINTR or EAGAIN
+		uint64_t retries;
+
+		/// Number of failed writes
+		uint64_t errors;
+
+		/// Number of bytes accepted by the sink which have not been passed to a system call yet
+		uint64_t buffered_bytes;
+
+		/// Number of sampled write calls of the writer to its sink, in each latency bucket
+		uint64_t write_latency[BUCKET_COUNT];
+
+		/// Number of flushes of the sink, in each latency bucket
+		uint64_t flush_latency[BUCKET_COUNT];
+	};
+
+	WriterStats();
+
+	WriterStats(const WriterStats&) = delete;
+	WriterStats& operator=(const WriterStats&) = delete;
+
+	/**
+	 * Counts written packets.
+	 *
+	 * @param packets Number of packets.
+	 * @param bytes Number of bytes of their records.
+	 */
+	inline void add_packets(uint64_t packets, uint64_t bytes);
+
+	/// Counts a write system call.
+	inline void add_write_call();
+
+	/// Counts a retried write system call.
+	inline void add_retry();
+
+	/// Counts a failed write.
+	inline void add_error();
+
+	/**
+	 * Sets the number of bytes held in sink buffers.
+	 *
+	 * @param bytes Number of bytes accepted by the sink which have not been passed to a system call yet.
+	 */
+	inline void set_buffered(uint64_t bytes);
+
+	/**
+	 * Tells whether a write call of the writer to its sink is to be timed. Called once per write call.
+	 *
+	 * @return True for one call in WRITE_SAMPLE_INTERVAL, starting with the first.
+	 */
+	inline bool sample_write();
+
+	/**
+	 * Records how long a sampled write call of the writer to its sink took.
+	 *
+	 * @param nanoseconds Duration of the call.
+	 */
+	inline void record_write(uint64_t nanoseconds);
+
+	/**
+	 * Records how long a flush of the sink took.
+	 *
+	 * @param nanoseconds Duration of the flush.
+	 */
+	inline void record_flush(uint64_t nanoseconds);
+
+	/**
+	 * Reads every counter. May be called from any thread.
+	 *
+	 * @param snapshot Filled with the counters.
+	 */
+	void snapshot(snapshot_t* snapshot) const;
+
+	/// Sets every counter to zero. Must not be called while the writer is writing.
+	void reset();
+
+	/// @return Monotonic time in nanoseconds, to measure durations.
+	inline static uint64_t now();
+
+	/**
+	 * @param nanoseconds A duration.
+	 * @return Index of the histogram bucket of the duration.
+	 */
+	inline static size_t bucket(uint64_t nanoseconds);
+
+	/**
+	 * @param index Index of a histogram bucket.
+	 * @return Highest duration of the bucket in nanoseconds.
+	 */
+	static uint64_t bucket_limit(size_t index);
+
+	/**
+	 * Finds a percentile of a histogram.
+	 *
+	 * @param histogram Histogram of a snapshot, BUCKET_COUNT buckets.
+	 * @param fraction Fraction of values at or below the percentile, e.g. 0.99.
+	 * @return Highest duration of the bucket holding the percentile in nanoseconds, or 0 if the histogram is empty.
+	 */
+	static uint64_t percentile(const uint64_t* histogram, double fraction);
+
+	/**
+	 * @param histogram Histogram of a snapshot, BUCKET_COUNT buckets.
+	 * @return Number of values in the histogram.
+	 */
+	static uint64_t count(const uint64_t* histogram);
+
+private:
+	/// Adds to a counter which only the calling thread updates.
+	inline static void add(std::atomic<uint64_t>& counter, uint64_t value);
+
+	/// Number of packets written
+	std::atomic<uint64_t> packet_count;
+
+	/// Number of bytes written
+	std::atomic<uint64_t> byte_count;
+
+	/// Number of write system calls
+	std::atomic<uint64_t> write_call_count;
+
+	/// Number of retried write system calls
+	std::atomic<uint64_t> retry_count;
+
+	/// Number of failed writes
+	std::atomic<uint64_t> error_count;
+
+	/// Number of bytes held in sink buffers
+	std::atomic<uint64_t> buffered_byte_count;
+
+	/// Latency histogram of sampled write calls
+	std::atomic<uint64_t> write_histogram[BUCKET_COUNT];
+
+	/// Number of write calls before the next sampled one, only used by the updating thread
+	uint32_t writes_to_sample;
+
+	/// Latency histogram of flushes
+	std::atomic<uint64_t> flush_histogram[BUCKET_COUNT];
+};
+
+void WriterStats::add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	// A single thread updates the counter, so a read-modify-write instruction is not needed.
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void WriterStats::add_packets(uint64_t packets, uint64_t bytes)
+{
+	add(packet_count, packets);
+	add(byte_count, bytes);
+}
+
+void WriterStats::add_write_call()
+{
+	add(write_call_count, 1);
+}
+
+void WriterStats::add_retry()
+{
+	add(retry_count, 1);
+}
+
+void WriterStats::add_error()
+{
+	add(error_count, 1);
+}
+
+void WriterStats::set_buffered(uint64_t bytes)
+{
+	buffered_byte_count.store(bytes, std::memory_order_relaxed);
+}
+
+bool WriterStats::sample_write()
+{
+	if (writes_to_sample > 0)
+	{
+		--writes_to_sample;
+		return false;
+	}
+
+	writes_to_sample = WRITE_SAMPLE_INTERVAL - 1;
+	return true;
+}
+
+void WriterStats::record_write(uint64_t nanoseconds)
+{
+	add(write_histogram[bucket(nanoseconds)], 1);
+}
+
+void WriterStats::record_flush(uint64_t nanoseconds)
+{
+	add(flush_histogram[bucket(nanoseconds)], 1);
+}
+
+uint64_t WriterStats::now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+}
+
+size_t WriterStats::bucket(uint64_t nanoseconds)
+{
+	// Values below SUB_BUCKETS have a bucket each; above, the three bits after the leading one select the bucket.
+	if (nanoseconds < SUB_BUCKETS)
+		return static_cast<size_t>(nanoseconds);
+
+	const unsigned int exponent = 63 - static_cast<unsigned int>(__builtin_clzll(nanoseconds));
+	const size_t sub_bucket = static_cast<size_t>(nanoseconds >> (exponent - 3)) & (SUB_BUCKETS - 1);
+	return (exponent - 2) * SUB_BUCKETS + sub_bucket;
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include "CaptureRing.h"
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "FdSink.h"
+#include "PcapReader.h"
+#include "SignalHandler.h"
+#include "StatsDumper.h"
+
+using namespace std;
+
+PacketRing* capture_ring = nullptr;
+
+cmd_parameters::cmd_parameters()
+: interface("eth0")
+, output_file_name("ring_output.pcap")
+, num_packets(0)
+, block_size(1024)
+, block_count(64)
+, promiscuous(false)
+, durable(false)
+, durability(DurabilityPolicy::level::data)
+, coalesce_size(0)
+, nanoseconds(false)
+{
+}
+
+void signal_handle(int)
+{
+	if (capture_ring)
+		capture_ring->stop();
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program captures packets through a TPACKET_V3 ring with pcap file writer's library.\n");
+	printf(" Usage : %s -i <interface> -f <PATH> -n <NUM> -b <KiB> -c <NUM> -p -r <PATH> -s <PATH> -D <LEVEL> -B <MiB>"
+		" -N -v <PATH> -h\n\n", program_name);
+	printf("\t[-i <interface>]\t: Interface to capture from (default eth0).\n");
+	printf("\t[-f <PATH>]\t\t: Output path.\n");
+	printf("\t[-n <NUM>]\t\t: Number of packets to capture, 0 until SIGINT (default 0).\n");
+	printf("\t[-b <KiB>]\t\t: Ring block size in KiB (default 1024).\n");
+	printf("\t[-c <NUM>]\t\t: Number of ring blocks (default 64).\n");
+	printf("\t[-p]\t\t\t: Promiscuous mode.\n");
+	printf("\t[-r <PATH>]\t\t: Replay this pcap file to the interface instead of capturing.\n");
+	printf("\t[-s <PATH>]\t\t: Append writer statistics to this file every second.\n");
+	printf("\t[-D <LEVEL>]\t\t: Sync the output every 64 MiB or second: flush, writeback, data or full.\n");
+	printf("\t[-B <MiB>]\t\t: Coalesce records in an output buffer of 1 to 64 MiB, flushed within 100 ms.\n");
+	printf("\t[-N]\t\t\t: Write nanosecond timestamps instead of microsecond ones.\n");
+	printf("\t[-v <PATH>]\t\t: Compare the captured frames with those of this pcap file, record by record.\n");
+	printf("\t[-h]\t\t\t: This help menu.\n\n");
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+
+	while ((cmds = getopt(argc, argv, "i:f:n:b:c:pr:s:D:B:Nv:h")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'i':
+				parameters->interface = optarg;
+				break;
+			case 'f':
+				parameters->output_file_name = optarg;
+				break;
+			case 'n':
+				parameters->num_packets = strtoull(optarg, nullptr, 10);
+				break;
+			case 'b':
+				parameters->block_size = static_cast<uint32_t>(atoi(optarg));
+				break;
+			case 'c':
+				parameters->block_count = static_cast<uint32_t>(atoi(optarg));
+				break;
+			case 'p':
+				parameters->promiscuous = true;
+				break;
+			case 'r':
+				parameters->replay_file_name = optarg;
+				break;
+			case 's':
+				parameters->stats_file_name = optarg;
+				break;
+			case 'D':
+				parameters->durable = true;
+				if (strcmp(optarg, "flush") == 0)
+					parameters->durability = DurabilityPolicy::level::flush;
+				else if (strcmp(optarg, "writeback") == 0)
+					parameters->durability = DurabilityPolicy::level::writeback;
+				else if (strcmp(optarg, "data") == 0)
+					parameters->durability = DurabilityPolicy::level::data;
+				else if (strcmp(optarg, "full") == 0)
+					parameters->durability = DurabilityPolicy::level::full;
+				else
+				{
+					fprintf(stderr, "Unknown durability level '%s'!\n", optarg);
+					return false;
+				}
+				break;
+			case 'B':
+				parameters->coalesce_size = static_cast<uint32_t>(atoi(optarg));
+				break;
+			case 'N':
+				parameters->nanoseconds = true;
+				break;
+			case 'v':
+				parameters->verify_file_name = optarg;
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	return true;
+}
+
+long long int replay(const cmd_parameters& parameters)
+{
+	PcapReader reader;
+	if (!reader.open(parameters.replay_file_name))
+		return -1;
+
+	const int socket_fd = socket(AF_PACKET, SOCK_RAW, 0);
+	if (socket_fd < 0)
+		return -1;
+
+	sockaddr_ll address = sockaddr_ll();
+	address.sll_family = AF_PACKET;
+	address.sll_ifindex = static_cast<int>(if_nametoindex(parameters.interface.c_str()));
+
+	long long int sent = 0;
+	PcapReader::record_t record;
+	while (reader.next(&record))
+	{
+		if (sendto(socket_fd, record.frame, record.caplen, 0, reinterpret_cast<sockaddr*>(&address),
+			sizeof(address)) < 0)
+		{
+			sent = -1;
+			break;
+		}
+		++sent;
+	}
+
+	close(socket_fd);
+	return sent;
+}
+
+bool verify_capture(const cmd_parameters& parameters)
+{
+	PcapReader expected_file;
+	PcapReader actual_file;
+	if (!expected_file.open(parameters.verify_file_name) || !actual_file.open(parameters.output_file_name))
+		return false;
+
+	uint64_t compared = 0;
+	PcapReader::record_t expected;
+	PcapReader::record_t actual;
+	while (expected_file.next(&expected))
+	{
+		if (!actual_file.next(&actual) || actual.caplen != expected.caplen || actual.len != expected.len
+			|| memcmp(actual.frame, expected.frame, expected.caplen) != 0)
+		{
+			fprintf(stderr, "Record %llu of the capture does not match!\n",
+				static_cast<unsigned long long int>(compared));
+			return false;
+		}
+		++compared;
+	}
+
+	if (actual_file.next(&actual))
+	{
+		fprintf(stderr, "Capture has more than %llu records!\n", static_cast<unsigned long long int>(compared));
+		return false;
+	}
+
+	printf("Verified %llu records.\n", static_cast<unsigned long long int>(compared));
+	return true;
+}
+
+long long int capture(const cmd_parameters& parameters)
+{
+	PacketRing ring(parameters.block_size * 1024, parameters.block_count);
+	if (!ring.open(parameters.interface, parameters.promiscuous))
+	{
+		fprintf(stderr, "Could not open packet ring on '%s'!\n", parameters.interface.c_str());
+		return -1;
+	}
+
+	FdSink sink;
+	PcapWriter writer;
+	WriterStats stats;
+	writer.set_stats(&stats);
+	if (!writer.set_coalescing(static_cast<size_t>(parameters.coalesce_size) * 1024 * 1024))
+	{
+		fprintf(stderr, "Output buffer size must be 0 or from 1 to 64 MiB!\n");
+		return -1;
+	}
+
+	// Link type 1 = Ethernet
+	const PcapWriter::ts_resolution resolution = parameters.nanoseconds ? PcapWriter::ts_resolution::nanoseconds
+		: PcapWriter::ts_resolution::microseconds;
+	if (!sink.open(parameters.output_file_name) || writer.write_pcap_header(&sink, 1, resolution) < 0)
+	{
+		fprintf(stderr, "Could not open output file '%s'!\n", parameters.output_file_name.c_str());
+		return -1;
+	}
+
+	StatsDumper dumper;
+	dumper.add("capture", &stats);
+	if (!parameters.stats_file_name.empty() && !dumper.start(parameters.stats_file_name, 1000))
+	{
+		fprintf(stderr, "Could not open statistics file '%s'!\n", parameters.stats_file_name.c_str());
+		return -1;
+	}
+
+	DurabilityPolicy durability(parameters.durability);
+	if (parameters.durable)
+	{
+		durability.start(sink.descriptor());
+		writer.set_durability(&durability);
+	}
+
+	capture_ring = &ring;
+	SignalHandler::add_handler_to_signals(signal_handle, {SIGINT, SIGTERM});
+
+	const long long int total_size = ring.capture(&writer, parameters.num_packets);
+	capture_ring = nullptr;
+
+	if (!dumper.stop())
+		fprintf(stderr, "Writing statistics file '%s' failed!\n", parameters.stats_file_name.c_str());
+
+	WriterStats::snapshot_t snapshot;
+	stats.snapshot(&snapshot);
+	printf("Writer: %llu write calls, %llu retries, %llu errors, write p99 %llu ns.\n",
+		static_cast<unsigned long long>(snapshot.write_calls), static_cast<unsigned long long>(snapshot.retries),
+		static_cast<unsigned long long>(snapshot.errors),
+		static_cast<unsigned long long>(WriterStats::percentile(snapshot.write_latency, 0.99)));
+
+	uint64_t received = 0;
+	uint64_t dropped = 0;
+	if (ring.statistics(&received, &dropped))
+		printf("Kernel received %llu packets, dropped %llu.\n", static_cast<unsigned long long>(received),
+			static_cast<unsigned long long>(dropped));
+
+	if (parameters.coalesce_size > 0)
+	{
+		if (!parameters.durable && !writer.flush())
+			fprintf(stderr, "Writing output file '%s' failed!\n", parameters.output_file_name.c_str());
+		printf("Output buffer: %llu flushes at threshold, %llu at deadline, threshold %llu bytes.\n",
+			static_cast<unsigned long long>(writer.coalescer().size_flushes()),
+			static_cast<unsigned long long>(writer.coalescer().deadline_flushes()),
+			static_cast<unsigned long long>(writer.coalescer().flush_threshold()));
+	}
+
+	if (parameters.durable)
+	{
+		if (!writer.flush() || !durability.stop())
+			fprintf(stderr, "Syncing output file '%s' failed!\n", parameters.output_file_name.c_str());
+		printf("Durability: %llu syncs, %llu errors.\n", static_cast<unsigned long long>(durability.syncs()),
+			static_cast<unsigned long long>(durability.errors()));
+	}
+
+	if (!sink.close())
+		return -1;
+
+	return total_size;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then either captures packets from the interface
+ * into the output file, and optionally compares it with another file, or replays an input file to the interface.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	if (!parameters.replay_file_name.empty())
+	{
+		const long long int sent = replay(parameters);
+		if (sent < 0)
+		{
+			fprintf(stderr, "Replaying '%s' failed!\n", parameters.replay_file_name.c_str());
+			return EXIT_FAILURE;
+		}
+
+		printf("Totally %lld packets sent to '%s'.\n", sent, parameters.interface.c_str());
+		return EXIT_SUCCESS;
+	}
+
+	const long long int total_size = capture(parameters);
+	if (total_size < 0)
+	{
+		fprintf(stderr, "Capturing failed!\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Totally %lld bytes written to '%s'.\n", total_size + 24, parameters.output_file_name.c_str());
+
+	if (!parameters.verify_file_name.empty() && !verify_capture(parameters))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
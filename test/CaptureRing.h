@@ -0,0 +1,101 @@
+#ifndef CAPTURE_RING_H_
+#define CAPTURE_RING_H_
+
+#include <cstdint>
+#include <string>
+
+#include "DurabilityPolicy.h"
+#include "PacketRing.h"
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Interface to capture from, or to replay to
+	std::string interface;
+
+	/// Output file path
+	std::string output_file_name;
+
+	/// Input file replayed to the interface instead of capturing, or empty to capture
+	std::string replay_file_name;
+
+	/// Number of packets to capture, 0 for no limit
+	uint64_t num_packets;
+
+	/// Size of each ring block in KiB
+	uint32_t block_size;
+
+	/// Number of ring blocks
+	uint32_t block_count;
+
+	/// Put the interface into promiscuous mode
+	bool promiscuous;
+
+	/// File the writer statistics are appended to every second, or empty
+	std::string stats_file_name;
+
+	/// True if the output file is synced at checkpoints
+	bool durable;
+
+	/// Durability level of checkpoints
+	DurabilityPolicy::level durability;
+
+	/// Size of the writer's output buffer in MiB, or 0 to write records straight from the ring
+	uint32_t coalesce_size;
+
+	/// Write nanosecond timestamps, as the ring has them
+	bool nanoseconds;
+
+	/// File whose frames the captured ones are compared with after capturing, or empty
+	std::string verify_file_name;
+};
+
+/// Ring stopped by signal_handle()
+extern PacketRing* capture_ring;
+
+/// Signal handler which stops capturing
+void signal_handle(int signal_number);
+
+/// Prints how to use capture ring tool.
+void print_usage(char* program_name);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+/**
+ * Sends every frame of a pcap file out of an interface through a packet socket, so that a capture on the peer of a
+ * veth pair can be tested without a physical NIC.
+ *
+ * @param parameters Command line parameters.
+ * @return Number of packets sent, or -1 for failure.
+ */
+long long int replay(const cmd_parameters& parameters);
+
+/**
+ * Compares the records of the output file with those of another pcap file, e.g. the replayed one, record by record.
+ * Timestamps are not compared; saved lengths, original lengths and frames must be equal.
+ *
+ * @param parameters Command line parameters.
+ * @return True if both files have the same records; otherwise false.
+ */
+bool verify_capture(const cmd_parameters& parameters);
+
+/**
+ * Captures packets from an interface through a TPACKET_V3 ring and writes them to the output file.
+ *
+ * @param parameters Command line parameters.
+ * @return Number of bytes written, or -1 for failure.
+ */
+long long int capture(const cmd_parameters& parameters);
+
+#endif
@@ -0,0 +1,109 @@
+#include "MergeFiles.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "FdSink.h"
+
+using namespace std;
+
+cmd_parameters::cmd_parameters()
+: output_file_name("merged.pcap")
+, dedup_window(0)
+{
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program merges pcap files in timestamp order with pcap file writer's library.\n");
+	printf(" Usage : %s -o <output_file> -d <window> -h <input_file>...\n\n", program_name);
+	printf("\t[-o <output_file>]\t: Output file name.\n");
+	printf("\t[-d <window>]\t\t: Removes duplicate packets seen within this many microseconds.\n");
+	printf("\t[-h]\t\t\t: This help menu.\n\n");
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+
+	while ((cmds = getopt(argc, argv, "o:d:h")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'o':
+				parameters->output_file_name = optarg;
+				break;
+			case 'd':
+				parameters->dedup_window = strtoull(optarg, nullptr, 10);
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	for (int i = optind; i < argc; ++i)
+		parameters->input_files.push_back(argv[i]);
+
+	if (parameters->input_files.empty())
+	{
+		print_usage(argv[0]);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then opens all input files and merges them into the
+ * output file in timestamp order, removing duplicate packets if asked to.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	PcapMerger merger;
+	for (const string& input : parameters.input_files)
+	{
+		if (!merger.add_input(input))
+		{
+			fprintf(stderr, "Could not open input file '%s', or its link type differs!\n", input.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	PacketDeduplicator deduplicator(parameters.dedup_window * 1000);
+	if (parameters.dedup_window > 0)
+		merger.set_deduplicator(&deduplicator);
+
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+	{
+		fprintf(stderr, "Could not open output file '%s'!\n", parameters.output_file_name.c_str());
+		return EXIT_FAILURE;
+	}
+
+	const long long int total_size = merger.merge(&sink);
+	if (total_size < 0 || !sink.close())
+	{
+		fprintf(stderr, "Merging failed!\n");
+		return EXIT_FAILURE;
+	}
+
+	if (parameters.dedup_window > 0)
+		printf("Removed %llu duplicates of %llu packets (%llu evictions).\n",
+			static_cast<unsigned long long int>(deduplicator.counters().duplicates),
+			static_cast<unsigned long long int>(deduplicator.counters().evaluated),
+			static_cast<unsigned long long int>(deduplicator.counters().evictions));
+
+	printf("Totally %lld bytes written to '%s'.\n", total_size, parameters.output_file_name.c_str());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef MERGE_FILES_H_
+#define MERGE_FILES_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PcapMerger.h"
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Input file paths
+	std::vector<std::string> input_files;
+
+	/// Output file path
+	std::string output_file_name;
+
+	/// Deduplication window in microseconds, or 0 to keep duplicate packets
+	uint64_t dedup_window;
+};
+
+/// Prints how to use merge files tool.
+void print_usage(char* program_name);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+#endif
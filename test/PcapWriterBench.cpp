@@ -0,0 +1,1773 @@
+#include "PcapWriterBench.h"
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <linux/perf_event.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <thread>
+
+#include "CompressedReader.h"
+#include "DemuxPcapWriter.h"
+#include "DirectSink.h"
+#include "FdSink.h"
+#include "MmapSink.h"
+#include "PcapNgWriter.h"
+#include "ShardedPcapWriter.h"
+#include "UringSink.h"
+
+using namespace std;
+
+int cycle_counter_fd = -1;
+
+double cycles_per_second = 0;
+
+cmd_parameters::cmd_parameters()
+: num_packets(1000000)
+, packet_size(64)
+, batch_size(256)
+, queue_depth(32)
+, shard_count(static_cast<unsigned int>(thread::hardware_concurrency()))
+, distribution(size_distribution::fixed)
+, pattern(timestamp_pattern::uniform)
+{
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program benchmarks pcap file writer's library write paths.\n");
+	printf(" Usage : %s -n <NUM> -s <SIZE> -d <DIST> -T <PATTERN> -b <BATCH> -q <DEPTH> -t <SHARDS> -f <PATH> -i <PATH>"
+		" -h\n\n", program_name);
+	printf("\t[-n <NUM>]\t: Number of packets to write.\n");
+	printf("\t[-s <SIZE>]\t: Length of each packet with fixed sizes.\n");
+	printf("\t[-d <DIST>]\t: Packet sizes: fixed (default), 64, imix or jumbo.\n");
+	printf("\t[-T <PATTERN>]\t: Timestamps: uniform (default), burst or jitter.\n");
+	printf("\t[-b <BATCH>]\t: Number of packets per batch.\n");
+	printf("\t[-q <DEPTH>]\t: Number of io_uring writes in flight.\n");
+	printf("\t[-t <SHARDS>]\t: Number of shards of sharded writer.\n");
+	printf("\t[-f <PATH>]\t: Output path, may be repeated (default: /dev/shm/bench.pcap and bench.pcap).\n");
+	printf("\t[-i <PATH>]\t: Write packets of this trace instead of synthetic ones.\n");
+	printf("\t[-h]\t\t: This help menu.\n\n");
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+
+	while ((cmds = getopt(argc, argv, "n:s:d:T:b:q:t:f:i:h")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'n':
+				parameters->num_packets = strtoul(optarg, nullptr, 10);
+				break;
+			case 's':
+				parameters->packet_size = static_cast<uint16_t>(atoi(optarg));
+				break;
+			case 'd':
+				if (strcmp(optarg, "fixed") == 0)
+					parameters->distribution = size_distribution::fixed;
+				else if (strcmp(optarg, "64") == 0)
+					parameters->distribution = size_distribution::minimum;
+				else if (strcmp(optarg, "imix") == 0)
+					parameters->distribution = size_distribution::imix;
+				else if (strcmp(optarg, "jumbo") == 0)
+					parameters->distribution = size_distribution::jumbo;
+				else
+				{
+					fprintf(stderr, "Invalid size distribution '%s'!\n", optarg);
+					return false;
+				}
+				break;
+			case 'T':
+				if (strcmp(optarg, "uniform") == 0)
+					parameters->pattern = timestamp_pattern::uniform;
+				else if (strcmp(optarg, "burst") == 0)
+					parameters->pattern = timestamp_pattern::burst;
+				else if (strcmp(optarg, "jitter") == 0)
+					parameters->pattern = timestamp_pattern::jitter;
+				else
+				{
+					fprintf(stderr, "Invalid timestamp pattern '%s'!\n", optarg);
+					return false;
+				}
+				break;
+			case 'b':
+				parameters->batch_size = strtoul(optarg, nullptr, 10);
+				break;
+			case 'q':
+				parameters->queue_depth = static_cast<unsigned int>(atoi(optarg));
+				break;
+			case 't':
+				parameters->shard_count = static_cast<unsigned int>(atoi(optarg));
+				break;
+			case 'f':
+				parameters->output_paths.push_back(optarg);
+				break;
+			case 'i':
+				parameters->input_file_name = optarg;
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	if (parameters->shard_count == 0)
+		parameters->shard_count = 1;
+
+	if (parameters->batch_size == 0)
+	{
+		print_usage(argv[0]);
+		return false;
+	}
+
+	// Page cache and storage costs differ a lot, so both a memory file system and the working directory are measured.
+	if (parameters->output_paths.empty())
+	{
+		struct stat shm_stat;
+		if (stat("/dev/shm", &shm_stat) == 0 && S_ISDIR(shm_stat.st_mode))
+			parameters->output_paths.push_back("/dev/shm/bench.pcap");
+		parameters->output_paths.push_back("bench.pcap");
+	}
+
+	return true;
+}
+
+const char* open_cycle_counter()
+{
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.size = sizeof(attributes);
+	attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+	attributes.inherit = 1;		// Threads created later are counted too.
+	attributes.exclude_hv = 1;
+
+	// Kernel cycles are part of the cost of writing; they are left out only if the kernel does not allow counting them.
+	cycle_counter_fd = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+	if (cycle_counter_fd >= 0)
+		return "CPU cycle counter";
+
+	attributes.exclude_kernel = 1;
+	cycle_counter_fd = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+	if (cycle_counter_fd >= 0)
+		return "CPU cycle counter, user space only";
+
+#if defined(__x86_64__) || defined(__i386__)
+	// Virtual machines often have no cycle counter; CPU time is then scaled by the time stamp counter rate.
+	const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+	const uint64_t start_ticks = __rdtsc();
+	this_thread::sleep_for(chrono::milliseconds(100));
+	const uint64_t ticks = __rdtsc() - start_ticks;
+	cycles_per_second = static_cast<double>(ticks) / chrono::duration<double>(chrono::steady_clock::now() - start_time)
+		.count();
+	return "CPU time x time stamp counter rate";
+#else
+	return "not available";
+#endif
+}
+
+measurement_t start_measurement()
+{
+	measurement_t start;
+	start.cycles = 0;
+	if (cycle_counter_fd >= 0 && read(cycle_counter_fd, &start.cycles, sizeof(start.cycles)) != sizeof(start.cycles))
+		start.cycles = 0;
+
+	timespec cpu_time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time);
+	start.cpu_seconds = static_cast<double>(cpu_time.tv_sec) + static_cast<double>(cpu_time.tv_nsec) / 1e9;
+	start.time = chrono::steady_clock::now();
+	return start;
+}
+
+void stop_measurement(const measurement_t& start, bench_result* result)
+{
+	const measurement_t stop = start_measurement();
+	result->seconds = chrono::duration<double>(stop.time - start.time).count();
+	result->cpu_seconds = stop.cpu_seconds - start.cpu_seconds;
+
+	if (cycle_counter_fd >= 0)
+		result->cycles = static_cast<double>(stop.cycles - start.cycles);
+	else
+		result->cycles = result->cpu_seconds * cycles_per_second;
+}
+
+const char* file_system_name(const string& path)
+{
+	const size_t separator = path.rfind('/');
+	const string directory = separator == string::npos ? "." : path.substr(0, separator > 0 ? separator : 1);
+
+	struct statfs file_system;
+	if (statfs(directory.c_str(), &file_system) != 0)
+		return "unknown";
+
+	switch (static_cast<unsigned long>(file_system.f_type))
+	{
+		case TMPFS_MAGIC:
+			return "tmpfs";
+		case EXT4_SUPER_MAGIC:
+			return "ext4";
+		case XFS_SUPER_MAGIC:
+			return "xfs";
+		case BTRFS_SUPER_MAGIC:
+			return "btrfs";
+		case OVERLAYFS_SUPER_MAGIC:
+			return "overlayfs";
+		case NFS_SUPER_MAGIC:
+			return "nfs";
+		default:
+			return "unknown";
+	}
+}
+
+void generate_packets(const cmd_parameters& parameters, vector<char>* payload, vector<PcapWriter::packet_t>* packets)
+{
+	static const uint16_t imix_sizes[] = {64, 576, 64, 64, 1500, 64, 576, 64, 576, 64, 576, 64};
+
+	payload->resize(9000);
+	for (size_t i = 0; i < payload->size(); ++i)
+		(*payload)[i] = static_cast<char>(i);
+
+	// A fixed seed makes every run write the same packets.
+	uint64_t random = 0x9e3779b97f4a7c15;
+	uint64_t timestamp = 1000000000ull * 1000000;		// Microseconds.
+
+	packets->resize(parameters.num_packets);
+	for (size_t i = 0; i < packets->size(); ++i)
+	{
+		random = random * 6364136223846793005ull + 1442695040888963407ull;
+		const uint32_t random_bits = static_cast<uint32_t>(random >> 33);
+
+		PcapWriter::packet_t& packet = (*packets)[i];
+		packet.frame = payload->data();
+		packet.original_size = 0;
+		switch (parameters.distribution)
+		{
+			case size_distribution::fixed:
+				packet.frame_size = parameters.packet_size;
+				break;
+			case size_distribution::minimum:
+				packet.frame_size = 64;
+				break;
+			case size_distribution::imix:
+				packet.frame_size = imix_sizes[i % 12];
+				break;
+			case size_distribution::jumbo:
+				packet.frame_size = 9000;
+				break;
+		}
+
+		switch (parameters.pattern)
+		{
+			case timestamp_pattern::uniform:
+				timestamp += 1;
+				break;
+			case timestamp_pattern::burst:
+				timestamp += i % 64 == 0 ? 100 : 0;
+				break;
+			case timestamp_pattern::jitter:
+				timestamp += random_bits % 4096 == 0 ? 1000 : random_bits % 3;
+				break;
+		}
+
+		packet.time.tv_sec = static_cast<time_t>(timestamp / 1000000);
+		packet.time.tv_usec = static_cast<suseconds_t>(timestamp % 1000000);
+	}
+}
+
+bool load_packets(const string& path, PcapReader* reader, vector<PcapWriter::packet_t>* packets)
+{
+	if (!reader->open(path))
+		return false;
+
+	packets->clear();
+	PcapReader::record_t record;
+	while (reader->next(&record))
+	{
+		PcapWriter::packet_t packet;
+		packet.frame = record.frame;
+		packet.frame_size = record.caplen;
+		packet.original_size = record.len;
+		packet.time.tv_sec = static_cast<time_t>(record.ts_sec);
+		packet.time.tv_usec = static_cast<suseconds_t>(record.ts_usec);
+		packets->push_back(packet);
+	}
+
+	return true;
+}
+
+template <class Writer>
+bool write_all(Writer& writer, const vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	bench_result* result)
+{
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	uint64_t bytes = 0;
+	if (batch_size == 0)
+	{
+		// Timing every call would cost as much as a buffered write_packet(), so 1 call in 64 is timed.
+		result->latencies.reserve(packets.size() / 64 + 1);
+		for (size_t i = 0; i < packets.size(); ++i)
+		{
+			const PcapWriter::packet_t& packet = packets[i];
+			if (i % 64 != 0)
+			{
+				const int written = writer.write_packet(packet.frame, packet.frame_size, packet.time);
+				if (written < 0)
+					return false;
+
+				bytes += static_cast<uint64_t>(written);
+				continue;
+			}
+
+			const chrono::steady_clock::time_point call_start = chrono::steady_clock::now();
+			const int written = writer.write_packet(packet.frame, packet.frame_size, packet.time);
+			if (written < 0)
+				return false;
+
+			result->latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - call_start).count());
+			bytes += static_cast<uint64_t>(written);
+		}
+	}
+	else
+	{
+		result->latencies.reserve(packets.size() / batch_size + 1);
+		for (size_t i = 0; i < packets.size(); i += batch_size)
+		{
+			const size_t count = packets.size() - i < batch_size ? packets.size() - i : batch_size;
+			const chrono::steady_clock::time_point call_start = chrono::steady_clock::now();
+			const long int written = writer.write_packets(&packets[i], count);
+			if (written < 0)
+				return false;
+
+			result->latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - call_start).count());
+			bytes += static_cast<uint64_t>(written);
+		}
+	}
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes;
+	return true;
+}
+
+bool write_sink(PcapSink* sink, const vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	bench_result* result)
+{
+	PcapWriter writer;
+	if (writer.write_pcap_header(sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, batch_size, result) || !sink->close())
+		return false;
+
+	// Closing is part of the measurement, so that buffered bytes are accounted for.
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_write_packet(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	fstream output_stream;
+	output_stream.open(parameters.output_file_name.c_str(), fstream::out | fstream::trunc);
+	if (!output_stream.good())
+		return false;
+
+	PcapWriter writer;
+	if (writer.write_pcap_header(&output_stream, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, 0, result))
+		return false;
+
+	// Closing is part of the measurement, so that buffered bytes are accounted for.
+	output_stream.close();
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_write_packets(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	return write_sink(&sink, packets, parameters.batch_size, result);
+}
+
+bool bench_direct(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	DirectSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	return write_sink(&sink, packets, parameters.batch_size, result);
+}
+
+bool bench_uring(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	UringSink sink(parameters.queue_depth);
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	if (!sink.uses_uring())
+		printf("io_uring is not available, using synchronous fallback.\n");
+
+	return write_sink(&sink, packets, parameters.batch_size, result);
+}
+
+bool bench_mmap(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	MmapSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	return write_sink(&sink, packets, parameters.batch_size, result);
+}
+
+/**
+ * Writes global header and all packets with a writer specialized for Ethernet and MmapSink, without stages, then
+ * closes the sink.
+ *
+ * @param sink The output sink.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+template <pcap_ts_resolution TsResolution>
+bool write_specialized(MmapSink* sink, const vector<PcapWriter::packet_t>& packets, bench_result* result)
+{
+	BasicPcapWriter<1, TsResolution, MmapSink> writer;		// Link type 1 = Ethernet
+	if (writer.write_pcap_header(sink) < 0)
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, 0, result) || !sink->close())
+		return false;
+
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_specialized(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	pcap_ts_resolution resolution, bool specialized, bench_result* result)
+{
+	MmapSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	if (!specialized)
+	{
+		PcapWriter writer;
+		if (writer.write_pcap_header(&sink, 1, resolution) < 0)		// Link type 1 = Ethernet
+			return false;
+
+		const measurement_t start = start_measurement();
+		if (!write_all(writer, packets, 0, result) || !sink.close())
+			return false;
+
+		stop_measurement(start, result);
+		return true;
+	}
+
+	if (resolution == pcap_ts_resolution::nanoseconds)
+		return write_specialized<pcap_ts_resolution::nanoseconds>(&sink, packets, result);
+
+	return write_specialized<pcap_ts_resolution::microseconds>(&sink, packets, result);
+}
+
+/**
+ * Writes global header and all packets with a writer into a MemorySink.
+ *
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+template <class Writer>
+bool write_memory(const vector<PcapWriter::packet_t>& packets, bench_result* result)
+{
+	MemorySink sink;
+	Writer writer;
+	if (writer.write_pcap_header(&sink, 1, pcap_ts_resolution::microseconds) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, 0, result))
+		return false;
+
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_writer_cost(const vector<PcapWriter::packet_t>& packets, writer_variant variant, bench_result* result)
+{
+	switch (variant)
+	{
+	case writer_variant::runtime:
+		return write_memory<PcapWriter>(packets, result);
+
+	case writer_variant::all_stages:
+		return write_memory<BasicPcapWriter<1, pcap_ts_resolution::microseconds, MemorySink, PCAP_ALL_STAGES,
+			RUNTIME_SNAPLEN>>(packets, result);
+
+	case writer_variant::specialized:
+		return write_memory<BasicPcapWriter<1, pcap_ts_resolution::microseconds, MemorySink>>(packets, result);
+	}
+
+	return false;
+}
+
+bool bench_pcapng(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapNgWriter writer;
+	if (writer.write_section_header(&sink) < 0)
+		return false;
+
+	const int interface_id = writer.add_interface(1);		// Link type 1 = Ethernet
+	if (interface_id < 0)
+		return false;
+
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < packets.size(); i += parameters.batch_size)
+	{
+		const size_t count = packets.size() - i < parameters.batch_size ? packets.size() - i : parameters.batch_size;
+		const long int written = writer.write_packets(static_cast<uint32_t>(interface_id), &packets[i], count);
+		if (written < 0)
+			return false;
+
+		bytes += static_cast<uint64_t>(written);
+	}
+
+	if (!sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes;
+	return true;
+}
+
+bool bench_async(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	AsyncPcapWriter writer;
+	if (writer.start(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	uint64_t bytes = 0;
+	for (const PcapWriter::packet_t& packet : packets)
+	{
+		const int written = writer.write_packet(packet.frame, packet.frame_size, packet.time);
+		if (written < 0)
+			return false;
+
+		bytes += static_cast<uint64_t>(written);
+	}
+
+	if (!writer.stop() || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes;
+	return true;
+}
+
+bool bench_async_capture(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	PacketPool* pool, bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	AsyncPcapWriter writer;
+	if (writer.start(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	vector<char> capture_buffer(65536);
+
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	uint64_t bytes = 0;
+	for (const PcapWriter::packet_t& packet : packets)
+	{
+		int written = 0;
+		if (!pool)
+		{
+			memcpy(capture_buffer.data(), packet.frame, packet.frame_size);
+			written = writer.write_packet(capture_buffer.data(), packet.frame_size, packet.time);
+		}
+		else
+		{
+			// Buffers come back as the writer thread drains them; an exhausted pool waits as a full ring would.
+			PacketBuffer buffer = pool->allocate(packet.frame_size);
+			while (!buffer)
+			{
+				this_thread::yield();
+				buffer = pool->allocate(packet.frame_size);
+			}
+
+			memcpy(buffer.data(), packet.frame, packet.frame_size);
+			buffer.set_size(packet.frame_size);
+			buffer.set_time(packet.time);
+			written = writer.write_packet(move(buffer));
+		}
+		if (written < 0)
+			return false;
+
+		bytes += static_cast<uint64_t>(written);
+	}
+
+	if (!writer.stop() || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes;
+	return true;
+}
+
+bool bench_async_overflow(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	AsyncPcapWriter::overflow_policy policy, bench_result* result, uint64_t* dropped)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	AsyncPcapWriter writer(ASYNC_OVERFLOW_RING_SIZE, policy);
+	if (writer.start(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	for (const PcapWriter::packet_t& packet : packets)
+	{
+		if (writer.write_packet(packet.frame, packet.frame_size, packet.time) < 0)
+			return false;
+	}
+
+	if (!writer.stop() || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = writer.written_packets();
+	*dropped = writer.dropped_packets();
+	if (writer.written_packets() + writer.dropped_packets() != packets.size())
+		return false;
+
+	// The file must hold exactly the packets counted as written; queued packets may still have been dropped since.
+	PcapReader reader;
+	if (!reader.open(parameters.output_file_name))
+		return false;
+
+	PcapReader::record_t record;
+	uint64_t records = 0;
+	result->bytes = 0;
+	while (reader.next(&record))
+	{
+		++records;
+		result->bytes += 16 + record.caplen;		// Record header is 16 bytes.
+	}
+
+	return records == writer.written_packets();
+}
+
+bool bench_sharded(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	bench_result* result)
+{
+	ShardedPcapWriter writer(parameters.output_file_name, parameters.shard_count);
+	if (!writer.open(1))		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+
+	atomic<uint64_t> bytes(0);
+	atomic<bool> failed(false);
+	writer.run([&](ShardedPcapWriter::Shard& shard)
+	{
+		const size_t share = (packets.size() + parameters.shard_count - 1) / parameters.shard_count;
+		const size_t first = share * shard.index();
+		const size_t last = first + share < packets.size() ? first + share : packets.size();
+
+		for (size_t i = first; i < last; i += parameters.batch_size)
+		{
+			const size_t count = last - i < parameters.batch_size ? last - i : parameters.batch_size;
+			const long int written = shard.write_packets(&packets[i], count);
+			if (written < 0)
+			{
+				failed.store(true);
+				return;
+			}
+
+			bytes += static_cast<uint64_t>(written);
+		}
+	});
+
+	if (!writer.close() || failed.load())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes.load();
+	result->latencies.clear();
+
+	for (unsigned int i = 0; i < parameters.shard_count; ++i)
+		unlink((parameters.output_file_name + "." + to_string(i) + ".pcap").c_str());
+	unlink((parameters.output_file_name + ".manifest").c_str());
+	return true;
+}
+
+bool bench_demux(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	unsigned int stream_count, unsigned int max_open_files, bench_result* result, uint64_t* evictions)
+{
+	DemuxPcapWriter writer(parameters.output_file_name, max_open_files);
+	if (!writer.open())
+		return false;
+
+	const measurement_t start = start_measurement();
+
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < packets.size(); ++i)
+	{
+		const PcapWriter::packet_t& packet = packets[i];
+		const uint64_t key = i / DEMUX_RUN_PACKETS % stream_count;
+		const int written = writer.write_packet(1, key, packet.frame, packet.frame_size, packet.time);		// Ethernet
+		if (written < 0)
+			return false;
+
+		bytes += static_cast<uint64_t>(written);
+	}
+
+	*evictions = writer.evictions();
+	bytes += static_cast<uint64_t>(writer.stream_count()) * 24;		// Global header is 24 bytes.
+	if (!writer.close())
+		return false;
+
+	stop_measurement(start, result);
+	result->packets = packets.size();
+	result->bytes = bytes;
+	result->latencies.clear();
+
+	for (unsigned int key = 0; key < stream_count; ++key)
+		unlink(writer.file_path(1, key).c_str());
+	return true;
+}
+
+bool bench_compressed(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	CompressedSink::codec compression, bench_result* result, uint64_t* compressed_bytes)
+{
+	CompressedSink sink(compression);
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	if (!write_sink(&sink, packets, parameters.batch_size, result))
+		return false;
+
+	*compressed_bytes = sink.bytes_out();
+	return true;
+}
+
+bool bench_indexed(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	uint32_t bloom_size, bench_result* result, uint64_t* blocks)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	const string index_file_name = parameters.output_file_name + ".idx";
+	PcapIndex index(4096, 100000000, bloom_size);
+	if (!index.open(index_file_name))
+		return false;
+
+	PcapWriter writer;
+	writer.set_index(&index);
+	if (writer.write_pcap_header(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, parameters.batch_size, result) || !sink.close() || !index.close())
+		return false;
+
+	stop_measurement(start, result);
+	*blocks = index.blocks();
+	unlink(index_file_name.c_str());
+	return true;
+}
+
+bool bench_stats(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	WriterStats* stats, bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapWriter writer;
+	if (stats)
+	{
+		stats->reset();
+		writer.set_stats(stats);
+	}
+
+	if (writer.write_pcap_header(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, batch_size, result) || !writer.flush() || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_coalesced(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	size_t buffer_size, unsigned int max_latency_ms, WriterStats* stats, bench_result* result, size_t* threshold)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapWriter writer;
+	if (stats)
+	{
+		stats->reset();
+		writer.set_stats(stats);
+	}
+
+	if (!writer.set_coalescing(buffer_size, max_latency_ms) || writer.write_pcap_header(&sink, 1) < 0)		// Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, 0, result))
+		return false;
+
+	*threshold = writer.coalescer().flush_threshold();
+	if (!writer.flush() || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	return true;
+}
+
+bool bench_idle_link(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	unsigned int max_latency_ms, WriterStats* stats, vector<double>* delays)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapWriter writer;
+	stats->reset();
+	writer.set_stats(stats);
+	if (!writer.set_coalescing(WriteCoalescer::DEFAULT_BUFFER_SIZE, max_latency_ms)
+		|| writer.write_pcap_header(&sink, 1) < 0)		// Link type 1 = Ethernet
+	{
+		return false;
+	}
+
+	const size_t count = packets.size() < IDLE_LINK_PACKETS ? packets.size() : IDLE_LINK_PACKETS;
+	vector<chrono::steady_clock::time_point> written_times;
+	written_times.reserve(count);
+	delays->clear();
+	uint64_t write_calls = 0;
+
+	// Every record written before the latest write system call is in the file.
+	auto check_written = [&]()
+	{
+		WriterStats::snapshot_t snapshot;
+		stats->snapshot(&snapshot);
+		if (snapshot.write_calls == write_calls)
+			return;
+
+		write_calls = snapshot.write_calls;
+		const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		for (size_t i = delays->size(); i < written_times.size(); ++i)
+			delays->push_back(chrono::duration<double>(now - written_times[i]).count());
+	};
+
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const chrono::nanoseconds packet_interval(1000000000 / IDLE_LINK_RATE);
+	const chrono::milliseconds poll_interval(IDLE_LINK_POLL_MS);
+	for (size_t i = 0; i <= count; ++i)
+	{
+		// After the last packet, the writer is polled until its records have been written.
+		const chrono::steady_clock::time_point due = i < count ? start + packet_interval * static_cast<long int>(i)
+			: chrono::steady_clock::now() + chrono::milliseconds(max_latency_ms) + poll_interval * 2;
+		while (chrono::steady_clock::now() < due && delays->size() < count)
+		{
+			const chrono::steady_clock::time_point wake_up = chrono::steady_clock::now() + poll_interval;
+			this_thread::sleep_until(wake_up < due ? wake_up : due);
+			if (!writer.poll())
+				return false;
+			check_written();
+		}
+
+		if (i == count)
+			break;
+
+		const PcapWriter::packet_t& packet = packets[i];
+		if (writer.write_packet(packet.frame, packet.frame_size, packet.time) < 0)
+			return false;
+		written_times.push_back(chrono::steady_clock::now());
+		check_written();
+	}
+
+	return writer.flush() && sink.close() && delays->size() == count;
+}
+
+bool bench_dedup(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	PacketDeduplicator* deduplicator, bench_result* result)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapWriter writer;
+	if (deduplicator)
+	{
+		deduplicator->clear();
+		deduplicator->reset_counters();
+		writer.set_deduplicator(deduplicator);
+	}
+
+	if (writer.write_pcap_header(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, parameters.batch_size, result) || !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	return true;
+}
+
+void bench_dedup_lookup(const vector<PcapWriter::packet_t>& packets, bench_result* result)
+{
+	PacketDeduplicator deduplicator(0);
+
+	const measurement_t start = start_measurement();
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < packets.size(); ++i)
+	{
+		deduplicator.accept(packets[i].frame, packets[i].frame_size, i);
+		bytes += packets[i].frame_size;
+	}
+	stop_measurement(start, result);
+
+	result->packets = packets.size();
+	result->bytes = bytes;
+	result->latencies.clear();
+}
+
+bool bench_durability(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets,
+	const DurabilityPolicy::level* durability, bench_result* result, uint64_t* syncs)
+{
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+		return false;
+
+	PcapWriter writer;
+	DurabilityPolicy policy(durability ? *durability : DurabilityPolicy::level::flush, DURABILITY_INTERVAL_BYTES,
+		DURABILITY_INTERVAL_MS);
+	if (durability)
+	{
+		policy.start(sink.descriptor());
+		writer.set_durability(&policy);
+	}
+
+	if (writer.write_pcap_header(&sink, 1) < 0)		// Link type 1 = Ethernet
+		return false;
+
+	const measurement_t start = start_measurement();
+	if (!write_all(writer, packets, parameters.batch_size, result) || !writer.flush() || !policy.stop()
+		|| !sink.close())
+		return false;
+
+	stop_measurement(start, result);
+	*syncs = policy.syncs();
+	return true;
+}
+
+void evict_file(const string& path)
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	// Dirty pages cannot be dropped, so they are written back first.
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+bool bench_read(const cmd_parameters& parameters, read_mode mode, bench_result* result)
+{
+	struct stat file_stat;
+	if (stat(parameters.output_file_name.c_str(), &file_stat) != 0)
+		return false;
+
+	evict_file(parameters.output_file_name);
+	const measurement_t start = start_measurement();
+
+	result->latencies.clear();
+	result->packets = 0;
+	if (mode == read_mode::raw)
+	{
+		const int fd = open(parameters.output_file_name.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		vector<char> buffer(1024 * 1024);
+		ssize_t count = 0;
+		while ((count = read(fd, buffer.data(), buffer.size())) > 0)
+			;
+		close(fd);
+
+		if (count < 0)
+			return false;
+	}
+	else
+	{
+		PcapReader reader;
+		if (!reader.open(parameters.output_file_name))
+			return false;
+
+		if (mode == read_mode::scan)
+		{
+			PcapReader::summary_t summary;
+			reader.scan(&summary);
+			result->packets = summary.packets;
+		}
+		else
+		{
+			// The first byte of every frame is read, as any consumer of records would.
+			PcapReader::record_t record;
+			volatile char first_byte = 0;
+			while (reader.next(&record))
+			{
+				if (record.caplen > 0)
+					first_byte = record.frame[0];
+				++result->packets;
+			}
+			(void)first_byte;
+		}
+	}
+
+	stop_measurement(start, result);
+	result->bytes = static_cast<uint64_t>(file_stat.st_size);
+	return true;
+}
+
+bool bench_compressed_read(const cmd_parameters& parameters, const string& compressed_file_name,
+	bench_result* result)
+{
+	CompressedReader reader;
+	if (!reader.open(compressed_file_name))
+		return false;
+
+	const int fd = open(parameters.output_file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || reader.size() != static_cast<uint64_t>(file_stat.st_size) || reader.size() == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	vector<char> buffer(COMPRESSED_READ_SIZE);
+	vector<char> expected(COMPRESSED_READ_SIZE);
+	uint64_t random = 0x9e3779b97f4a7c15;		// A fixed seed makes every run read the same ranges.
+	bool matches = true;
+
+	const measurement_t start = start_measurement();
+	result->latencies.clear();
+	result->bytes = 0;
+	for (result->packets = 0; result->packets < COMPRESSED_READ_COUNT && matches; ++result->packets)
+	{
+		random = random * 6364136223846793005ull + 1442695040888963407ull;
+		const uint64_t offset = (random >> 16) % reader.size();
+		const size_t count = static_cast<size_t>(random >> 48) % COMPRESSED_READ_SIZE + 1;
+
+		// Reads which run past the end of the file are cut short by both.
+		const long long int read_count = reader.read(offset, buffer.data(), count);
+		const ssize_t expected_count = pread(fd, expected.data(), count, static_cast<off_t>(offset));
+		matches = read_count >= 0 && read_count == expected_count
+			&& memcmp(buffer.data(), expected.data(), static_cast<size_t>(read_count)) == 0;
+		result->bytes += matches ? static_cast<uint64_t>(read_count) : 0;
+	}
+	stop_measurement(start, result);
+
+	close(fd);
+	return matches;
+}
+
+bool bench_slice(const cmd_parameters& parameters, slice_mode mode, bool use_slicer, bench_result* result)
+{
+	PcapReader reader;
+	if (!reader.open(parameters.output_file_name))
+		return false;
+
+	PcapReader::summary_t summary;
+	reader.scan(&summary);
+	const uint32_t snaplen = mode == slice_mode::snaplen ? 64 : reader.header().snaplen;
+	const uint64_t to = mode == slice_mode::half
+		? summary.first_timestamp + (summary.last_timestamp - summary.first_timestamp) / 2 : UINT64_MAX;
+	const string slice_file_name = parameters.output_file_name + ".slice";
+
+	result->latencies.clear();
+	result->packets = 0;
+	const measurement_t start = start_measurement();
+	long long int bytes = 0;
+	if (use_slicer)
+	{
+		PcapSlicer slicer;
+		if (!slicer.open(parameters.output_file_name))
+			return false;
+
+		slicer.set_time_range(0, to);
+		slicer.set_snaplen(mode == slice_mode::snaplen ? snaplen : 0);
+		bytes = slicer.slice(slice_file_name);
+		result->packets = slicer.statistics().records;
+	}
+	else
+	{
+		// Records are coalesced into large writes, as a tuned loop would; unbuffered it costs two syscalls each.
+		FdSink sink;
+		PcapWriter writer;
+		writer.set_snaplen(snaplen);
+		if (!sink.open(slice_file_name) || !writer.set_coalescing(WriteCoalescer::DEFAULT_BUFFER_SIZE, 0)
+			|| (bytes = writer.write_pcap_header(&sink, reader.header().linktype)) < 0)
+			return false;
+
+		PcapReader::record_t record;
+		while (reader.next(&record))
+		{
+			if (record.ts_sec * 1000000000ull + record.ts_nsec > to)
+				continue;
+
+			timeval time;
+			time.tv_sec = static_cast<time_t>(record.ts_sec);
+			time.tv_usec = static_cast<suseconds_t>(record.ts_usec);
+			const int written = writer.write_packet(record.frame, record.caplen, record.len, time);
+			if (written < 0)
+				return false;
+			bytes += written;
+			++result->packets;
+		}
+
+		if (!writer.flush() || !sink.close())
+			return false;
+	}
+
+	stop_measurement(start, result);
+	unlink(slice_file_name.c_str());
+	if (bytes < 0)
+		return false;
+
+	result->bytes = static_cast<uint64_t>(bytes);
+	return true;
+}
+
+void print_result(const char* name, bench_result& result)
+{
+	const double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+	const double packets = result.packets > 0 ? static_cast<double>(result.packets) : 1;
+	printf("%-24s %10zu pkts %8.3f s %10.3f Mpps %8.3f GB/s", name, result.packets, result.seconds,
+		static_cast<double>(result.packets) / seconds / 1e6, static_cast<double>(result.bytes) / seconds / 1e9);
+
+	if (result.packets == 0)
+		printf(" %16s", "");
+	else if (result.cycles > 0)
+		printf(" %8.0f cyc/pkt", result.cycles / packets);
+	else
+		printf(" %5.0f ns CPU/pkt", result.cpu_seconds * 1e9 / packets);
+
+	if (!result.latencies.empty())
+	{
+		vector<double>& latencies = result.latencies;
+		sort(latencies.begin(), latencies.end());
+		printf("  call p50 %8.1f us p99 %8.1f us p99.9 %8.1f us max %8.1f us", latencies[latencies.size() / 2] * 1e6,
+			latencies[latencies.size() * 99 / 100] * 1e6, latencies[latencies.size() * 999 / 1000] * 1e6,
+			latencies.back() * 1e6);
+	}
+
+	printf("\n");
+}
+
+bool run_suite(const cmd_parameters& parameters, const vector<PcapWriter::packet_t>& packets)
+{
+	bench_result result;
+	if (!bench_write_packet(parameters, packets, &result))
+	{
+		fprintf(stderr, "write_packet benchmark failed!\n");
+		return false;
+	}
+	print_result("write_packet (fstream)", result);
+
+	if (!bench_write_packets(parameters, packets, &result))
+	{
+		fprintf(stderr, "write_packets benchmark failed!\n");
+		return false;
+	}
+	print_result("write_packets (writev)", result);
+
+	// O_DIRECT is not supported by every file system (e.g. tmpfs), so its failure is not fatal.
+	if (bench_direct(parameters, packets, &result))
+		print_result("write_packets (O_DIRECT)", result);
+	else
+		printf("%-24s skipped, O_DIRECT is not available for '%s'\n", "write_packets (O_DIRECT)",
+			parameters.output_file_name.c_str());
+
+	if (!bench_uring(parameters, packets, &result))
+	{
+		fprintf(stderr, "io_uring benchmark failed!\n");
+		return false;
+	}
+	print_result("write_packets (io_uring)", result);
+
+	if (!bench_mmap(parameters, packets, &result))
+	{
+		fprintf(stderr, "mmap benchmark failed!\n");
+		return false;
+	}
+	print_result("write_packets (mmap)", result);
+
+	if (!bench_pcapng(parameters, packets, &result))
+	{
+		fprintf(stderr, "PcapNgWriter benchmark failed!\n");
+		return false;
+	}
+	print_result("PcapNgWriter (writev)", result);
+
+	if (!bench_async(parameters, packets, &result))
+	{
+		fprintf(stderr, "AsyncPcapWriter benchmark failed!\n");
+		return false;
+	}
+	print_result("AsyncPcapWriter (block)", result);
+
+	// A ring of the smallest size overflows under a flood; each policy must account for every packet.
+	const AsyncPcapWriter::overflow_policy policies[] =
+	{
+		AsyncPcapWriter::overflow_policy::block, AsyncPcapWriter::overflow_policy::drop_newest,
+		AsyncPcapWriter::overflow_policy::drop_oldest
+	};
+	const char* const policy_names[] = {"overflow (block)", "overflow (drop_newest)", "overflow (drop_oldest)"};
+	for (size_t i = 0; i < 3; ++i)
+	{
+		uint64_t dropped = 0;
+		if (!bench_async_overflow(parameters, packets, policies[i], &result, &dropped))
+		{
+			fprintf(stderr, "%s benchmark failed: written and dropped packets do not add up!\n", policy_names[i]);
+			return false;
+		}
+		print_result(policy_names[i], result);
+		printf("%-24s %llu written + %llu dropped of %zu packets\n", "",
+			static_cast<unsigned long long int>(result.packets), static_cast<unsigned long long int>(dropped),
+			packets.size());
+	}
+
+	if (!bench_sharded(parameters, packets, &result))
+	{
+		fprintf(stderr, "ShardedPcapWriter benchmark failed!\n");
+		return false;
+	}
+	print_result("ShardedPcapWriter", result);
+
+	// A small stream count fits the open file limit; a large one reopens a file for almost every run.
+	const unsigned int demux_streams[] = {16, 1024};
+	const char* const demux_names[] = {"DemuxPcapWriter (16)", "DemuxPcapWriter (1024)"};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		uint64_t evictions = 0;
+		if (!bench_demux(parameters, packets, demux_streams[i], 64, &result, &evictions))
+		{
+			fprintf(stderr, "%s benchmark failed!\n", demux_names[i]);
+			return false;
+		}
+		print_result(demux_names[i], result);
+		printf("%-24s %u streams, 64 open files, %llu evictions\n", "", demux_streams[i],
+			static_cast<unsigned long long int>(evictions));
+	}
+
+	// Plain and indexed runs are interleaved and the best of each is kept, so that page cache noise cancels out.
+	const uint32_t bloom_sizes[] = {0, 512};
+	const char* const index_names[] = {"write_packets (index)", "write_packets (bloom)"};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		bench_result plain_result;
+		bench_result indexed_result;
+		uint64_t index_blocks = 0;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_write_packets(parameters, packets, &result))
+			{
+				fprintf(stderr, "write_packets benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < plain_result.seconds)
+				plain_result = result;
+
+			if (!bench_indexed(parameters, packets, bloom_sizes[i], &result, &index_blocks))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", index_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < indexed_result.seconds)
+				indexed_result = result;
+		}
+		print_result(index_names[i], indexed_result);
+		printf("%-24s %llu blocks, overhead %+.1f %% (best of 3 against write_packets)\n", "",
+			static_cast<unsigned long long int>(index_blocks),
+			(indexed_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100);
+	}
+
+	// Runs with and without statistics are interleaved and the best of each is kept, as for the index above.
+	WriterStats stats;
+	const size_t stats_batch_sizes[] = {0, parameters.batch_size};
+	const char* const stats_names[] = {"write_packet (stats)", "write_packets (stats)"};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		bench_result plain_result;
+		bench_result stats_result;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_stats(parameters, packets, stats_batch_sizes[i], nullptr, &result))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", stats_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < plain_result.seconds)
+				plain_result = result;
+
+			if (!bench_stats(parameters, packets, stats_batch_sizes[i], &stats, &result))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", stats_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < stats_result.seconds)
+				stats_result = result;
+		}
+		print_result(stats_names[i], stats_result);
+
+		WriterStats::snapshot_t snapshot;
+		stats.snapshot(&snapshot);
+		printf("%-24s overhead %+.1f %% (best of 3), %llu system calls, %llu retries, write p50 %llu ns p99 %llu ns\n", "",
+			(stats_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100,
+			static_cast<unsigned long long int>(snapshot.write_calls),
+			static_cast<unsigned long long int>(snapshot.retries),
+			static_cast<unsigned long long int>(WriterStats::percentile(snapshot.write_latency, 0.5)),
+			static_cast<unsigned long long int>(WriterStats::percentile(snapshot.write_latency, 0.99)));
+	}
+
+	// Records coalesced in the writer's output buffer against write_packet() through a std::fstream, whose stream buffer
+	// is only a few KiB; runs are interleaved and the best of each is kept, then one more run counts system calls and
+	// flush latencies. A latency of 0 keeps the flush threshold at the buffer size, to compare with the adaptive one.
+	const size_t coalesce_sizes[] = {WriteCoalescer::MIN_BUFFER_SIZE, WriteCoalescer::MAX_BUFFER_SIZE,
+		WriteCoalescer::MAX_BUFFER_SIZE};
+	const unsigned int coalesce_latencies[] = {100, 100, 0};
+	const char* const coalesce_names[] = {"coalesced (1 MiB)", "coalesced (64 MiB)", "coalesced (64 MiB, full)"};
+	for (size_t i = 0; i < 3; ++i)
+	{
+		bench_result fstream_result;
+		bench_result coalesced_result;
+		size_t threshold = 0;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_write_packet(parameters, packets, &result))
+			{
+				fprintf(stderr, "write_packet benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < fstream_result.seconds)
+				fstream_result = result;
+
+			if (!bench_coalesced(parameters, packets, coalesce_sizes[i], coalesce_latencies[i], nullptr, &result,
+				&threshold))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", coalesce_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < coalesced_result.seconds)
+				coalesced_result = result;
+		}
+		print_result(coalesce_names[i], coalesced_result);
+
+		if (!bench_coalesced(parameters, packets, coalesce_sizes[i], coalesce_latencies[i], &stats, &result,
+			&threshold))
+		{
+			fprintf(stderr, "%s benchmark failed!\n", coalesce_names[i]);
+			return false;
+		}
+
+		WriterStats::snapshot_t snapshot;
+		stats.snapshot(&snapshot);
+		printf("%-24s %+.1f %% against fstream (best of 3), %llu system calls, threshold %zu KiB, flush p99 %llu us\n",
+			"", (coalesced_result.seconds / (fstream_result.seconds > 0 ? fstream_result.seconds : 1e-9) - 1) * 100,
+			static_cast<unsigned long long int>(snapshot.write_calls), threshold / 1024,
+			static_cast<unsigned long long int>(WriterStats::percentile(snapshot.flush_latency, 0.99) / 1000));
+	}
+
+	// A slow link: each record must reach the file within the maximum latency, plus the poll interval.
+	vector<double> delays;
+	if (!bench_idle_link(parameters, packets, 100, &stats, &delays))
+	{
+		fprintf(stderr, "Idle link benchmark failed!\n");
+		return false;
+	}
+	sort(delays.begin(), delays.end());
+	WriterStats::snapshot_t idle_snapshot;
+	stats.snapshot(&idle_snapshot);
+	printf("%-24s %10zu pkts at %u pps, 100 ms latency: %llu system calls, delay p50 %.1f ms max %.1f ms\n",
+		"coalesced (idle link)", delays.size(), IDLE_LINK_RATE,
+		static_cast<unsigned long long int>(idle_snapshot.write_calls), delays[delays.size() / 2] * 1e3,
+		delays.back() * 1e3);
+
+	// Runs with and without deduplication are interleaved and the best of each is kept, as for the index above. The
+	// window is 0, so only identical packets with the same timestamp are removed.
+	PacketDeduplicator deduplicator(0);
+	bench_result plain_result;
+	bench_result dedup_result;
+	for (int run = 0; run < 3; ++run)
+	{
+		if (!bench_dedup(parameters, packets, nullptr, &result))
+		{
+			fprintf(stderr, "write_packets benchmark failed!\n");
+			return false;
+		}
+		if (run == 0 || result.seconds < plain_result.seconds)
+			plain_result = result;
+
+		if (!bench_dedup(parameters, packets, &deduplicator, &result))
+		{
+			fprintf(stderr, "PacketDeduplicator benchmark failed!\n");
+			return false;
+		}
+		if (run == 0 || result.seconds < dedup_result.seconds)
+			dedup_result = result;
+	}
+	print_result("write_packets (dedup)", dedup_result);
+	printf("%-24s overhead %+.1f %% (best of 3), %llu duplicates, %llu evictions\n", "",
+		(dedup_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100,
+		static_cast<unsigned long long int>(deduplicator.counters().duplicates),
+		static_cast<unsigned long long int>(deduplicator.counters().evictions));
+
+	bench_dedup_lookup(packets, &result);
+	print_result("PacketDeduplicator", result);
+
+	// Each durability level is run after a run without any policy, and the best of 3 of each is kept.
+	const DurabilityPolicy::level levels[] =
+	{
+		DurabilityPolicy::level::flush, DurabilityPolicy::level::writeback, DurabilityPolicy::level::data,
+		DurabilityPolicy::level::full
+	};
+	const char* const level_names[] =
+	{
+		"durability (flush)", "durability (writeback)", "durability (fdatasync)", "durability (fsync)"
+	};
+	for (size_t i = 0; i < 4; ++i)
+	{
+		bench_result durable_result;
+		uint64_t syncs = 0;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_durability(parameters, packets, nullptr, &result, &syncs))
+			{
+				fprintf(stderr, "write_packets benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < plain_result.seconds)
+				plain_result = result;
+
+			if (!bench_durability(parameters, packets, &levels[i], &result, &syncs))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", level_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < durable_result.seconds)
+				durable_result = result;
+		}
+		print_result(level_names[i], durable_result);
+		printf("%-24s overhead %+.1f %% (best of 3), %llu syncs, every %llu MiB or %u ms\n", "",
+			(durable_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100,
+			static_cast<unsigned long long int>(syncs),
+			static_cast<unsigned long long int>(DURABILITY_INTERVAL_BYTES / (1024 * 1024)), DURABILITY_INTERVAL_MS);
+	}
+
+	// PcapWriter and the specialized writer are interleaved and the best of each is kept, as for the index above.
+	const pcap_ts_resolution resolutions[] = {pcap_ts_resolution::microseconds, pcap_ts_resolution::nanoseconds};
+	const char* const specialized_names[] = {"BasicPcapWriter (us)", "BasicPcapWriter (ns)"};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		bench_result specialized_result;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_specialized(parameters, packets, resolutions[i], false, &result))
+			{
+				fprintf(stderr, "write_packet benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < plain_result.seconds)
+				plain_result = result;
+
+			if (!bench_specialized(parameters, packets, resolutions[i], true, &result))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", specialized_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < specialized_result.seconds)
+				specialized_result = result;
+		}
+		print_result(specialized_names[i], specialized_result);
+		printf("%-24s overhead %+.1f %% (best of 3 against PcapWriter), %+.0f cycles/packet\n", "",
+			(specialized_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100,
+			(specialized_result.cycles - plain_result.cycles) / static_cast<double>(packets.size() ? packets.size() : 1));
+	}
+
+	// Page faults of the mapping above hide the cost of the writer itself, which is measured into memory instead.
+	const writer_variant variants[] = {writer_variant::runtime, writer_variant::all_stages,
+		writer_variant::specialized};
+	bench_result variant_results[3];
+	for (int run = 0; run < MEMORY_BENCH_RUNS; ++run)
+	{
+		for (size_t i = 0; i < 3; ++i)
+		{
+			if (!bench_writer_cost(packets, variants[i], &result))
+			{
+				fprintf(stderr, "Writer cost benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < variant_results[i].seconds)
+				variant_results[i] = result;
+		}
+	}
+
+	const double packet_count = static_cast<double>(packets.size() ? packets.size() : 1);
+	print_result("BasicPcapWriter (memory)", variant_results[2]);
+	printf("%-24s %.2f ns/packet against %.2f with every stage compiled in and %.2f for PcapWriter (best of %d)\n", "",
+		variant_results[2].seconds * 1e9 / packet_count, variant_results[1].seconds * 1e9 / packet_count,
+		variant_results[0].seconds * 1e9 / packet_count, MEMORY_BENCH_RUNS);
+
+	// Capture into a single buffer and into pool buffers is interleaved and the best of each is kept, as for the index
+	// above. Allocation failures count the times the capture loop had to wait for buffers to come back.
+	PacketPool pool;
+	bench_result pool_result;
+	for (int run = 0; run < 3; ++run)
+	{
+		if (!bench_async_capture(parameters, packets, nullptr, &result))
+		{
+			fprintf(stderr, "AsyncPcapWriter benchmark failed!\n");
+			return false;
+		}
+		if (run == 0 || result.seconds < plain_result.seconds)
+			plain_result = result;
+
+		if (!bench_async_capture(parameters, packets, &pool, &result))
+		{
+			fprintf(stderr, "PacketPool benchmark failed!\n");
+			return false;
+		}
+		if (run == 0 || result.seconds < pool_result.seconds)
+			pool_result = result;
+	}
+	print_result("AsyncPcapWriter (copy)", plain_result);
+	print_result("AsyncPcapWriter (pool)", pool_result);
+	printf("%-24s overhead %+.1f %% (best of 3), %llu allocation failures, %s pages, NUMA node %d\n", "",
+		(pool_result.seconds / (plain_result.seconds > 0 ? plain_result.seconds : 1e-9) - 1) * 100,
+		static_cast<unsigned long long int>(pool.allocation_failures()), pool.huge_pages() ? "huge" : "regular",
+		pool.numa_node());
+
+	// Rates are of uncompressed bytes; codecs which have not been compiled in are skipped.
+	const CompressedSink::codec codecs[] = {CompressedSink::codec::lz4, CompressedSink::codec::zstd};
+	const char* const codec_names[] = {"CompressedSink (lz4)", "CompressedSink (zstd)"};
+	const char* const codec_extensions[] = {".lz4", ".zst"};
+	bool compressed_files[] = {false, false};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		if (!CompressedSink::available(codecs[i]))
+		{
+			printf("%-24s skipped, codec is not available\n", codec_names[i]);
+			continue;
+		}
+
+		uint64_t compressed_bytes = 0;
+		if (!bench_compressed(parameters, packets, codecs[i], &result, &compressed_bytes))
+		{
+			fprintf(stderr, "%s benchmark failed!\n", codec_names[i]);
+			return false;
+		}
+		print_result(codec_names[i], result);
+		printf("%-24s ratio %.2f (%.2f MB to %.2f MB)\n", "", static_cast<double>(result.bytes + 24)
+			/ static_cast<double>(compressed_bytes ? compressed_bytes : 1), static_cast<double>(result.bytes + 24) / 1e6,
+			static_cast<double>(compressed_bytes) / 1e6);
+
+		// Compressed files are kept to be read back against the plain file below.
+		compressed_files[i] = rename(parameters.output_file_name.c_str(),
+			(parameters.output_file_name + codec_extensions[i]).c_str()) == 0;
+	}
+
+	// The read paths are measured on a plain pcap file of the same packets.
+	if (!bench_write_packets(parameters, packets, &result))
+	{
+		fprintf(stderr, "write_packets benchmark failed!\n");
+		return false;
+	}
+
+	const char* const reader_names[] = {"CompressedReader (lz4)", "CompressedReader (zstd)"};
+	for (size_t i = 0; i < 2; ++i)
+	{
+		if (!compressed_files[i])
+			continue;
+
+		const string compressed_file_name = parameters.output_file_name + codec_extensions[i];
+		const bool matches = bench_compressed_read(parameters, compressed_file_name, &result);
+		unlink(compressed_file_name.c_str());
+		if (!matches)
+		{
+			fprintf(stderr, "%s benchmark failed, reads do not match the plain file!\n", reader_names[i]);
+			return false;
+		}
+		print_result(reader_names[i], result);
+		printf("%-24s %zu random reads of up to %zu bytes match the plain file\n", "", result.packets,
+			COMPRESSED_READ_SIZE);
+	}
+
+	const read_mode read_modes[] = {read_mode::raw, read_mode::records, read_mode::scan};
+	const char* const read_names[] = {"read (1 MiB)", "PcapReader (next)", "PcapReader (scan)"};
+	for (size_t i = 0; i < 3; ++i)
+	{
+		if (!bench_read(parameters, read_modes[i], &result))
+		{
+			fprintf(stderr, "%s benchmark failed!\n", read_names[i]);
+			return false;
+		}
+		print_result(read_names[i], result);
+	}
+
+	// Slicer and write_packet() loop runs are interleaved and the best of each is kept, as for the index above.
+	const slice_mode slice_modes[] = {slice_mode::copy, slice_mode::snaplen, slice_mode::half};
+	const char* const slice_names[] = {"PcapSlicer (copy)", "PcapSlicer (snaplen 64)", "PcapSlicer (half)"};
+	for (size_t i = 0; i < 3; ++i)
+	{
+		bench_result loop_result;
+		bench_result slicer_result;
+		for (int run = 0; run < 3; ++run)
+		{
+			if (!bench_slice(parameters, slice_modes[i], false, &result))
+			{
+				fprintf(stderr, "write_packet loop benchmark failed!\n");
+				return false;
+			}
+			if (run == 0 || result.seconds < loop_result.seconds)
+				loop_result = result;
+
+			if (!bench_slice(parameters, slice_modes[i], true, &result))
+			{
+				fprintf(stderr, "%s benchmark failed!\n", slice_names[i]);
+				return false;
+			}
+			if (run == 0 || result.seconds < slicer_result.seconds)
+				slicer_result = result;
+		}
+		print_result(slice_names[i], slicer_result);
+		printf("%-24s %.2f GB/s against %.2f GB/s of next() + write_packet() (best of 3)\n", "",
+			static_cast<double>(slicer_result.bytes) / (slicer_result.seconds > 0 ? slicer_result.seconds : 1e-9) / 1e9,
+			static_cast<double>(loop_result.bytes) / (loop_result.seconds > 0 ? loop_result.seconds : 1e-9) / 1e9);
+	}
+
+	unlink(parameters.output_file_name.c_str());
+	return true;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then generates synthetic packets (or loads those of
+ * a trace). For each output path, it writes them through every benchmarked write path, printing packet and byte rates,
+ * CPU cycles per packet and call latencies for each of them, and the compression ratio of compressed sinks. Then it
+ * reads the written file back from cold cache, and copies parts of it with PcapSlicer and with a write_packet() loop.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	vector<char> payload;
+	vector<PcapWriter::packet_t> packets;
+	PcapReader trace;
+	if (parameters.input_file_name.empty())
+	{
+		generate_packets(parameters, &payload, &packets);
+	}
+	else if (!load_packets(parameters.input_file_name, &trace, &packets))
+	{
+		fprintf(stderr, "Could not open trace '%s'!\n", parameters.input_file_name.c_str());
+		return EXIT_FAILURE;
+	}
+
+	uint64_t frame_bytes = 0;
+	for (const PcapWriter::packet_t& packet : packets)
+		frame_bytes += packet.frame_size;
+
+	printf("%zu packets, %.1f bytes on average; cycles: %s\n", packets.size(),
+		packets.empty() ? 0.0 : static_cast<double>(frame_bytes) / static_cast<double>(packets.size()),
+		open_cycle_counter());
+
+	for (const string& path : parameters.output_paths)
+	{
+		printf("\n== %s (%s)\n", path.c_str(), file_system_name(path));
+
+		parameters.output_file_name = path;
+		if (!run_suite(parameters, packets))
+			return EXIT_FAILURE;
+	}
+
+	if (cycle_counter_fd >= 0)
+		close(cycle_counter_fd);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,659 @@
+#ifndef PCAP_WRITER_BENCH_H_
+#define PCAP_WRITER_BENCH_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AsyncPcapWriter.h"
+#include "CompressedSink.h"
+#include "DurabilityPolicy.h"
+#include "PacketDeduplicator.h"
+#include "PacketPool.h"
+#include "PcapIndex.h"
+#include "PcapReader.h"
+#include "PcapSlicer.h"
+#include "PcapWriter.h"
+#include "WriterStats.h"
+
+/// Ring size of the overflow benchmarks in bytes, the smallest one AsyncPcapWriter accepts
+constexpr size_t ASYNC_OVERFLOW_RING_SIZE = 256 * 1024;
+
+/// Number of random reads of the compressed read benchmarks
+constexpr size_t COMPRESSED_READ_COUNT = 1000;
+
+/// Maximum size of a random read of the compressed read benchmarks in bytes
+constexpr size_t COMPRESSED_READ_SIZE = 64 * 1024;
+
+/// Number of consecutive packets of one stream in the demultiplexing benchmarks
+constexpr size_t DEMUX_RUN_PACKETS = 16;
+
+/// Packet rate of the idle link benchmark in packets per second
+constexpr unsigned int IDLE_LINK_RATE = 200;
+
+/// Number of packets of the idle link benchmark
+constexpr size_t IDLE_LINK_PACKETS = 100;
+
+/// Time the idle link benchmark sleeps between polls of the writer in milliseconds, as PacketRing::capture() does
+constexpr unsigned int IDLE_LINK_POLL_MS = 20;
+
+/// Number of bytes between checkpoints of the durability benchmarks
+constexpr uint64_t DURABILITY_INTERVAL_BYTES = 4 * 1024 * 1024;
+
+/// Time between checkpoints of the durability benchmarks in milliseconds
+constexpr unsigned int DURABILITY_INTERVAL_MS = 100;
+
+/// Size of the buffer of MemorySink in bytes, small enough to stay in cache
+constexpr size_t MEMORY_SINK_SIZE = 1024 * 1024;
+
+/// Number of runs of each writer of the memory benchmarks, the best of which is kept
+constexpr int MEMORY_BENCH_RUNS = 10;
+
+/// Sizes of synthetic packets.
+enum class size_distribution
+{
+	/// Every packet has the size given by -s
+	fixed,
+
+	/// Minimum Ethernet frames of 64 bytes
+	minimum,
+
+	/// Simple IMIX: 7 of every 12 packets have 64 bytes, 4 have 576 bytes and 1 has 1500 bytes
+	imix,
+
+	/// Jumbo frames of 9000 bytes
+	jumbo
+};
+
+/// Timestamps of synthetic packets.
+enum class timestamp_pattern
+{
+	/// One packet every microsecond
+	uniform,
+
+	/// Bursts of 64 packets with the same timestamp, 100 microseconds apart
+	burst,
+
+	/// Random gaps of 0 to 2 microseconds, with an idle millisecond every 4096 packets on average
+	jitter
+};
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Number of packets to write in each benchmark
+	size_t num_packets;
+
+	/// Length of each synthetic packet
+	uint16_t packet_size;
+
+	/// Number of packets passed to each write_packets() call
+	size_t batch_size;
+
+	/// Number of writes in flight for io_uring sink
+	unsigned int queue_depth;
+
+	/// Number of shards (worker threads) of sharded writer
+	unsigned int shard_count;
+
+	/// Sizes of synthetic packets
+	size_distribution distribution;
+
+	/// Timestamps of synthetic packets
+	timestamp_pattern pattern;
+
+	/// Output file paths; the whole suite runs once for each of them, e.g. on tmpfs and on a disk
+	std::vector<std::string> output_paths;
+
+	/// Output file path of the running suite, one of output_paths
+	std::string output_file_name;
+
+	/// Trace whose packets are written instead of synthetic ones, or empty
+	std::string input_file_name;
+};
+
+/// Writers compared by bench_writer_cost().
+enum class writer_variant
+{
+	/// PcapWriter, through the virtual functions of the sink
+	runtime,
+
+	/// BasicPcapWriter for Ethernet, microseconds and MemorySink, with every stage and a runtime snapshot length
+	all_stages,
+
+	/// BasicPcapWriter for Ethernet, microseconds and MemorySink, without stages and with the default snapshot length
+	specialized
+};
+
+/**
+ * Sink which copies records into a buffer of MEMORY_SINK_SIZE bytes, starting over at its beginning when it is full,
+ * so that the cost of a writer is measured without any I/O.
+ */
+class MemorySink : public PcapSink
+{
+public:
+	MemorySink()
+	: buffer(MEMORY_SINK_SIZE)
+	, used(0)
+	{
+	}
+
+	inline bool write(const void* data, size_t count) override
+	{
+		if (count > buffer.size())
+			return false;
+
+		if (used + count > buffer.size())
+			used = 0;
+
+		memcpy(buffer.data() + used, data, count);
+		used += count;
+		return true;
+	}
+
+	bool flush() override
+	{
+		return true;
+	}
+
+	bool close() override
+	{
+		return true;
+	}
+
+private:
+	/// Buffer the records are copied into
+	std::vector<char> buffer;
+
+	/// Number of bytes of the buffer written since it was last started over
+	size_t used;
+};
+
+/// How bench_read() reads the output file.
+enum class read_mode
+{
+	/// PcapReader::next() for every record
+	records,
+
+	/// PcapReader::scan() of record headers
+	scan,
+
+	/// read() system calls of 1 MiB, the bandwidth of the storage
+	raw
+};
+
+/// Which records bench_slice() copies.
+enum class slice_mode
+{
+	/// Every record as it is
+	copy,
+
+	/// Every record truncated to 64 bytes, so every header is rewritten
+	snaplen,
+
+	/// Records of the first half of the time range
+	half
+};
+
+/// Result of a single benchmark run.
+struct bench_result
+{
+	/// Number of packets has been written
+	size_t packets;
+
+	/// Number of bytes has been written, including pcap headers
+	uint64_t bytes;
+
+	/// Elapsed wall clock time in seconds
+	double seconds;
+
+	/// CPU time of the process, all threads included, in seconds
+	double cpu_seconds;
+
+	/// CPU cycles of the process, all threads included, or 0 if they cannot be measured
+	double cycles;
+
+	/// Latency of each write_packet() or write_packets() call in seconds, empty for other write paths
+	std::vector<double> latencies;
+};
+
+/// Start of a measurement, see start_measurement().
+struct measurement_t
+{
+	/// Wall clock time
+	std::chrono::steady_clock::time_point time;
+
+	/// CPU time of the process in seconds
+	double cpu_seconds;
+
+	/// Value of the CPU cycle counter, or 0 if there is none
+	uint64_t cycles;
+};
+
+/// Hardware CPU cycle counter of the process (perf_event_open), or -1 if cycles are estimated from CPU time
+extern int cycle_counter_fd;
+
+/// Time stamp counter rate, used to estimate cycles from CPU time, or 0 if it is unknown
+extern double cycles_per_second;
+
+/// Prints how to use pcap writer benchmark.
+void print_usage(char* program_name);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+/**
+ * Opens the hardware CPU cycle counter of the process if the kernel and the CPU provide one. Otherwise, measures the
+ * rate of the time stamp counter, so cycles are estimated from CPU time.
+ *
+ * @return Description of how cycles are measured.
+ */
+const char* open_cycle_counter();
+
+/// @return Measurement started now.
+measurement_t start_measurement();
+
+/**
+ * Ends a measurement, and fills elapsed wall clock time, CPU time and cycles of a result.
+ *
+ * @param start Start of the measurement.
+ * @param result Benchmark result to fill.
+ */
+void stop_measurement(const measurement_t& start, bench_result* result);
+
+/**
+ * @param path A file path.
+ * @return Name of the file system type of the path's directory ("tmpfs", "ext4", ...), or "unknown".
+ */
+const char* file_system_name(const std::string& path);
+
+/**
+ * Generates synthetic packets with sizes and timestamps chosen by parameters. All frames share the given payload
+ * buffer.
+ *
+ * @param parameters Benchmark parameters.
+ * @param payload Buffer holding frame data, filled by this function.
+ * @param packets Packet descriptors, filled by this function.
+ */
+void generate_packets(const cmd_parameters& parameters, std::vector<char>* payload,
+	std::vector<PcapWriter::packet_t>* packets);
+
+/**
+ * Loads every packet of a trace. Frames point into the reader's mapping of the file.
+ *
+ * @param path The trace file path.
+ * @param reader Reader of the trace, which must stay open while packets are used.
+ * @param packets Packet descriptors, filled by this function.
+ * @return True if the trace has been opened; otherwise false.
+ */
+bool load_packets(const std::string& path, PcapReader* reader, std::vector<PcapWriter::packet_t>* packets);
+
+/**
+ * Writes all packets with an already initialized writer and measures elapsed time.
+ *
+ * @param writer Pcap writer whose global header has been written, PcapWriter or another BasicPcapWriter.
+ * @param packets Packets to write.
+ * @param batch_size Number of packets per write_packets() call, or 0 to write packets one by one with write_packet().
+ * @param result Benchmark result to fill; latency of each write_packets() call is recorded.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+template <class Writer>
+bool write_all(Writer& writer, const std::vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	bench_result* result);
+
+/**
+ * Writes global header and all packets to an opened sink, then closes it. Elapsed time includes closing the sink.
+ *
+ * @param sink The output sink.
+ * @param packets Packets to write.
+ * @param batch_size Number of packets per write_packets() call, or 0 to write packets one by one with write_packet().
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool write_sink(PcapSink* sink, const std::vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	bench_result* result);
+
+/**
+ * Writes packets one by one with write_packet() through a std::fstream.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_write_packet(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets in batches with write_packets() through a file descriptor sink.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_write_packets(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets in batches with write_packets() through an O_DIRECT sink.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_direct(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets in batches with write_packets() through an io_uring sink, or its synchronous fallback.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_uring(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets in batches with write_packets() through a memory-mapped sink.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_mmap(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets one by one with write_packet() through a memory-mapped sink, either with PcapWriter or with a
+ * BasicPcapWriter specialized for Ethernet, the given resolution and MmapSink, without stages. Elapsed time includes
+ * closing the sink.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param resolution Resolution of record timestamps, microseconds or nanoseconds.
+ * @param specialized True to write with the specialized writer, false with PcapWriter.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_specialized(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	pcap_ts_resolution resolution, bool specialized, bench_result* result);
+
+/**
+ * Writes packets one by one with write_packet() into a MemorySink, so that only the cost of the writer is measured.
+ *
+ * @param packets Packets to write.
+ * @param variant Writer to write with.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_writer_cost(const std::vector<PcapWriter::packet_t>& packets, writer_variant variant, bench_result* result);
+
+/**
+ * Writes packets in batches with PcapNgWriter::write_packets() through a file descriptor sink, to compare pcapng with
+ * the classic format written by bench_write_packets().
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_pcapng(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Queues packets one by one into an AsyncPcapWriter which writes them through a file descriptor sink. Elapsed time
+ * includes draining the ring.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_async(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Captures packets one by one into an AsyncPcapWriter, as a capture loop would: each frame is copied once to stand
+ * for its reception, either into a capture buffer which write_packet() then copies into the ring, or into a pool
+ * buffer handed over to the writer. Elapsed time includes draining the ring.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param pool Pool to capture into, or nullptr to capture into a single buffer.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_async_capture(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	PacketPool* pool, bench_result* result);
+
+/**
+ * Queues packets one by one as fast as possible into an AsyncPcapWriter with a ring of ASYNC_OVERFLOW_RING_SIZE
+ * bytes, so that the ring overflows and the policy applies. Every packet must be either written or counted as
+ * dropped, and the output file must hold the written ones.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param policy What the writer does when the ring is full.
+ * @param result Benchmark result to fill, with the number of written packets.
+ * @param dropped Number of dropped packets, filled by this function.
+ * @return True if all packets have been accounted for and the file holds the written ones; otherwise false.
+ */
+bool bench_async_overflow(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	AsyncPcapWriter::overflow_policy policy, bench_result* result, uint64_t* dropped);
+
+/**
+ * Writes packets in batches through a ShardedPcapWriter, every worker thread writing an equal share of the packets
+ * to its own shard file. Shard files and manifest are removed afterwards.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_sharded(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	bench_result* result);
+
+/**
+ * Writes packets one by one through a DemuxPcapWriter, as runs of DEMUX_RUN_PACKETS packets of each stream in turn, so
+ * that every stream is written to its own file. With more streams than open files, every run reopens a file. Stream
+ * files are removed afterwards.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param stream_count Number of streams.
+ * @param max_open_files Maximum number of open files of the writer.
+ * @param result Benchmark result to fill.
+ * @param evictions Number of files closed to stay within max_open_files, filled by this function.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_demux(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	unsigned int stream_count, unsigned int max_open_files, bench_result* result, uint64_t* evictions);
+
+/**
+ * Writes packets in batches with write_packets() through a compressed sink. Elapsed time includes compressing the
+ * last frames and closing the sink.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param compression Compression format.
+ * @param result Benchmark result to fill.
+ * @param compressed_bytes Size of the compressed file, filled by this function.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_compressed(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	CompressedSink::codec compression, bench_result* result, uint64_t* compressed_bytes);
+
+/**
+ * Writes packets in batches with write_packets() through a file descriptor sink while building a sidecar index, to
+ * compare with bench_write_packets(). The index file is removed afterwards.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param bloom_size Size of the bloom filter of each index block, 0 not to index flows.
+ * @param result Benchmark result to fill.
+ * @param blocks Number of index blocks, filled by this function.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_indexed(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	uint32_t bloom_size, bench_result* result, uint64_t* blocks);
+
+/**
+ * Writes packets through a file descriptor sink with a writer which counts in the given statistics, to measure the
+ * cost of instrumentation against the same writer without statistics.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param batch_size Number of packets per write_packets() call, or 0 to write them one by one with write_packet().
+ * @param stats Statistics of the writer, or nullptr not to count.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_stats(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets, size_t batch_size,
+	WriterStats* stats, bench_result* result);
+
+/**
+ * Writes packets one by one with write_packet() through a file descriptor sink, with records coalesced in the output
+ * buffer of the writer (see PcapWriter::set_coalescing()). Elapsed time includes the final flush.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param buffer_size Size of the output buffer in bytes.
+ * @param max_latency_ms Maximum latency of buffered records, or 0 to write the buffer only when it is full.
+ * @param stats Statistics of the writer, reset first, or nullptr not to count.
+ * @param result Benchmark result to fill.
+ * @param threshold Flush threshold of the buffer after the last packet, filled by this function.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_coalesced(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	size_t buffer_size, unsigned int max_latency_ms, WriterStats* stats, bench_result* result, size_t* threshold);
+
+/**
+ * Writes IDLE_LINK_PACKETS packets at IDLE_LINK_RATE through a writer with a coalescing buffer, polling it every
+ * IDLE_LINK_POLL_MS between packets as a capture loop would, and measures how long each record takes to reach the
+ * file: a record is in the file once the sink has issued a write system call after it, as counted by the statistics.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write, of which the first IDLE_LINK_PACKETS are used.
+ * @param max_latency_ms Maximum latency of buffered records.
+ * @param stats Statistics of the writer, reset first.
+ * @param delays Time each record has taken to reach the file in seconds, filled by this function.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_idle_link(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	unsigned int max_latency_ms, WriterStats* stats, std::vector<double>* delays);
+
+/**
+ * Writes packets in batches with write_packets() through a file descriptor sink, removing duplicates with the given
+ * deduplicator, to measure the cost of deduplication against the same writer without it.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param deduplicator Deduplicator of the writer, or nullptr to write every packet.
+ * @param result Benchmark result to fill.
+ * @return True if all packets have been written successfully; otherwise false.
+ */
+bool bench_dedup(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	PacketDeduplicator* deduplicator, bench_result* result);
+
+/**
+ * Looks up every packet in a deduplicator, without writing. Packets are given distinct timestamps 1 ns apart and the
+ * window is 0, so every packet is hashed, looked up and remembered, and none is a duplicate. Bytes are frame bytes.
+ *
+ * @param packets Packets to look up.
+ * @param result Benchmark result to fill.
+ */
+void bench_dedup_lookup(const std::vector<PcapWriter::packet_t>& packets, bench_result* result);
+
+/**
+ * Writes packets in batches with write_packets() through a file descriptor sink, with a checkpoint every
+ * DURABILITY_INTERVAL_BYTES or DURABILITY_INTERVAL_MS. Elapsed time includes the final sync of the whole file.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @param durability Durability level of checkpoints, or nullptr to leave syncing to the kernel.
+ * @param result Benchmark result to fill.
+ * @param syncs Number of sync calls, filled by this function.
+ * @return True if all packets have been written and synced successfully; otherwise false.
+ */
+bool bench_durability(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets,
+	const DurabilityPolicy::level* durability, bench_result* result, uint64_t* syncs);
+
+/**
+ * Evicts a file from the page cache, so that it is read from storage again. Has no effect on tmpfs.
+ *
+ * @param path The file path.
+ */
+void evict_file(const std::string& path);
+
+/**
+ * Reads the output file written by the last benchmark from cold cache. Bytes are counted over the whole file.
+ *
+ * @param parameters Benchmark parameters.
+ * @param mode How the file is read.
+ * @param result Benchmark result to fill.
+ * @return True if the file has been read successfully; otherwise false.
+ */
+bool bench_read(const cmd_parameters& parameters, read_mode mode, bench_result* result);
+
+/**
+ * Reads a file written by CompressedSink at random offsets with CompressedReader::read(), and compares every read with
+ * the same range of the output file written by the last benchmark, which must hold the same packets uncompressed.
+ * Elapsed time includes reading the plain file, which stays in the page cache. Bytes are counted over all reads.
+ *
+ * @param parameters Benchmark parameters.
+ * @param compressed_file_name Path of the compressed file.
+ * @param result Benchmark result to fill, one packet per read.
+ * @return True if every read matches the plain file; otherwise false.
+ */
+bool bench_compressed_read(const cmd_parameters& parameters, const std::string& compressed_file_name,
+	bench_result* result);
+
+/**
+ * Copies records of the output file written by the last benchmark to a new file, either with PcapSlicer or with a
+ * PcapReader::next() and PcapWriter::write_packet() loop. The input stays in the page cache. Bytes are counted over the
+ * new file.
+ *
+ * @param parameters Benchmark parameters.
+ * @param mode Which records are copied.
+ * @param use_slicer True to copy with PcapSlicer, false with the write_packet() loop.
+ * @param result Benchmark result to fill.
+ * @return True if the records have been copied successfully; otherwise false.
+ */
+bool bench_slice(const cmd_parameters& parameters, slice_mode mode, bool use_slicer, bench_result* result);
+
+/**
+ * Prints one benchmark result line. Latency percentiles of write calls are printed if they have been recorded.
+ *
+ * @param name Name of the benchmarked write path.
+ * @param result Benchmark result to print; its latencies are sorted.
+ */
+void print_result(const char* name, bench_result& result);
+
+/**
+ * Runs every benchmark on parameters.output_file_name and prints their results.
+ *
+ * @param parameters Benchmark parameters.
+ * @param packets Packets to write.
+ * @return True if every benchmark has succeeded; otherwise false.
+ */
+bool run_suite(const cmd_parameters& parameters, const std::vector<PcapWriter::packet_t>& packets);
+
+#endif
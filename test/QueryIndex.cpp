@@ -0,0 +1,303 @@
+#include "QueryIndex.h"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "FdSink.h"
+#include "PacketFilter.h"
+#include "PcapWriter.h"
+
+using namespace std;
+
+cmd_parameters::cmd_parameters()
+: output_file_name("query.pcap")
+, build(false)
+, bloom_size(512)
+, from(0)
+, to(UINT64_MAX)
+, has_flow(false)
+, flow_hash(0)
+, verify(false)
+{
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program builds and queries sidecar indexes of pcap files with pcap file writer's library.\n");
+	printf(" Usage : %s -r <input_file> -x <index_file> -b -B <SIZE> -t <FROM>,<TO> -F <FLOW> -o <output_file>\n\n",
+		program_name);
+	printf("\t[-r <input_file>]\t: Input pcap file name.\n");
+	printf("\t[-x <index_file>]\t: Index file name (default: input file name followed by \".idx\").\n");
+	printf("\t[-b]\t\t\t: Build the index of the input file.\n");
+	printf("\t[-B <SIZE>]\t\t: Bloom filter bytes per block when building, 0 not to index flows.\n");
+	printf("\t[-t <FROM>,<TO>]\t: Time range in seconds, e.g. 1500000000.25,1500000001.\n");
+	printf("\t[-F <FLOW>]\t\t: Flow as source,destination,protocol,source_port,destination_port.\n");
+	printf("\t[-o <output_file>]\t: Output file name of matching packets.\n");
+	printf("\t[-v]\t\t\t: Compare the query result with a scan of the whole input file.\n");
+	printf("\t[-h]\t\t\t: This help menu.\n\n");
+}
+
+bool parse_time(const char* text, uint64_t* timestamp)
+{
+	char* end = nullptr;
+	const unsigned long long int seconds = strtoull(text, &end, 10);
+	if (end == text)
+		return false;
+
+	uint64_t fraction = 0;
+	if (*end == '.')
+	{
+		// Digits beyond nanoseconds are ignored.
+		uint64_t scale = 100000000;
+		for (++end; *end >= '0' && *end <= '9'; ++end)
+		{
+			fraction += static_cast<uint64_t>(*end - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	*timestamp = static_cast<uint64_t>(seconds) * 1000000000 + fraction;
+	return *end == '\0' || *end == ',';
+}
+
+bool parse_flow(const char* text, uint32_t* flow_hash)
+{
+	char source_text[INET6_ADDRSTRLEN] = {};
+	char destination_text[INET6_ADDRSTRLEN] = {};
+	unsigned int protocol = 0;
+	unsigned int source_port = 0;
+	unsigned int destination_port = 0;
+	if (sscanf(text, "%45[^,],%45[^,],%u,%u,%u", source_text, destination_text, &protocol, &source_port,
+		&destination_port) != 5 || protocol > 255 || source_port > 65535 || destination_port > 65535)
+		return false;
+
+	uint8_t source[16];
+	uint8_t destination[16];
+	size_t address_size = 4;
+	if (inet_pton(AF_INET, source_text, source) != 1 || inet_pton(AF_INET, destination_text, destination) != 1)
+	{
+		address_size = 16;
+		if (inet_pton(AF_INET6, source_text, source) != 1 || inet_pton(AF_INET6, destination_text, destination) != 1)
+			return false;
+	}
+
+	*flow_hash = PacketFilter::tuple_hash(source, destination, address_size, static_cast<uint8_t>(protocol),
+		static_cast<uint16_t>(source_port), static_cast<uint16_t>(destination_port), 0);
+	return true;
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+	const char* separator = nullptr;
+
+	while ((cmds = getopt(argc, argv, "r:x:bB:t:F:o:vh")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'r':
+				parameters->input_file_name = optarg;
+				break;
+			case 'x':
+				parameters->index_file_name = optarg;
+				break;
+			case 'b':
+				parameters->build = true;
+				break;
+			case 'B':
+				parameters->bloom_size = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+				break;
+			case 't':
+				separator = strchr(optarg, ',');
+				if (!separator || !parse_time(optarg, &parameters->from) || !parse_time(separator + 1, &parameters->to))
+				{
+					fprintf(stderr, "Invalid time range '%s'!\n", optarg);
+					return false;
+				}
+				break;
+			case 'F':
+				if (!parse_flow(optarg, &parameters->flow_hash))
+				{
+					fprintf(stderr, "Invalid flow '%s'!\n", optarg);
+					return false;
+				}
+				parameters->has_flow = true;
+				break;
+			case 'o':
+				parameters->output_file_name = optarg;
+				break;
+			case 'v':
+				parameters->verify = true;
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	if (parameters->input_file_name.empty())
+	{
+		print_usage(argv[0]);
+		return false;
+	}
+
+	if (parameters->index_file_name.empty())
+		parameters->index_file_name = parameters->input_file_name + ".idx";
+
+	return true;
+}
+
+bool build_index(const cmd_parameters& parameters)
+{
+	PcapReader reader;
+	if (!reader.open(parameters.input_file_name))
+	{
+		fprintf(stderr, "Could not open input file '%s'!\n", parameters.input_file_name.c_str());
+		return false;
+	}
+
+	PcapIndex index(4096, 100000000, parameters.bloom_size);
+	if (!index.open(parameters.index_file_name))
+	{
+		fprintf(stderr, "Could not open index file '%s'!\n", parameters.index_file_name.c_str());
+		return false;
+	}
+
+	uint64_t offset = reader.offset();
+	PcapReader::record_t record;
+	while (reader.next(&record))
+	{
+		const uint64_t timestamp = record.ts_sec * 1000000000ull + record.ts_nsec;
+		index.add(timestamp, offset, static_cast<uint32_t>(reader.offset() - offset), record.frame, record.caplen);
+		offset = reader.offset();
+	}
+
+	if (!index.close())
+	{
+		fprintf(stderr, "Writing index file '%s' failed!\n", parameters.index_file_name.c_str());
+		return false;
+	}
+
+	printf("%llu blocks written to '%s'.\n", static_cast<unsigned long long int>(index.blocks()),
+		parameters.index_file_name.c_str());
+	return true;
+}
+
+bool matches(const cmd_parameters& parameters, const PcapReader::record_t& record)
+{
+	const uint64_t timestamp = record.ts_sec * 1000000000ull + record.ts_nsec;
+	if (timestamp < parameters.from || timestamp > parameters.to)
+		return false;
+
+	return !parameters.has_flow || PacketFilter::flow_hash(record.frame, record.caplen, 0) == parameters.flow_hash;
+}
+
+bool query_index(const cmd_parameters& parameters)
+{
+	PcapIndexReader index;
+	if (!index.open(parameters.index_file_name))
+	{
+		fprintf(stderr, "Could not open index file '%s'!\n", parameters.index_file_name.c_str());
+		return false;
+	}
+
+	PcapReader reader;
+	if (!reader.open(parameters.input_file_name))
+	{
+		fprintf(stderr, "Could not open input file '%s'!\n", parameters.input_file_name.c_str());
+		return false;
+	}
+
+	vector<PcapIndexReader::region_t> regions;
+	if (parameters.has_flow)
+		index.find_flow(parameters.flow_hash, parameters.from, parameters.to, &regions);
+	else
+		index.find(parameters.from, parameters.to, &regions);
+
+	FdSink sink;
+	if (!sink.open(parameters.output_file_name))
+	{
+		fprintf(stderr, "Could not open output file '%s'!\n", parameters.output_file_name.c_str());
+		return false;
+	}
+
+	PcapWriter writer;
+	writer.set_snaplen(reader.header().snaplen);
+	if (writer.write_pcap_header(&sink, reader.header().linktype) < 0)
+		return false;
+
+	uint64_t scanned = 0;
+	uint64_t matched = 0;
+	PcapReader::record_t record;
+	for (const PcapIndexReader::region_t& region : regions)
+	{
+		if (!reader.seek(region.offset))
+		{
+			fprintf(stderr, "Index does not match input file '%s'!\n", parameters.input_file_name.c_str());
+			return false;
+		}
+
+		while (reader.offset() < region.offset + region.size && reader.next(&record))
+		{
+			if (!matches(parameters, record))
+				continue;
+
+			timeval time;
+			time.tv_sec = static_cast<time_t>(record.ts_sec);
+			time.tv_usec = static_cast<suseconds_t>(record.ts_usec);
+			if (writer.write_packet(record.frame, record.caplen, record.len, time) < 0)
+				return false;
+			++matched;
+		}
+		scanned += region.size;
+	}
+
+	if (!sink.close())
+		return false;
+
+	printf("%zu regions, %llu bytes read, %llu packets written to '%s'.\n", regions.size(),
+		static_cast<unsigned long long int>(scanned), static_cast<unsigned long long int>(matched),
+		parameters.output_file_name.c_str());
+
+	if (parameters.verify)
+	{
+		// A scan of the whole file must find exactly the packets found through the index.
+		uint64_t expected = 0;
+		reader.seek(sizeof(pcap_file_header));
+		while (reader.next(&record))
+			expected += matches(parameters, record);
+
+		printf("Full scan: %llu bytes, %llu packets.\n", static_cast<unsigned long long int>(reader.offset()),
+			static_cast<unsigned long long int>(expected));
+		if (expected != matched)
+		{
+			fprintf(stderr, "Index query missed %llu packets!\n", static_cast<unsigned long long int>(expected - matched));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then either builds the index of the input file, or
+ * writes the packets of the input file which match the query to the output file.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	const bool result = parameters.build ? build_index(parameters) : query_index(parameters);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+#ifndef QUERY_INDEX_H_
+#define QUERY_INDEX_H_
+
+#include <cstdint>
+#include <string>
+
+#include "PcapIndex.h"
+#include "PcapIndexReader.h"
+#include "PcapReader.h"
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Input pcap file path
+	std::string input_file_name;
+
+	/// Index file path, the input path followed by ".idx" if empty
+	std::string index_file_name;
+
+	/// Output file path of matching packets
+	std::string output_file_name;
+
+	/// Build the index of the input file instead of querying it
+	bool build;
+
+	/// Size of the bloom filter of each block when building, 0 not to index flows
+	uint32_t bloom_size;
+
+	/// Lowest timestamp of the query in nanoseconds
+	uint64_t from;
+
+	/// Highest timestamp of the query in nanoseconds
+	uint64_t to;
+
+	/// True if the query is restricted to one flow
+	bool has_flow;
+
+	/// Flow hash of the query, see PacketFilter::tuple_hash()
+	uint32_t flow_hash;
+
+	/// Compare the query result with a scan of the whole input file
+	bool verify;
+};
+
+/// Prints how to use query index tool.
+void print_usage(char* program_name);
+
+/**
+ * Parses a timestamp given as seconds with an optional fraction of up to nine digits, e.g. "1500000000.25".
+ *
+ * @param text The timestamp.
+ * @param timestamp Filled with the timestamp in nanoseconds.
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_time(const char* text, uint64_t* timestamp);
+
+/**
+ * Parses a flow given as "source,destination,protocol,source_port,destination_port" with IPv4 or IPv6 addresses, and
+ * hashes it.
+ *
+ * @param text The flow.
+ * @param flow_hash Filled with the flow hash.
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_flow(const char* text, uint32_t* flow_hash);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+/**
+ * Builds the index of an existing pcap file.
+ *
+ * @param parameters Command line parameters.
+ * @return True for success and false for failure.
+ */
+bool build_index(const cmd_parameters& parameters);
+
+/**
+ * Tests whether a record matches the query.
+ *
+ * @param parameters Command line parameters holding the query.
+ * @param record The record.
+ * @return True if the record matches.
+ */
+bool matches(const cmd_parameters& parameters, const PcapReader::record_t& record);
+
+/**
+ * Writes the packets which match the query to the output file, reading only the regions found in the index.
+ *
+ * @param parameters Command line parameters.
+ * @return True for success and false for failure.
+ */
+bool query_index(const cmd_parameters& parameters);
+
+#endif
@@ -0,0 +1,89 @@
+#include "RecoverFile.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+cmd_parameters::cmd_parameters()
+: dry_run(false)
+{
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program truncates torn records at the end of pcap files with pcap file writer's library.\n");
+	printf(" Usage : %s -n -h <file>...\n\n", program_name);
+	printf("\t[-n]\t: Only report torn records, without truncating files.\n");
+	printf("\t[-h]\t: This help menu.\n\n");
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+
+	while ((cmds = getopt(argc, argv, "nh")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'n':
+				parameters->dry_run = true;
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	for (int i = optind; i < argc; ++i)
+		parameters->input_files.push_back(argv[i]);
+
+	if (parameters->input_files.empty())
+	{
+		print_usage(argv[0]);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then checks every file and truncates it after its
+ * last plausible record. The exit status is non-zero if a file could not be read or repaired.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	int status = EXIT_SUCCESS;
+	for (const string& path : parameters.input_files)
+	{
+		PcapRecovery::report_t report;
+		const bool result = parameters.dry_run ? PcapRecovery::inspect(path, &report)
+			: PcapRecovery::repair(path, &report);
+		if (!result)
+		{
+			fprintf(stderr, "Could not %s '%s'!\n", parameters.dry_run ? "read" : "repair", path.c_str());
+			status = EXIT_FAILURE;
+			continue;
+		}
+
+		const unsigned long long int torn_bytes = report.file_size - report.valid_size;
+		if (torn_bytes == 0)
+			printf("%s: %llu packets, valid.\n", path.c_str(), static_cast<unsigned long long int>(report.packets));
+		else
+			printf("%s: %llu packets, %llu torn bytes %s.\n", path.c_str(),
+				static_cast<unsigned long long int>(report.packets), torn_bytes,
+				parameters.dry_run ? "at end of file" : "truncated");
+	}
+
+	return status;
+}
@@ -0,0 +1,35 @@
+#ifndef RECOVER_FILE_H_
+#define RECOVER_FILE_H_
+
+#include <string>
+#include <vector>
+
+#include "PcapRecovery.h"
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Pcap file paths
+	std::vector<std::string> input_files;
+
+	/// Only report torn records, without truncating files
+	bool dry_run;
+};
+
+/// Prints how to use recover file tool.
+void print_usage(char* program_name);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+#endif
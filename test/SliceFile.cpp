@@ -0,0 +1,220 @@
+#include "SliceFile.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+cmd_parameters::cmd_parameters()
+: output_file_name("slice.pcap")
+, from(0)
+, to(UINT64_MAX)
+, snaplen(0)
+, shift(0)
+, verify(false)
+{
+}
+
+void print_usage(char* program_name)
+{
+	printf("\nThis program copies a part of a pcap file to a new one with pcap file writer's library.\n");
+	printf(" Usage : %s -r <input_file> -o <output_file> -t <FROM>,<TO> -s <SNAPLEN> -S <SHIFT> -x <index_file>\n\n",
+		program_name);
+	printf("\t[-r <input_file>]\t: Input pcap file name.\n");
+	printf("\t[-o <output_file>]\t: Output pcap file name (default: slice.pcap).\n");
+	printf("\t[-t <FROM>,<TO>]\t: Time range in seconds, e.g. 1500000000.25,1500000001.\n");
+	printf("\t[-s <SNAPLEN>]\t\t: Snapshot length of the output, longer packets are truncated.\n");
+	printf("\t[-S <SHIFT>]\t\t: Shift of every timestamp in nanoseconds, may be negative.\n");
+	printf("\t[-x <index_file>]\t: Sidecar index of the input file, see query-index.\n");
+	printf("\t[-v]\t\t\t: Compare the output with the records of the input file.\n");
+	printf("\t[-h]\t\t\t: This help menu.\n\n");
+}
+
+bool parse_time(const char* text, uint64_t* timestamp)
+{
+	char* end = nullptr;
+	const unsigned long long int seconds = strtoull(text, &end, 10);
+	if (end == text)
+		return false;
+
+	uint64_t fraction = 0;
+	if (*end == '.')
+	{
+		// Digits beyond nanoseconds are ignored.
+		uint64_t scale = 100000000;
+		for (++end; *end >= '0' && *end <= '9'; ++end)
+		{
+			fraction += static_cast<uint64_t>(*end - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	*timestamp = static_cast<uint64_t>(seconds) * 1000000000 + fraction;
+	return *end == '\0' || *end == ',';
+}
+
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
+{
+	int cmds = 0;
+	const char* separator = nullptr;
+
+	while ((cmds = getopt(argc, argv, "r:o:t:s:S:x:vh")) != -1)
+	{
+		switch (cmds)
+		{
+			case 'r':
+				parameters->input_file_name = optarg;
+				break;
+			case 'o':
+				parameters->output_file_name = optarg;
+				break;
+			case 't':
+				separator = strchr(optarg, ',');
+				if (!separator || !parse_time(optarg, &parameters->from) || !parse_time(separator + 1, &parameters->to))
+				{
+					fprintf(stderr, "Invalid time range '%s'!\n", optarg);
+					return false;
+				}
+				break;
+			case 's':
+				parameters->snaplen = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+				break;
+			case 'S':
+				parameters->shift = strtoll(optarg, nullptr, 10);
+				break;
+			case 'x':
+				parameters->index_file_name = optarg;
+				break;
+			case 'v':
+				parameters->verify = true;
+				break;
+			case '?':
+			case 'h':
+			default:
+				print_usage(argv[0]);
+				return false;
+		}
+	}
+
+	if (parameters->input_file_name.empty())
+	{
+		print_usage(argv[0]);
+		return false;
+	}
+
+	return true;
+}
+
+bool verify_slice(const cmd_parameters& parameters)
+{
+	PcapReader input;
+	PcapReader output;
+	if (!input.open(parameters.input_file_name) || !output.open(parameters.output_file_name))
+		return false;
+
+	const uint32_t snaplen = parameters.snaplen > 0 ? parameters.snaplen : input.header().snaplen;
+	if (output.header().snaplen != snaplen || output.header().linktype != input.header().linktype
+		|| output.nanoseconds() != input.nanoseconds())
+	{
+		fprintf(stderr, "Global header of the output does not match!\n");
+		return false;
+	}
+
+	// Timestamps of the output keep the resolution of the input.
+	const uint64_t resolution = input.nanoseconds() ? 1 : 1000;
+	uint64_t compared = 0;
+	PcapReader::record_t expected;
+	PcapReader::record_t actual;
+	while (input.next(&expected))
+	{
+		const uint64_t timestamp = expected.ts_sec * 1000000000ull + expected.ts_nsec;
+		if (timestamp < parameters.from || timestamp > parameters.to)
+			continue;
+
+		int64_t shifted = static_cast<int64_t>(timestamp) + parameters.shift;
+		if (shifted < 0)
+			shifted = 0;
+		const uint64_t expected_timestamp = static_cast<uint64_t>(shifted) / resolution * resolution;
+		const uint32_t caplen = expected.caplen < snaplen ? expected.caplen : snaplen;
+
+		if (!output.next(&actual) || actual.ts_sec * 1000000000ull + actual.ts_nsec != expected_timestamp
+			|| actual.caplen != caplen || actual.len != expected.len || memcmp(actual.frame, expected.frame, caplen) != 0)
+		{
+			fprintf(stderr, "Record %llu of the output does not match!\n", static_cast<unsigned long long int>(compared));
+			return false;
+		}
+		++compared;
+	}
+
+	if (output.next(&actual))
+	{
+		fprintf(stderr, "Output has more than %llu records!\n", static_cast<unsigned long long int>(compared));
+		return false;
+	}
+
+	printf("Verified %llu records.\n", static_cast<unsigned long long int>(compared));
+	return true;
+}
+
+/**
+ * Main function and entry point of this program.
+ *
+ * Main function takes the command line arguments and parses them, then copies the records of the input file in the
+ * time range to the output file with PcapSlicer, and prints how many bytes the kernel has copied.
+ */
+int main(int argc, char* argv[])
+{
+	cmd_parameters parameters;
+	if (!parse_command_line(argc, argv, &parameters))
+		return 1;
+
+	PcapSlicer slicer;
+	if (!slicer.open(parameters.input_file_name))
+	{
+		fprintf(stderr, "Could not open input file '%s'!\n", parameters.input_file_name.c_str());
+		return EXIT_FAILURE;
+	}
+
+	PcapIndexReader index;
+	if (!parameters.index_file_name.empty())
+	{
+		if (!index.open(parameters.index_file_name))
+		{
+			fprintf(stderr, "Could not open index file '%s'!\n", parameters.index_file_name.c_str());
+			return EXIT_FAILURE;
+		}
+		slicer.set_index(&index);
+	}
+
+	slicer.set_time_range(parameters.from, parameters.to);
+	slicer.set_snaplen(parameters.snaplen);
+	slicer.set_time_shift(parameters.shift);
+
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const long long int bytes = slicer.slice(parameters.output_file_name);
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (bytes < 0)
+	{
+		fprintf(stderr, "Writing output file '%s' failed!\n", parameters.output_file_name.c_str());
+		return EXIT_FAILURE;
+	}
+
+	const PcapSlicer::statistics_t& statistics = slicer.statistics();
+	printf("%llu records, %lld bytes written to '%s' in %.3f ms (%.2f GB/s).\n",
+		static_cast<unsigned long long int>(statistics.records), bytes, parameters.output_file_name.c_str(),
+		seconds * 1e3, seconds > 0 ? bytes / seconds / 1e9 : 0.0);
+	printf("Kernel copies: %llu calls, %llu bytes; buffered: %llu bytes; rewritten headers: %llu.\n",
+		static_cast<unsigned long long int>(statistics.kernel_copies),
+		static_cast<unsigned long long int>(statistics.kernel_bytes),
+		static_cast<unsigned long long int>(statistics.buffered_bytes),
+		static_cast<unsigned long long int>(statistics.rewritten));
+
+	if (parameters.verify && !verify_slice(parameters))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#ifndef SLICE_FILE_H_
+#define SLICE_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "PcapIndexReader.h"
+#include "PcapReader.h"
+#include "PcapSlicer.h"
+
+/// Structure to store command line parameters.
+struct cmd_parameters
+{
+	cmd_parameters();
+
+	/// Input pcap file path
+	std::string input_file_name;
+
+	/// Output pcap file path
+	std::string output_file_name;
+
+	/// Sidecar index file path, or empty to walk every record
+	std::string index_file_name;
+
+	/// Lowest kept timestamp in nanoseconds
+	uint64_t from;
+
+	/// Highest kept timestamp in nanoseconds
+	uint64_t to;
+
+	/// Snapshot length of the output, 0 for the input's one
+	uint32_t snaplen;
+
+	/// Shift of timestamps in nanoseconds
+	int64_t shift;
+
+	/// Compare the output with the records of the input it should hold
+	bool verify;
+};
+
+/// Prints how to use slice file tool.
+void print_usage(char* program_name);
+
+/**
+ * Parses a timestamp given as seconds with an optional fraction of up to nine digits, e.g. "1500000000.25".
+ *
+ * @param text The timestamp.
+ * @param timestamp Filled with the timestamp in nanoseconds.
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_time(const char* text, uint64_t* timestamp);
+
+/**
+ * Parses command line arguments, and fills the given cmd_parameters struct fields.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @param parameters Structure of cmd_parameters to fill.
+ *
+ * @return True if parsing successfully; otherwise false.
+ */
+bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
+
+/**
+ * Reads the output file back and compares every record with the record of the input it should be made of.
+ *
+ * @param parameters Command line parameters.
+ * @return True if the output holds exactly the expected records.
+ */
+bool verify_slice(const cmd_parameters& parameters);
+
+#endif
@@ -39,7 +39,7 @@ long int capture(PcapWriter& writer, int num_packet_capture, pcap_t** handle)
 			continue;
 		}
 
-		writer.write_packet((const char*)packet, header.len, header.ts);
+		writer.write_packet((const char*)packet, header.caplen, header.len, header.ts);
 		/*
 		 * To see captured packets uncomment the code below.
 		 * printf("Packet #%5d captured \tlen:%5d\n", (i + 1), header.len);
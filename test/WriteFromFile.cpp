@@ -3,6 +3,9 @@
 cmd_parameters::cmd_parameters()
 : input_file("")
 , output_file("out.pcap")
+, sink_type("stream")
+, filter_expression("")
+, use_reader(false)
 {
 }
 
@@ -38,9 +41,12 @@ void dump_hex(const unsigned char* data, unsigned int size)
 void print_usage(char* program_name)
 {
 	printf("\nThis program has been written to test pcap file writer's library.\n");
-	printf(" Usage : %s -i <input_file> -o <output_file> -h\n\n", program_name);
+	printf(" Usage : %s -i <input_file> -o <output_file> -s <sink> -F <expression> -r -h\n\n", program_name);
 	printf("\t-i <input_file>\t: Input file name.\n");
 	printf("\t[-o <output_file]>\t: Output file name.\n");
+	printf("\t[-s <sink>]\t: Pcap Writer output: stream, fd, direct, uring or mmap.\n");
+	printf("\t[-F <expression>]\t: Writes only packets matching this filter expression.\n");
+	printf("\t[-r]\t\t: Reads packets for Pcap Writer with PcapReader and compares them with libpcap's.\n");
 	printf("\t[-h]\t\t: This help menu.\n\n");
 }
 
@@ -48,7 +54,7 @@ bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
 {
 	int cmds = 0;
 
-	while ((cmds = getopt(argc, argv, "i:o:h")) != -1)
+	while ((cmds = getopt(argc, argv, "i:o:s:F:rh")) != -1)
 	{
 		switch (cmds)
 		{
@@ -58,6 +64,15 @@ bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
 			case 'o':
 				parameters->output_file = optarg;
 				break;
+			case 's':
+				parameters->sink_type = optarg;
+				break;
+			case 'F':
+				parameters->filter_expression = optarg;
+				break;
+			case 'r':
+				parameters->use_reader = true;
+				break;
 			case '?':
 			case 'h':
 			default:
@@ -75,6 +90,45 @@ bool parse_command_line(int argc, char** argv, cmd_parameters* parameters)
 	return true;
 }
 
+PcapSink* open_sink(const string& sink_type, const string& path)
+{
+	PcapSink* sink = nullptr;
+	bool opened = false;
+
+	if (sink_type == "fd")
+	{
+		FdSink* fd_sink = new FdSink();
+		opened = fd_sink->open(path);
+		sink = fd_sink;
+	}
+	else if (sink_type == "direct")
+	{
+		DirectSink* direct_sink = new DirectSink();
+		opened = direct_sink->open(path);
+		sink = direct_sink;
+	}
+	else if (sink_type == "uring")
+	{
+		UringSink* uring_sink = new UringSink();
+		opened = uring_sink->open(path);
+		sink = uring_sink;
+	}
+	else if (sink_type == "mmap")
+	{
+		MmapSink* mmap_sink = new MmapSink();
+		opened = mmap_sink->open(path);
+		sink = mmap_sink;
+	}
+
+	if (!opened)
+	{
+		delete sink;
+		return nullptr;
+	}
+
+	return sink;
+}
+
 int main(int argc, char** argv)
 {
 	// Register all signal types you want to handle.
@@ -107,8 +161,20 @@ int main(int argc, char** argv)
 	 * 0666 means user, group and others have read and write permission on this file.
 	 */
 	std::fstream output_stream;
-	output_stream.open(writer_file_name.c_str(), std::fstream::out);
-	if (!output_stream.good())
+	PcapSink* output_sink = nullptr;
+	bool opened = false;
+	if (!strcmp(parameters.sink_type, "stream"))
+	{
+		output_stream.open(writer_file_name.c_str(), std::fstream::out);
+		opened = output_stream.good();
+	}
+	else
+	{
+		output_sink = open_sink(parameters.sink_type, writer_file_name);
+		opened = output_sink != nullptr;
+	}
+
+	if (!opened)
 	{
 		cerr << "Could not open output file for Pcap Writer!" << endl;
 		return EXIT_FAILURE;
@@ -117,7 +183,36 @@ int main(int argc, char** argv)
 	chmod(writer_file_name.c_str(), 0666);
 
 	PcapWriter writer;
-	writer.write_pcap_header(&output_stream, 1);		// Link type 1 = Ethernet
+	if (output_sink)
+		writer.write_pcap_header(output_sink, 1);		// Link type 1 = Ethernet
+	else
+		writer.write_pcap_header(&output_stream, 1);		// Link type 1 = Ethernet
+
+	/*
+	 * The same compiled filter is run by PcapWriter through PacketFilter and by libpcap before dumping, so both
+	 * outputs are still equal only if both agree on every packet.
+	 */
+	bpf_program filter_program = bpf_program();
+	PacketFilter filter;
+	if (strcmp(parameters.filter_expression, "") != 0)
+	{
+		if (pcap_compile(handle, &filter_program, parameters.filter_expression, 1, PCAP_NETMASK_UNKNOWN) != 0
+			|| filter.add_bpf(&filter_program) < 0)
+		{
+			cerr << "Could not compile filter : '" << pcap_geterr(handle) << "'." << endl;
+			return EXIT_FAILURE;
+		}
+
+		writer.set_filter(&filter);
+	}
+
+	// PcapReader walks the same file alongside libpcap, and every record must be equal to libpcap's one.
+	PcapReader reader;
+	if (parameters.use_reader && !reader.open(parameters.input_file))
+	{
+		cerr << "Could not open pcap file with PcapReader!" << endl;
+		return EXIT_FAILURE;
+	}
 
 	const unsigned char* pkt = nullptr;
 	pcap_pkthdr* pkthdr = nullptr;
@@ -125,6 +220,7 @@ int main(int argc, char** argv)
 	unsigned long long packet_count = 0;
 	unsigned long long caplen = 0;
 	unsigned long long len = 0;
+	unsigned long long reader_mismatches = 0;
 
 	// Reads packet.
 	while (pcap_next_ex(handle, &pkthdr, &pkt) >= 0)
@@ -135,8 +231,29 @@ int main(int argc, char** argv)
 		caplen += pkthdr->caplen;
 
 		// Writes Packet to file.
-		pcap_dump(reinterpret_cast<u_char*>(dumper), pkthdr, pkt);
-		writer_total_bytes += writer.write_packet(reinterpret_cast<const char*>(pkt), pkthdr->caplen, pkthdr->ts);
+		if (filter_program.bf_len == 0 || bpf_filter(filter_program.bf_insns, pkt, pkthdr->len, pkthdr->caplen) != 0)
+			pcap_dump(reinterpret_cast<u_char*>(dumper), pkthdr, pkt);
+		if (parameters.use_reader)
+		{
+			PcapReader::record_t record;
+			if (!reader.next(&record) || record.caplen != pkthdr->caplen || record.len != pkthdr->len
+				|| record.ts_sec != static_cast<uint32_t>(pkthdr->ts.tv_sec)
+				|| record.ts_usec != static_cast<uint32_t>(pkthdr->ts.tv_usec) || memcmp(record.frame, pkt, record.caplen))
+			{
+				++reader_mismatches;
+				continue;
+			}
+
+			timeval time;
+			time.tv_sec = static_cast<time_t>(record.ts_sec);
+			time.tv_usec = static_cast<suseconds_t>(record.ts_usec);
+			writer_total_bytes += writer.write_packet(record.frame, record.caplen, record.len, time);
+		}
+		else
+		{
+			writer_total_bytes += writer.write_packet(reinterpret_cast<const char*>(pkt), pkthdr->caplen, pkthdr->len,
+				pkthdr->ts);
+		}
 
 		/*
 		 * Dump content in hex formated.
@@ -160,10 +277,21 @@ int main(int argc, char** argv)
 	 * Total file size is caplen + size of pcap_file_header + (size of pcap_pkthdr * packet_count).
 	 */
 	cout << "Output size must be: " << (caplen  + 24 + (16 * packet_count)) << endl;
+	if (parameters.use_reader)
+		cout << "PcapReader mismatches : " << reader_mismatches << endl;
+	if (filter.stages() > 0)
+		cout << "Filter hits          : " << filter.counters(0).hits << " of " << filter.counters(0).evaluated << endl;
 	cout << signals.size() << " signal(s) handled :" << endl;
 	for (map<const int, int>::value_type& signal : signals)
 		cout << "signal " << signal.first << " caught " << signal.second << " times." << endl;
-	output_stream.close();
+	if (output_sink)
+	{
+		output_sink->close();
+		delete output_sink;
+	}
+	else
+		output_stream.close();
+	pcap_freecode(&filter_program);
 	pcap_dump_close(dumper);
 	pcap_close(handle);
 
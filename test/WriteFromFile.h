@@ -14,7 +14,13 @@
 #include <fstream>
 
 #include "signal-handler/SignalHandler.h"
+#include "DirectSink.h"
+#include "FdSink.h"
+#include "MmapSink.h"
+#include "PacketFilter.h"
+#include "PcapReader.h"
 #include "PcapWriter.h"
+#include "UringSink.h"
 
 using namespace std;
 
@@ -28,6 +34,15 @@ struct cmd_parameters
 
 	/// Output file path
 	const char* output_file;
+
+	/// Output sink type of Pcap Writer: stream, fd, direct, uring or mmap
+	const char* sink_type;
+
+	/// Filter expression applied to both outputs, or empty to write every packet
+	const char* filter_expression;
+
+	/// Read packets for Pcap Writer with PcapReader instead of libpcap
+	bool use_reader;
 };
 
 map<int, int> signals;
@@ -52,4 +67,14 @@ void print_usage(char* program_name);
  */
 bool parse_command_line(int argc, char** argv, cmd_parameters* parameters);
 
+/**
+ * Creates and opens the output sink of the given type for Pcap Writer.
+ *
+ * @param sink_type Sink type: fd, direct, uring or mmap.
+ * @param path The output file path.
+ *
+ * @return Opened sink, or nullptr if the type is unknown or the file could not be opened.
+ */
+PcapSink* open_sink(const string& sink_type, const string& path);
+
 #endif
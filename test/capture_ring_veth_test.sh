@@ -0,0 +1,61 @@
+#!/bin/bash
+
+input="$1"
+output="ring_output.pcap"
+namespace="pcap-writer-ring"
+
+# If the input arguments are not correct, echo how to use script.
+if [ "$input" == "" ];
+then
+	echo "Usage : ./capture_ring_veth_test.sh <input_pcap_file>"
+	exit -1
+fi
+
+input=$(readlink -f "$input")
+
+mkdir -p ./build		# Create build directory if needed.
+cd ./build		# Change current directory to build.
+
+if [ -e $output ]
+then
+	rm $output
+fi
+
+cmake ..
+make capture-ring
+
+# A veth pair inside a private network namespace, with IPv6 disabled so that no packet but the replayed ones crosses it.
+ip netns add $namespace || exit 1
+ip netns exec $namespace sysctl -q -w net.ipv6.conf.all.disable_ipv6=1 net.ipv6.conf.default.disable_ipv6=1
+ip netns exec $namespace ip link add ring0 mtu 9000 type veth peer name ring1 mtu 9000
+ip netns exec $namespace ip link set ring0 up
+ip netns exec $namespace ip link set ring1 up
+
+# Captures on one end until interrupted, while the input file is replayed to the other end. The capture is then
+# compared with the input record by record: timestamps differ, but lengths and frames, with VLAN tags which the
+# kernel has stripped inserted back, must be the same.
+ip netns exec $namespace ./capture-ring -i ring1 -f $output -v "$input" &
+capture_pid=$!
+sleep 1
+ip netns exec $namespace ./capture-ring -i ring0 -r "$input"
+sleep 1
+kill -INT $capture_pid
+wait $capture_pid
+capture_status=$?
+
+ip netns del $namespace
+
+# Change color scheme. 1 for red, 2 for green, 3 for yellow, 4 for blue and etc.
+txtred=$(tput setaf 1)
+txtgreen=$(tput setaf 2)
+# Reset color scheme to default.
+txtrst=$(tput sgr0)
+
+echo "------------------------------------"
+if [ "$capture_status" == "0" ]
+then
+	echo "${txtgreen}Every replayed packet has been captured unchanged.${txtrst}" # Change color and reset at the end of line.
+else
+	echo "${txtred}Captured records differ from the input file.${txtrst}"
+fi
+echo "------------------------------------"
@@ -30,11 +30,29 @@ then
 	rm writer_$output2
 fi
 
+if [ -e writer_mmap_$output2 ]
+then
+	rm writer_mmap_$output2
+fi
+
+if [ -e writer_reader_$output2 ]
+then
+	rm writer_reader_$output2
+fi
+
+if [ -e writer_filtered_$output2 ]
+then
+	rm filtered_$output2 writer_filtered_$output2
+fi
+
 # Make and run tests with appropriate arguments.
 cmake ..
 make
 ./write-from-device  -f $output1 -n $packet_number
 ./write-from-file -i ./$output1 -o $output2
+./write-from-file -i ./$output1 -o mmap_$output2 -s mmap
+./write-from-file -i ./$output1 -o reader_$output2 -r
+./write-from-file -i ./$output1 -o filtered_$output2 -F "tcp or (udp and not port 53)"
 
 # Change color scheme. 1 for red, 2 for green, 3 for yellow, 4 for blue and etc.
 txtred=$(tput setaf 1)
@@ -46,17 +64,34 @@ txtrst=$(tput sgr0)
 result_file1=$(md5sum ${output1} | cut -f1 -d' ')
 result_file2=$(md5sum ${output2} | cut -f1 -d' ')
 result_file3=$(md5sum writer_${output2} | cut -f1 -d' ')
+result_file4=$(md5sum writer_mmap_${output2} | cut -f1 -d' ')
+result_file5=$(md5sum writer_reader_${output2} | cut -f1 -d' ')
 echo "------------------------------------"
 echo "md5sum of all output files : "
 echo $result_file1 : Written from device 
 echo $result_file2 : Written from out.pcap with libpcap 
 echo $result_file3 : Written from out.pcap with PcapWriter 
-if [ "$result_file1" == "$result_file2" ] && [ "$result_file2" == "$result_file3" ]
+echo $result_file4 : Written from out.pcap with PcapWriter and MmapSink
+echo $result_file5 : Read from out.pcap with PcapReader and written with PcapWriter
+if [ "$result_file1" == "$result_file2" ] && [ "$result_file2" == "$result_file3" ] && [ "$result_file3" == "$result_file4" ] \
+	&& [ "$result_file4" == "$result_file5" ]
 then
 	echo "${txtgreen}md5sum outputs for these files are equal.${txtrst}" # Change color and reset at the end of line.
 else
 	echo "${txtred}md5sum outputs for these files are NOT equal.${txtrst}"
 
 fi
+
+# The filtered outputs of libpcap and PcapWriter must be equal to each other.
+result_file6=$(md5sum filtered_${output2} | cut -f1 -d' ')
+result_file7=$(md5sum writer_filtered_${output2} | cut -f1 -d' ')
+echo $result_file6 : Filtered from out.pcap with libpcap
+echo $result_file7 : Filtered from out.pcap with PcapWriter and PacketFilter
+if [ "$result_file6" == "$result_file7" ]
+then
+	echo "${txtgreen}md5sum outputs for filtered files are equal.${txtrst}"
+else
+	echo "${txtred}md5sum outputs for filtered files are NOT equal.${txtrst}"
+fi
 echo "------------------------------------"
 